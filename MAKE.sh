@@ -155,8 +155,218 @@ else
 fi
 
 
-echo -e "\n\r>> LINK: "${Link[@]}" "$buildDir"/avr_fat_test.elf "$buildDir"/avr_fat_test.o  "$buildDir"/avr_spi.o "$buildDir"/sd_spi_base.o "$buildDir"/sd_spi_rwe.o "$buildDir"/avr_usart.o "$buildDir"/prints.o "$buildDir"/fat_bpb.o "$buildDir"/fat.o "$buildDir"/fat_to_sd.o"
-"${Link[@]}" $buildDir/avr_fat_test.elf $buildDir/avr_fat_test.o $buildDir/avr_spi.o $buildDir/sd_spi_base.o $buildDir/sd_spi_rwe.o $buildDir/avr_usart.o $buildDir/prints.o $buildDir/fat.o $buildDir/fat_bpb.o $buildDir/fat_to_sd.o
+echo -e "\n\r>> COMPILE: "${Compile[@]}" "$buildDir"/fat_search.o "$fatDir"/fat_search.c"
+"${Compile[@]}" $buildDir/fat_search.o $fatDir/fat_search.c
+status=$?
+sleep $t
+if [ $status -gt 0 ]
+then
+    echo -e "error compiling FAT_SEARCH.C"
+    echo -e "program exiting with code $status"
+    exit $status
+else
+    echo -e "Compiling FAT_SEARCH.C successful"
+fi
+
+
+echo -e "\n\r>> COMPILE: "${Compile[@]}" "$buildDir"/fat_kv.o "$fatDir"/fat_kv.c"
+"${Compile[@]}" $buildDir/fat_kv.o $fatDir/fat_kv.c
+status=$?
+sleep $t
+if [ $status -gt 0 ]
+then
+    echo -e "error compiling FAT_KV.C"
+    echo -e "program exiting with code $status"
+    exit $status
+else
+    echo -e "Compiling FAT_KV.C successful"
+fi
+
+
+echo -e "\n\r>> COMPILE: "${Compile[@]}" "$buildDir"/fat_lz.o "$fatDir"/fat_lz.c"
+"${Compile[@]}" $buildDir/fat_lz.o $fatDir/fat_lz.c
+status=$?
+sleep $t
+if [ $status -gt 0 ]
+then
+    echo -e "error compiling FAT_LZ.C"
+    echo -e "program exiting with code $status"
+    exit $status
+else
+    echo -e "Compiling FAT_LZ.C successful"
+fi
+
+
+echo -e "\n\r>> COMPILE: "${Compile[@]}" "$buildDir"/fat_sum.o "$fatDir"/fat_sum.c"
+"${Compile[@]}" $buildDir/fat_sum.o $fatDir/fat_sum.c
+status=$?
+sleep $t
+if [ $status -gt 0 ]
+then
+    echo -e "error compiling FAT_SUM.C"
+    echo -e "program exiting with code $status"
+    exit $status
+else
+    echo -e "Compiling FAT_SUM.C successful"
+fi
+
+
+echo -e "\n\r>> COMPILE: "${Compile[@]}" "$buildDir"/fat_ioq.o "$fatDir"/fat_ioq.c"
+"${Compile[@]}" $buildDir/fat_ioq.o $fatDir/fat_ioq.c
+status=$?
+sleep $t
+if [ $status -gt 0 ]
+then
+    echo -e "error compiling FAT_IOQ.C"
+    echo -e "program exiting with code $status"
+    exit $status
+else
+    echo -e "Compiling FAT_IOQ.C successful"
+fi
+
+
+echo -e "\n\r>> COMPILE: "${Compile[@]}" "$buildDir"/avr_timer.o "$ioDir"/avr_timer.c"
+"${Compile[@]}" $buildDir/avr_timer.o $ioDir/avr_timer.c
+status=$?
+sleep $t
+if [ $status -gt 0 ]
+then
+    echo -e "error compiling AVR_TIMER.C"
+    echo -e "program exiting with code $status"
+    exit $status
+else
+    echo -e "Compiling AVR_TIMER.C successful"
+fi
+
+
+echo -e "\n\r>> COMPILE: "${Compile[@]}" "$buildDir"/fat_cache.o "$fatDir"/fat_cache.c"
+"${Compile[@]}" $buildDir/fat_cache.o $fatDir/fat_cache.c
+status=$?
+sleep $t
+if [ $status -gt 0 ]
+then
+    echo -e "error compiling FAT_CACHE.C"
+    echo -e "program exiting with code $status"
+    exit $status
+else
+    echo -e "Compiling FAT_CACHE.C successful"
+fi
+
+
+echo -e "\n\r>> COMPILE: "${Compile[@]}" "$buildDir"/fat_stream.o "$fatDir"/fat_stream.c"
+"${Compile[@]}" $buildDir/fat_stream.o $fatDir/fat_stream.c
+status=$?
+sleep $t
+if [ $status -gt 0 ]
+then
+    echo -e "error compiling FAT_STREAM.C"
+    echo -e "program exiting with code $status"
+    exit $status
+else
+    echo -e "Compiling FAT_STREAM.C successful"
+fi
+
+
+echo -e "\n\r>> COMPILE: "${Compile[@]}" "$buildDir"/fat_ring.o "$fatDir"/fat_ring.c"
+"${Compile[@]}" $buildDir/fat_ring.o $fatDir/fat_ring.c
+status=$?
+sleep $t
+if [ $status -gt 0 ]
+then
+    echo -e "error compiling FAT_RING.C"
+    echo -e "program exiting with code $status"
+    exit $status
+else
+    echo -e "Compiling FAT_RING.C successful"
+fi
+
+
+echo -e "\n\r>> COMPILE: "${Compile[@]}" "$buildDir"/sd_spi_info.o "$sdDir"/sd_spi_info.c"
+"${Compile[@]}" $buildDir/sd_spi_info.o $sdDir/sd_spi_info.c
+status=$?
+sleep $t
+if [ $status -gt 0 ]
+then
+    echo -e "error compiling SD_SPI_INFO.C"
+    echo -e "program exiting with code $status"
+    exit $status
+else
+    echo -e "Compiling SD_SPI_INFO.C successful"
+fi
+
+
+echo -e "\n\r>> COMPILE: "${Compile[@]}" "$buildDir"/fat_probe.o "$fatDir"/fat_probe.c"
+"${Compile[@]}" $buildDir/fat_probe.o $fatDir/fat_probe.c
+status=$?
+sleep $t
+if [ $status -gt 0 ]
+then
+    echo -e "error compiling FAT_PROBE.C"
+    echo -e "program exiting with code $status"
+    exit $status
+else
+    echo -e "Compiling FAT_PROBE.C successful"
+fi
+
+
+echo -e "\n\r>> COMPILE: "${Compile[@]}" "$buildDir"/fat_warm.o "$fatDir"/fat_warm.c"
+"${Compile[@]}" $buildDir/fat_warm.o $fatDir/fat_warm.c
+status=$?
+sleep $t
+if [ $status -gt 0 ]
+then
+    echo -e "error compiling FAT_WARM.C"
+    echo -e "program exiting with code $status"
+    exit $status
+else
+    echo -e "Compiling FAT_WARM.C successful"
+fi
+
+
+echo -e "\n\r>> COMPILE: "${Compile[@]}" "$buildDir"/fat_neg.o "$fatDir"/fat_neg.c"
+"${Compile[@]}" $buildDir/fat_neg.o $fatDir/fat_neg.c
+status=$?
+sleep $t
+if [ $status -gt 0 ]
+then
+    echo -e "error compiling FAT_NEG.C"
+    echo -e "program exiting with code $status"
+    exit $status
+else
+    echo -e "Compiling FAT_NEG.C successful"
+fi
+
+
+echo -e "\n\r>> COMPILE: "${Compile[@]}" "$buildDir"/fat_rpc.o "$fatDir"/fat_rpc.c"
+"${Compile[@]}" $buildDir/fat_rpc.o $fatDir/fat_rpc.c
+status=$?
+sleep $t
+if [ $status -gt 0 ]
+then
+    echo -e "error compiling FAT_RPC.C"
+    echo -e "program exiting with code $status"
+    exit $status
+else
+    echo -e "Compiling FAT_RPC.C successful"
+fi
+
+
+echo -e "\n\r>> COMPILE: "${Compile[@]}" "$buildDir"/fat_play.o "$fatDir"/fat_play.c"
+"${Compile[@]}" $buildDir/fat_play.o $fatDir/fat_play.c
+status=$?
+sleep $t
+if [ $status -gt 0 ]
+then
+    echo -e "error compiling FAT_PLAY.C"
+    echo -e "program exiting with code $status"
+    exit $status
+else
+    echo -e "Compiling FAT_PLAY.C successful"
+fi
+
+
+echo -e "\n\r>> LINK: "${Link[@]}" "$buildDir"/avr_fat_test.elf "$buildDir"/avr_fat_test.o  "$buildDir"/avr_spi.o "$buildDir"/sd_spi_base.o "$buildDir"/sd_spi_rwe.o "$buildDir"/avr_usart.o "$buildDir"/prints.o "$buildDir"/fat_bpb.o "$buildDir"/fat.o "$buildDir"/fat_to_sd.o "$buildDir"/fat_search.o "$buildDir"/fat_kv.o "$buildDir"/fat_lz.o "$buildDir"/fat_sum.o "$buildDir"/fat_ioq.o "$buildDir"/avr_timer.o "$buildDir"/fat_cache.o "$buildDir"/fat_stream.o "$buildDir"/fat_ring.o "$buildDir"/sd_spi_info.o "$buildDir"/fat_probe.o "$buildDir"/fat_warm.o "$buildDir"/fat_neg.o "$buildDir"/fat_rpc.o "$buildDir"/fat_play.o"
+"${Link[@]}" $buildDir/avr_fat_test.elf $buildDir/avr_fat_test.o $buildDir/avr_spi.o $buildDir/sd_spi_base.o $buildDir/sd_spi_rwe.o $buildDir/avr_usart.o $buildDir/prints.o $buildDir/fat.o $buildDir/fat_bpb.o $buildDir/fat_to_sd.o $buildDir/fat_search.o $buildDir/fat_kv.o $buildDir/fat_lz.o $buildDir/fat_sum.o $buildDir/fat_ioq.o $buildDir/avr_timer.o $buildDir/fat_cache.o $buildDir/fat_stream.o $buildDir/fat_ring.o $buildDir/sd_spi_info.o $buildDir/fat_probe.o $buildDir/fat_warm.o $buildDir/fat_neg.o $buildDir/fat_rpc.o $buildDir/fat_play.o
 status=$?
 sleep $t
 if [ $status -gt 0 ]
@@ -37,6 +37,18 @@
 
 #define SPI_REG_BIT_LEN      8
 
+//
+// SPI clock rates, as F_CPU / 2^(n + 1). SPI_CLK_DIV_64 is set by
+// spi_MasterInit. Pass one of these to spi_SetClockDiv.
+//
+#define SPI_CLK_DIV_2        0
+#define SPI_CLK_DIV_4        1
+#define SPI_CLK_DIV_8        2
+#define SPI_CLK_DIV_16       3
+#define SPI_CLK_DIV_32       4
+#define SPI_CLK_DIV_64       5
+#define SPI_CLK_DIV_128      6
+
 /*
  ******************************************************************************
  *                              FUNCTION PROTOTYPES
@@ -81,4 +93,28 @@ uint8_t spi_MasterReceive(void);
  */
 void spi_MasterTransmit(uint8_t byte);
 
+/*
+ * ----------------------------------------------------------------------------
+ *                                                          SET SPI CLOCK RATE
+ * 
+ * Description : Sets the clock rate of the SPI port to F_CPU / 2^(div + 1).
+ * 
+ * Arguments   : div   - one of the SPI clock rate macros, e.g.
+ *                       SPI_CLK_DIV_4. Values above SPI_CLK_DIV_128 are set
+ *                       to SPI_CLK_DIV_128.
+ * ----------------------------------------------------------------------------
+ */
+void spi_SetClockDiv(uint8_t div);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                          GET SPI CLOCK RATE
+ * 
+ * Description : Gets the clock rate of the SPI port.
+ * 
+ * Returns     : one of the SPI clock rate macros, e.g. SPI_CLK_DIV_64.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t spi_GetClockDiv(void);
+
 #endif  //SPI_H
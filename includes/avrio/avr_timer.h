@@ -0,0 +1,129 @@
+/*
+ * File       : AVR_TIMER.H
+ * Version    : 1.0 
+ * Target     : Default - ATMega1280
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ * 
+ * AVR_TIMER.H provides an interface for a millisecond clock kept by TIMER0
+ * of the ATMega microcontroller, and a sample clock kept by TIMER1 that calls
+ * a function at a fixed rate, e.g. to output audio samples.
+ */
+
+#ifndef AVR_TIMER_H
+#define AVR_TIMER_H
+
+/*
+ ******************************************************************************
+ *                                  MACROS
+ ******************************************************************************
+ */
+
+#ifndef F_CPU
+#define F_CPU       16000000UL                   // default target clk freq.
+#endif //F_CPU
+
+//
+// TIMER0 counts F_CPU / 64 and is cleared on compare match every millisecond.
+// OCR0A must fit in 8 bits, so F_CPU can be at most 16.384 MHz.
+//
+#define TIMER_PRESCALE      64
+#define TIMER_OCR_VALUE     ((F_CPU) / (TIMER_PRESCALE) / 1000 - 1)
+
+//
+// TIMER1 counts F_CPU / 8 for the sample clock. OCR1A must fit in 16 bits,
+// so the lowest rate is F_CPU / 8 / 65536, i.e. 31 Hz at 16 MHz.
+//
+#define TIMER_SAMPLE_PRESCALE    8
+
+/*
+ ******************************************************************************
+ *                                  STRUCTS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           TICK FUNCTION TYPE
+ *
+ * Description : Type of the function called by the sample clock at each
+ *               tick.
+ *
+ * Arguments   : void
+ *
+ * Returns     : void
+ *
+ * Warnings    : The function is called from an interrupt, so it must be
+ *               short, and must not wait for other interrupts.
+ * ----------------------------------------------------------------------------
+ */
+typedef void (*TimerTickFn)(void);
+
+/*
+ ******************************************************************************
+ *                             FUNCTION PROTOTYPES
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             INITIALIZE TIMER
+ *                                        
+ * Description : Starts TIMER0 interrupting every millisecond, and sets the
+ *               millisecond clock to 0.
+ * 
+ * Arguments   : void 
+ *
+ * Notes       : Global interrupts must be enabled, e.g. with sei(), for the
+ *               clock to run.
+ * ----------------------------------------------------------------------------
+ */
+void timer_Init(void);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                        GET MILLISECOND CLOCK
+ *                                         
+ * Description : Returns the number of milliseconds since timer_Init.
+ * 
+ * Arguments   : void
+ * 
+ * Returns     : milliseconds since timer_Init. Wraps after about 49 days, so
+ *               time differences should be calculated as unsigned 32-bit
+ *               subtractions.
+ * ----------------------------------------------------------------------------
+ */
+uint32_t timer_GetMs(void);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           START SAMPLE CLOCK
+ *                                        
+ * Description : Starts TIMER1 interrupting rateHz times a second, and calling
+ *               tickFn from each interrupt.
+ * 
+ * Arguments   : rateHz   - Number of ticks each second. Must be at least
+ *                          F_CPU / TIMER_SAMPLE_PRESCALE / 65536.
+ *               tickFn   - Function called at each tick.
+ *
+ * Notes       : 1) Global interrupts must be enabled, e.g. with sei(), for
+ *                  the clock to run.
+ *               2) The rate is rounded to the nearest that TIMER1 can count,
+ *                  e.g. 8000 Hz is exact at 16 MHz, but 44100 Hz is 44444 Hz.
+ * ----------------------------------------------------------------------------
+ */
+void timer_SampleStart(uint32_t rateHz, TimerTickFn tickFn);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            STOP SAMPLE CLOCK
+ *                                        
+ * Description : Stops the TIMER1 interrupt started by timer_SampleStart.
+ * 
+ * Arguments   : void
+ * ----------------------------------------------------------------------------
+ */
+void timer_SampleStop(void);
+
+#endif //AVR_TIMER_H
@@ -26,6 +26,14 @@
 #define BAUD        9600U                        // decimal baud rate
 #define UBRR_VALUE  ((F_CPU) / 16 / (BAUD) - 1)  // calculate value for UBRR
 
+//
+// bytes held by the receive buffer of usart_RxBufferOn. It must be a power of
+// 2, and no more than 256. One byte of it is always left empty.
+//
+#ifndef USART_RX_BUF_LEN
+#define USART_RX_BUF_LEN    256
+#endif //USART_RX_BUF_LEN
+
 /*
  *******************************************************************************
  *                             FUNCTION PROTOTYPES
@@ -69,4 +77,39 @@ uint8_t usart_Receive(void);
  */
 void usart_Transmit(uint8_t data);
 
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                  USART RECEIVE BUFFER ON/OFF
+ *
+ * Description : usart_RxBufferOn starts the receive complete interrupt, which
+ *               adds each byte received to a buffer of USART_RX_BUF_LEN
+ *               bytes, and empties the buffer. usart_RxBufferOff stops it.
+ *
+ * Arguments   : void
+ *
+ * Notes       : 1) While the buffer is on, usart_Receive returns the bytes of
+ *                  the buffer, in the order they were received, so bytes
+ *                  received while the program is busy are not lost.
+ *               2) Bytes received while the buffer is full are dropped.
+ *               3) Global interrupts must be enabled, e.g. with sei().
+ * ----------------------------------------------------------------------------
+ */
+void usart_RxBufferOn(void);
+void usart_RxBufferOff(void);
+
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                     USART RECEIVE BYTE COUNT
+ *
+ * Description : Returns the number of bytes waiting in the receive buffer.
+ *
+ * Arguments   : void
+ *
+ * Returns     : bytes in the receive buffer, or 0 if the buffer is off.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t usart_RxCount(void);
+
 #endif //AVR_USART_H
@@ -9,8 +9,9 @@
  * Copyright (c) 2020, 2021
  * 
  * Interface for navigating / accessing contents of a FAT32 formatted volume
- * using an AVR microconstroller. These only provide READ access to the 
- * volume's contents. No WRITE/ERASE access is currently implemented.
+ * using an AVR microconstroller. These provide READ access to the volume's
+ * contents, and WRITE access only within the existing allocation of a file.
+ * Files and directories cannot be created, extended, or erased.
  */
 
 #ifndef FAT_H
@@ -142,6 +143,42 @@
 #define MIN_CALC(X)          (((X) & MIN_MASK) >> 5)
 #define SEC_CALC(X)          (2 * ((X) & SEC_MASK))
 
+// date and time of a packed date/time value of a FatEntryInfo instance.
+#define DATE_OF(X)           ((uint16_t)((X) >> 16))
+#define TIME_OF(X)           ((uint16_t)(X))
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                          LITTLE ENDIAN LOADS
+ *
+ * Description : Load the 16 and 32 bit little endian values that start at
+ *               the byte pointed to by P, e.g. the fields of an entry.
+ *
+ * Notes       : These only use byte loads, so P does not need to be aligned.
+ * ----------------------------------------------------------------------------
+ */
+#define LOAD_LE16(P)         ((uint16_t)((P)[0] | (uint16_t)(P)[1] << 8))
+#define LOAD_LE32(P)         (LOAD_LE16(P) | (uint32_t)LOAD_LE16((P) + 2) << 16)
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                       ENTRY REFERENCE LENGTH
+ *
+ * Description : Number of bytes a FatEntryRef is packed into by fat_PackRef.
+ * ----------------------------------------------------------------------------
+ */
+#define ENTRY_REF_LEN        7
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                      DIRECTORY CURSOR LENGTH
+ *
+ * Description : Number of bytes a FatDirCursor is packed into by
+ *               fat_PackCursor.
+ * ----------------------------------------------------------------------------
+ */
+#define DIR_CURSOR_LEN       7
+
 /* 
  * ----------------------------------------------------------------------------
  *                                                        LONG NAME ENTRY BYTES
@@ -204,10 +241,18 @@
  *                                                              FAT ERROR FLAGS
  *
  * Description : Error Flags returned by various FAT functions.
+ *
+ * Notes       : Each module built on FAT.C, e.g. FAT_KV.H, returns its own
+ *               error flags as well as these. Their values, e.g. 0x03, are ORs
+ *               of these flags, so a returned value must only be compared
+ *               with == or in a switch, and never tested as a bit.
  * ----------------------------------------------------------------------------
  */
 #define SUCCESS                0x00
 #define INVALID_NAME           0x01
+#ifndef FAILED_WRITE_SECTOR
+#define FAILED_WRITE_SECTOR    0x02 // also defined in fat_to_disk.h
+#endif//FAILED_WRITE_SECTOR
 #define FILE_NOT_FOUND         0x04
 #define DIR_NOT_FOUND          0x08
 #define END_OF_FILE            0x10
@@ -217,6 +262,17 @@
 #define FAILED_READ_SECTOR     0x80 // also defined in fat_to_disk.h
 #endif//FAILED_READ_SECTOR
 
+/*
+ * ----------------------------------------------------------------------------
+ *                                                               STEP BUSY FLAG
+ *
+ * Description : Returned by the step functions, e.g. fat_StepNextEntry, when
+ *               the operation is not yet complete and the function should be
+ *               called again.
+ * ----------------------------------------------------------------------------
+ */
+#define STEP_BUSY              0xFF
+
 /* 
  * ----------------------------------------------------------------------------
  *                                                        FAT ENTRY FIELD FLAGS
@@ -291,16 +347,40 @@ typedef struct
 } 
 FatDir;
 
-/* 
+/*
+ * ----------------------------------------------------------------------------
+ *                                                        FAT ENTRY INFO STRUCT
+ *
+ * Description : The fields of a short name entry, decoded from its bytes.
+ *
+ * Notes       : The dates and times are the packed 16-bit values of the
+ *               entry. Use DATE_OF and TIME_OF to get them from a date/time
+ *               member, then the CALC macros to get their fields.
+ * ----------------------------------------------------------------------------
+ */
+typedef struct
+{
+  uint8_t  attr;                       // attribute byte
+  uint32_t fstClusIndx;                // index of entry's first cluster
+  uint32_t fileSize;                   // file size in bytes
+  uint32_t createDateTime;             // creation date << 16 | time
+  uint32_t writeDateTime;              // last modified date << 16 | time
+  uint16_t lastAccDate;                // last access date
+}
+FatEntryInfo;
+
+/*
  * ----------------------------------------------------------------------------
  *                                                             FAT ENTRY STRUCT
  *
  * Description : Instances of this struct are used to locate entries within a 
  *               FAT directory.
  *       
- * Notes       : Any instance of this struct should first be initialized by
- *               passing it to fat_InitEntry, after which, fat_SetNextEntry
- *               should be the only function that updates the instance.
+ * Notes       : 1) Any instance of this struct should first be initialized by
+ *                  passing it to fat_InitEntry, after which, fat_SetNextEntry
+ *                  should be the only function that updates the instance.
+ *               2) info is decoded from snEnt once, when the entry is set, so
+ *                  its fields should be used rather than the bytes of snEnt.
  * 
  * Warnings    : Members of an instance of this struct should never be set
  *               manually, but only by passing it to the FAT functions.
@@ -311,12 +391,241 @@ typedef struct
   char lnStr[LN_STR_LEN_MAX];          // entry long name
   char snStr[SN_CHAR_LEN + 1];         // entry short name. Add 1 for null
   uint8_t snEnt[ENTRY_LEN];            // the 32 bytes of the short name entry
+  FatEntryInfo info;                   // decoded fields of snEnt
   uint32_t snEntClusIndx;              // cluster index of the sn entry
   uint8_t  snEntSecNumInClus;          // sector number in cluster of sn entry
   uint16_t nextEntPos;
 } 
 FatEntry;
 
+/*
+ * ----------------------------------------------------------------------------
+ *                                                              FAT FILE STRUCT
+ *
+ * Description : Instances of this struct are used to read and write the
+ *               contents of a file entry from any byte position in the file.
+ *
+ * Notes       : 1) Any instance of this struct must first be initialized by
+ *                  passing it to fat_OpenFile.
+ *               2) currClusIndx and currClusNum are only updated when a read
+ *                  requires it, so a seek costs nothing until the next read.
+ *                  Reads at or beyond the current cluster continue along the
+ *                  cluster chain from currClusIndx. Reads before it restart
+ *                  from the file's first cluster.
+ *
+ * Warnings    : Members of an instance of this struct should never be set
+ *               manually, but only by passing it to the FAT functions.
+ * ----------------------------------------------------------------------------
+ */
+typedef struct
+{
+  uint32_t fstClusIndx;                // index of file's first cluster
+  uint32_t fileSize;                   // file size in bytes
+  uint32_t currPos;                    // byte position of next read
+  uint32_t currClusIndx;               // index of a cluster in the file
+  uint32_t currClusNum;                // number of currClusIndx in the chain
+  uint32_t entClusIndx;                // cluster index of the file's sn entry
+  uint8_t  entSecNumInClus;            // sector number in cluster of sn entry
+  uint16_t entPos;                     // byte position in sector of sn entry
+}
+FatFile;
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                   FAT ENTRY REFERENCE STRUCT
+ *
+ * Description : The location on the disk of a file's short name entry, and
+ *               the checksum of its short name, so the file can be reopened
+ *               by fat_OpenRef without searching its directory.
+ *
+ * Notes       : 1) Any instance of this struct must be set by fat_SetEntryRef,
+ *                  fat_GetFileRef or fat_UnpackRef.
+ *               2) The checksum is the one stored in a long name's entries,
+ *                  calculated from the 11 bytes of the short name.
+ *               3) A reference stays valid until the entry is deleted or
+ *                  moved, e.g. by another system.
+ * ----------------------------------------------------------------------------
+ */
+typedef struct
+{
+  uint32_t clusIndx;                   // cluster index of the sn entry
+  uint8_t  secNumInClus;               // sector number in cluster of entry
+  uint8_t  slot;                       // entry number in the sector
+  uint8_t  snChkSum;                   // checksum of the short name
+}
+FatEntryRef;
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                  FAT DIRECTORY CURSOR STRUCT
+ *
+ * Description : A position in a directory, between two of its entries, from
+ *               which a listing of the directory can be resumed without
+ *               reading the entries before it.
+ *
+ * Notes       : 1) Any instance of this struct must be set by
+ *                  fat_InitDirCursor, fat_SetCursorToEntry or
+ *                  fat_UnpackCursor.
+ *               2) The position is that of the FatEntry members snEntClusIndx,
+ *                  snEntSecNumInClus and nextEntPos after the entry before
+ *                  it was found.
+ *               3) A cursor stays valid while no entries are added to or
+ *                  removed from the directory before it.
+ * ----------------------------------------------------------------------------
+ */
+typedef struct
+{
+  uint32_t clusIndx;                   // cluster index of the sector
+  uint8_t  secNumInClus;               // sector number in the cluster
+  uint16_t entPos;                     // byte position of the next entry
+}
+FatDirCursor;
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                         SECTOR FUNCTION TYPE
+ *
+ * Description : Type of a function that sectors are passed to, in order, as
+ *               they are read from the disk by fat_ReadFileSectors and
+ *               FATtoDisk_ReadMultipleSectors.
+ *
+ * Arguments   : secArr   - Pointer to the array holding the sector.
+ *               arg      - Pointer passed through by the caller.
+ *
+ * Returns     : 0 to continue reading. Non-zero to stop.
+ *
+ * Warnings    : The disk is still in the middle of the read when this is
+ *               called, so it must not read or write the disk.
+ * ----------------------------------------------------------------------------
+ */
+typedef uint8_t (*FatSectorFn)(const uint8_t secArr[], void *arg);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                  SECTOR SOURCE FUNCTION TYPE
+ *
+ * Description : Type of a function that FATtoDisk_WriteMultipleSectors calls
+ *               for the data of each sector, in order, as it is written.
+ *
+ * Arguments   : secIndx  - Index of the sector in the write, starting at 0.
+ *               arg      - Pointer passed through by the caller.
+ *
+ * Returns     : Pointer to the array holding the sector.
+ *
+ * Warnings    : The disk is still in the middle of the write when this is
+ *               called, so it must not read or write the disk.
+ * ----------------------------------------------------------------------------
+ */
+typedef const uint8_t *(*FatSectorSrcFn)(uint32_t secIndx, void *arg);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           SINK FUNCTION TYPE
+ *
+ * Description : Type of a function that fat_StreamFile passes the bytes of a
+ *               file to, e.g. to send them on to a USART, an SPI display or
+ *               a DAC.
+ *
+ * Arguments   : spanArr  - Pointer to the bytes, in the cache or in the
+ *                          array the disk driver reads sectors into.
+ *               len      - Number of bytes at spanArr. Never more than the
+ *                          bytes left in the sector they are in.
+ *               arg      - Pointer passed through by the caller.
+ *
+ * Returns     : Number of bytes taken, from 0 to len. Fewer than len stops
+ *               the stream until it is called again, e.g. when a transmit
+ *               buffer is full.
+ *
+ * Warnings    : 1) The disk may still be in the middle of a read when this
+ *                  is called, so it must not read or write the disk. spanArr
+ *                  is only valid until it returns.
+ *               2) The disk is deselected while this runs, so other devices
+ *                  on its bus, e.g. an SPI display, may be used. The bus
+ *                  settings must be left as they were found.
+ * ----------------------------------------------------------------------------
+ */
+typedef uint16_t (*FatSinkFn)(const uint8_t spanArr[], uint16_t len,
+                              void *arg);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                    FAT DIRECTORY STEP STRUCT
+ *
+ * Description : Instances of this struct hold the state of a search for the
+ *               next entries of a directory by fat_StepNextEntry. The sector
+ *               being searched is kept here, so it is only read once for all
+ *               of the entries in it.
+ *
+ * Notes       : Any instance of this struct must first be initialized by
+ *               passing it to fat_InitDirStep.
+ *
+ * Warnings    : Members of an instance of this struct should never be set
+ *               manually, but only by passing it to the FAT functions.
+ * ----------------------------------------------------------------------------
+ */
+typedef struct
+{
+  FatEntry *ent;                       // entry set to each entry found
+  uint32_t clusIndx;                   // cluster index of sector in secArr
+  uint8_t  secNumInClus;               // sector number in cluster of secArr
+  uint16_t entPos;                     // position in secArr of next entry
+  uint16_t snPos;                      // sn pos of a ln that spans sectors
+  uint8_t  state;                      // next work to be done by a step
+  char lnStr[LN_STR_LEN_MAX];          // part of a ln that spans sectors
+  uint8_t secArr[SECTOR_LEN];          // sector being searched
+}
+FatDirStep;
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                       FAT LOOKUP STEP STRUCT
+ *
+ * Description : Instances of this struct hold the state of a search of a
+ *               directory for a file or directory by name by fat_StepLookup.
+ *               When it is found, ent is set to its entry.
+ *
+ * Notes       : Any instance of this struct must first be initialized by
+ *               passing it to fat_InitLookupStep.
+ *
+ * Warnings    : 1) Members of an instance of this struct should never be set
+ *                  manually, but only by passing it to the FAT functions.
+ *               2) dirStep points to ent, so an instance must not be copied
+ *                  or moved after it is initialized.
+ * ----------------------------------------------------------------------------
+ */
+typedef struct
+{
+  FatDirStep  dirStep;                 // search of the directory
+  FatEntry    ent;                     // entry found
+  const char *nameStr;                 // name to find
+  uint8_t     attr;                    // DIR_ENTRY_ATTR or 0 for a file
+  uint8_t     isAbsent;                // 1 if the filter rules it out
+  uint16_t    negTag;                  // filter of FAT_NEG.H being built
+}
+FatLookupStep;
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                    FAT READ FILE STEP STRUCT
+ *
+ * Description : Instances of this struct hold the state of a read of a file
+ *               by fat_StepReadFile.
+ *
+ * Notes       : Any instance of this struct must first be initialized by
+ *               passing it to fat_InitReadStep.
+ *
+ * Warnings    : Members of an instance of this struct should never be set
+ *               manually, but only by passing it to the FAT functions.
+ * ----------------------------------------------------------------------------
+ */
+typedef struct
+{
+  FatFile *file;                       // file being read
+  uint8_t *dataArr;                    // where the next byte read is loaded
+  uint16_t len;                        // number of bytes left to read
+}
+FatReadStep;
+
 /*
  ******************************************************************************
  *                           FUNCTION PROTOTYPES
@@ -400,6 +709,28 @@ uint8_t fat_SetNextEntry(FatEntry *currEntry, const BPB *bpb);
  */
 uint8_t fat_SetDir(FatDir *dir, const char newDirStr[], const BPB *bpb);
 
+/*
+ * ----------------------------------------------------------------------------
+ *                                                        SET DIRECTORY TO PATH
+ *
+ * Description : Sets a FatDir instance to the directory at a path from the
+ *               root directory, one directory name at a time by fat_SetDir.
+ *
+ * Arguments   : dir       - Pointer to the FatDir instance to be set.
+ *               pathStr   - Path of the directory, with the names separated
+ *                           by '/'. A leading '/' is ignored.
+ *               bpb       - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, INVALID_NAME if a name is too long, or a FAT Error
+ *               Flag from fat_SetDir.
+ *
+ * Notes       : An empty path, or "/", is the root directory. If a name along
+ *               the path is not found, the FatDir instance is left at the
+ *               directory that should have contained it.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_SetDirToPath(FatDir *dir, const char pathStr[], const BPB *bpb);
+
 /*
  * ----------------------------------------------------------------------------
  *                                            PRINT DIRECTORY ENTRIES TO SCREEN
@@ -430,6 +761,93 @@ uint8_t fat_SetDir(FatDir *dir, const char newDirStr[], const BPB *bpb);
  */
 uint8_t fat_PrintDir(const FatDir *dir, uint8_t entFlds, const BPB *bpb);
 
+/*
+ * ----------------------------------------------------------------------------
+ *                                                  INITIALIZE DIRECTORY CURSOR
+ *
+ * Description : Sets a FatDirCursor instance to the first entry of a
+ *               directory.
+ *
+ * Arguments   : cur   - Pointer to the FatDirCursor instance to be set.
+ *               dir   - Pointer to a FatDir instance of the directory.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void fat_InitDirCursor(FatDirCursor *cur, const FatDir *dir);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                            CURSOR TO ENTRY / ENTRY TO CURSOR
+ *
+ * Description : fat_SetEntryToCursor sets a FatEntry instance so the next
+ *               call of fat_SetNextEntry, or fat_StepNextEntry, finds the
+ *               first entry after a cursor. fat_SetCursorToEntry sets a
+ *               cursor to the position after the entry a FatEntry instance
+ *               was last set to.
+ *
+ * Arguments   : ent   - Pointer to a FatEntry instance.
+ *               cur   - Pointer to a FatDirCursor instance.
+ *               bpb   - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, or CORRUPT_FAT_ENTRY if the cursor is not a position
+ *               between the entries of a cluster, in which case the FatEntry
+ *               instance is not changed.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_SetEntryToCursor(FatEntry *ent, const FatDirCursor *cur,
+                             const BPB *bpb);
+void fat_SetCursorToEntry(FatDirCursor *cur, const FatEntry *ent);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                  PRINT A PAGE OF A DIRECTORY
+ *
+ * Description : Prints the entries of a directory after a cursor, as
+ *               fat_PrintDir, until entCnt entries are printed or the end of
+ *               the directory is reached, and moves the cursor past the last
+ *               entry printed.
+ *
+ * Arguments   : cur       - Pointer to a FatDirCursor instance.
+ *               entFlds   - Any combination of the FAT ENTRY FIELD FLAGS, as
+ *                           for fat_PrintDir.
+ *               entCnt    - Most entries to print.
+ *               bpb       - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS if entCnt entries were printed, END_OF_DIRECTORY if
+ *               the end of the directory was reached, or another FAT Error
+ *               Flag, e.g. CORRUPT_FAT_ENTRY if the cursor is not valid. The
+ *               cursor is only moved on SUCCESS or END_OF_DIRECTORY.
+ *
+ * Notes       : Entries that entFlds does not print, e.g. hidden entries, are
+ *               passed over and not counted. The sectors read are those of
+ *               the page only, whatever the position of the cursor.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_PrintDirPage(FatDirCursor *cur, uint8_t entFlds, uint16_t entCnt,
+                         const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                               PACK / UNPACK DIRECTORY CURSOR
+ *
+ * Description : fat_PackCursor stores a FatDirCursor in DIR_CURSOR_LEN bytes,
+ *               e.g. to be sent to a client that is paging through a
+ *               directory, and fat_UnpackCursor sets a FatDirCursor from
+ *               those bytes.
+ *
+ * Arguments   : cur      - Pointer to the FatDirCursor instance.
+ *               curArr   - Pointer to an array of DIR_CURSOR_LEN bytes.
+ *
+ * Returns     : void
+ *
+ * Notes       : The cluster index and entry position are stored little
+ *               endian, with the sector number between them.
+ * ----------------------------------------------------------------------------
+ */
+void fat_PackCursor(const FatDirCursor *cur, uint8_t curArr[]);
+void fat_UnpackCursor(FatDirCursor *cur, const uint8_t curArr[]);
+
 /*
  * ----------------------------------------------------------------------------
  *                                                         PRINT FILE TO SCREEN
@@ -451,6 +869,444 @@ uint8_t fat_PrintDir(const FatDir *dir, uint8_t entFlds, const BPB *bpb);
  */
 uint8_t fat_PrintFile(const FatDir *dir, const char fileStr[], const BPB *bpb);
 
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                    OPEN FILE
+ *
+ * Description : Sets a FatFile instance to the file entry specified by fileStr
+ *               and positions it at the first byte of the file.
+ *
+ * Arguments   : file       - Pointer to the FatFile instance to be set.
+ *               dir        - Pointer to a FatDir instance. This directory must
+ *                            contain the entry for the file to be opened.
+ *               fileStr    - Pointer to a string. This is the name of the file
+ *                            to be opened.
+ *               bpb        - Pointer to the BPB struct instance.
+ *
+ * Returns     : A FAT Error Flag. If any value other than SUCCESS is returned
+ *               then the FatFile instance was not set. FILE_NOT_FOUND is
+ *               returned if the directory does not contain fileStr.
+ *
+ * Notes       : fileStr must be a long name unless a long name for a given
+ *               entry does not exist, in which case it must be a short name.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_OpenFile(FatFile *file, const FatDir *dir, const char fileStr[],
+                     const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                    SEEK FILE
+ *
+ * Description : Sets the byte position in the file of the next read.
+ *
+ * Arguments   : file   - Pointer to a FatFile instance set by fat_OpenFile.
+ *               pos    - Byte position in the file.
+ *               bpb    - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, or END_OF_FILE if pos is beyond the end of the file,
+ *               in which case the file position is unchanged.
+ *
+ * Notes       : No sectors are read here. The cluster chain is followed to
+ *               the new position by the next call to fat_ReadFile.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_SeekFile(FatFile *file, uint32_t pos, const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                    READ FILE
+ *
+ * Description : Reads bytes from the file's current position into an array
+ *               and advances the position by the number of bytes read.
+ *
+ * Arguments   : file      - Pointer to a FatFile instance set by fat_OpenFile.
+ *               dataArr   - Pointer to the array that will be loaded with the
+ *                           bytes read from the file.
+ *               len       - Number of bytes to read.
+ *               bpb       - Pointer to the BPB struct instance.
+ *
+ * Returns     : A FAT Error Flag. SUCCESS if len bytes were read. END_OF_FILE
+ *               if the end of the file was reached first, in which case the
+ *               bytes up to the end of the file were still loaded. The number
+ *               of bytes read can be found from the change in file->currPos.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_ReadFile(FatFile *file, uint8_t dataArr[], uint16_t len,
+                     const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            READ FILE SECTORS
+ *
+ * Description : Reads every sector of a file that holds file bytes, in order,
+ *               and passes each one to secFn. Runs of consecutive clusters are
+ *               read with a single multiple sector read from the disk.
+ *
+ * Arguments   : file      - Pointer to a FatFile instance set by fat_OpenFile.
+ *               secFn     - Function each sector is passed to. If it returns
+ *                           a non-zero value, no more sectors are read.
+ *               arg       - Pointer passed to secFn with each sector.
+ *               bpb       - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, FAILED_READ_SECTOR, or CORRUPT_FAT_ENTRY if the
+ *               cluster chain ends before the end of the file.
+ *
+ * Notes       : 1) Only the first fileSize % bytesPerSec bytes of the last
+ *                  sector are file bytes, unless that value is 0.
+ *               2) The file's position is not used or changed.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_ReadFileSectors(const FatFile *file, FatSectorFn secFn, void *arg,
+                            const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                  STREAM FILE
+ *
+ * Description : Passes len bytes of a file, from pos, to a sink function a
+ *               span at a time, without copying them into an array first.
+ *               Each span is the bytes of the range in one sector.
+ *
+ * Arguments   : file      - Pointer to a FatFile instance set by fat_OpenFile.
+ *               pos       - Byte position in the file of the first byte.
+ *               len       - Number of bytes to pass.
+ *               sinkFn    - Function the spans are passed to.
+ *               arg       - Pointer passed to sinkFn with each span.
+ *               bpb       - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS if sinkFn took all len bytes. END_OF_FILE if the end
+ *               of the file was reached first, or pos is beyond it. STEP_BUSY
+ *               if sinkFn took fewer bytes than it was passed. Otherwise
+ *               FAILED_READ_SECTOR, FAILED_WRITE_SECTOR or CORRUPT_FAT_ENTRY.
+ *
+ * Notes       : 1) The file's position is left after the last byte taken by
+ *                  sinkFn, so after STEP_BUSY the stream is continued by
+ *                  calling this again with pos set to file->currPos and len
+ *                  reduced by the bytes already taken.
+ *               2) A sector held in the sector cache is passed from the
+ *                  cache. Runs of sectors that are not are read with a single
+ *                  multiple sector read, and each sector is passed from the
+ *                  disk driver's array as it is read, so they do not take the
+ *                  place of the FAT and directory sectors in the cache.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_StreamFile(FatFile *file, uint32_t pos, uint32_t len,
+                       FatSinkFn sinkFn, void *arg, const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                   WRITE FILE
+ *
+ * Description : Writes bytes from an array to the file's current position and
+ *               advances the position by the number of bytes written.
+ *
+ * Arguments   : file      - Pointer to a FatFile instance set by fat_OpenFile.
+ *               dataArr   - Pointer to the array holding the bytes that will
+ *                           be written to the file.
+ *               len       - Number of bytes to write.
+ *               bpb       - Pointer to the BPB struct instance.
+ *
+ * Returns     : A FAT Error Flag. SUCCESS if len bytes were written.
+ *               END_OF_FILE if the end of the file was reached first, in which
+ *               case the bytes up to the end of the file were still written.
+ *
+ * Notes       : 1) The file is never extended. Only bytes that already exist
+ *                  in the file, i.e. before fileSize, can be overwritten.
+ *               2) A sector that is only partially written is first read so
+ *                  the rest of its bytes are kept. A sector that is written
+ *                  entirely is not read.
+ *               3) The sectors are written to the sector cache of FAT_CACHE.H.
+ *                  They reach the disk when the cache is flushed, e.g. by
+ *                  fat_Sync.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_WriteFile(FatFile *file, const uint8_t dataArr[], uint16_t len,
+                      const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                          GET FILE SECTOR RUN
+ *
+ * Description : Finds the run of consecutive sectors on the disk that starts
+ *               with the sector holding the file's current position, i.e. the
+ *               sectors that can be transferred with a single multiple sector
+ *               read or write.
+ *
+ * Arguments   : file        - Pointer to a FatFile instance set by
+ *                             fat_OpenFile.
+ *               secNum      - Pointer to a variable set to the disk sector of
+ *                             the first sector of the run.
+ *               numOfSecs   - Pointer to a variable set to the number of
+ *                             sectors in the run.
+ *               secsMax     - Largest number of sectors the run can have.
+ *               bpb         - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, END_OF_FILE if the position is at or beyond the end
+ *               of the file, or CORRUPT_FAT_ENTRY if the cluster chain ends
+ *               before the position.
+ *
+ * Notes       : 1) The run ends at the last sector holding file bytes, or
+ *                  where the next cluster in the chain is not the next on the
+ *                  disk.
+ *               2) The file's position is not changed.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_GetFileRun(FatFile *file, uint32_t *secNum, uint32_t *numOfSecs,
+                       uint32_t secsMax, const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                               SET FILE ENTRY
+ *
+ * Description : Sets the first cluster index and file size fields of a file's
+ *               short name entry, and of the FatFile instance, to the values
+ *               passed in.
+ *
+ * Arguments   : file          - Pointer to a FatFile instance set by
+ *                               fat_OpenFile.
+ *               fstClusIndx   - New index of the file's first cluster.
+ *               fileSize      - New file size in bytes.
+ *               bpb           - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, FAILED_READ_SECTOR or FAILED_WRITE_SECTOR.
+ *
+ * Notes       : The FAT is not modified, so the new first cluster must be the
+ *               start of a cluster chain that is not used by another entry.
+ *               The file is repositioned to its first byte.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_SetFileEntry(FatFile *file, uint32_t fstClusIndx,
+                         uint32_t fileSize, const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                   SWAP FILES
+ *
+ * Description : Exchanges the contents of two files by swapping the first
+ *               cluster index and file size fields of their short name
+ *               entries. The FatFile instances are swapped to match, so each
+ *               still corresponds to the same name.
+ *
+ * Arguments   : fileA   - Pointer to a FatFile instance set by fat_OpenFile.
+ *               fileB   - Pointer to a FatFile instance set by fat_OpenFile.
+ *               bpb     - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, FAILED_READ_SECTOR or FAILED_WRITE_SECTOR.
+ *
+ * Notes       : 1) If both entries are in the same sector, the swap is a
+ *                  single sector write. Otherwise fileA's entry is written
+ *                  first, and if the second write does not happen both
+ *                  entries will point to fileB's original clusters.
+ *               2) Both files are repositioned to their first byte.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_SwapFiles(FatFile *fileA, FatFile *fileB, const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                          SET ENTRY REFERENCE
+ *
+ * Description : Sets a FatEntryRef instance to the short name entry of a
+ *               FatEntry instance.
+ *
+ * Arguments   : ref   - Pointer to the FatEntryRef instance to be set.
+ *               ent   - Pointer to a FatEntry instance set to an entry, e.g.
+ *                       by fat_SetNextEntry.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void fat_SetEntryRef(FatEntryRef *ref, const FatEntry *ent);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                     GET FILE ENTRY REFERENCE
+ *
+ * Description : Sets a FatEntryRef instance to the short name entry of an
+ *               open file.
+ *
+ * Arguments   : file   - Pointer to a FatFile instance set by fat_OpenFile or
+ *                        fat_OpenRef.
+ *               ref    - Pointer to the FatEntryRef instance to be set.
+ *               bpb    - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS or FAILED_READ_SECTOR.
+ *
+ * Notes       : The entry's sector is read, from the cache if it is held, for
+ *               the short name.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_GetFileRef(const FatFile *file, FatEntryRef *ref, const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                       OPEN FILE BY REFERENCE
+ *
+ * Description : Sets a FatFile instance to the file at a FatEntryRef, and
+ *               positions it at the first byte of the file, as fat_OpenFile,
+ *               but by reading only the sector of the file's entry.
+ *
+ * Arguments   : file   - Pointer to the FatFile instance to be set.
+ *               ref    - Pointer to a FatEntryRef instance.
+ *               bpb    - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, FAILED_READ_SECTOR, or FILE_NOT_FOUND if the entry at
+ *               the reference is not a file entry, or the checksum of its
+ *               short name does not match, i.e. the reference is stale. The
+ *               FatFile instance is only set on SUCCESS.
+ *
+ * Notes       : A file whose reference is stale should be opened again with
+ *               fat_OpenFile, and its reference renewed.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_OpenRef(FatFile *file, const FatEntryRef *ref, const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                PACK / UNPACK ENTRY REFERENCE
+ *
+ * Description : fat_PackRef stores a FatEntryRef in ENTRY_REF_LEN bytes, e.g.
+ *               to be saved to EEPROM or a file, and fat_UnpackRef sets a
+ *               FatEntryRef from those bytes.
+ *
+ * Arguments   : ref      - Pointer to the FatEntryRef instance.
+ *               refArr   - Pointer to an array of ENTRY_REF_LEN bytes.
+ *
+ * Returns     : void
+ *
+ * Notes       : The cluster index is stored little endian, followed by the
+ *               sector number, slot and checksum, so the bytes can be read
+ *               on any machine.
+ * ----------------------------------------------------------------------------
+ */
+void fat_PackRef(const FatEntryRef *ref, uint8_t refArr[]);
+void fat_UnpackRef(FatEntryRef *ref, const uint8_t refArr[]);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                    INITIALIZE DIRECTORY STEP
+ *
+ * Description : Sets a FatDirStep instance to search for the entries of a
+ *               directory that follow the entry of a FatEntry instance.
+ *
+ * Arguments   : step    - Pointer to the FatDirStep instance to be set.
+ *               ent     - Pointer to a FatEntry instance. Its members will be
+ *                         updated to each entry found by fat_StepNextEntry.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void fat_InitDirStep(FatDirStep *step, FatEntry *ent);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                       STEP TO THE NEXT ENTRY
+ *
+ * Description : Performs the next step of a search for the next entry of a
+ *               directory. Each step reads at most one sector from the disk.
+ *
+ * Arguments   : step    - Pointer to a FatDirStep instance set by
+ *                         fat_InitDirStep.
+ *               bpb     - Pointer to the BPB struct instance.
+ *
+ * Returns     : STEP_BUSY if the search is not complete. SUCCESS if the next
+ *               entry was found, in which case step->ent has been updated to
+ *               it, and the next call will search for the entry after it.
+ *               Otherwise a FAT Error Flag, e.g. END_OF_DIRECTORY.
+ *
+ * Notes       : fat_SetNextEntry is the blocking form of this function.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_StepNextEntry(FatDirStep *step, const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                       INITIALIZE LOOKUP STEP
+ *
+ * Description : Sets a FatLookupStep instance to search a directory for a
+ *               file or directory.
+ *
+ * Arguments   : lk        - Pointer to the FatLookupStep instance to be set.
+ *               dir       - Pointer to the FatDir instance of the directory
+ *                           to be searched.
+ *               nameStr   - Pointer to the name of the file or directory.
+ *               attr      - DIR_ENTRY_ATTR to find a directory, or 0 to find
+ *                           a file.
+ *               bpb       - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS or INVALID_NAME.
+ *
+ * Warnings    : nameStr is not copied, so it must not change until the
+ *               lookup is complete.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_InitLookupStep(FatLookupStep *lk, const FatDir *dir,
+                           const char nameStr[], uint8_t attr,
+                           const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                              STEP THE LOOKUP
+ *
+ * Description : Performs the next step of a search of a directory for a file
+ *               or directory. Each step reads at most one sector from the
+ *               disk.
+ *
+ * Arguments   : lk      - Pointer to a FatLookupStep instance set by
+ *                         fat_InitLookupStep.
+ *               bpb     - Pointer to the BPB struct instance.
+ *
+ * Returns     : STEP_BUSY if the search is not complete. SUCCESS if it was
+ *               found, in which case lk->ent is its entry. FILE_NOT_FOUND or
+ *               DIR_NOT_FOUND if the directory does not contain it, or
+ *               another FAT Error Flag.
+ *
+ * Notes       : The names found are added to the directory's filter in
+ *               FAT_NEG.H. Once a search has reached the end of the
+ *               directory, a name the filter rules out is not found at the
+ *               first step, without reading the disk.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_StepLookup(FatLookupStep *lk, const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                         INITIALIZE READ STEP
+ *
+ * Description : Sets a FatReadStep instance to read bytes from the file's
+ *               current position.
+ *
+ * Arguments   : rd        - Pointer to the FatReadStep instance to be set.
+ *               file      - Pointer to a FatFile instance set by fat_OpenFile.
+ *               dataArr   - Pointer to the array that will be loaded with the
+ *                           bytes read from the file.
+ *               len       - Number of bytes to read.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void fat_InitReadStep(FatReadStep *rd, FatFile *file, uint8_t dataArr[],
+                      uint16_t len);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           STEP THE FILE READ
+ *
+ * Description : Performs the next step of a read of a file. Each step reads
+ *               at most one sector from the disk, either a sector of the file
+ *               or a sector of the FAT to follow its cluster chain.
+ *
+ * Arguments   : rd      - Pointer to a FatReadStep instance set by
+ *                         fat_InitReadStep.
+ *               bpb     - Pointer to the BPB struct instance.
+ *
+ * Returns     : STEP_BUSY if the read is not complete. Otherwise the same as
+ *               fat_ReadFile, which is the blocking form of this function.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_StepReadFile(FatReadStep *rd, const BPB *bpb);
+
 /*
  *-----------------------------------------------------------------------------
  *                                                         PRINT FAT ERROR FLAG
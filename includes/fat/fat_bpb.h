@@ -80,6 +80,111 @@
                                  || (SPC == 8)  || (SPC == 16) || (SPC == 32) \
                                  || (SPC == 64) || (SPC == 128))
 
+// log2 of the length in bytes of a FAT32 FAT index (entry).
+#define FAT32_INDX_SHIFT       2
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                               FIXED GEOMETRY
+ *
+ * Description : Build option for products whose volumes are all formatted
+ *               with the same cluster size. Defining FAT_FIXED_SEC_PER_CLUS,
+ *               e.g. with -DFAT_FIXED_SEC_PER_CLUS=8, makes the sectors per
+ *               cluster, and bytes per sector (SECTOR_LEN), constants, so the
+ *               compiler can fold the sector math and loop bounds that use
+ *               them.
+ *
+ *               The BPB_BYTES_PER_SEC, BPB_SEC_PER_CLUS and the BPB_..._SHIFT
+ *               and _MASK macros read the geometry of a volume. They are
+ *               constants if FAT_FIXED_SEC_PER_CLUS is defined, and otherwise
+ *               read the members of the BPB struct instance, B.
+ *
+ * Notes       : fat_SetBPB returns INVALID_SECTORS_PER_CLUSTER for a volume
+ *               whose cluster size does not match FAT_FIXED_SEC_PER_CLUS,
+ *               so a card formatted otherwise fails when it is mounted.
+ * ----------------------------------------------------------------------------
+ */
+
+// log2 of a power of 2 up to 2^15, as a constant expression.
+#define FAT_LOG2(N)  ((N) >= 0x8000 ? 15 : (N) >= 0x4000 ? 14                \
+                    : (N) >= 0x2000 ? 13 : (N) >= 0x1000 ? 12                 \
+                    : (N) >= 0x0800 ? 11 : (N) >= 0x0400 ? 10                 \
+                    : (N) >= 0x0200 ?  9 : (N) >= 0x0100 ?  8                 \
+                    : (N) >= 0x0080 ?  7 : (N) >= 0x0040 ?  6                 \
+                    : (N) >= 0x0020 ?  5 : (N) >= 0x0010 ?  4                 \
+                    : (N) >= 0x0008 ?  3 : (N) >= 0x0004 ?  2                 \
+                    : (N) >= 0x0002 ?  1 : 0)
+
+#ifdef FAT_FIXED_SEC_PER_CLUS
+#if !CHK_VLD_SEC_PER_CLUS(FAT_FIXED_SEC_PER_CLUS)
+#error "FAT_FIXED_SEC_PER_CLUS must be a power of 2 from 1 to 128"
+#endif
+#define BPB_BYTES_PER_SEC(B)         SECTOR_LEN
+#define BPB_SEC_PER_CLUS(B)          FAT_FIXED_SEC_PER_CLUS
+#define BPB_BYTES_PER_SEC_SHIFT(B)   FAT_LOG2(SECTOR_LEN)
+#define BPB_SEC_PER_CLUS_SHIFT(B)    FAT_LOG2(FAT_FIXED_SEC_PER_CLUS)
+#define BPB_BYTES_PER_CLUS_SHIFT(B)  (FAT_LOG2(SECTOR_LEN)                   \
+                                   + FAT_LOG2(FAT_FIXED_SEC_PER_CLUS))
+#define BPB_BYTES_PER_CLUS_MASK(B)   ((uint32_t)SECTOR_LEN                   \
+                                      * FAT_FIXED_SEC_PER_CLUS - 1)
+#define BPB_FAT_INDXS_SHIFT(B)       (FAT_LOG2(SECTOR_LEN) - FAT32_INDX_SHIFT)
+#else
+#define BPB_BYTES_PER_SEC(B)         ((B)->bytesPerSec)
+#define BPB_SEC_PER_CLUS(B)          ((B)->secPerClus)
+#define BPB_BYTES_PER_SEC_SHIFT(B)   ((B)->bytesPerSecShift)
+#define BPB_SEC_PER_CLUS_SHIFT(B)    ((B)->secPerClusShift)
+#define BPB_BYTES_PER_CLUS_SHIFT(B)  ((B)->bytesPerClusShift)
+#define BPB_BYTES_PER_CLUS_MASK(B)   ((B)->bytesPerClusMask)
+#define BPB_FAT_INDXS_SHIFT(B)       ((B)->fatIndxsPerSecShift)
+#endif//FAT_FIXED_SEC_PER_CLUS
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                              VOLUME GEOMETRY
+ *
+ * Description : Convert between clusters, sectors and byte positions using
+ *               the shifts and masks of the BPB struct, so that no divide or
+ *               multiply is needed.
+ *
+ *               BPB_CLUS_TO_SEC      - disk sector of the first sector of a
+ *                                      cluster index.
+ *               BPB_POS_TO_CLUS_NUM  - number of the cluster in a file's
+ *                                      chain that holds a byte position.
+ *               BPB_POS_IN_CLUS      - byte position in its cluster of a byte
+ *                                      position in a file.
+ *               BPB_SEC_IN_CLUS      - sector in its cluster of a byte
+ *                                      position in a file.
+ *               BPB_POS_TO_SEC_CNT   - number of sectors from the start of a
+ *                                      file to a byte position.
+ *               BPB_POS_IN_SEC       - byte position in its sector of a byte
+ *                                      position in a file.
+ *               BPB_FAT_SEC          - disk sector of the FAT holding a
+ *                                      cluster index's FAT entry.
+ *               BPB_FAT_POS          - byte position of that entry in the
+ *                                      FAT sector.
+ *
+ * Notes       : B is a pointer to a BPB struct instance set by fat_SetBPB.
+ * ----------------------------------------------------------------------------
+ */
+#define BPB_CLUS_TO_SEC(B, CLUS)     ((B)->dataRegionFirstSector             \
+                                   + ((uint32_t)((CLUS) - (B)->rootClus)      \
+                                      << BPB_SEC_PER_CLUS_SHIFT(B)))
+#define BPB_POS_TO_CLUS_NUM(B, POS)  ((uint32_t)(POS)                        \
+                                      >> BPB_BYTES_PER_CLUS_SHIFT(B))
+#define BPB_POS_IN_CLUS(B, POS)      ((uint32_t)(POS)                        \
+                                   & BPB_BYTES_PER_CLUS_MASK(B))
+#define BPB_SEC_IN_CLUS(B, POS)      ((uint8_t)(BPB_POS_IN_CLUS(B, POS)      \
+                                                >> BPB_BYTES_PER_SEC_SHIFT(B)))
+#define BPB_POS_TO_SEC_CNT(B, POS)   ((uint32_t)(POS)                        \
+                                      >> BPB_BYTES_PER_SEC_SHIFT(B))
+#define BPB_POS_IN_SEC(B, POS)       ((uint16_t)(POS)                        \
+                                   & (BPB_BYTES_PER_SEC(B) - 1))
+#define BPB_FAT_SEC(B, CLUS)         ((B)->rsvdSecCnt                        \
+                                   + ((uint32_t)(CLUS)                        \
+                                      >> BPB_FAT_INDXS_SHIFT(B)))
+#define BPB_FAT_POS(B, CLUS)         (((uint16_t)(CLUS) << FAT32_INDX_SHIFT) \
+                                   & (BPB_BYTES_PER_SEC(B) - 1))
+
 /*
  ******************************************************************************
  *                                 STRUCTS      
@@ -93,8 +198,15 @@
  * Description : The members of this struct correspond to the Bios Parameter 
  *               Block fields needed by this module.
  * 
- * Notes       : dataRegionFirstSector is not a BPB field is a value calculated
- *               from the BPB values that is used frequently.
+ * Notes       : 1) dataRegionFirstSector is not a BPB field is a value
+ *                  calculated from the BPB values that is used frequently.
+ *               2) The shift and mask members are not BPB fields either. They
+ *                  are the log2 of the sizes, calculated once by fat_SetBPB,
+ *                  and used by the VOLUME GEOMETRY macros in place of divides
+ *                  and multiplies, which the AVR has no instructions for.
+ *               3) Read the geometry members with the FIXED GEOMETRY macros,
+ *                  e.g. BPB_SEC_PER_CLUS, so they become constants when
+ *                  FAT_FIXED_SEC_PER_CLUS is defined.
  * ----------------------------------------------------------------------------
  */
 typedef struct
@@ -106,6 +218,11 @@ typedef struct
   uint32_t fatSize32;
   uint32_t rootClus;
   uint32_t dataRegionFirstSector;
+  uint8_t  secPerClusShift;            // log2 of secPerClus
+  uint8_t  bytesPerSecShift;           // log2 of bytesPerSec
+  uint8_t  bytesPerClusShift;          // log2 of bytes per cluster
+  uint8_t  fatIndxsPerSecShift;        // log2 of FAT indexes per sector
+  uint32_t bytesPerClusMask;           // bytes per cluster - 1
 } 
 BPB;
 
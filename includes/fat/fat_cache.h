@@ -0,0 +1,285 @@
+/*
+ * File       : FAT_CACHE.H
+ * Version    : 2.0
+ * Target     : ATMega1280
+ * Compiler   : AVR-GCC 9.3.0
+ * Downloader : AVRDUDE 6.3
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Interface for the write-back sector cache between the FAT functions and the
+ * FATtoDisk functions. Sectors written by the FAT functions are held in the
+ * cache, and repeated writes to a sector are combined, until they are flushed
+ * to the disk by fat_Sync, by age, or to make room for another sector. While
+ * an I/O queue of FAT_IOQ.H is attached, the cache's transfers go through it.
+ */
+
+#ifndef FAT_CACHE_H
+#define FAT_CACHE_H
+
+/*
+ ******************************************************************************
+ *                                    MACROS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                 CACHE LIMITS
+ *
+ * Description : FAT_CACHE_SECS is the number of sectors held in the cache.
+ *               FAT_CACHE_AGE_MS is the longest time, in milliseconds, that a
+ *               written sector is held before the cache is flushed by
+ *               fat_CacheAutoFlush.
+ *
+ * Notes       : The cache uses FAT_CACHE_SECS * SECTOR_LEN bytes of RAM.
+ * ----------------------------------------------------------------------------
+ */
+#ifndef FAT_CACHE_SECS
+#define FAT_CACHE_SECS          4
+#endif//FAT_CACHE_SECS
+
+#ifndef FAT_CACHE_AGE_MS
+#define FAT_CACHE_AGE_MS        1000
+#endif//FAT_CACHE_AGE_MS
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                 CACHE QUOTAS
+ *
+ * Description : The most sectors of each class, see SECTOR CLASSES, that the
+ *               cache holds at once. A sector added to the cache when its
+ *               class is at its quota takes the place of a sector of the same
+ *               class, so e.g. reading a large file never evicts the FAT and
+ *               directory sectors needed by the next file lookup.
+ *
+ * Notes       : 1) Each quota must be at least 1. The quotas may add up to
+ *                  more than FAT_CACHE_SECS, in which case the classes share
+ *                  the lines above their quotas by least recent use. By
+ *                  default no class can take every line of the cache.
+ *               2) Sequential reads of file data are further limited to one
+ *                  line. See fat_CacheRead.
+ * ----------------------------------------------------------------------------
+ */
+#ifndef FAT_CACHE_DATA_SECS
+#define FAT_CACHE_DATA_SECS     (FAT_CACHE_SECS > 1 ? FAT_CACHE_SECS - 1 : 1)
+#endif//FAT_CACHE_DATA_SECS
+
+#ifndef FAT_CACHE_FAT_SECS
+#define FAT_CACHE_FAT_SECS      (FAT_CACHE_SECS > 1 ? FAT_CACHE_SECS - 1 : 1)
+#endif//FAT_CACHE_FAT_SECS
+
+#ifndef FAT_CACHE_DIR_SECS
+#define FAT_CACHE_DIR_SECS      (FAT_CACHE_SECS > 1 ? FAT_CACHE_SECS - 1 : 1)
+#endif//FAT_CACHE_DIR_SECS
+
+#if FAT_CACHE_DATA_SECS < 1 || FAT_CACHE_FAT_SECS < 1 || FAT_CACHE_DIR_SECS < 1
+#error "FAT_CACHE_DATA_SECS, _FAT_SECS and _DIR_SECS must be at least 1"
+#endif
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                               SECTOR CLASSES
+ *
+ * Description : The kind of sector being read or written. Written sectors
+ *               are flushed in order of class, i.e. file data, then the FAT,
+ *               then directories, and within a class in the order they were
+ *               first written.
+ *
+ * Notes       : Flushing in this order means a directory entry never points
+ *               to data or clusters that are not yet on the disk.
+ * ----------------------------------------------------------------------------
+ */
+#define CACHE_DATA              0
+#define CACHE_FAT               1
+#define CACHE_DIR               2
+
+/*
+ ******************************************************************************
+ *                           FUNCTION PROTOTYPES
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           READ CACHED SECTOR
+ *
+ * Description : Loads a sector into an array, from the cache if it is held
+ *               there, otherwise from the disk, in which case it is added to
+ *               the cache.
+ *
+ * Arguments   : secNum   - Block number of the sector on the disk.
+ *               secArr   - Pointer to the array that will be loaded with the
+ *                          sector. Must be of length SECTOR_LEN.
+ *               cls      - Class of the sector. See SECTOR CLASSES.
+ *
+ * Returns     : SUCCESS, FAILED_READ_SECTOR, or FAILED_WRITE_SECTOR if a
+ *               written sector could not be flushed to make room.
+ *
+ * Notes       : A CACHE_DATA sector that is not held, and is the sector after
+ *               the last CACHE_DATA sector read, takes the place of the least
+ *               recently used data sector that is not waiting to be written.
+ *               A file read from start to end therefore passes through a
+ *               single line of the cache.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_CacheRead(uint32_t secNum, uint8_t secArr[], uint8_t cls);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           PEEK CACHED SECTOR
+ *
+ * Description : Gets the cache's copy of a sector if it is held there, so it
+ *               can be used without copying it. The disk is not read.
+ *
+ * Arguments   : secNum   - Block number of the sector on the disk.
+ *
+ * Returns     : Pointer to the SECTOR_LEN bytes of the sector, or NULL if
+ *               the sector is not held.
+ *
+ * Warnings    : The pointer is only valid until the next call to any other
+ *               function of the cache, which may reuse the line.
+ * ----------------------------------------------------------------------------
+ */
+const uint8_t *fat_CachePeek(uint32_t secNum);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                          WRITE CACHED SECTOR
+ *
+ * Description : Writes an array to a sector in the cache. The sector is
+ *               written to the disk when the cache is next flushed.
+ *
+ * Arguments   : secNum   - Block number of the sector on the disk.
+ *               secArr   - Pointer to the array holding the sector. Must be
+ *                          of length SECTOR_LEN.
+ *               cls      - Class of the sector. See SECTOR CLASSES.
+ *
+ * Returns     : SUCCESS, or FAILED_WRITE_SECTOR if a written sector could not
+ *               be flushed to make room.
+ *
+ * Notes       : If the sector is already waiting to be written, its data is
+ *               replaced, so it is only written to the disk once.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_CacheWrite(uint32_t secNum, const uint8_t secArr[], uint8_t cls);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            LOAD SECTOR RANGE
+ *
+ * Description : Reads a range of sectors from the disk into the cache, with a
+ *               single multiple sector read, so that later reads of them by
+ *               fat_CacheRead are served from the cache.
+ *
+ * Arguments   : secNum      - Block number of the first sector of the range.
+ *               numOfSecs   - Number of sectors in the range.
+ *               cls         - Class of the sectors. See SECTOR CLASSES.
+ *
+ * Returns     : SUCCESS, FAILED_READ_SECTOR, or FAILED_WRITE_SECTOR if a
+ *               written sector could not be flushed to make room.
+ *
+ * Notes       : 1) Sectors at either end of the range that are already held
+ *                  are not read. Sectors of the range waiting to be written
+ *                  keep the data written to them.
+ *               2) Only the last sectors of a range longer than the quota of
+ *                  its class are read, as the cache would not keep the
+ *                  others.
+ *               3) The lines for the sectors are taken, and any of them
+ *                  waiting to be written flushed, before the read starts, as
+ *                  the disk cannot be written during a multiple sector read.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_CacheLoad(uint32_t secNum, uint32_t numOfSecs, uint8_t cls);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                 SYNC TO DISK
+ *
+ * Description : Writes every sector waiting in the cache to the disk, in the
+ *               order described in SECTOR CLASSES. Consecutive sectors are
+ *               written with a single multiple sector write.
+ *
+ * Arguments   : void
+ *
+ * Returns     : SUCCESS or FAILED_WRITE_SECTOR. Sectors not written are kept
+ *               waiting.
+ *
+ * Notes       : This is a barrier. Nothing written after it returns SUCCESS
+ *               reaches the disk before what was written before it.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_Sync(void);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                      SYNC CACHE SECTOR RANGE
+ *
+ * Description : Calls fat_Sync if any sector in a range of sectors is waiting
+ *               in the cache. Used before the range is read from the disk
+ *               around the cache.
+ *
+ * Arguments   : secNum      - Block number of the first sector of the range.
+ *               numOfSecs   - Number of sectors in the range.
+ *
+ * Returns     : SUCCESS or FAILED_WRITE_SECTOR.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_CacheSyncRange(uint32_t secNum, uint32_t numOfSecs);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                   DISCARD CACHE SECTOR RANGE
+ *
+ * Description : Removes the sectors in a range of sectors from the cache. Used
+ *               when the range is written to the disk around the cache, so
+ *               the cache does not hold the old data.
+ *
+ * Arguments   : secNum      - Block number of the first sector of the range.
+ *               numOfSecs   - Number of sectors in the range.
+ *
+ * Returns     : void
+ *
+ * Warnings    : Sectors of the range waiting to be written are lost. Call
+ *               fat_CacheSyncRange first to keep them.
+ * ----------------------------------------------------------------------------
+ */
+void fat_CacheDiscardRange(uint32_t secNum, uint32_t numOfSecs);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             AUTO-FLUSH CACHE
+ *
+ * Description : Calls fat_Sync if the oldest sector waiting in the cache was
+ *               first written FAT_CACHE_AGE_MS or more ago.
+ *
+ * Arguments   : void
+ *
+ * Returns     : SUCCESS or FAILED_WRITE_SECTOR.
+ *
+ * Notes       : This is called by fat_CacheRead and fat_CacheWrite. It should
+ *               also be called periodically from the main loop, so sectors
+ *               are flushed when the FAT functions are not being used.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_CacheAutoFlush(void);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             INVALIDATE CACHE
+ *
+ * Description : Removes every sector from the cache, e.g. after the disk is
+ *               changed.
+ *
+ * Arguments   : void
+ *
+ * Returns     : void
+ *
+ * Warnings    : Sectors waiting to be written are lost. Call fat_Sync first
+ *               to keep them.
+ * ----------------------------------------------------------------------------
+ */
+void fat_CacheInvalidate(void);
+
+#endif //FAT_CACHE_H
@@ -0,0 +1,314 @@
+/*
+ * File       : FAT_IOQ.H
+ * Version    : 2.0
+ * Target     : ATMega1280
+ * Compiler   : AVR-GCC 9.3.0
+ * Downloader : AVRDUDE 6.3
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Interface for a queue of sector read and write requests in front of the
+ * FATtoDisk functions, for when more than one part of an application uses the
+ * disk. Requests are serviced in order of priority, then in elevator order
+ * within a priority, and adjacent requests are merged into a single multiple
+ * sector transfer. Once a queue is attached by fat_IoqAttach, the sector
+ * cache, FatStream and FatRing send their transfers through it.
+ */
+
+#ifndef FAT_IOQ_H
+#define FAT_IOQ_H
+
+/*
+ ******************************************************************************
+ *                                    MACROS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                 QUEUE LIMITS
+ *
+ * Description : IOQ_LEN_MAX is the number of requests the queue can hold.
+ *               IOQ_MERGE_MAX is the largest number of sectors that requests
+ *               are merged up to in a single transfer.
+ *
+ * Notes       : A single request larger than IOQ_MERGE_MAX is still
+ *               transferred whole, but nothing is merged with it.
+ * ----------------------------------------------------------------------------
+ */
+#ifndef IOQ_LEN_MAX
+#define IOQ_LEN_MAX             8
+#endif//IOQ_LEN_MAX
+
+#ifndef IOQ_MERGE_MAX
+#define IOQ_MERGE_MAX           8
+#endif//IOQ_MERGE_MAX
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           REQUEST PRIORITIES
+ *
+ * Description : Values of the prio member of a request. Lower values are
+ *               serviced first.
+ *
+ * Notes       : Priorities are strict. No request is serviced while one of a
+ *               lower value can be, so IOQ_PRIO_RT should only be used for
+ *               requests with a deadline, e.g. writes of a data logger.
+ * ----------------------------------------------------------------------------
+ */
+#define IOQ_PRIO_RT             0
+#define IOQ_PRIO_NORMAL         1
+#define IOQ_PRIO_SHELL          2
+#define IOQ_PRIO_CNT            3
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           REQUEST OPERATIONS
+ *
+ * Description : Values of the op member of a request.
+ * ----------------------------------------------------------------------------
+ */
+#define IOQ_READ                0
+#define IOQ_WRITE               1
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            QUEUE ERROR FLAGS
+ *
+ * Description : Flags returned by fat_IoqSubmit.
+ *
+ * Notes       : The status of a request can also be one of the FAT Error
+ *               Flags from FAT.H.
+ * ----------------------------------------------------------------------------
+ */
+#define IOQ_FULL                0x03
+#define IOQ_INVALID_REQ         0x05
+
+/*
+ ******************************************************************************
+ *                                   STRUCTS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           I/O REQUEST STRUCT
+ *
+ * Description : A request to read or write consecutive sectors of the disk.
+ *
+ * Notes       : 1) secNum is the block number of the sector on the disk, as
+ *                  passed to the FATtoDisk functions.
+ *               2) secArr must hold numOfSecs * SECTOR_LEN bytes.
+ *               3) status is set by the queue. It is STEP_BUSY while the
+ *                  request is queued, then SUCCESS, FAILED_READ_SECTOR or
+ *                  FAILED_WRITE_SECTOR.
+ *
+ * Warnings    : 1) The request and secArr must not be changed, or go out of
+ *                  scope, while the request is queued.
+ *               2) Requests go around the sector cache of FAT_CACHE.H. Call
+ *                  fat_Sync before a request for sectors the FAT functions
+ *                  have written.
+ * ----------------------------------------------------------------------------
+ */
+typedef struct
+{
+  uint32_t secNum;                     // disk sector of the first sector
+  uint8_t *secArr;                     // data of the sectors
+  uint16_t numOfSecs;                  // number of sectors
+  uint8_t  prio;                       // see REQUEST PRIORITIES
+  uint8_t  op;                         // IOQ_READ or IOQ_WRITE
+  volatile uint8_t status;             // set by the queue
+}
+IoReq;
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                     I/O REQUEST QUEUE STRUCT
+ *
+ * Description : Holds the queued requests, in the order they were submitted,
+ *               and the position and direction of the elevator.
+ *
+ * Notes       : Any instance of this struct must be initialized by passing it
+ *               to fat_IoqInit.
+ *
+ * Warnings    : Members of an instance of this struct should never be set
+ *               manually, but only by passing it to the functions here.
+ * ----------------------------------------------------------------------------
+ */
+typedef struct
+{
+  IoReq   *reqArr[IOQ_LEN_MAX];        // queued requests, oldest first
+  uint8_t  cnt;                        // number of queued requests
+  uint8_t  upward;                     // 1 if the elevator is moving up
+  uint32_t headSecNum;                 // disk sector after the last transfer
+}
+FatIoq;
+
+/*
+ ******************************************************************************
+ *                           FUNCTION PROTOTYPES
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                         INITIALIZE I/O QUEUE
+ *
+ * Description : Sets a FatIoq instance to an empty queue.
+ *
+ * Arguments   : q    - Pointer to the FatIoq instance to be set.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void fat_IoqInit(FatIoq *q);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           SUBMIT I/O REQUEST
+ *
+ * Description : Adds a request to the queue. The request is transferred by a
+ *               later call to fat_IoqService or fat_IoqWait.
+ *
+ * Arguments   : q      - Pointer to a FatIoq instance.
+ *               req    - Pointer to the request. Its secNum, secArr,
+ *                        numOfSecs, prio and op members must be set.
+ *
+ * Returns     : SUCCESS, IOQ_FULL if IOQ_LEN_MAX requests are queued, or
+ *               IOQ_INVALID_REQ if numOfSecs is 0, or prio or op is not
+ *               valid.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_IoqSubmit(FatIoq *q, IoReq *req);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            SERVICE I/O QUEUE
+ *
+ * Description : Makes a single transfer to or from the disk. The request
+ *               transferred is the next one, in elevator order, of the
+ *               highest priority with a request that can be transferred.
+ *               Queued requests of the same priority and operation that
+ *               are next to it on the disk are merged into the transfer.
+ *
+ * Arguments   : q      - Pointer to a FatIoq instance.
+ *
+ * Returns     : Number of requests still queued.
+ *
+ * Notes       : 1) This is meant to be called from the main loop, so the
+ *                  disk is only used for one transfer at a time.
+ *               2) A request is not transferred before an older request
+ *                  for any of the same sectors, if either one is a write, so
+ *                  a read always returns the data of the writes submitted
+ *                  before it.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_IoqService(FatIoq *q);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                         WAIT FOR I/O REQUEST
+ *
+ * Description : Services the queue until a request has been transferred.
+ *
+ * Arguments   : q      - Pointer to a FatIoq instance.
+ *               req    - Pointer to a request submitted to q.
+ *
+ * Returns     : The status of the request. SUCCESS, FAILED_READ_SECTOR or
+ *               FAILED_WRITE_SECTOR.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_IoqWait(FatIoq *q, IoReq *req);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             ATTACH I/O QUEUE
+ *
+ * Description : Sets the queue the FAT modules send their transfers to. The
+ *               sector cache of FAT_CACHE.H sends its reads and writes at
+ *               IOQ_PRIO_NORMAL, and FatStream and FatRing send their writes
+ *               at IOQ_PRIO_RT, so the sectors of a logger are written before
+ *               those of, e.g., a directory listing.
+ *
+ * Arguments   : q      - Pointer to a FatIoq instance set by fat_IoqInit, or
+ *                        NULL for the modules to use the disk directly.
+ *
+ * Returns     : void
+ *
+ * Notes       : 1) The queue is serviced by the modules while they wait for
+ *                  their requests, and by each fat_StreamService, so the
+ *                  application does not have to call fat_IoqService.
+ *               2) FatPlay, fat_ProbeRun and the multiple sector reads of
+ *                  FAT.H still use the disk directly.
+ *
+ * Warnings    : Only change the attached queue while it is empty and no
+ *               FatStream is open.
+ * ----------------------------------------------------------------------------
+ */
+void fat_IoqAttach(FatIoq *q);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                        IS I/O QUEUE ATTACHED
+ *
+ * Description : Checks if a queue has been attached by fat_IoqAttach.
+ *
+ * Arguments   : void
+ *
+ * Returns     : 1 if a queue is attached, otherwise 0.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_IoqIsAttached(void);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             SEND I/O REQUEST
+ *
+ * Description : Submits a request to the attached queue. If the queue is
+ *               full, it is serviced until there is room.
+ *
+ * Arguments   : req    - Pointer to the request, as for fat_IoqSubmit.
+ *
+ * Returns     : SUCCESS or IOQ_INVALID_REQ.
+ *
+ * Warnings    : Only call while a queue is attached.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_IoqSend(IoReq *req);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             POLL I/O REQUEST
+ *
+ * Description : Makes a single transfer of the attached queue if a request
+ *               sent to it is still queued.
+ *
+ * Arguments   : req    - Pointer to a request sent by fat_IoqSend.
+ *
+ * Returns     : The status of the request. STEP_BUSY while it is queued,
+ *               then SUCCESS, FAILED_READ_SECTOR or FAILED_WRITE_SECTOR.
+ *
+ * Notes       : The transfer made may be of another request of a higher
+ *               priority, or nearer the elevator.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_IoqPoll(const IoReq *req);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                         TRANSFER I/O REQUEST
+ *
+ * Description : Transfers a request and waits for it. It is sent to the
+ *               attached queue if there is one, otherwise it is transferred
+ *               directly.
+ *
+ * Arguments   : req    - Pointer to the request, as for fat_IoqSubmit.
+ *
+ * Returns     : SUCCESS, FAILED_READ_SECTOR, FAILED_WRITE_SECTOR or
+ *               IOQ_INVALID_REQ.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_IoqTransfer(IoReq *req);
+
+#endif //FAT_IOQ_H
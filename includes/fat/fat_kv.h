@@ -0,0 +1,309 @@
+/*
+ * File       : FAT_KV.H
+ * Version    : 2.0
+ * Target     : ATMega1280
+ * Compiler   : AVR-GCC 9.3.0
+ * Downloader : AVRDUDE 6.3
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Interface for a small key-value store kept in two preallocated FAT files,
+ * e.g. for settings and counters. Updates are appended to a log in the store
+ * file, and the position of each key's latest record is kept in a hash index
+ * in RAM, so a get or a put only reads or writes the sectors it needs. When
+ * the log fills, the live records are compacted into the second file, a step
+ * at a time, and the directory entries of the two files are then swapped.
+ */
+
+#ifndef FAT_KV_H
+#define FAT_KV_H
+
+/*
+ ******************************************************************************
+ *                                    MACROS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                              KV STORE LIMITS
+ *
+ * Description : Max lengths of keys and values, the number of slots in the
+ *               hash index, and how full the log can get, as a percent of the
+ *               store file, before fat_KvCompactStep begins a compaction.
+ *
+ * Notes       : 1) KV_INDEX_SLOTS must be a power of 2. It is the max number
+ *                  of keys, including deleted keys that have not yet been
+ *                  removed by a compaction. Each slot uses 6 bytes of RAM.
+ *               2) KV_KEY_LEN_MAX and KV_VAL_LEN_MAX must be less than 255.
+ * ----------------------------------------------------------------------------
+ */
+#ifndef KV_KEY_LEN_MAX
+#define KV_KEY_LEN_MAX          8
+#endif//KV_KEY_LEN_MAX
+
+#ifndef KV_VAL_LEN_MAX
+#define KV_VAL_LEN_MAX          32
+#endif//KV_VAL_LEN_MAX
+
+#ifndef KV_INDEX_SLOTS
+#define KV_INDEX_SLOTS          32
+#endif//KV_INDEX_SLOTS
+
+#ifndef KV_COMPACT_PCT
+#define KV_COMPACT_PCT          50
+#endif//KV_COMPACT_PCT
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            KV FILE LAYOUT
+ *
+ * Description : Sector 0 of each file is a header. The log begins at sector 1.
+ *               Each log sector begins with the generation of the store it
+ *               was written for, followed by records, which never cross a
+ *               sector boundary. A record is:
+ *
+ *               [keyLen][valLen][key bytes][value bytes][crc8]
+ *
+ *               A keyLen of 0 ends the records of a sector. A valLen of
+ *               KV_TOMBSTONE marks the key as deleted and has no value bytes.
+ *
+ * Notes       : 1) A log sector whose generation does not match the header is
+ *                  left over from an older store and ends the log.
+ *               2) The header's snapEnd is the end of the records copied by
+ *                  the last compaction, i.e. the snapshot. These hold one
+ *                  record per key, so they are replayed without comparing
+ *                  keys. A snapEnd of 0 marks a compaction in progress.
+ *               3) prevClus and prevSize are the first cluster index and size
+ *                  of the file this store was compacted from. They are used to
+ *                  repair the entries if a swap was interrupted.
+ * ----------------------------------------------------------------------------
+ */
+#define KV_MAGIC                "KVS1"
+#define KV_MAGIC_LEN            4
+#define KV_HDR_GEN_POS          4
+#define KV_HDR_SNAP_END_POS     8
+#define KV_HDR_PREV_CLUS_POS    12
+#define KV_HDR_PREV_SIZE_POS    16
+#define KV_HDR_LEN              20
+
+#define KV_SEC_HDR_LEN          4         // generation at start of log sector
+#define KV_REC_HDR_LEN          2         // keyLen and valLen bytes
+#define KV_REC_LEN_MAX          (KV_REC_HDR_LEN + KV_KEY_LEN_MAX \
+                                 + KV_VAL_LEN_MAX + 1)
+#define KV_TOMBSTONE            0xFF
+
+// set in a slotPos of FatKv if the key's latest record is a tombstone.
+#define KV_DELETED_FLAG         0x80000000
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                               KV ERROR FLAGS
+ *
+ * Description : Flags returned by the key-value store functions.
+ *
+ * Notes       : The store functions can also return the FAT Error Flags from
+ *               FAT.H.
+ * ----------------------------------------------------------------------------
+ */
+#define KV_KEY_NOT_FOUND        0x03
+#define KV_NOT_FORMATTED        0x05
+#define KV_STORE_FULL           0x06
+#define KV_INDEX_FULL           0x07
+#define KV_INVALID_KEY          0x09
+#define KV_COMPACTING           0x0A
+#define KV_VALUE_TOO_LONG       0x0B
+
+/*
+ ******************************************************************************
+ *                                   STRUCTS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                         FAT KV STORE STRUCT
+ *
+ * Description : Holds the two files of a key-value store, the position of the
+ *               end of its log, its hash index, and the state of a compaction.
+ *
+ * Notes       : 1) Any instance of this struct must be initialized by passing
+ *                  it to fat_KvMount or fat_KvFormat.
+ *               2) files[0] is always the store and files[1] the file that the
+ *                  next compaction is written to.
+ *               3) slotHash is 0 for an empty slot. slotPos is the position of
+ *                  the key's latest record in the store, with KV_DELETED_FLAG
+ *                  set if that record is a tombstone.
+ *
+ * Warnings    : Members of an instance of this struct should never be set
+ *               manually, but only by passing it to the KV functions.
+ * ----------------------------------------------------------------------------
+ */
+typedef struct
+{
+  FatFile  files[2];                   // store file and compaction file
+  uint32_t gen;                        // generation of the store
+  uint32_t topGen;                     // highest generation in either file
+  uint32_t tailPos;                    // position of next record in store
+  uint8_t  compPhase;                  // state of the compaction
+  uint8_t  compSlot;                   // next index slot to copy
+  uint32_t compSrcPos;                 // next store record to copy
+  uint32_t compDstPos;                 // position of next copied record
+  uint32_t compSnapEnd;                // end of the copied index slots
+  uint16_t slotHash[KV_INDEX_SLOTS];   // hash of each key
+  uint32_t slotPos[KV_INDEX_SLOTS];    // position of each key's record
+}
+FatKv;
+
+/*
+ ******************************************************************************
+ *                           FUNCTION PROTOTYPES
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            FORMAT KV STORE
+ *
+ * Description : Writes the headers of an empty store to the two files, and
+ *               then mounts it.
+ *
+ * Arguments   : kv        - Pointer to the FatKv instance to be set.
+ *               dir       - Pointer to a FatDir instance. This directory must
+ *                           contain the entries of both files.
+ *               storeStr  - Pointer to a string. Name of the store file.
+ *               tempStr   - Pointer to a string. Name of the second file.
+ *               bpb       - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, KV_NOT_FORMATTED if either file is less than two
+ *               sectors long, or a FAT Error Flag.
+ *
+ * Notes       : 1) The files must already exist. Their size is the capacity
+ *                  of the store and is never changed.
+ *               2) Any contents of the store are lost.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_KvFormat(FatKv *kv, const FatDir *dir, const char storeStr[],
+                     const char tempStr[], const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             MOUNT KV STORE
+ *
+ * Description : Opens the two files of a store and builds its hash index by
+ *               replaying the snapshot and then the rest of the log.
+ *
+ * Arguments   : kv        - Pointer to the FatKv instance to be set.
+ *               dir       - Pointer to a FatDir instance. This directory must
+ *                           contain the entries of both files.
+ *               storeStr  - Pointer to a string. Name of the store file.
+ *               tempStr   - Pointer to a string. Name of the second file.
+ *               bpb       - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, KV_NOT_FORMATTED, KV_INDEX_FULL, or a FAT Error
+ *               Flag.
+ *
+ * Notes       : If a compaction was interrupted after the second file was
+ *               complete, the swap of the directory entries is finished here.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_KvMount(FatKv *kv, const FatDir *dir, const char storeStr[],
+                    const char tempStr[], const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                 GET KEY VALUE
+ *
+ * Description : Loads the value of a key into an array.
+ *
+ * Arguments   : kv       - Pointer to a mounted FatKv instance.
+ *               keyStr   - Pointer to the key string.
+ *               valArr   - Pointer to the array that will be loaded with the
+ *                          value. Must be at least KV_VAL_LEN_MAX long.
+ *               valLen   - Pointer to the value's length, set here.
+ *               bpb      - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, KV_KEY_NOT_FOUND, KV_INVALID_KEY, or a FAT Error
+ *               Flag.
+ *
+ * Notes       : Reads the sector holding the key's record, only.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_KvGet(FatKv *kv, const char keyStr[], uint8_t valArr[],
+                  uint8_t *valLen, const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                 PUT KEY VALUE
+ *
+ * Description : Sets the value of a key, adding the key if it does not exist.
+ *
+ * Arguments   : kv       - Pointer to a mounted FatKv instance.
+ *               keyStr   - Pointer to the key string. 1 to KV_KEY_LEN_MAX
+ *                          characters.
+ *               valArr   - Pointer to the array holding the value.
+ *               valLen   - Length of the value. 0 to KV_VAL_LEN_MAX.
+ *               bpb      - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, KV_INVALID_KEY, KV_VALUE_TOO_LONG if valLen is more
+ *               than KV_VAL_LEN_MAX, KV_INDEX_FULL, KV_STORE_FULL, or a FAT
+ *               Error Flag.
+ *
+ * Notes       : 1) Appends one record to the log. This writes the last sector
+ *                  of the log, which is read first unless the record starts
+ *                  a new sector.
+ *               2) If KV_STORE_FULL is returned, the store must be compacted
+ *                  by calling fat_KvCompactStep before the put is retried.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_KvPut(FatKv *kv, const char keyStr[], const uint8_t valArr[],
+                  uint8_t valLen, const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                   DELETE KEY
+ *
+ * Description : Deletes a key from the store by appending a tombstone record.
+ *
+ * Arguments   : kv       - Pointer to a mounted FatKv instance.
+ *               keyStr   - Pointer to the key string.
+ *               bpb      - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, KV_KEY_NOT_FOUND, KV_INVALID_KEY, KV_STORE_FULL, or
+ *               a FAT Error Flag.
+ *
+ * Notes       : The key's index slot is not freed until the next compaction.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_KvDelete(FatKv *kv, const char keyStr[], const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                        STEP KV COMPACTION
+ *
+ * Description : Performs one step of a compaction of the store, beginning one
+ *               if the log is more than KV_COMPACT_PCT percent of the store
+ *               file. Each step copies one live record into the second file.
+ *               The last step writes its header, swaps the directory entries
+ *               of the two files, and rebuilds the index from the new store.
+ *
+ * Arguments   : kv       - Pointer to a mounted FatKv instance.
+ *               bpb      - Pointer to the BPB struct instance.
+ *
+ * Returns     : KV_COMPACTING while a compaction is in progress. SUCCESS if
+ *               none is in progress, or one was just finished. KV_STORE_FULL
+ *               if the live records do not fit in the second file, in which
+ *               case the compaction is abandoned. Otherwise a FAT Error Flag.
+ *
+ * Notes       : 1) Gets, puts and deletes can be called between steps. Any
+ *                  records appended to the store after a compaction begins
+ *                  are copied in order after the index slots.
+ *               2) If a compaction is interrupted, e.g. by a power loss, the
+ *                  store is unchanged, or the swap is finished when the store
+ *                  is next mounted.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_KvCompactStep(FatKv *kv, const BPB *bpb);
+
+#endif //FAT_KV_H
@@ -0,0 +1,182 @@
+/*
+ * File       : FAT_LZ.H
+ * Version    : 2.0
+ * Target     : ATMega1280
+ * Compiler   : AVR-GCC 9.3.0
+ * Downloader : AVRDUDE 6.3
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Interface for reading files compressed with the LZSS compressor in
+ * tools/fat_lzs.c. The file is decompressed as it is read, so only the
+ * compressed sectors are read from the disk. The decoder keeps a small
+ * window of the most recent plaintext bytes in RAM.
+ */
+
+#ifndef FAT_LZ_H
+#define FAT_LZ_H
+
+/*
+ ******************************************************************************
+ *                                    MACROS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                       COMPRESSED FILE FORMAT
+ *
+ * Description : A compressed file begins with a header:
+ *
+ *               [magic "LZS1"][window bits][length bits][plaintext size]
+ *
+ *               where the plaintext size is a 32-bit little-endian value. The
+ *               header is followed by a stream of bits, most significant bit
+ *               of each byte first. Each token in the stream is either:
+ *
+ *               1 [8-bit literal byte]
+ *               0 [window bits: distance - 1][length bits: length - LZ_MIN_LEN]
+ *
+ *               A reference copies 'length' bytes starting 'distance' bytes
+ *               back in the plaintext.
+ * ----------------------------------------------------------------------------
+ */
+#define LZ_MAGIC                "LZS1"
+#define LZ_MAGIC_LEN            4
+#define LZ_WIN_BITS_POS         4
+#define LZ_LEN_BITS_POS         5
+#define LZ_SIZE_POS             6
+#define LZ_HDR_LEN              10
+#define LZ_MIN_LEN              2
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           DECODER RAM LIMITS
+ *
+ * Description : LZ_WIN_BITS_MAX is the largest window, as a power of 2, of a
+ *               file that can be read. LZ_IN_BUF_LEN is the length of the
+ *               buffer of compressed bytes.
+ *
+ * Notes       : 1) The window uses 2^LZ_WIN_BITS_MAX bytes of RAM.
+ *               2) LZ_IN_BUF_LEN should be the sector length so that each
+ *                  compressed sector is read from the disk only once. It must
+ *                  be a power of 2 no larger than the sector length.
+ *               3) Length bits can be 1 to 8.
+ * ----------------------------------------------------------------------------
+ */
+#ifndef LZ_WIN_BITS_MAX
+#define LZ_WIN_BITS_MAX         8
+#endif//LZ_WIN_BITS_MAX
+
+#ifndef LZ_IN_BUF_LEN
+#define LZ_IN_BUF_LEN           SECTOR_LEN
+#endif//LZ_IN_BUF_LEN
+
+#define LZ_LEN_BITS_MAX         8
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                      COMPRESSION ERROR FLAGS
+ *
+ * Description : Flags returned by the compressed file functions.
+ *
+ * Notes       : These functions can also return the FAT Error Flags from
+ *               FAT.H.
+ * ----------------------------------------------------------------------------
+ */
+#define LZ_INVALID_FORMAT       0x05
+#define LZ_CORRUPT_DATA         0x06
+
+/*
+ ******************************************************************************
+ *                                   STRUCTS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                   FAT COMPRESSED FILE STRUCT
+ *
+ * Description : Holds the state of the decoder of a compressed file: the
+ *               window of recent plaintext, the buffer of compressed bytes,
+ *               and any reference that has not yet been fully copied.
+ *
+ * Notes       : Any instance of this struct must be initialized by passing it
+ *               to fat_OpenCompressed.
+ *
+ * Warnings    : Members of an instance of this struct should never be set
+ *               manually, but only by passing it to the functions here.
+ * ----------------------------------------------------------------------------
+ */
+typedef struct
+{
+  FatFile  file;                       // the compressed file
+  uint32_t outSize;                    // plaintext size
+  uint32_t outPos;                     // plaintext position of next read
+  uint8_t  winBits;                    // window bits of the file
+  uint8_t  lenBits;                    // length bits of the file
+  uint16_t winPos;                     // window position of next byte
+  uint16_t refDist;                    // distance of reference being copied
+  uint16_t refLen;                     // bytes of the reference left to copy
+  uint16_t inPos;                      // position of next byte in inArr
+  uint16_t inLen;                      // number of bytes loaded in inArr
+  uint8_t  bitBuf;                     // byte currently being read
+  uint8_t  bitCnt;                     // bits of bitBuf not yet read
+  uint8_t  win[1 << LZ_WIN_BITS_MAX];  // recent plaintext
+  uint8_t  inArr[LZ_IN_BUF_LEN];       // compressed bytes
+}
+FatLz;
+
+/*
+ ******************************************************************************
+ *                           FUNCTION PROTOTYPES
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                         OPEN COMPRESSED FILE
+ *
+ * Description : Sets a FatLz instance to decompress a file from its first
+ *               plaintext byte.
+ *
+ * Arguments   : lz      - Pointer to the FatLz instance to be set.
+ *               file    - Pointer to a FatFile instance, set by fat_OpenFile,
+ *                         of the compressed file.
+ *               bpb     - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, LZ_INVALID_FORMAT if the header is not valid or the
+ *               window is larger than 2^LZ_WIN_BITS_MAX, or a FAT Error Flag.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_OpenCompressed(FatLz *lz, const FatFile *file, const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                         READ COMPRESSED FILE
+ *
+ * Description : Decompresses the next bytes of plaintext of a compressed file
+ *               into an array.
+ *
+ * Arguments   : lz        - Pointer to a FatLz instance set by
+ *                           fat_OpenCompressed.
+ *               dataArr   - Pointer to the array that will be loaded with the
+ *                           plaintext bytes.
+ *               len       - Number of plaintext bytes to read.
+ *               bpb       - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS if len bytes were read. END_OF_FILE if the end of the
+ *               plaintext was reached first, in which case the bytes up to the
+ *               end were still loaded. The number of bytes read can be found
+ *               from the change in lz->outPos. LZ_CORRUPT_DATA if the stream
+ *               is not valid, or a FAT Error Flag.
+ *
+ * Notes       : The plaintext can only be read in order. To read it again,
+ *               pass the instance to fat_OpenCompressed.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_ReadCompressed(FatLz *lz, uint8_t dataArr[], uint16_t len,
+                           const BPB *bpb);
+
+#endif //FAT_LZ_H
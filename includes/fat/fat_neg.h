@@ -0,0 +1,159 @@
+/*
+ * File       : FAT_NEG.H
+ * Version    : 2.0
+ * Target     : ATMega1280
+ * Compiler   : AVR-GCC 9.3.0
+ * Downloader : AVRDUDE 6.3
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Interface for the negative lookup cache. A Bloom filter of the names in a
+ * directory is built while a lookup searches the directory. Once a search
+ * has read the whole directory, a later lookup of a name that is not in the
+ * filter is answered as not found without reading the disk, e.g. when a
+ * logger checks LOG0001, LOG0002, ... for the first name that is free.
+ */
+
+#ifndef FAT_NEG_H
+#define FAT_NEG_H
+
+/*
+ ******************************************************************************
+ *                                    MACROS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                          NEGATIVE CACHE SIZE
+ *
+ * Description : FAT_NEG_DIRS is the number of directories a filter is kept
+ *               for. FAT_NEG_BITS is the number of bits in each filter, and
+ *               must be a power of 2 from 8 to 32768.
+ *
+ * Notes       : 1) The filters use FAT_NEG_DIRS * (FAT_NEG_BITS / 8 + 8)
+ *                  bytes of RAM.
+ *               2) Each name sets 2 bits of the filter. For a directory of
+ *                  FAT_NEG_BITS / 5 names about 1 in 10 names that are not in
+ *                  it still need a search. Larger directories fill the filter,
+ *                  and then most misses need a search.
+ * ----------------------------------------------------------------------------
+ */
+#ifndef FAT_NEG_DIRS
+#define FAT_NEG_DIRS            2
+#endif//FAT_NEG_DIRS
+
+#ifndef FAT_NEG_BITS
+#define FAT_NEG_BITS            512
+#endif//FAT_NEG_BITS
+
+#if FAT_NEG_BITS < 8 || FAT_NEG_BITS > 32768                                  \
+    || (FAT_NEG_BITS & (FAT_NEG_BITS - 1))
+#error "FAT_NEG_BITS must be a power of 2 from 8 to 32768"
+#endif
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                  FILTER TAGS
+ *
+ * Description : NEG_NO_TAG is passed to fat_NegAdd and fat_NegEnd by a
+ *               search that is not building a filter. It is never the tag of
+ *               a filter.
+ * ----------------------------------------------------------------------------
+ */
+#define NEG_NO_TAG              0xFFFF
+
+/*
+ ******************************************************************************
+ *                           FUNCTION PROTOTYPES
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           IS NAME NOT IN DIR
+ *
+ * Description : Checks the filter of a directory for a name.
+ *
+ * Arguments   : dirClusIndx   - Index of the directory's first cluster.
+ *               nameStr       - Pointer to the name, as it would be compared
+ *                               to the lnStr member of a FatEntry.
+ *
+ * Returns     : 1 if the directory does not hold an entry of that name.
+ *               0 if it might, or there is no complete filter for it.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_NegIsAbsent(uint32_t dirClusIndx, const char nameStr[]);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           BEGIN FILTER BUILD
+ *
+ * Description : Gets the filter of a directory for a search of it that
+ *               starts at its first entry. If there is no filter for the
+ *               directory, the least recently claimed one is cleared and
+ *               given to it.
+ *
+ * Arguments   : dirClusIndx   - Index of the directory's first cluster.
+ *
+ * Returns     : Tag of the filter, to be passed to fat_NegAdd and fat_NegEnd.
+ *
+ * Notes       : The tag of a filter that is cleared, or given to another
+ *               directory, during the search is no longer valid, so nothing
+ *               is added to the filter with it.
+ * ----------------------------------------------------------------------------
+ */
+uint16_t fat_NegBegin(uint32_t dirClusIndx);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           ADD NAME TO FILTER
+ *
+ * Description : Adds the name of an entry found by a search to the filter of
+ *               the directory being searched.
+ *
+ * Arguments   : tag       - Tag returned by fat_NegBegin, or NEG_NO_TAG.
+ *               nameStr   - Pointer to the lnStr member of the FatEntry.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void fat_NegAdd(uint16_t tag, const char nameStr[]);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             END FILTER BUILD
+ *
+ * Description : Marks the filter of a directory as complete, once a search
+ *               that added every entry to it has reached END_OF_DIRECTORY.
+ *               fat_NegIsAbsent only answers from complete filters.
+ *
+ * Arguments   : tag   - Tag returned by fat_NegBegin, or NEG_NO_TAG.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void fat_NegEnd(uint16_t tag);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                    INVALIDATE NEGATIVE CACHE
+ *
+ * Description : fat_NegInvalidate clears the filter of a directory, and
+ *               fat_NegInvalidateAll clears every filter.
+ *
+ * Arguments   : dirClusIndx   - Index of the directory's first cluster.
+ *
+ * Returns     : void
+ *
+ * Warnings    : Any code that creates or renames an entry of a directory must
+ *               call fat_NegInvalidate for the directory, otherwise the new
+ *               name can be reported as not found. Call fat_NegInvalidateAll
+ *               with fat_CacheInvalidate when the disk is changed.
+ * ----------------------------------------------------------------------------
+ */
+void fat_NegInvalidate(uint32_t dirClusIndx);
+void fat_NegInvalidateAll(void);
+
+#endif //FAT_NEG_H
@@ -0,0 +1,305 @@
+/*
+ * File       : FAT_PLAY.H
+ * Version    : 2.0
+ * Target     : ATMega1280
+ * Compiler   : AVR-GCC 9.3.0
+ * Downloader : AVRDUDE 6.3
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Interface for playing a file at a constant bitrate, e.g. audio samples to
+ * a DAC. A timer interrupt takes fixed length frames from a ring of sectors,
+ * while the main loop refills the ring with a read stream of the disk that
+ * never waits on the card. The runs of consecutive sectors of the file are
+ * found ahead of the read, while the ring is full, so reading the FAT does
+ * not hold up a refill. Underruns and the least time left in the ring when
+ * a sector is added are kept, so the margin of a card and file can be
+ * measured before it fails.
+ */
+
+#ifndef FAT_PLAY_H
+#define FAT_PLAY_H
+
+/*
+ ******************************************************************************
+ *                                    MACROS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                PLAY SETTINGS
+ *
+ * Description : PLAY_RING_SECS is the number of sectors in the ring.
+ *               PLAY_RUNS_MAX is the most runs of consecutive sectors found
+ *               ahead of the read. PLAY_RUN_SECS_MAX is the largest number of
+ *               sectors read by a single read stream of the disk.
+ *
+ * Notes       : 1) The time the ring lasts at the file's bitrate is the
+ *                  longest the disk can be slow without an underrun, so a
+ *                  higher bitrate needs more sectors.
+ *               2) PLAY_RING_SECS must be a power of 2, and not more than
+ *                  128.
+ * ----------------------------------------------------------------------------
+ */
+#ifndef PLAY_RING_SECS
+#define PLAY_RING_SECS          4
+#endif//PLAY_RING_SECS
+
+#ifndef PLAY_RUNS_MAX
+#define PLAY_RUNS_MAX           8
+#endif//PLAY_RUNS_MAX
+
+#ifndef PLAY_RUN_SECS_MAX
+#define PLAY_RUN_SECS_MAX       2048
+#endif//PLAY_RUN_SECS_MAX
+
+#if (PLAY_RING_SECS & (PLAY_RING_SECS - 1)) || PLAY_RING_SECS > 128
+#error "PLAY_RING_SECS must be a power of 2, and not more than 128"
+#endif
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             PLAY ERROR FLAGS
+ *
+ * Description : Flags returned by the play functions.
+ *
+ * Notes       : The play functions can also return the FAT Error Flags from
+ *               FAT.H.
+ * ----------------------------------------------------------------------------
+ */
+#define PLAY_NOT_ALIGNED        0x03
+#define PLAY_UNDERRUN           0x05
+#define PLAY_BAD_FRAME          0x06
+
+/*
+ ******************************************************************************
+ *                                   STRUCTS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                         FAT FILE PLAY STRUCT
+ *
+ * Description : Holds the ring of sectors being played, the runs of sectors
+ *               found ahead of the read, and the state of the disk's read
+ *               stream.
+ *
+ * Notes       : 1) Any instance of this struct must be initialized by passing
+ *                  it to fat_PlayOpen.
+ *               2) headSec and tailSec count the sectors added to and taken
+ *                  from the ring, modulo 256. The sector of a count is at
+ *                  ringArr[count % PLAY_RING_SECS]. headSec is only set by
+ *                  fat_PlayService, and tailSec and tailPos only by
+ *                  fat_PlayDrain.
+ *               3) The file's currPos is the position after the last run
+ *                  found, so it is ahead of the sectors in the ring.
+ *
+ * Warnings    : 1) Members of an instance of this struct should never be set
+ *                  manually, but only by passing it to the functions here.
+ *               2) From fat_PlayOpen until fat_PlayClose returns, the disk
+ *                  can be in a read stream. No other FAT function may use the
+ *                  disk in that time, e.g. fat_CacheAutoFlush must not be
+ *                  called from the main loop.
+ * ----------------------------------------------------------------------------
+ */
+typedef struct
+{
+  FatFile *file;                       // file being played
+  uint32_t readPos;                    // position of the next sector to read
+  uint32_t endPos;                     // position after the last whole frame
+  uint32_t byteRate;                   // bytes played per second
+  uint16_t frameLen;                   // bytes taken by each fat_PlayDrain
+  uint32_t runSecArr[PLAY_RUNS_MAX];   // first sector of each run found
+  uint16_t runLenArr[PLAY_RUNS_MAX];   // sectors left in each run
+  uint8_t  runIndx;                    // run being read
+  uint8_t  runCnt;                     // runs found and not yet read
+  uint8_t  runOpen;                    // 1 if a disk read stream is started
+  volatile uint8_t  headSec;           // sectors added to the ring
+  volatile uint8_t  tailSec;           // sectors taken from the ring
+  volatile uint16_t tailPos;           // bytes taken from the tail sector
+  volatile uint8_t  isEnd;             // 1 once the last sector is added
+  volatile uint8_t  isRunning;         // 1 while fat_PlayDrain takes frames
+  volatile uint16_t underrunCnt;       // drains with the ring empty
+  uint32_t marginMin;                  // least bytes in the ring at a refill
+  uint32_t secsRead;                   // sectors added to the ring
+  uint16_t runsFound;                  // runs found by fat_GetFileRun
+  volatile uint16_t lenArr[PLAY_RING_SECS];  // bytes to play of each sector
+  uint8_t  ringArr[PLAY_RING_SECS][SECTOR_LEN];
+}
+FatPlay;
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            PLAY STATS STRUCT
+ *
+ * Description : The counts kept while a file is played, from
+ *               fat_PlayGetStats.
+ *
+ * Notes       : 1) marginMs is the least time, at the file's bitrate, that
+ *                  was left in the ring when a sector was added to it while
+ *                  the file was playing. It is 0xFFFF until a sector is
+ *                  added.
+ *               2) underrunCnt stops at 0xFFFF.
+ * ----------------------------------------------------------------------------
+ */
+typedef struct
+{
+  uint16_t underrunCnt;                // drains with the ring empty
+  uint16_t marginMs;                   // least time left in the ring
+  uint32_t secsRead;                   // sectors added to the ring
+  uint16_t runsFound;                  // runs of consecutive sectors
+}
+FatPlayStats;
+
+/*
+ ******************************************************************************
+ *                           FUNCTION PROTOTYPES
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                               OPEN FILE PLAY
+ *
+ * Description : Sets a FatPlay instance to play a file from the file's
+ *               current position to its end.
+ *
+ * Arguments   : play       - Pointer to the FatPlay instance to be set.
+ *               file       - Pointer to a FatFile instance set by
+ *                            fat_OpenFile.
+ *               frameLen   - Number of bytes taken by each fat_PlayDrain,
+ *                            e.g. the bytes of one sample of each channel.
+ *               byteRate   - Number of bytes played each second. Only used
+ *                            to give the margin in milliseconds.
+ *               bpb        - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS. PLAY_NOT_ALIGNED if the file's position is not at
+ *               the start of a sector, or the sectors are not SECTOR_LEN
+ *               bytes. PLAY_BAD_FRAME if frameLen or byteRate is 0, or
+ *               frameLen does not divide SECTOR_LEN.
+ *
+ * Notes       : Bytes at the end of the file that do not fill a frame are
+ *               not played.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_PlayOpen(FatPlay *play, FatFile *file, uint16_t frameLen,
+                     uint32_t byteRate, const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                              START FILE PLAY
+ *
+ * Description : Fills the ring, then lets fat_PlayDrain take frames from it.
+ *
+ * Arguments   : play   - Pointer to a FatPlay instance.
+ *               bpb    - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS or a FAT Error Flag.
+ *
+ * Notes       : This waits on the disk while the ring is filled. Start the
+ *               timer that calls fat_PlayDrain after it returns.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_PlayStart(FatPlay *play, const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            SERVICE FILE PLAY
+ *
+ * Description : Refills the ring from the disk's read stream, without waiting
+ *               while the disk reads a sector. A read stream is started for
+ *               each run of consecutive sectors of the file. Runs are found,
+ *               by reading the FAT, only while no read stream is started and
+ *               either the ring is full or no run is left to read, so a
+ *               lookup is never made while the ring is short of sectors.
+ *
+ * Arguments   : play   - Pointer to a FatPlay instance.
+ *               bpb    - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS if the ring is full and every run that can be found
+ *               ahead has been. STEP_BUSY if it should be called again.
+ *               END_OF_FILE once the last sector of the file is in the ring.
+ *               Otherwise FAILED_READ_SECTOR or a FAT Error Flag from
+ *               finding the file's sectors, in which case the read stream is
+ *               stopped and the sector is read again by the next call.
+ *
+ * Notes       : This is meant to be called from the main loop, as often as
+ *               possible while the file plays. Each call does at most one
+ *               step, i.e. reads one sector, starts or stops a read stream,
+ *               or finds one run.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_PlayService(FatPlay *play, const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                              DRAIN FILE PLAY
+ *
+ * Description : Copies the next frame from the ring. Called at the file's
+ *               frame rate, e.g. from a timer interrupt.
+ *
+ * Arguments   : play       - Pointer to a FatPlay instance.
+ *               frameArr   - Pointer to the array the frame is copied to.
+ *                            Must be at least frameLen bytes.
+ *
+ * Returns     : SUCCESS if a frame was copied. PLAY_UNDERRUN if the ring is
+ *               empty, in which case the frame's time is lost and it is
+ *               counted. END_OF_FILE once every frame has been taken, or
+ *               before fat_PlayStart.
+ *
+ * Notes       : This never uses the disk, so it can be called from an
+ *               interrupt while fat_PlayService runs in the main loop.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_PlayDrain(FatPlay *play, uint8_t frameArr[]);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                              IS FILE PLAYING
+ *
+ * Description : Checks if fat_PlayDrain is still taking frames.
+ *
+ * Arguments   : play   - Pointer to a FatPlay instance.
+ *
+ * Returns     : 1 from fat_PlayStart until every frame has been taken, or
+ *               fat_PlayClose is called. Otherwise 0.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_PlayIsPlaying(const FatPlay *play);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                          GET FILE PLAY STATS
+ *
+ * Description : Loads the counts kept while the file plays into a
+ *               FatPlayStats instance.
+ *
+ * Arguments   : play    - Pointer to a FatPlay instance.
+ *               stats   - Pointer to the FatPlayStats instance to be set.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void fat_PlayGetStats(const FatPlay *play, FatPlayStats *stats);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                              CLOSE FILE PLAY
+ *
+ * Description : Stops fat_PlayDrain taking frames and stops the disk's read
+ *               stream.
+ *
+ * Arguments   : play   - Pointer to a FatPlay instance.
+ *
+ * Returns     : SUCCESS or FAILED_READ_SECTOR.
+ *
+ * Notes       : The file's currPos is left after the last run found, not
+ *               after the last frame played.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_PlayClose(FatPlay *play);
+
+#endif //FAT_PLAY_H
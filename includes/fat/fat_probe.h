@@ -0,0 +1,166 @@
+/*
+ * File       : FAT_PROBE.H
+ * Version    : 2.0
+ * Target     : ATMega1280
+ * Compiler   : AVR-GCC 9.3.0
+ * Downloader : AVRDUDE 6.3
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Interface for measuring the rate the disk is written at, by writing the
+ * sectors of a scratch file with the disk's multiple sector write. Run
+ * periodically, it shows a disk slowing down, e.g. a worn card, before a
+ * data logger using it starts to drop data.
+ */
+
+#ifndef FAT_PROBE_H
+#define FAT_PROBE_H
+
+/*
+ ******************************************************************************
+ *                                    MACROS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             PROBE BUSY LIMIT
+ *
+ * Description : The longest time, in milliseconds, the probe waits for the
+ *               disk to write a sector before the write is failed.
+ *
+ * Notes       : This should be at least the disk's own write time limit,
+ *               e.g. SD_WRITE_BUSY_MS of an SD card.
+ * ----------------------------------------------------------------------------
+ */
+#ifndef PROBE_BUSY_MS
+#define PROBE_BUSY_MS           500
+#endif//PROBE_BUSY_MS
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            PROBE ERROR FLAGS
+ *
+ * Description : Flags returned by fat_ProbeRun and fat_ProbeService.
+ *
+ * Notes       : The probe functions can also return the FAT Error Flags from
+ *               FAT.H.
+ * ----------------------------------------------------------------------------
+ */
+#define PROBE_TOO_SMALL         0x03
+#define PROBE_NOT_ALIGNED       0x05
+
+/*
+ ******************************************************************************
+ *                                   STRUCTS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           WRITE PROBE STRUCT
+ *
+ * Description : Holds the settings of a write probe, and the results of the
+ *               last probe and of every probe since it was initialized.
+ *
+ * Notes       : 1) Any instance of this struct must be initialized by passing
+ *                  it to fat_ProbeInit.
+ *               2) Rates are in KB/s, where a KB is 1000 bytes, i.e. bytes
+ *                  written per millisecond.
+ *               3) The sector times include the time the disk was busy
+ *                  writing the sector. The longest of them is the longest a
+ *                  data logger would have to buffer its data for.
+ * ----------------------------------------------------------------------------
+ */
+typedef struct
+{
+  uint16_t secCnt;                     // sectors written by each probe
+  uint32_t periodMs;                   // time between probes of the service
+  uint32_t startMs;                    // time the last probe started
+  uint16_t runCnt;                     // number of probes completed
+  uint16_t failCnt;                    // number of probes that failed
+  uint32_t lastMs;                     // time taken by the last probe
+  uint16_t lastRate;                   // rate of the last probe
+  uint16_t minRate;                    // lowest rate of any probe
+  uint16_t maxRate;                    // highest rate of any probe
+  uint16_t lastSecMsMax;               // longest sector time of last probe
+  uint16_t secMsMax;                   // longest sector time of any probe
+}
+FatProbe;
+
+/*
+ ******************************************************************************
+ *                           FUNCTION PROTOTYPES
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                       INITIALIZE WRITE PROBE
+ *
+ * Description : Sets the settings of a FatProbe instance and clears its
+ *               results.
+ *
+ * Arguments   : probe      - Pointer to the FatProbe instance to be set.
+ *               secCnt     - Number of sectors written by each probe.
+ *               periodMs   - Time between the probes run by
+ *                            fat_ProbeService.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void fat_ProbeInit(FatProbe *probe, uint16_t secCnt, uint32_t periodMs);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                              RUN WRITE PROBE
+ *
+ * Description : Writes the first secCnt sectors of a scratch file and times
+ *               the writes. The results are added to the FatProbe instance.
+ *
+ * Arguments   : probe   - Pointer to a FatProbe instance.
+ *               file    - Pointer to a FatFile instance set by fat_OpenFile.
+ *               bpb     - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, FAILED_WRITE_SECTOR, PROBE_TOO_SMALL if the file
+ *               has fewer than secCnt sectors, PROBE_NOT_ALIGNED if the
+ *               sectors are not SECTOR_LEN bytes, or a FAT Error Flag from
+ *               finding the file's sectors. On failure only the failCnt and
+ *               startMs members of the FatProbe instance are changed.
+ *
+ * Notes       : 1) Each run of consecutive sectors of the file is written
+ *                  with one multiple sector write of the disk, so the rate is
+ *                  that of a contiguous file, e.g. a FatStream or FatRing.
+ *               2) The file's position is left after the last sector written.
+ *
+ * Warnings    : The contents of the file are overwritten. Only pass a file
+ *               created for the probe.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_ProbeRun(FatProbe *probe, FatFile *file, const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                          SERVICE WRITE PROBE
+ *
+ * Description : Runs a probe, as fat_ProbeRun, if periodMs has passed since
+ *               the last probe started, or no probe has been run.
+ *
+ * Arguments   : probe   - Pointer to a FatProbe instance.
+ *               file    - Pointer to a FatFile instance set by fat_OpenFile.
+ *               bpb     - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS if no probe was due, otherwise as fat_ProbeRun. The
+ *               runCnt member of the FatProbe instance is incremented by each
+ *               successful probe. A probe that fails is run again when the
+ *               next one is due.
+ *
+ * Notes       : This is meant to be called from the main loop while the disk
+ *               is otherwise idle. A probe takes the disk for as long as it
+ *               takes to write secCnt sectors.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_ProbeService(FatProbe *probe, FatFile *file, const BPB *bpb);
+
+#endif //FAT_PROBE_H
@@ -0,0 +1,224 @@
+/*
+ * File       : FAT_RING.H
+ * Version    : 2.0
+ * Target     : ATMega1280
+ * Compiler   : AVR-GCC 9.3.0
+ * Downloader : AVRDUDE 6.3
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Interface for a ring log kept in a file. The file is created at its full
+ * size, in consecutive clusters, and its sectors are then written in order,
+ * wrapping back to the first sector, so it always holds the latest log data.
+ * Every sector holds a sequence number, so the log's head is found by a
+ * binary search when the ring is opened, and neither the FAT nor the file's
+ * directory entry is ever written.
+ */
+
+#ifndef FAT_RING_H
+#define FAT_RING_H
+
+/*
+ ******************************************************************************
+ *                                    MACROS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           RING SECTOR LAYOUT
+ *
+ * Description : Each sector of the ring is a header of RING_HDR_LEN bytes
+ *               followed by up to RING_DATA_LEN bytes of log data.
+ *
+ * Notes       : The header is the sector's sequence number (4 bytes, little
+ *               endian), the number of log data bytes it holds (2 bytes), the
+ *               byte RING_MAGIC, and a check byte, which is the inverse of
+ *               the exclusive-or of the other 7 bytes.
+ * ----------------------------------------------------------------------------
+ */
+#define RING_HDR_LEN            8
+#define RING_DATA_LEN           (SECTOR_LEN - RING_HDR_LEN)
+#define RING_MAGIC              0xA5
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             RING ERROR FLAGS
+ *
+ * Description : Flags returned by fat_RingOpen.
+ *
+ * Notes       : The ring functions can also return the FAT Error Flags from
+ *               FAT.H.
+ * ----------------------------------------------------------------------------
+ */
+#define RING_TOO_SMALL          0x03
+#define RING_NOT_CONTIG         0x05
+
+/*
+ ******************************************************************************
+ *                                   STRUCTS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                              FAT RING STRUCT
+ *
+ * Description : Holds the location of a ring on the disk, and the head
+ *               sector, which is the sector log data is being added to.
+ *
+ * Notes       : 1) Any instance of this struct must be initialized by passing
+ *                  it to fat_RingOpen.
+ *               2) The head sector is sector headSeq % secCnt of the ring. It
+ *                  is held in secArr until it is full, or fat_RingFlush is
+ *                  called.
+ *
+ * Warnings    : Members of an instance of this struct should never be set
+ *               manually, but only by passing it to the functions here.
+ * ----------------------------------------------------------------------------
+ */
+typedef struct
+{
+  uint32_t fstSecNum;                  // disk sector of the ring's 1st sector
+  uint32_t secCnt;                     // number of sectors in the ring
+  uint32_t headIndx;                   // sector of the ring being filled
+  uint32_t headSeq;                    // sequence number of the head sector
+  uint16_t fillLen;                    // log data bytes in the head sector
+  uint8_t  secArr[SECTOR_LEN];         // the head sector
+}
+FatRing;
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                     FAT RING ITERATOR STRUCT
+ *
+ * Description : Position of a reader in a ring, from the oldest sector to
+ *               the head sector.
+ *
+ * Notes       : Any instance of this struct must be initialized by passing it
+ *               to fat_RingIterInit.
+ * ----------------------------------------------------------------------------
+ */
+typedef struct
+{
+  uint32_t seq;                        // sequence number of the next sector
+  uint32_t endSeq;                     // sequence number after the last one
+}
+FatRingIter;
+
+/*
+ ******************************************************************************
+ *                           FUNCTION PROTOTYPES
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                OPEN RING LOG
+ *
+ * Description : Sets a FatRing instance to the ring kept in a file, and finds
+ *               its head sector by a binary search of the sectors' sequence
+ *               numbers. If the last sector written is not full, log data
+ *               added to the ring continues in it.
+ *
+ * Arguments   : ring   - Pointer to the FatRing instance to be set.
+ *               file   - Pointer to a FatFile instance set by fat_OpenFile.
+ *               bpb    - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, FAILED_READ_SECTOR, RING_TOO_SMALL if the file has
+ *               fewer than 2 whole sectors or the sectors are not SECTOR_LEN
+ *               bytes, RING_NOT_CONTIG if the file's clusters are not
+ *               consecutive on the disk, or CORRUPT_FAT_ENTRY.
+ *
+ * Notes       : 1) Only the whole sectors of the file are used.
+ *               2) The file should be filled with zeros when it is created. A
+ *                  new ring then starts at its first sector.
+ *               3) The ring's sectors are written around the sector cache of
+ *                  FAT_CACHE.H. Any sector of the file waiting in the cache is
+ *                  written, and then removed from the cache, by this function.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_RingOpen(FatRing *ring, FatFile *file, const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           APPEND TO RING LOG
+ *
+ * Description : Adds bytes to the head sector of the ring. Each time the head
+ *               sector is full it is written to the disk, and the next sector
+ *               of the ring, overwriting the oldest, becomes the head.
+ *
+ * Arguments   : ring      - Pointer to a FatRing instance.
+ *               dataArr   - Pointer to the array holding the bytes.
+ *               len       - Number of bytes to add.
+ *
+ * Returns     : SUCCESS or FAILED_WRITE_SECTOR. On failure the full head
+ *               sector is kept, and written by the next call to this function
+ *               or fat_RingFlush, but the bytes of dataArr after it are not
+ *               added.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_RingAppend(FatRing *ring, const uint8_t dataArr[], uint16_t len);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                               FLUSH RING LOG
+ *
+ * Description : Writes the head sector to the disk, if it holds any bytes,
+ *               without moving to the next sector.
+ *
+ * Arguments   : ring   - Pointer to a FatRing instance.
+ *
+ * Returns     : SUCCESS or FAILED_WRITE_SECTOR.
+ *
+ * Notes       : The head sector is written again each time it is flushed
+ *               until it is full, so flushing more often than necessary
+ *               wears the disk.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_RingFlush(FatRing *ring);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                     INITIALIZE RING ITERATOR
+ *
+ * Description : Sets a FatRingIter instance to the oldest sector of a ring.
+ *
+ * Arguments   : it     - Pointer to the FatRingIter instance to be set.
+ *               ring   - Pointer to a FatRing instance set by fat_RingOpen.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void fat_RingIterInit(FatRingIter *it, const FatRing *ring);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             NEXT RING SECTOR
+ *
+ * Description : Loads the next sector of a ring, in the order the log data
+ *               was added, into an array.
+ *
+ * Arguments   : it       - Pointer to a FatRingIter instance.
+ *               ring     - Pointer to the FatRing instance it was set with.
+ *               secArr   - Pointer to an array of length SECTOR_LEN that will
+ *                          be loaded with the sector. The log data starts at
+ *                          secArr[RING_HDR_LEN].
+ *               len      - Pointer to a variable set to the number of bytes
+ *                          of log data in the sector.
+ *
+ * Returns     : SUCCESS, FAILED_READ_SECTOR, or END_OF_FILE if there are no
+ *               more sectors.
+ *
+ * Notes       : 1) Sectors whose header is not valid, or whose sequence
+ *                  number is not the one expected, are skipped.
+ *               2) Sectors are read from the disk, so bytes added to the head
+ *                  sector since it was last written are not returned. Call
+ *                  fat_RingFlush first to include them.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_RingIterNext(FatRingIter *it, const FatRing *ring,
+                         uint8_t secArr[], uint16_t *len);
+
+#endif //FAT_RING_H
@@ -0,0 +1,283 @@
+/*
+ * File       : FAT_RPC.H
+ * Version    : 2.0
+ * Target     : ATMega1280
+ * Compiler   : AVR-GCC 9.3.0
+ * Downloader : AVRDUDE 6.3
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Interface for serving the FAT volume to a host program over a serial link,
+ * e.g. the USART, with a framed binary protocol instead of the text of the
+ * test shell. A host can list directories, get the properties of a file,
+ * read and write ranges of it and calculate its checksum. Each frame has a
+ * sequence number and a CRC, so a host can keep several requests in flight
+ * and match the responses to them. While it waits for the next request, the
+ * server reads the sectors after the last range read into the cache.
+ */
+
+#ifndef FAT_RPC_H
+#define FAT_RPC_H
+
+/*
+ ******************************************************************************
+ *                                    MACROS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                 RPC SETTINGS
+ *
+ * Description : RPC_PAYLOAD_MAX is the largest payload of a frame, in either
+ *               direction. RPC_WINDOW_BYTES is the most bytes of requests a
+ *               host can send before it has their responses. RPC_PREFETCH_SECS
+ *               is the number of sectors read into the cache after a range.
+ *
+ * Notes       : 1) The host is told RPC_PAYLOAD_MAX and RPC_WINDOW_BYTES by
+ *                  the RPC_OP_HELLO response, so only the server needs to be
+ *                  built with other values.
+ *               2) The requests of the window wait in the receive buffer of
+ *                  the link while the server is busy, so RPC_WINDOW_BYTES must
+ *                  not be larger than that buffer, e.g. USART_RX_BUF_LEN.
+ * ----------------------------------------------------------------------------
+ */
+#ifndef RPC_PAYLOAD_MAX
+#define RPC_PAYLOAD_MAX         256
+#endif//RPC_PAYLOAD_MAX
+
+#ifndef RPC_WINDOW_BYTES
+#define RPC_WINDOW_BYTES        192
+#endif//RPC_WINDOW_BYTES
+
+#ifndef RPC_PREFETCH_SECS
+#define RPC_PREFETCH_SECS       2
+#endif//RPC_PREFETCH_SECS
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             RPC FRAME LAYOUT
+ *
+ * Description : A frame is the byte RPC_SOF, the sequence number (1 byte),
+ *               the op (1 byte), the payload length (2 bytes), the payload,
+ *               and the CRC (2 bytes). Multi-byte values are little endian.
+ *
+ * Notes       : 1) The CRC is the CRC-16/CCITT-FALSE (polynomial 0x1021,
+ *                  initial value 0xFFFF) of every byte after RPC_SOF and
+ *                  before the CRC.
+ *               2) A response has the sequence number of its request, the op
+ *                  of the request with RPC_RESP set, and a payload that starts
+ *                  with a status byte, which is SUCCESS, a FAT Error Flag or
+ *                  an RPC Error Flag.
+ *               3) A frame with a bad CRC or length is dropped without a
+ *                  response, and the server looks for the next RPC_SOF. The
+ *                  host sends the request again when its response does not
+ *                  arrive. Every op can be repeated without changing its
+ *                  result.
+ * ----------------------------------------------------------------------------
+ */
+#define RPC_SOF                 0x7E
+#define RPC_RESP                0x80
+#define RPC_HDR_LEN             5
+#define RPC_CRC_LEN             2
+#define RPC_FRAME_MAX           (RPC_HDR_LEN + RPC_PAYLOAD_MAX + RPC_CRC_LEN)
+#define RPC_VERSION             1
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                      RPC OPS
+ *
+ * Description : The ops of a request, with the payloads of the request and
+ *               of its response after the status byte.
+ *
+ *   RPC_OP_HELLO  : request  - none.
+ *                   response - RPC_VERSION (1), RPC_PAYLOAD_MAX (2),
+ *                              RPC_WINDOW_BYTES (2).
+ *   RPC_OP_LIST   : request  - cursor (DIR_CURSOR_LEN), most entries (1),
+ *                              path of the directory.
+ *                   response - cursor (DIR_CURSOR_LEN), entry count (1),
+ *                              then for each entry its attr (1), fileSize
+ *                              (4), writeDateTime (4), reference
+ *                              (ENTRY_REF_LEN), long name length (1) and
+ *                              long name.
+ *   RPC_OP_STAT   : request  - path of the file or directory.
+ *                   response - attr (1), fileSize (4), createDateTime (4),
+ *                              writeDateTime (4), lastAccDate (2),
+ *                              reference (ENTRY_REF_LEN).
+ *   RPC_OP_READ   : request  - reference (ENTRY_REF_LEN), position (4),
+ *                              length (2).
+ *                   response - the bytes read.
+ *   RPC_OP_WRITE  : request  - reference (ENTRY_REF_LEN), position (4),
+ *                              the bytes to write.
+ *                   response - number of bytes written (2).
+ *   RPC_OP_SUM    : request  - reference (ENTRY_REF_LEN), algo (1), as for
+ *                              fat_Checksum.
+ *                   response - checksum (4).
+ *   RPC_OP_SYNC   : request  - none. Writes the cache to the disk.
+ *                   response - none.
+ *   RPC_OP_EXIT   : request  - none. Ends the session.
+ *                   response - none.
+ *
+ * Notes       : 1) A cursor of all zeros starts a listing at the first entry
+ *                  of the directory at the path. Any other cursor continues
+ *                  from where the listing it was returned by stopped, and the
+ *                  path is not used. The status of a listing is SUCCESS until
+ *                  the page that reaches the end of the directory, which is
+ *                  END_OF_DIRECTORY. Volume ID entries are not listed.
+ *               2) Paths are from the root directory, with the names
+ *                  separated by '/', and are not null terminated.
+ *               3) A reference is a packed FatEntryRef, from RPC_OP_STAT or
+ *                  RPC_OP_LIST, so reads and writes do not search the
+ *                  directory. A reference that is no longer the file's
+ *                  returns FILE_NOT_FOUND.
+ *               4) A read returns fewer bytes than the length, with the
+ *                  status END_OF_FILE, at the end of the file, and at most
+ *                  RPC_PAYLOAD_MAX - 1 bytes. A write, as fat_WriteFile,
+ *                  never extends the file.
+ * ----------------------------------------------------------------------------
+ */
+#define RPC_OP_HELLO            0x00
+#define RPC_OP_LIST             0x01
+#define RPC_OP_STAT             0x02
+#define RPC_OP_READ             0x03
+#define RPC_OP_WRITE            0x04
+#define RPC_OP_SUM              0x05
+#define RPC_OP_SYNC             0x06
+#define RPC_OP_EXIT             0x0F
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                              RPC ERROR FLAGS
+ *
+ * Description : RPC_BAD_OP and RPC_BAD_LEN are the status of a response to a
+ *               request with an unknown op, or a payload of the wrong length.
+ *               RPC_EXIT is returned by fat_RpcRxByte once the response to
+ *               RPC_OP_EXIT is sent.
+ *
+ * Notes       : The status can also be a FAT Error Flag from FAT.H.
+ * ----------------------------------------------------------------------------
+ */
+#define RPC_BAD_OP              0x03
+#define RPC_BAD_LEN             0x05
+#define RPC_EXIT                0x06
+
+/*
+ ******************************************************************************
+ *                                   STRUCTS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                  TRANSMIT BYTE FUNCTION TYPE
+ *
+ * Description : Type of the function the server sends each byte of its
+ *               responses with, e.g. usart_Transmit.
+ *
+ * Arguments   : byte   - The byte to send.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+typedef void (*FatRpcTxFn)(uint8_t byte);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            RPC SERVER STRUCT
+ *
+ * Description : Holds the frame being received, and the file of the last
+ *               reference used, which is kept open for the next request.
+ *
+ * Notes       : 1) Any instance of this struct must be initialized by passing
+ *                  it to fat_RpcInit.
+ *               2) A request with the same reference as the one before
+ *                  continues along the file's cluster chain, so a file read
+ *                  in order is not followed from its first cluster for each
+ *                  range.
+ *
+ * Warnings    : Members of an instance of this struct should never be set
+ *               manually, but only by passing it to the functions here.
+ * ----------------------------------------------------------------------------
+ */
+typedef struct
+{
+  FatRpcTxFn txFn;                     // sends the bytes of a response
+  uint8_t    inFrame;                  // 1 once RPC_SOF is received
+  uint16_t   rxLen;                    // bytes of frameArr received
+  uint16_t   frameCnt;                 // frames received with a good CRC
+  uint16_t   badCnt;                   // frames dropped
+  FatFile    file;                     // file of the last reference
+  uint8_t    refArr[ENTRY_REF_LEN];    // packed reference of file
+  uint8_t    isOpen;                   // 1 if file is set
+  uint8_t    isPrefetch;               // 1 if sectors at file's pos are due
+  uint8_t    frameArr[RPC_FRAME_MAX - 1];  // the frame, after RPC_SOF
+}
+FatRpc;
+
+/*
+ ******************************************************************************
+ *                           FUNCTION PROTOTYPES
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                        INITIALIZE RPC SERVER
+ *
+ * Description : Sets a FatRpc instance to wait for the first byte of a frame.
+ *
+ * Arguments   : rpc     - Pointer to the FatRpc instance to be set.
+ *               txFn    - Function the bytes of the responses are sent with.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void fat_RpcInit(FatRpc *rpc, FatRpcTxFn txFn);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                          RECEIVE AN RPC BYTE
+ *
+ * Description : Adds a byte received from the host to the frame being
+ *               received. When the frame is complete and its CRC is good,
+ *               the request is carried out and its response sent.
+ *
+ * Arguments   : rpc     - Pointer to a FatRpc instance.
+ *               byte    - The byte received.
+ *               bpb     - Pointer to the BPB struct instance.
+ *
+ * Returns     : STEP_BUSY while a frame is being received, or after a frame
+ *               is dropped. Otherwise the status of the response sent, or
+ *               RPC_EXIT if it was the response to RPC_OP_EXIT.
+ *
+ * Notes       : Bytes before RPC_SOF are ignored, e.g. the echo of the
+ *               command that started the server.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_RpcRxByte(FatRpc *rpc, uint8_t byte, const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                RPC IDLE STEP
+ *
+ * Description : Reads up to RPC_PREFETCH_SECS sectors of the file, from the
+ *               end of the last range read, into the cache, so the next range
+ *               of a file read in order is already in the cache when its
+ *               request arrives.
+ *
+ * Arguments   : rpc     - Pointer to a FatRpc instance.
+ *               bpb     - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, or a FAT Error Flag from reading the sectors. Any
+ *               error is found again by the next read of the file.
+ *
+ * Notes       : Call this while no bytes are waiting to be received. It
+ *               reads at most one run of sectors, with a single multiple
+ *               sector read of the disk, and returns at once when there is
+ *               nothing to read.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_RpcIdle(FatRpc *rpc, const BPB *bpb);
+
+#endif //FAT_RPC_H
@@ -0,0 +1,173 @@
+/*
+ * File       : FAT_SEARCH.H
+ * Version    : 2.0
+ * Target     : ATMega1280
+ * Compiler   : AVR-GCC 9.3.0
+ * Downloader : AVRDUDE 6.3
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Interface for searching a file of fixed-width records, sorted by key, for
+ * the record matching a given key. The search is a binary search done on the
+ * disk using file seeks, so only the sectors holding the probed records are
+ * read. The top levels of the search are cached in RAM and numeric keys are
+ * interpolated.
+ */
+
+#ifndef FAT_SEARCH_H
+#define FAT_SEARCH_H
+
+/*
+ ******************************************************************************
+ *                                    MACROS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           SEARCH CACHE SIZE
+ *
+ * Description : Number of levels of the implicit binary search tree whose keys
+ *               are cached in RAM when a search is initialized. A lookup will
+ *               not read any record from the disk until it is below these
+ *               levels.
+ *
+ * Notes       : The cache holds (2^FS_CACHE_LVLS - 1) keys, each of length
+ *               FS_KEY_LEN_MAX, plus a 32-bit cluster index for each key.
+ * ----------------------------------------------------------------------------
+ */
+#ifndef FS_CACHE_LVLS
+#define FS_CACHE_LVLS           4
+#endif//FS_CACHE_LVLS
+
+#define FS_CACHE_NODES          ((1 << FS_CACHE_LVLS) - 1)
+
+// max byte length of a record's key.
+#define FS_KEY_LEN_MAX          8
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                    KEY TYPES
+ *
+ * Description : Specifies how the keys of the records are compared.
+ *
+ * Notes       : 1) FS_KEY_BYTES keys are compared as byte strings (memcmp).
+ *               2) FS_KEY_UINT_LE and FS_KEY_UINT_BE keys are unsigned
+ *                  integers of 1 to 4 bytes, stored little-endian and
+ *                  big-endian respectively. Only these are interpolated.
+ * ----------------------------------------------------------------------------
+ */
+#define FS_KEY_BYTES            0
+#define FS_KEY_UINT_LE          1
+#define FS_KEY_UINT_BE          2
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           SEARCH ERROR FLAGS
+ *
+ * Description : Flags returned by the search functions.
+ *
+ * Notes       : The search functions can also return the FAT Error Flags from
+ *               FAT.H.
+ * ----------------------------------------------------------------------------
+ */
+#define KEY_NOT_FOUND           0x03
+#define INVALID_RECORD_FORMAT   0x05
+
+/*
+ ******************************************************************************
+ *                                   STRUCTS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                          FAT SEARCH STRUCT
+ *
+ * Description : Holds the record format of a sorted file and the cached keys
+ *               of the top levels of its implicit binary search tree.
+ *
+ * Notes       : 1) Any instance of this struct must be initialized by passing
+ *                  it to fat_InitSearch.
+ *               2) Node n of the tree (n = 1 is the root) is cached at index
+ *                  n - 1. Its children are nodes 2n and 2n + 1.
+ *
+ * Warnings    : Members of an instance of this struct should never be set
+ *               manually, but only by passing it to the search functions.
+ * ----------------------------------------------------------------------------
+ */
+typedef struct
+{
+  FatFile  file;                       // the sorted file
+  uint32_t numOfRecs;                  // number of records in the file
+  uint16_t recLen;                     // byte length of each record
+  uint8_t  keyOffset;                  // byte offset of key in each record
+  uint8_t  keyLen;                     // byte length of the key
+  uint8_t  keyType;                    // one of the KEY TYPES
+  uint8_t  cacheKeys[FS_CACHE_NODES][FS_KEY_LEN_MAX];
+  uint32_t cacheClus[FS_CACHE_NODES];  // clus index of each cached record end
+}
+FatSearch;
+
+/*
+ ******************************************************************************
+ *                           FUNCTION PROTOTYPES
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            INITIALIZE SEARCH
+ *
+ * Description : Sets the record format of a sorted file in a FatSearch
+ *               instance and loads the keys of the top levels of the search
+ *               tree from the file into its cache.
+ *
+ * Arguments   : srch        - Pointer to the FatSearch instance to be set.
+ *               file        - Pointer to a FatFile instance, set by
+ *                             fat_OpenFile, of the sorted file.
+ *               recLen      - Byte length of each record.
+ *               keyOffset   - Byte offset of the key in each record.
+ *               keyLen      - Byte length of the key.
+ *               keyType     - One of the KEY TYPES.
+ *               bpb         - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, INVALID_RECORD_FORMAT, or a FAT Error Flag if the
+ *               cached keys could not be read.
+ *
+ * Notes       : 1) The file must hold a whole number of records, sorted in
+ *                  ascending order of their keys.
+ *               2) This reads (2^FS_CACHE_LVLS - 1) records, at most.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_InitSearch(FatSearch *srch, const FatFile *file, uint16_t recLen,
+                       uint8_t keyOffset, uint8_t keyLen, uint8_t keyType,
+                       const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                        SEARCH FOR RECORD KEY
+ *
+ * Description : Searches the sorted file for the record whose key matches
+ *               keyArr, and loads the record into recArr if it is found.
+ *
+ * Arguments   : srch     - Pointer to a FatSearch instance set by
+ *                          fat_InitSearch.
+ *               keyArr   - Pointer to an array holding the key to search for.
+ *                          Must be of length keyLen and in the key's format.
+ *               recArr   - Pointer to the array that will be loaded with the
+ *                          matching record. Must be of length recLen.
+ *               bpb      - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS if found, KEY_NOT_FOUND, or a FAT Error Flag if a
+ *               record could not be read.
+ *
+ * Notes       : A lookup costs about log2(numOfRecs) - FS_CACHE_LVLS record
+ *               reads, and fewer with interpolation of numeric keys.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_SearchKey(FatSearch *srch, const uint8_t keyArr[],
+                      uint8_t recArr[], const BPB *bpb);
+
+#endif //FAT_SEARCH_H
@@ -0,0 +1,201 @@
+/*
+ * File       : FAT_STREAM.H
+ * Version    : 2.0
+ * Target     : ATMega1280
+ * Compiler   : AVR-GCC 9.3.0
+ * Downloader : AVRDUDE 6.3
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Interface for a double-buffered write stream to a file, for data loggers.
+ * Bytes are written to one sector buffer while the other is sent to the disk,
+ * and the disk's multiple sector write is kept open across buffers, so the
+ * logger never waits on the disk while a buffer is free. While an I/O queue
+ * of FAT_IOQ.H is attached, each buffer is instead sent as a request of the
+ * queue, ahead of the other modules' transfers.
+ */
+
+#ifndef FAT_STREAM_H
+#define FAT_STREAM_H
+
+/*
+ ******************************************************************************
+ *                                    MACROS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                 STREAM LIMIT
+ *
+ * Description : The largest number of sectors written by a single multiple
+ *               sector write of the disk. A new one is started after it, or
+ *               where the file's clusters are not consecutive on the disk.
+ * ----------------------------------------------------------------------------
+ */
+#ifndef STREAM_RUN_SECS_MAX
+#define STREAM_RUN_SECS_MAX     2048
+#endif//STREAM_RUN_SECS_MAX
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           STREAM ERROR FLAGS
+ *
+ * Description : Flags returned by the stream functions.
+ *
+ * Notes       : The stream functions can also return the FAT Error Flags from
+ *               FAT.H.
+ * ----------------------------------------------------------------------------
+ */
+#define STREAM_FULL             0x03
+#define STREAM_NOT_ALIGNED      0x05
+#define STREAM_TOO_LONG         0x06
+
+/*
+ ******************************************************************************
+ *                                   STRUCTS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                       FAT FILE STREAM STRUCT
+ *
+ * Description : Holds the two sector buffers of a stream and the state of
+ *               the disk's multiple sector write.
+ *
+ * Notes       : 1) Any instance of this struct must be initialized by passing
+ *                  it to fat_StreamOpen.
+ *               2) Bytes are written to bufArr[fillIndx]. When it is full and
+ *                  the other buffer has been sent, the two are swapped.
+ *               3) The file's currPos is the position of the next sector to
+ *                  be sent to the disk.
+ *
+ * Warnings    : 1) Members of an instance of this struct should never be set
+ *                  manually, but only by passing it to the functions here.
+ *               2) From fat_StreamOpen until fat_StreamClose returns, the disk
+ *                  can be in a multiple sector write. No other FAT function
+ *                  may use the disk in that time, e.g. fat_CacheAutoFlush must
+ *                  not be called from the main loop, and the file must only be
+ *                  used through the stream. While an I/O queue is attached
+ *                  the disk is not held between calls, so only the last
+ *                  applies.
+ * ----------------------------------------------------------------------------
+ */
+typedef struct
+{
+  FatFile *file;                       // file being written
+  uint32_t runSecNum;                  // disk sector of the next to send
+  uint32_t runSecsLeft;                // sectors left in the disk write
+  uint16_t fillLen;                    // bytes in bufArr[fillIndx]
+  uint8_t  fillIndx;                   // buffer being written to
+  uint8_t  sendFull;                   // 1 if the other buffer waits to send
+  uint8_t  runOpen;                    // 1 if a disk write is started
+  IoReq    req;                        // buffer sent to an I/O queue
+  uint8_t  bufArr[2][SECTOR_LEN];      // the ping-pong buffers
+}
+FatStream;
+
+/*
+ ******************************************************************************
+ *                           FUNCTION PROTOTYPES
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             OPEN FILE STREAM
+ *
+ * Description : Sets a FatStream instance to write a file from the file's
+ *               current position.
+ *
+ * Arguments   : strm   - Pointer to the FatStream instance to be set.
+ *               file   - Pointer to a FatFile instance set by fat_OpenFile.
+ *               bpb    - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, or STREAM_NOT_ALIGNED if the file's position is not
+ *               at the start of a sector, or the sectors are not SECTOR_LEN
+ *               bytes.
+ *
+ * Notes       : As with fat_WriteFile, the file is never extended. The file
+ *               should be created at its full size before it is streamed.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_StreamOpen(FatStream *strm, FatFile *file, const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            WRITE FILE STREAM
+ *
+ * Description : Copies bytes into the stream's buffers. This never uses the
+ *               disk, so it can be called with a deadline, e.g. by a sampling
+ *               loop. The buffers are sent to the disk by fat_StreamService.
+ *
+ * Arguments   : strm      - Pointer to a FatStream instance.
+ *               dataArr   - Pointer to the array holding the bytes.
+ *               len       - Number of bytes to write. Must not be more
+ *                           than SECTOR_LEN.
+ *
+ * Returns     : SUCCESS if all len bytes were copied. STREAM_FULL if there is
+ *               not room for them in the buffers, END_OF_FILE if they would go
+ *               past the end of the file, or STREAM_TOO_LONG, in which case
+ *               none are copied.
+ *
+ * Notes       : STREAM_FULL is the back-pressure of the stream. Both buffers
+ *               are full because the disk is slower than the data, so the
+ *               caller must either wait, calling fat_StreamService, or drop
+ *               the data.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_StreamWrite(FatStream *strm, const uint8_t dataArr[],
+                        uint16_t len);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                          SERVICE FILE STREAM
+ *
+ * Description : Sends a full buffer to the disk, without waiting while the
+ *               disk is busy writing the buffer sent before it. A multiple
+ *               sector write is started when needed and stopped at the end of
+ *               each run of consecutive sectors of the file.
+ *
+ * Arguments   : strm   - Pointer to a FatStream instance.
+ *               bpb    - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS if there is no full buffer to send. STEP_BUSY if the
+ *               disk is busy or a full buffer is still waiting, in which case
+ *               this should be called again. Otherwise FAILED_WRITE_SECTOR or
+ *               a FAT Error Flag from finding the file's sectors, in which
+ *               case the buffer is kept and sent again by the next call.
+ *
+ * Notes       : 1) This is meant to be called from the main loop, as often as
+ *                  possible while data is being written.
+ *               2) While an I/O queue is attached, the full buffer is sent as
+ *                  an IOQ_PRIO_RT request, and each call makes at most one
+ *                  transfer of the queue until it is written.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_StreamService(FatStream *strm, const BPB *bpb);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            CLOSE FILE STREAM
+ *
+ * Description : Sends every full buffer, stops the disk's multiple sector
+ *               write, then writes the bytes of a partly filled buffer to the
+ *               file with fat_WriteFile.
+ *
+ * Arguments   : strm   - Pointer to a FatStream instance.
+ *               bpb    - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS or a FAT Error Flag.
+ *
+ * Notes       : The bytes of a partly filled buffer are written to the sector
+ *               cache of FAT_CACHE.H. Call fat_Sync to write them to the
+ *               disk. The file's currPos is left after the last byte written.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_StreamClose(FatStream *strm, const BPB *bpb);
+
+#endif //FAT_STREAM_H
@@ -0,0 +1,80 @@
+/*
+ * File       : FAT_SUM.H
+ * Version    : 2.0
+ * Target     : ATMega1280
+ * Compiler   : AVR-GCC 9.3.0
+ * Downloader : AVRDUDE 6.3
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Interface for calculating the checksum of a file on the disk, so a file
+ * can be checked after it is transferred without reading it back out.
+ */
+
+#ifndef FAT_SUM_H
+#define FAT_SUM_H
+
+/*
+ ******************************************************************************
+ *                                    MACROS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                          CHECKSUM ALGORITHMS
+ *
+ * Description : Values of the algo argument of fat_Checksum.
+ *
+ * Notes       : 1) FAT_SUM_CRC32 is the CRC-32 of zip, gzip and PNG, e.g. the
+ *                  value from the 'crc32' or 'cksum -a crc32b' commands.
+ *               2) FAT_SUM_ADLER32 is the Adler-32 of zlib. It is faster to
+ *                  calculate, but less able to detect errors.
+ * ----------------------------------------------------------------------------
+ */
+#define FAT_SUM_CRC32           0
+#define FAT_SUM_ADLER32         1
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                         CHECKSUM ERROR FLAGS
+ *
+ * Description : Flags returned by fat_Checksum.
+ *
+ * Notes       : fat_Checksum can also return the FAT Error Flags from FAT.H.
+ * ----------------------------------------------------------------------------
+ */
+#define SUM_INVALID_ALGO        0x03
+
+/*
+ ******************************************************************************
+ *                           FUNCTION PROTOTYPES
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             CHECKSUM OF FILE
+ *
+ * Description : Calculates the checksum of every byte of a file.
+ *
+ * Arguments   : file    - Pointer to a FatFile instance set by fat_OpenFile.
+ *               algo    - Checksum algorithm. See CHECKSUM ALGORITHMS.
+ *               sum     - Pointer to the checksum, set here.
+ *               bpb     - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, SUM_INVALID_ALGO, or a FAT Error Flag.
+ *
+ * Notes       : 1) The file is read with fat_ReadFileSectors, so runs of
+ *                  consecutive clusters are read with a single multiple
+ *                  sector read from the disk.
+ *               2) On the AVR, CRC-32 uses a 16 entry table and takes two
+ *                  lookups per byte, to save RAM. Otherwise it uses a 256
+ *                  entry table and one lookup per byte.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_Checksum(const FatFile *file, uint8_t algo, uint32_t *sum,
+                     const BPB *bpb);
+
+#endif //FAT_SUM_H
@@ -43,6 +43,12 @@
 #define FAILED_READ_SECTOR      0x08        // This should be defined in fat.h
 #endif//FAILED_READ_SECTOR
 
+// values that can be returned by FATtoDisk_WriteSingleSector.
+#define WRITE_SECTOR_SUCCESS    0
+#ifndef FAILED_WRITE_SECTOR
+#define FAILED_WRITE_SECTOR     0x02        // This should be defined in fat.h
+#endif//FAILED_WRITE_SECTOR
+
 // Boot sector signature bytes. The last two bytes of BS should be these.
 #define BS_SIGN_1     0x55
 #define BS_SIGN_2     0xAA
@@ -57,6 +63,22 @@
 #define JMP_BOOT_3A     0x90
 #define JMP_BOOT_1B     0xE9
 
+//
+// A single sector read or write that fails, after the disk driver's own
+// retries, adds the sector to the bad sector list as a suspect. It becomes
+// bad once DISK_BAD_FAILS operations on it have failed in a row, or at once
+// if the disk reports a media error, and reads of it then fail at once.
+// Writes are always tried, and one that succeeds removes the sector from the
+// list. The list holds up to DISK_BAD_SECS_MAX sectors.
+//
+#ifndef DISK_BAD_FAILS
+#define DISK_BAD_FAILS          3
+#endif//DISK_BAD_FAILS
+
+#ifndef DISK_BAD_SECS_MAX
+#define DISK_BAD_SECS_MAX       16
+#endif//DISK_BAD_SECS_MAX
+
 /*
  ******************************************************************************
  *                            FUNCTION PROTOTYPES
@@ -97,8 +119,311 @@ uint32_t FATtoDisk_FindBootSector(void);
  * 
  * Returns     : READ_SECTOR_SUCCES if successful.
  *               READ_SECTOR_FAILED if failure.
+ *
+ * Notes       : A failed read is retried by the SD card driver. The sector is
+ *               then added to the bad sector list. See DISK_BAD_FAILS.
  * ----------------------------------------------------------------------------
  */
 uint8_t FATtoDisk_ReadSingleSector(uint32_t blkNum, uint8_t blkArr[]);
 
+/* 
+ * ----------------------------------------------------------------------------
+ *                                              READ MULTIPLE SECTORS FROM DISK
+ *                                       
+ * Description : Reads consecutive sectors/blocks from the disk, in order, and
+ *               passes each one to secFn as soon as it has been loaded.
+ *
+ * Arguments   : blkNum      - Block number address of the first sector/block
+ *                             to read.
+ *               numOfBlks   - Number of sectors/blocks to read.
+ *               blkArr      - Pointer to the array each sector/block is
+ *                             loaded into before it is passed to secFn. Must
+ *                             be the length of a sector.
+ *               secFn       - Function each sector/block is passed to. If it
+ *                             returns a non-zero value, no more are read.
+ *               arg         - Pointer passed to secFn with each sector/block.
+ * 
+ * Returns     : READ_SECTOR_SUCCESS if successful.
+ *               FAILED_READ_SECTOR if failure.
+ *
+ * Notes       : 1) This should use the disk's multiple block read, if it
+ *                  has one, so a run of sectors is read faster than by
+ *                  calling FATtoDisk_ReadSingleSector for each.
+ *               2) A failure is not retried, since some sectors may already
+ *                  have been passed to secFn. The read fails at once if any of
+ *                  the sectors is bad. See DISK_BAD_FAILS.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t FATtoDisk_ReadMultipleSectors(uint32_t blkNum, uint32_t numOfBlks,
+                                     uint8_t blkArr[], FatSectorFn secFn,
+                                     void *arg);
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                  WRITE SINGLE SECTOR TO DISK
+ *                                       
+ * Description : Writes the contents of the array, blkArr, to the sector/block
+ *               at the specified address on the SD card.
+ *
+ * Arguments   : blkNum    - Block number address of the sector/block on the SD
+ *                           card that blkArr should be written to.
+ * 
+ *               blkArr    - Pointer to the array holding the data that will
+ *                           be written to the sector/block on the SD card at
+ *                           block specified by blkNum.
+ * 
+ * Returns     : WRITE_SECTOR_SUCCESS if successful.
+ *               FAILED_WRITE_SECTOR if failure.
+ *
+ * Notes       : A failed write is retried by the SD card driver. The sector
+ *               is then added to the bad sector list, and a write that
+ *               succeeds removes it. See DISK_BAD_FAILS.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t FATtoDisk_WriteSingleSector(uint32_t blkNum, const uint8_t blkArr[]);
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                               WRITE MULTIPLE SECTORS TO DISK
+ *                                       
+ * Description : Writes consecutive sectors/blocks to the disk, in order. The
+ *               data of each one is taken from secSrcFn just before it is
+ *               written.
+ *
+ * Arguments   : blkNum      - Block number address of the first sector/block
+ *                             to write.
+ *               numOfBlks   - Number of sectors/blocks to write.
+ *               secSrcFn    - Function that returns the data of each
+ *                             sector/block.
+ *               arg         - Pointer passed to secSrcFn with each
+ *                             sector/block.
+ * 
+ * Returns     : WRITE_SECTOR_SUCCESS if successful.
+ *               FAILED_WRITE_SECTOR if failure.
+ *
+ * Notes       : 1) This should use the disk's multiple block write, if it
+ *                  has one, so a run of sectors is written faster than by
+ *                  calling FATtoDisk_WriteSingleSector for each.
+ *               2) A failure is not retried, since some sectors may already
+ *                  have been written. A write that succeeds removes its
+ *                  sectors from the bad sector list.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t FATtoDisk_WriteMultipleSectors(uint32_t blkNum, uint32_t numOfBlks,
+                                      FatSectorSrcFn secSrcFn, void *arg);
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                        GET MILLISECOND CLOCK
+ *                                       
+ * Description : Returns a clock that counts milliseconds. Used by the sector
+ *               cache in FAT_CACHE.C(H) to flush written sectors by age.
+ *
+ * Arguments   : void
+ * 
+ * Returns     : Milliseconds since any fixed point in time. The value may
+ *               wrap, as only differences of it are used.
+ * ----------------------------------------------------------------------------
+ */
+uint32_t FATtoDisk_GetTimeMs(void);
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                      START DISK WRITE STREAM
+ *                                       
+ * Description : Starts a write stream of consecutive sectors/blocks, starting
+ *               at blkNum. The sectors are then written, one at a time, by
+ *               FATtoDisk_StreamSector, and the stream is ended by
+ *               FATtoDisk_StopStream.
+ *
+ * Arguments   : blkNum      - Block number address of the first sector/block
+ *                             of the stream.
+ * 
+ * Returns     : WRITE_SECTOR_SUCCESS if successful.
+ *               FAILED_WRITE_SECTOR if failure.
+ *
+ * Warnings    : No other FATtoDisk function may be called while a stream is
+ *               started, except FATtoDisk_IsBusy and FATtoDisk_GetTimeMs.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t FATtoDisk_StartStream(uint32_t blkNum);
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                  WRITE SECTOR TO DISK STREAM
+ *                                       
+ * Description : Sends the next sector/block of a stream started by
+ *               FATtoDisk_StartStream. This should return once the disk has
+ *               the data, without waiting while it is written.
+ *
+ * Arguments   : blkArr      - Pointer to the array holding the
+ *                             sector/block. Must be of length SECTOR_LEN.
+ * 
+ * Returns     : WRITE_SECTOR_SUCCESS if successful.
+ *               FAILED_WRITE_SECTOR if failure.
+ *
+ * Notes       : If the disk is still busy writing the previous sector/block,
+ *               this will wait for it first.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t FATtoDisk_StreamSector(const uint8_t blkArr[]);
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                                 IS DISK BUSY
+ *                                       
+ * Description : Checks, without waiting, if the disk is busy writing a
+ *               sector/block sent by FATtoDisk_StreamSector.
+ *
+ * Arguments   : void
+ * 
+ * Returns     : 1 if the disk is busy, 0 if it is not.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t FATtoDisk_IsBusy(void);
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                       STOP DISK WRITE STREAM
+ *                                       
+ * Description : Ends a stream started by FATtoDisk_StartStream, once the
+ *               last sector/block sent has been written.
+ *
+ * Arguments   : void
+ * 
+ * Returns     : WRITE_SECTOR_SUCCESS if successful.
+ *               FAILED_WRITE_SECTOR if failure.
+ *
+ * Notes       : The sectors of a stream that is stopped successfully are
+ *               removed from the bad sector list.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t FATtoDisk_StopStream(void);
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                       START DISK READ STREAM
+ *                                       
+ * Description : Starts a read stream of numOfBlks consecutive sectors/blocks,
+ *               starting at blkNum. The sectors are then read, one at a time,
+ *               by FATtoDisk_ReadStreamSector, and the stream is ended by
+ *               FATtoDisk_StopReadStream.
+ *
+ * Arguments   : blkNum      - Block number address of the first sector/block
+ *                             of the stream.
+ *               numOfBlks   - Most sectors/blocks that will be read.
+ * 
+ * Returns     : READ_SECTOR_SUCCESS if successful.
+ *               FAILED_READ_SECTOR if failure.
+ *
+ * Warnings    : No other FATtoDisk function may be called while a stream is
+ *               started, except FATtoDisk_IsReadReady and FATtoDisk_GetTimeMs.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t FATtoDisk_StartReadStream(uint32_t blkNum, uint32_t numOfBlks);
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                           IS DISK READ READY
+ *                                       
+ * Description : Checks, without waiting, if the next sector/block of a stream
+ *               started by FATtoDisk_StartReadStream can be read.
+ *
+ * Arguments   : void
+ * 
+ * Returns     : 1 if FATtoDisk_ReadStreamSector will not wait for the disk,
+ *               0 if it would.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t FATtoDisk_IsReadReady(void);
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                 READ SECTOR FROM DISK STREAM
+ *                                       
+ * Description : Reads the next sector/block of a stream started by
+ *               FATtoDisk_StartReadStream.
+ *
+ * Arguments   : blkArr      - Pointer to the array the sector/block is
+ *                             loaded into. Must be of length SECTOR_LEN.
+ * 
+ * Returns     : READ_SECTOR_SUCCESS if successful.
+ *               FAILED_READ_SECTOR if failure.
+ *
+ * Notes       : If the disk is not ready, this will wait for it first.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t FATtoDisk_ReadStreamSector(uint8_t blkArr[]);
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                        STOP DISK READ STREAM
+ *                                       
+ * Description : Ends a stream started by FATtoDisk_StartReadStream, whether
+ *               or not all of its sectors/blocks have been read.
+ *
+ * Arguments   : void
+ * 
+ * Returns     : READ_SECTOR_SUCCESS if successful.
+ *               FAILED_READ_SECTOR if failure.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t FATtoDisk_StopReadStream(void);
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                         OPEN BAD SECTOR LIST
+ *                                       
+ * Description : Sets the sector the bad sector list is kept in, and loads the
+ *               list saved there. From then on, the list is saved each time
+ *               a bad sector is added to it or removed from it.
+ *
+ * Arguments   : blkNum   - Block number address of a sector in a reserved
+ *                          area of the disk, e.g. the reserved region of the
+ *                          FAT volume.
+ * 
+ * Returns     : READ_SECTOR_SUCCESS, FAILED_READ_SECTOR, or 
+ *               FAILED_WRITE_SECTOR if a new list could not be saved.
+ *
+ * Notes       : 1) Until this is called the list is only kept in RAM.
+ *               2) Sectors added to the list before this is called are kept,
+ *                  and added to the saved list.
+ *               3) Only bad sectors are saved. Suspect ones, that have not
+ *                  failed DISK_BAD_FAILS times, are kept in RAM.
+ *
+ * Warnings    : If the sector does not hold a saved list, it is overwritten
+ *               with a new one, so it must not be used for anything else.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t FATtoDisk_OpenBadList(uint32_t blkNum);
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                        CLEAR BAD SECTOR LIST
+ *                                       
+ * Description : Removes every sector from the bad sector list, e.g. after
+ *               the disk is replaced or reformatted.
+ *
+ * Arguments   : void
+ * 
+ * Returns     : WRITE_SECTOR_SUCCESS, or FAILED_WRITE_SECTOR if the list is
+ *               saved on the disk and could not be written.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t FATtoDisk_ClearBadList(void);
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                    GET BAD SECTOR LIST COUNT
+ *                                       
+ * Description : Returns the number of bad sectors in the bad sector list.
+ *
+ * Arguments   : void
+ * 
+ * Returns     : Number of bad sectors, up to DISK_BAD_SECS_MAX. Suspect
+ *               sectors are not counted.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t FATtoDisk_GetBadCount(void);
+
 #endif //FAT_TO_DISK_IF_
@@ -0,0 +1,94 @@
+/*
+ * File       : FAT_WARM.H
+ * Version    : 2.0
+ * Target     : ATMega1280
+ * Compiler   : AVR-GCC 9.3.0
+ * Downloader : AVRDUDE 6.3
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Interface for prewarming the sector cache of FAT_CACHE.H when a volume is
+ * mounted. The first sectors of the root directory, and of a list of hot
+ * directories, are read with multiple sector reads, along with the FAT
+ * sectors of their cluster chains, so the first directory listing and file
+ * lookups after fat_SetBPB are served from the cache.
+ */
+
+#ifndef FAT_WARM_H
+#define FAT_WARM_H
+
+/*
+ ******************************************************************************
+ *                                    MACROS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                               PREWARM LIMITS
+ *
+ * Description : FAT_WARM_DIR_SECS is the most sectors of each directory that
+ *               are read into the cache.
+ *
+ * Notes       : The cache holds at most FAT_CACHE_DIR_SECS directory sectors,
+ *               so reading more than that from each directory only replaces
+ *               the sectors read before.
+ * ----------------------------------------------------------------------------
+ */
+#ifndef FAT_WARM_DIR_SECS
+#define FAT_WARM_DIR_SECS       FAT_CACHE_DIR_SECS
+#endif//FAT_WARM_DIR_SECS
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                          PREWARM ERROR FLAGS
+ *
+ * Description : Flags returned by fat_Prewarm.
+ *
+ * Notes       : fat_Prewarm can also return the FAT Error Flags from FAT.H.
+ * ----------------------------------------------------------------------------
+ */
+#define WARM_OUT_OF_TIME        0x03
+
+/*
+ ******************************************************************************
+ *                           FUNCTION PROTOTYPES
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            PREWARM THE CACHE
+ *
+ * Description : Reads the first sectors of the root directory, then of each
+ *               hot directory in turn, into the sector cache, until they are
+ *               all read or the time budget is used up.
+ *
+ * Arguments   : hotDirs    - Array of paths of the hot directories, from the
+ *                            root directory, e.g. "config/net". NULL if there
+ *                            are none.
+ *               dirCnt     - Number of paths in hotDirs.
+ *               budgetMs   - Most time, in milliseconds, to spend reading.
+ *               bpb        - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, WARM_OUT_OF_TIME if the budget was used up before
+ *               every directory was read, FAILED_READ_SECTOR, or
+ *               FAILED_WRITE_SECTOR if a written sector could not be flushed
+ *               to make room.
+ *
+ * Notes       : 1) Call this once fat_SetBPB has returned BPB_VALID.
+ *               2) The budget is checked before each multiple sector read, so
+ *                  a read started within it may finish after it.
+ *               3) The directories along each path are looked up as by
+ *                  fat_SetDir, so their sectors are also read. A path that
+ *                  does not name a directory is skipped.
+ *               4) The cache keeps the sectors read last, by least recent
+ *                  use, so the directories most likely to be used first
+ *                  should be last in hotDirs.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_Prewarm(const char *const hotDirs[], uint8_t dirCnt,
+                    uint32_t budgetMs, const BPB *bpb);
+
+#endif //FAT_WARM_H
@@ -33,6 +33,31 @@
 //
 #define TIMEOUT_LIMIT   0xFE  
 
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                             COMMAND TIMEOUTS
+ * 
+ * Description : Time limits, in milliseconds, for the card to respond. They
+ *               are measured by the millisecond clock of AVR_TIMER.H, so they
+ *               do not change with the SPI clock rate.
+ *        
+ * Notes       : SD_CMD_TIMEOUT_MS is for the R1 response to a command, and the
+ *               data response to a block written. SD_INIT_TIMEOUT_MS is for
+ *               the card to leave the idle state during initialization, which
+ *               the SD specification allows up to 1 second.
+ *
+ * Warnings    : timer_Init must be called, and global interrupts enabled,
+ *               before sd_InitModeSPI.
+ * ----------------------------------------------------------------------------
+ */
+#ifndef SD_CMD_TIMEOUT_MS
+#define SD_CMD_TIMEOUT_MS       10
+#endif//SD_CMD_TIMEOUT_MS
+
+#ifndef SD_INIT_TIMEOUT_MS
+#define SD_INIT_TIMEOUT_MS      1000
+#endif//SD_INIT_TIMEOUT_MS
+
 // dummy token sent via SPI port when waiting or trying to initiate response
 #define DMY_TKN         0xFF
 
@@ -246,7 +271,7 @@ void sd_SendCommand(uint8_t cmd, uint32_t arg);
  * Notes       : 1) always call immediately after sd_SendCommand().
  *               2) pass the return value to sd_PrintR1() to print R1 response.
  *               3) if R1_TIMEOUT is returned, then the SD Card did not return
- *                  a response.
+ *                  a response within SD_CMD_TIMEOUT_MS.
  * ----------------------------------------------------------------------------
  */
 uint8_t sd_GetR1(void);
@@ -0,0 +1,280 @@
+/*
+ * File       : SD_SPI_INFO.H
+ * Version    : 1.0
+ * Target     : ATMega1280
+ * Compiler   : AVR-GCC 9.3.0
+ * Downloader : AVRDUDE 6.3
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Interface for decoding the SD card's CSD, CID and SCR registers into a
+ * single struct of the card's properties, e.g. its capacity, maximum clock
+ * rate and access times, and its SD Status into a struct of its performance
+ * ratings. These functions require SD_SPI_BASE.H/C and SD_SPI_RWE.H/C, which
+ * reads the registers.
+ */
+
+#ifndef SD_SPI_INFO_H
+#define SD_SPI_INFO_H
+
+/*
+ ******************************************************************************
+ *                                  MACROS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             REGISTER LENGTHS
+ *
+ * Description : Length in bytes of the CSD, CID and SCR registers, and of
+ *               the SD Status.
+ * ----------------------------------------------------------------------------
+ */
+#define CSD_LEN                        16
+#define CID_LEN                        16
+#define SCR_LEN                        8
+#define SD_STATUS_LEN                  64
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                              COMMAND CLASSES
+ *
+ * Description : Bits of the cmdClasses member of SdInfo for the optional
+ *               command classes.
+ * ----------------------------------------------------------------------------
+ */
+#define CCC_WRITE_PROT                 0x0040
+#define CCC_LOCK_CARD                  0x0080
+#define CCC_APP_SPEC                   0x0100
+#define CCC_SWITCH                     0x0400
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                 CSD VERSIONS
+ *
+ * Description : Values of the csdVsn member of SdInfo.
+ *
+ * Notes       : Version 1.0 is used by SDSC cards, which are byte addressed.
+ *               Version 2.0 is used by SDHC and SDXC cards, and version 3.0 by
+ *               SDUC cards, which are block addressed.
+ * ----------------------------------------------------------------------------
+ */
+#define CSD_VSN_1                      1
+#define CSD_VSN_2                      2
+#define CSD_VSN_3                      3
+
+/*
+ ******************************************************************************
+ *                                   STRUCTS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                          SD CARD INFO STRUCT
+ *
+ * Description : Properties of an SD card, decoded from its CSD, CID and SCR
+ *               registers by sd_GetInfo.
+ *
+ * Notes       : 1) Sizes are in blocks of BLOCK_LEN bytes, whatever the block
+ *                  length of the card.
+ *               2) The capacity of an SDUC card can be more than 2^32 blocks.
+ *                  numOfBlks is then 0xFFFFFFFF, i.e. the part of the card
+ *                  that can be addressed.
+ *               3) The SCR register is not read from a card that does not
+ *                  support it, in which case scrValid is 0 and the SCR
+ *                  members are 0.
+ * ----------------------------------------------------------------------------
+ */
+typedef struct
+{
+  // CSD register
+  uint8_t  csdVsn;                     // see CSD VERSIONS
+  uint8_t  nsac;                       // read access clocks, in units of 100
+  uint8_t  r2wFactor;                  // write time is 2^r2wFactor x read
+  uint8_t  readPartial;                // 1 if partial block reads allowed
+  uint8_t  writePartial;               // 1 if partial block writes allowed
+  uint8_t  writeProt;                  // 1 if permanently or temp. protected
+  uint16_t cmdClasses;                 // CCC, bit n set if class n supported
+  uint16_t eraseBlks;                  // erase sector size
+  uint32_t taacNs;                     // read access time in ns
+  uint32_t maxClkHz;                   // maximum clock rate, from TRAN_SPEED
+  uint32_t numOfBlks;                  // capacity of the card
+
+  // CID register
+  uint8_t  mfrId;                      // manufacturer ID
+  char     oemId[3];                   // OEM/application ID string
+  char     prodName[6];                // product name string
+  uint8_t  prodRev;                    // product revision, BCD n.m
+  uint32_t serialNum;                  // product serial number
+  uint16_t mfgYear;                    // manufacturing date
+  uint8_t  mfgMonth;
+
+  // SCR register
+  uint8_t  scrValid;                   // 1 if the SCR was read
+  uint8_t  specVsn;                    // SD spec version x 10, e.g. 30 = 3.0
+  uint8_t  busWidths;                  // bit 0 is 1 bit, bit 2 is 4 bit bus
+  uint8_t  cmdSupport;                 // CMD_SUPPORT bits, e.g. CMD23
+  uint8_t  eraseData;                  // value of the data after an erase
+}
+SdInfo;
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                        SD CARD STATUS STRUCT
+ *
+ * Description : Performance ratings and erase properties of an SD card,
+ *               decoded from its SD Status by sd_GetStatus.
+ *
+ * Notes       : 1) speedClass is the class number, i.e. the minimum write
+ *                  rate in MB/s when the card is written one AU at a time.
+ *               2) perfMove is the rate in MB/s at which the card moves data
+ *                  when it has to reuse a partly written AU. 0 means it is
+ *                  not defined, and 0xFF that it is not limited.
+ *               3) auSizeKB is the size of an AU (allocation unit) in KB. The
+ *                  speed class only holds for writes that start at the start
+ *                  of an AU.
+ * ----------------------------------------------------------------------------
+ */
+typedef struct
+{
+  uint8_t  busWidth;                   // 1 or 4 bits
+  uint8_t  securedMode;                // 1 if in secured mode
+  uint16_t cardType;                   // 0 for a regular card, e.g. not ROM
+  uint32_t protArea;                   // protected area, bytes if SDHC
+  uint8_t  speedClass;                 // 0, 2, 4, 6 or 10
+  uint8_t  perfMove;                   // move rate in MB/s
+  uint32_t auSizeKB;                   // allocation unit size
+  uint16_t eraseAUs;                   // AUs erased in eraseTimeoutS
+  uint8_t  eraseTimeoutS;              // time to erase eraseAUs AUs
+  uint8_t  eraseOffsetS;               // fixed time of an erase
+  uint8_t  uhsSpeedGrade;              // 0, or 1 or 3 for U1 or U3
+  uint8_t  videoClass;                 // video speed class, e.g. 30 = V30
+}
+SdStatus;
+
+/*
+ ******************************************************************************
+ *                           FUNCTION PROTOTYPES
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             GET SD CARD INFO
+ *
+ * Description : Reads the CSD, CID and SCR registers of the card and decodes
+ *               them into an SdInfo instance.
+ *
+ * Arguments   : info   - pointer to the SdInfo instance that will be set.
+ *
+ * Returns     : Read Block Error (upper byte) and R1 Response (lower byte) of
+ *               the first register that could not be read, or READ_SUCCESS.
+ *               A card that rejects the SCR command is not an error.
+ *
+ * Notes       : This should be called once the card is initialized by
+ *               sd_InitModeSPI. Its result can then be passed to
+ *               sd_SetMaxClock and sd_SetTimeouts.
+ * ----------------------------------------------------------------------------
+ */
+uint16_t sd_GetInfo(SdInfo *info);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           DECODE CSD/CID/SCR
+ *
+ * Description : Decode the contents of a register, as read by sd_ReadCSD,
+ *               sd_ReadCID or sd_ReadSCR, into the members of an SdInfo
+ *               instance. Called by sd_GetInfo.
+ *
+ * Arguments   : info     - pointer to the SdInfo instance that will be set.
+ *               regArr   - pointer to the array holding the register, most
+ *                          significant byte first.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void sd_DecodeCSD(SdInfo *info, const uint8_t regArr[]);
+void sd_DecodeCID(SdInfo *info, const uint8_t regArr[]);
+void sd_DecodeSCR(SdInfo *info, const uint8_t regArr[]);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           GET SD CARD STATUS
+ *
+ * Description : Reads the SD Status of the card and decodes it into an
+ *               SdStatus instance.
+ *
+ * Arguments   : sts   - pointer to the SdStatus instance that will be set.
+ *
+ * Returns     : Read Block Error (upper byte) and R1 Response (lower byte).
+ *               READ_SUCCESS if the status was read.
+ *
+ * Notes       : The SD Status is read from the card each call, but only
+ *               changes if the card is locked, secured or its bus changed.
+ * ----------------------------------------------------------------------------
+ */
+uint16_t sd_GetStatus(SdStatus *sts);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                        DECODE SD CARD STATUS
+ *
+ * Description : Decode the SD Status, as read by sd_ReadSdStatus, into the
+ *               members of an SdStatus instance. Called by sd_GetStatus.
+ *
+ * Arguments   : sts      - pointer to the SdStatus instance that will be set.
+ *               regArr   - pointer to the array holding the SD Status, most
+ *                          significant byte first.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void sd_DecodeSdStatus(SdStatus *sts, const uint8_t regArr[]);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            SET MAXIMUM CLOCK
+ *
+ * Description : Sets the SPI clock to the fastest rate that is not faster
+ *               than the maximum clock rate of the card.
+ *
+ * Arguments   : info   - pointer to an SdInfo instance set by sd_GetInfo.
+ *
+ * Returns     : void
+ *
+ * Notes       : The read and write time limits depend on the SPI clock, so
+ *               sd_SetTimeouts should be called after this.
+ * ----------------------------------------------------------------------------
+ */
+void sd_SetMaxClock(const SdInfo *info);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           PRINT SD CARD INFO
+ *
+ * Description : Prints the members of an SdInfo instance to the screen.
+ *
+ * Arguments   : info   - pointer to an SdInfo instance set by sd_GetInfo.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void sd_PrintInfo(const SdInfo *info);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                         PRINT SD CARD STATUS
+ *
+ * Description : Prints the members of an SdStatus instance to the screen.
+ *
+ * Arguments   : sts   - pointer to an SdStatus instance set by sd_GetStatus.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void sd_PrintStatus(const SdStatus *sts);
+
+#endif //SD_SPI_INFO_H
@@ -10,7 +10,8 @@
  * 
  * Interface for some functions that implement SD Card single-block read/print, 
  * write, and multi-block erase by calling the necessary SD commands provided
- * in SD_SPI_CMDS.H. These functions require SD_SPI_BASE.H/C.
+ * in SD_SPI_CMDS.H. These functions require SD_SPI_BASE.H/C, and the SdInfo
+ * struct of SD_SPI_INFO.H.
  */
 
 #ifndef SD_SPI_RWE_H
@@ -42,6 +43,26 @@
  */
 #define START_BLOCK_TKN                0xFE
 
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                             DATA ERROR TOKEN
+ *
+ * Description : Token sent by the SD card, in place of the Start Block Token,
+ *               when it cannot send the block of a read. The token has the
+ *               form 0000EEEE, where at least one of the E bits is set, e.g.
+ *               for an ECC failure of the card's memory or an address that
+ *               is out of range. DATA_ERROR_TKN_MASK is the bits that are 0.
+ * ----------------------------------------------------------------------------
+ */
+#define DATA_ERROR_TKN_MASK            0xF0
+
+//
+// Tokens sent to the SD card before each block of a WRITE_MULTIPLE_BLOCK,
+// and to end it.
+//
+#define START_MULT_WRITE_TKN           0xFC
+#define STOP_TRAN_TKN                  0xFD
+
 /* 
  * ----------------------------------------------------------------------------
  *                                                         DATA RESPONSE TOKENS
@@ -82,6 +103,42 @@
  */
 #define START_TOKEN_TIMEOUT            0x0200
 #define READ_SUCCESS                   0x0400
+#define DATA_ERROR_TKN_RECEIVED        0x0800
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                      MULTIPLE BLOCK CALLBACK
+ *
+ * Description : Type of the function that sd_ReadMultipleBlocks passes each 
+ *               block to as it is received.
+ *
+ * Arguments   : blckArr   - pointer to the array holding the block that was
+ *                           just received. Length BLOCK_LEN.
+ *               arg       - the pointer passed to sd_ReadMultipleBlocks.
+ *
+ * Returns     : 0 to continue reading blocks, or any other value to stop.
+ *
+ * Notes       : The card is deselected while this runs, so it may use other
+ *               devices on the SPI bus, if it leaves the SPI settings as it
+ *               found them. It must not send commands to the card.
+ * ----------------------------------------------------------------------------
+ */
+typedef uint8_t (*SdBlockFn)(const uint8_t blckArr[], void *arg);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                  MULTIPLE BLOCK WRITE SOURCE
+ *
+ * Description : Type of the function that sd_WriteMultipleBlocks calls for
+ *               the data of each block before it is sent.
+ *
+ * Arguments   : blckNum   - number of the block in the write, starting at 0.
+ *               arg       - the pointer passed to sd_WriteMultipleBlocks.
+ *
+ * Returns     : pointer to the data of the block. Length BLOCK_LEN.
+ * ----------------------------------------------------------------------------
+ */
+typedef const uint8_t *(*SdBlockSrcFn)(uint32_t blckNum, void *arg);
 
 /* 
  * ----------------------------------------------------------------------------
@@ -118,6 +175,172 @@
 #define ERASE_ERROR                    0x0400
 #define ERASE_BUSY_TIMEOUT             0x0800
 
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                                BUSY TIMEOUTS
+ *
+ * Description : The longest time, in milliseconds, the card is waited on
+ *               while it is busy after each kind of operation, before
+ *               CARD_BUSY_TIMEOUT or ERASE_BUSY_TIMEOUT is returned, and
+ *               the longest time a block read waits for its data.
+ * 
+ * Notes       : 1) The SD specification limits the busy time of a block write
+ *                  to 250 ms for SDSC and SDHC, and 500 ms for SDXC cards,
+ *                  and the wait for a block read to 100 ms. The busy time
+ *                  of an erase depends on the number of blocks erased.
+ *               2) sd_SetTimeouts replaces the write and read limits with
+ *                  those of the card, from its CSD register.
+ * ----------------------------------------------------------------------------
+ */
+#ifndef SD_READ_TIMEOUT_MS
+#define SD_READ_TIMEOUT_MS             100
+#endif//SD_READ_TIMEOUT_MS
+
+#ifndef SD_WRITE_BUSY_MS
+#define SD_WRITE_BUSY_MS               500
+#endif//SD_WRITE_BUSY_MS
+
+#ifndef SD_ERASE_BUSY_MS
+#define SD_ERASE_BUSY_MS               30000
+#endif//SD_ERASE_BUSY_MS
+
+#ifndef SD_STOP_BUSY_MS
+#define SD_STOP_BUSY_MS                500
+#endif//SD_STOP_BUSY_MS
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                              BUSY OPERATIONS
+ *
+ * Description : The kinds of operation the card can be busy after. These
+ *               index the busy statistics and are passed to the busy yield
+ *               function.
+ *
+ * Notes       : SD_BUSY_WRITE is each block written, SD_BUSY_ERASE is an
+ *               erase, and SD_BUSY_STOP is the end of a multiple block read
+ *               or write.
+ * ----------------------------------------------------------------------------
+ */
+#define SD_BUSY_WRITE                  0
+#define SD_BUSY_ERASE                  1
+#define SD_BUSY_STOP                   2
+#define SD_BUSY_OP_CNT                 3
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                          BUSY YIELD FUNCTION
+ *
+ * Description : Type of the function set by sd_SetBusyYield, which is called
+ *               repeatedly while the card is busy, so the application can do
+ *               other work instead of waiting.
+ *
+ * Arguments   : op    - the operation the card is busy after. See BUSY
+ *                       OPERATIONS.
+ *               arg   - the pointer passed to sd_SetBusyYield.
+ *
+ * Returns     : void
+ *
+ * Warnings    : The card is deselected while this is called, but it may be in
+ *               the middle of a multiple block write, so the function must
+ *               not use the SD card.
+ * ----------------------------------------------------------------------------
+ */
+typedef void (*SdYieldFn)(uint8_t op, void *arg);
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                                 RETRY POLICY
+ *
+ * Description : SD_RETRY_MAX is the number of times sd_ReadSingleBlock and
+ *               sd_WriteSingleBlock retry a block that failed with a timeout
+ *               or CRC error. After SD_STEP_DOWN_FAILS bus errors in a row the
+ *               SPI clock rate is halved, down to SPI_CLK_DIV_128, and after
+ *               SD_STEP_UP_OKS transfers in a row that succeed at the first
+ *               try, one step down is undone. The card is resynchronized, by
+ *               sd_Resync, before each retry.
+ *
+ * Notes       : 1) Errors reported by the card, e.g. an address error or a
+ *                  DATA_ERROR_TKN_RECEIVED, are not retried, and neither is a
+ *                  CARD_BUSY_TIMEOUT, since the card may still be writing the
+ *                  block. Multiple block transfers are not retried.
+ *               2) Only an R1 timeout or a CRC error is a bus error. A
+ *                  START_TOKEN_TIMEOUT, or a bad data response, is retried
+ *                  but does not count towards a step down.
+ *               3) The clock is never sped up past the rate it had before
+ *                  the first step down. sd_SetTimeouts forgets the steps
+ *                  down, so it should be called after sd_SetMaxClock.
+ * ----------------------------------------------------------------------------
+ */
+#ifndef SD_RETRY_MAX
+#define SD_RETRY_MAX                   2
+#endif//SD_RETRY_MAX
+
+#ifndef SD_STEP_DOWN_FAILS
+#define SD_STEP_DOWN_FAILS             3
+#endif//SD_STEP_DOWN_FAILS
+
+#ifndef SD_STEP_UP_OKS
+#define SD_STEP_UP_OKS                 1000
+#endif//SD_STEP_UP_OKS
+
+/*
+ ******************************************************************************
+ *                                   STRUCTS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                       BUSY STATISTICS STRUCT
+ *
+ * Description : Statistics of the time the card was busy after one kind of
+ *               operation.
+ *
+ * Notes       : Times are counted by the millisecond clock of AVR_TIMER.H, so
+ *               a wait shorter than a millisecond may count as 0 ms.
+ * ----------------------------------------------------------------------------
+ */
+typedef struct
+{
+  uint32_t waitCnt;                    // number of waits
+  uint32_t pollCnt;                    // busy bytes received while waiting
+  uint32_t totalMs;                    // total time busy
+  uint32_t maxMs;                      // longest single wait
+  uint16_t timeoutCnt;                 // waits that timed out
+}
+SdBusyStats;
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                              TIMEOUTS STRUCT
+ *
+ * Description : Time limits, in milliseconds, of the card's block reads and
+ *               writes. Set by sd_SetTimeouts.
+ * ----------------------------------------------------------------------------
+ */
+typedef struct
+{
+  uint16_t readMs;                     // wait for the data of a block read
+  uint16_t writeMs;                    // busy time of a block write
+}
+SdTimeouts;
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                      RETRY STATISTICS STRUCT
+ *
+ * Description : Statistics of the retry policy. See RETRY POLICY.
+ * ----------------------------------------------------------------------------
+ */
+typedef struct
+{
+  uint32_t failCnt;                    // failed block reads and writes
+  uint32_t retryCnt;                   // of those, the ones retried
+  uint16_t stepDownCnt;                // times the SPI clock was slowed
+  uint16_t stepUpCnt;                  // times it was sped up again
+}
+SdRetryStats;
+
 /*
  ******************************************************************************
  *                               FUNCTIONS   
@@ -148,10 +371,42 @@
  *                            length BLOCK_LEN.
  * 
  * Returns     : Read Block Error (upper byte) and R1 Response (lower byte).   
+ *
+ * Notes       : A failed read is retried. See RETRY POLICY.
  * ----------------------------------------------------------------------------
  */
 uint16_t sd_ReadSingleBlock(uint32_t blckAddr, uint8_t blckArr[]);
 
+/*
+ * ----------------------------------------------------------------------------
+ *                                                         READ MULTIPLE BLOCKS
+ * 
+ * Description : Reads consecutive data blocks from the SD card with a single
+ *               READ_MULTIPLE_BLOCK command, and passes each block to blckFn
+ *               as it is received.
+ * 
+ * Arguments   : blckAddr     - address of the first data block to read.
+ *               numOfBlcks   - number of blocks to read.
+ *               blckArr      - pointer to the array each block is loaded into
+ *                              before it is passed to blckFn. Must be length
+ *                              BLOCK_LEN.
+ *               blckFn       - function each block is passed to. If it
+ *                              returns a non-zero value then no more blocks
+ *                              are read.
+ *               arg          - pointer passed to blckFn with each block.
+ * 
+ * Returns     : Read Block Error (upper byte) and R1 Response (lower byte).
+ *
+ * Notes       : 1) The command is only sent once, and the card streams the
+ *                  blocks, so this is faster than reading each block with
+ *                  sd_ReadSingleBlock.
+ *               2) The card is deselected while blckFn runs, so blckFn may
+ *                  use other devices on the SPI bus.
+ * ----------------------------------------------------------------------------
+ */
+uint16_t sd_ReadMultipleBlocks(uint32_t blckAddr, uint32_t numOfBlcks, 
+                               uint8_t blckArr[], SdBlockFn blckFn, void *arg);
+
 /*
  * ----------------------------------------------------------------------------
  *                                                           PRINT SINGLE BLOCK
@@ -183,10 +438,334 @@ void sd_PrintSingleBlock(const uint8_t blckArr[]);
  *                            the SD card. Must be of length BLOCK_LEN.
  * 
  * Returns     : Write Block Error (upper byte) and R1 Response (lower byte).
+ *
+ * Notes       : A failed write is retried. See RETRY POLICY.
  * ----------------------------------------------------------------------------
  */
 uint16_t sd_WriteSingleBlock(uint32_t blckAddr, const uint8_t dataArr[]);
 
+/*
+ * ----------------------------------------------------------------------------
+ *                                                        WRITE MULTIPLE BLOCKS
+ * 
+ * Description : Writes consecutive data blocks to the SD card with a single
+ *               WRITE_MULTIPLE_BLOCK command. The data of each block is taken
+ *               from blckSrcFn just before the block is sent.
+ * 
+ * Arguments   : blckAddr     - address of the first data block to write.
+ *               numOfBlcks   - number of blocks to write.
+ *               blckSrcFn    - function that returns the data of each block.
+ *               arg          - pointer passed to blckSrcFn with each block.
+ * 
+ * Returns     : Write Block Error (upper byte) and R1 Response (lower byte).
+ *
+ * Notes       : The write stops at the first block that is not written, and
+ *               the blocks after it are not written.
+ * ----------------------------------------------------------------------------
+ */
+uint16_t sd_WriteMultipleBlocks(uint32_t blckAddr, uint32_t numOfBlcks,
+                                SdBlockSrcFn blckSrcFn, void *arg);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           START WRITE STREAM
+ * 
+ * Description : Sends the WRITE_MULTIPLE_BLOCK command to begin a write
+ *               stream at blckAddr. Blocks are then sent one at a time by
+ *               sd_SendStreamBlock, and the stream is ended by sd_StopStream.
+ * 
+ * Arguments   : blckAddr   - address of the first data block to write.
+ * 
+ * Returns     : Write Block Error (upper byte) and R1 Response (lower byte).
+ *               DATA_WRITE_SUCCESS if the stream was started.
+ *
+ * Warnings    : No other command may be sent to the card until the stream is
+ *               ended by sd_StopStream.
+ * ----------------------------------------------------------------------------
+ */
+uint16_t sd_StartStream(uint32_t blckAddr);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            SEND STREAM BLOCK
+ * 
+ * Description : Sends the next data block of a write stream started by
+ *               sd_StartStream. This returns once the card has accepted the
+ *               block, without waiting while the card writes it.
+ * 
+ * Arguments   : blckArr   - pointer to the array holding the block. Must be of
+ *                           length BLOCK_LEN.
+ * 
+ * Returns     : Write Block Error. DATA_WRITE_SUCCESS if the block was
+ *               accepted.
+ *
+ * Notes       : If the card is still busy writing the previous block this
+ *               waits for it first. Call sd_IsCardBusy to avoid waiting.
+ * ----------------------------------------------------------------------------
+ */
+uint16_t sd_SendStreamBlock(const uint8_t blckArr[]);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                 IS CARD BUSY
+ * 
+ * Description : Checks, without waiting, if the card is busy writing a block.
+ * 
+ * Arguments   : void
+ * 
+ * Returns     : 1 if the card is busy, 0 if it is not.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t sd_IsCardBusy(void);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            STOP WRITE STREAM
+ * 
+ * Description : Ends a write stream started by sd_StartStream, and waits
+ *               while the card writes the last block.
+ * 
+ * Arguments   : void
+ * 
+ * Returns     : Write Block Error. DATA_WRITE_SUCCESS or CARD_BUSY_TIMEOUT.
+ * ----------------------------------------------------------------------------
+ */
+uint16_t sd_StopStream(void);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            START READ STREAM
+ * 
+ * Description : Sends the READ_MULTIPLE_BLOCK command to begin a read stream
+ *               at blckAddr. Blocks are then received one at a time by
+ *               sd_ReceiveStreamBlock, and the stream is ended by
+ *               sd_StopReadStream.
+ * 
+ * Arguments   : blckAddr   - address of the first data block to read.
+ * 
+ * Returns     : Read Block Error (upper byte) and R1 Response (lower byte).
+ *               READ_SUCCESS if the stream was started.
+ *
+ * Warnings    : No other command may be sent to the card until the stream is
+ *               ended by sd_StopReadStream.
+ * ----------------------------------------------------------------------------
+ */
+uint16_t sd_StartReadStream(uint32_t blckAddr);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                               IS BLOCK READY
+ * 
+ * Description : Checks, without waiting, if the card has started sending the
+ *               next block of a read stream started by sd_StartReadStream.
+ * 
+ * Arguments   : void
+ * 
+ * Returns     : 1 if sd_ReceiveStreamBlock will not wait for the block, 0 if
+ *               the card is still reading it.
+ *
+ * Notes       : This also returns 1 once the card has sent a Data Error
+ *               Token, or the read time limit has passed since the stream
+ *               was started or the last block received, so
+ *               sd_ReceiveStreamBlock returns DATA_ERROR_TKN_RECEIVED or
+ *               START_TOKEN_TIMEOUT at once.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t sd_IsBlockReady(void);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                         RECEIVE STREAM BLOCK
+ * 
+ * Description : Receives the next data block of a read stream started by
+ *               sd_StartReadStream.
+ * 
+ * Arguments   : blckArr   - pointer to the array the block is loaded into.
+ *                           Must be of length BLOCK_LEN.
+ * 
+ * Returns     : Read Block Error. READ_SUCCESS, START_TOKEN_TIMEOUT, or
+ *               DATA_ERROR_TKN_RECEIVED if the card could not read the block.
+ *
+ * Notes       : If the card has not started sending the block this waits for
+ *               it first. Call sd_IsBlockReady to avoid waiting.
+ * ----------------------------------------------------------------------------
+ */
+uint16_t sd_ReceiveStreamBlock(uint8_t blckArr[]);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             STOP READ STREAM
+ * 
+ * Description : Ends a read stream started by sd_StartReadStream. Any block
+ *               the card has started sending is dropped.
+ * 
+ * Arguments   : void
+ * 
+ * Returns     : Read Block Error. READ_SUCCESS.
+ * ----------------------------------------------------------------------------
+ */
+uint16_t sd_StopReadStream(void);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                               SET BUSY YIELD
+ * 
+ * Description : Sets the function called repeatedly while the card is busy.
+ *               See BUSY YIELD FUNCTION.
+ * 
+ * Arguments   : yieldFn   - the function, or NULL to wait without yielding.
+ *               arg       - pointer passed to yieldFn with each call.
+ * 
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void sd_SetBusyYield(SdYieldFn yieldFn, void *arg);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                          GET BUSY STATISTICS
+ * 
+ * Description : Copies the busy statistics of one kind of operation.
+ * 
+ * Arguments   : op      - the operation. See BUSY OPERATIONS.
+ *               stats   - pointer to the SdBusyStats instance that will be
+ *                         set.
+ * 
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void sd_GetBusyStats(uint8_t op, SdBusyStats *stats);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                        RESET BUSY STATISTICS
+ * 
+ * Description : Sets the busy statistics of every kind of operation to 0.
+ * 
+ * Arguments   : void
+ * 
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void sd_ResetBusyStats(void);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           RESYNCHRONIZE CARD
+ * 
+ * Description : Returns the card to a known state after a failed transfer.
+ *               The card is clocked while deselected, any multiple block
+ *               read it is still in is stopped, and its status is read,
+ *               which clears its error flags.
+ * 
+ * Arguments   : void
+ * 
+ * Returns     : R1 Response of the SEND_STATUS command. OUT_OF_IDLE if the
+ *               card is responding.
+ *
+ * Notes       : Sent after a failed transfer, STOP_TRANSMISSION is expected
+ *               to be rejected as an illegal command. Its response is not
+ *               checked.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t sd_Resync(void);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                   READ CSD/CID/SCR/SD STATUS
+ * 
+ * Description : Read the card's CSD (Card Specific Data), CID (Card
+ *               Identification) or SCR (SD Card Configuration) register, or
+ *               its SD Status.
+ * 
+ * Arguments   : regArr   - pointer to an array of length CSD_LEN, CID_LEN,
+ *                          SCR_LEN or SD_STATUS_LEN that will be loaded with
+ *                          the register, most significant byte first.
+ * 
+ * Returns     : Read Block Error (upper byte) and R1 Response (lower byte).
+ *
+ * Notes       : The registers are decoded by the functions of SD_SPI_INFO.H.
+ * ----------------------------------------------------------------------------
+ */
+uint16_t sd_ReadCSD(uint8_t regArr[]);
+uint16_t sd_ReadCID(uint8_t regArr[]);
+uint16_t sd_ReadSCR(uint8_t regArr[]);
+uint16_t sd_ReadSdStatus(uint8_t regArr[]);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           READ GEN_CMD BLOCK
+ * 
+ * Description : Reads the data block the card sends for a GEN_CMD (CMD56)
+ *               read. The contents of the block, and the argument selecting
+ *               it, are defined by the card's manufacturer, e.g. some cards
+ *               report their wear and spare blocks this way.
+ * 
+ * Arguments   : arg       - argument of the command. Bit 0, which selects a
+ *                           read, is set by this function.
+ *               blckArr   - pointer to an array of length BLOCK_LEN that
+ *                           will be loaded with the block.
+ * 
+ * Returns     : Read Block Error (upper byte) and R1 Response (lower byte).
+ *               R1_ERROR with ILLEGAL_CMD if the card does not support it.
+ *
+ * Notes       : Only cards that support command class 8 (CCC_APP_SPEC of
+ *               SD_SPI_INFO.H) accept GEN_CMD.
+ * ----------------------------------------------------------------------------
+ */
+uint16_t sd_ReadGenCmd(uint32_t arg, uint8_t blckArr[]);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                 SET TIMEOUTS
+ * 
+ * Description : Sets the time limits of block reads and writes from the
+ *               card's CSD register. See Notes.
+ * 
+ * Arguments   : info   - pointer to an SdInfo instance set by sd_GetInfo.
+ * 
+ * Returns     : void
+ *
+ * Notes       : 1) For a version 1.0 CSD (SDSC), the read limit is 100 times
+ *                  the access time given by TAAC and NSAC, up to 100 ms, and
+ *                  the write limit is that times 2^R2W_FACTOR, up to 250 ms.
+ *               2) For later CSD versions, the limits are fixed at 100 ms
+ *                  and 250 ms, or 500 ms for SDXC cards.
+ *               3) NSAC is in SPI clock cycles, so the limits are set again
+ *                  each time the retry policy changes the SPI clock. This
+ *                  should be called after the SPI clock rate is changed, and
+ *                  it forgets the retry policy's steps down of the clock.
+ * ----------------------------------------------------------------------------
+ */
+void sd_SetTimeouts(const SdInfo *info);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                 GET TIMEOUTS
+ * 
+ * Description : Copies the time limits of block reads and writes.
+ * 
+ * Arguments   : tmo   - pointer to the SdTimeouts instance that will be set.
+ * 
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void sd_GetTimeouts(SdTimeouts *tmo);
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                         GET RETRY STATISTICS
+ * 
+ * Description : Copies the statistics of the retry policy.
+ * 
+ * Arguments   : stats   - pointer to the SdRetryStats instance that will be
+ *                         set.
+ * 
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void sd_GetRetryStats(SdRetryStats *stats);
+
 /*
  * ----------------------------------------------------------------------------
  *                                                                 ERASE BLOCKS
@@ -88,3 +88,48 @@ void spi_MasterTransmit(uint8_t byte)
   while ( !(SPSR & 1 << SPIF))
     ;
 }
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                          SET SPI CLOCK RATE
+ * 
+ * Description : Sets the clock rate of the SPI port to F_CPU / 2^(div + 1).
+ * 
+ * Arguments   : div   - one of the SPI clock rate macros, e.g.
+ *                       SPI_CLK_DIV_4. Values above SPI_CLK_DIV_128 are set
+ *                       to SPI_CLK_DIV_128.
+ * ----------------------------------------------------------------------------
+ */
+void spi_SetClockDiv(uint8_t div)
+{
+  //
+  // SPR1:SPR0 select ck/4, 16, 64 or 128, and SPI2X doubles the rate, so
+  // each pair of rates shares an SPR setting. ck/128 is only set undoubled.
+  //
+  if (div > SPI_CLK_DIV_128)
+    div = SPI_CLK_DIV_128;
+  SPCR = (SPCR & ~(1 << SPR1 | 1 << SPR0)) | (div / 2) << SPR0;
+  if (div % 2 || div == SPI_CLK_DIV_128)
+    SPSR &= ~(1 << SPI2X);
+  else
+    SPSR |= 1 << SPI2X;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                          GET SPI CLOCK RATE
+ * 
+ * Description : Gets the clock rate of the SPI port.
+ * 
+ * Returns     : one of the SPI clock rate macros, e.g. SPI_CLK_DIV_64.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t spi_GetClockDiv(void)
+{
+  uint8_t spr = (SPCR >> SPR0) & 0x03;
+
+  // doubled ck/128 is ck/64.
+  if (spr == 0x03)
+    return (SPSR & 1 << SPI2X) ? SPI_CLK_DIV_64 : SPI_CLK_DIV_128;
+  return 2 * spr + ((SPSR & 1 << SPI2X) ? 0 : 1);
+}
@@ -0,0 +1,146 @@
+/*
+ * File       : AVR_TIMER.C
+ * Version    : 1.0 
+ * Target     : Default - ATMega1280
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ * 
+ * AVR_TIMER.C defines the functions of the millisecond clock kept by TIMER0
+ * and the sample clock kept by TIMER1 of the ATMega microcontroller. This is
+ * the implementation of AVR_TIMER.H
+ */
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include "avr_timer.h"
+
+// milliseconds since timer_Init. Incremented by the compare match interrupt.
+static volatile uint32_t msCnt;
+
+// called by the TIMER1 compare match interrupt. Set by timer_SampleStart.
+static TimerTickFn sampleTickFn;
+
+/*
+ ******************************************************************************
+ *                                  FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             INITIALIZE TIMER
+ *                                        
+ * Description : Starts TIMER0 interrupting every millisecond, and sets the
+ *               millisecond clock to 0.
+ * 
+ * Arguments   : void 
+ *
+ * Notes       : Global interrupts must be enabled, e.g. with sei(), for the
+ *               clock to run.
+ * ----------------------------------------------------------------------------
+ */
+void timer_Init(void)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    msCnt = 0;
+  }
+
+  // CTC mode, clk/64 prescaler, interrupt on compare match A.
+  TCCR0A = 1 << WGM01;
+  TCCR0B = 1 << CS01 | 1 << CS00;
+  OCR0A = (uint8_t)TIMER_OCR_VALUE;
+  TCNT0 = 0;
+  TIMSK0 = 1 << OCIE0A;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                        GET MILLISECOND CLOCK
+ *                                         
+ * Description : Returns the number of milliseconds since timer_Init.
+ * 
+ * Arguments   : void
+ * 
+ * Returns     : milliseconds since timer_Init. Wraps after about 49 days, so
+ *               time differences should be calculated as unsigned 32-bit
+ *               subtractions.
+ * ----------------------------------------------------------------------------
+ */
+uint32_t timer_GetMs(void)
+{
+  uint32_t ms;
+
+  // the 32-bit count must not be incremented while its bytes are read.
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    ms = msCnt;
+  }
+  return ms;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           START SAMPLE CLOCK
+ *                                        
+ * Description : Starts TIMER1 interrupting rateHz times a second, and calling
+ *               tickFn from each interrupt.
+ * 
+ * Arguments   : rateHz   - Number of ticks each second. Must be at least
+ *                          F_CPU / TIMER_SAMPLE_PRESCALE / 65536.
+ *               tickFn   - Function called at each tick.
+ *
+ * Notes       : 1) Global interrupts must be enabled, e.g. with sei(), for
+ *                  the clock to run.
+ *               2) The rate is rounded to the nearest that TIMER1 can count,
+ *                  e.g. 8000 Hz is exact at 16 MHz, but 44100 Hz is 44444 Hz.
+ * ----------------------------------------------------------------------------
+ */
+void timer_SampleStart(uint32_t rateHz, TimerTickFn tickFn)
+{
+  uint32_t cntsPerTick = (F_CPU / TIMER_SAMPLE_PRESCALE + rateHz / 2) / rateHz;
+
+  timer_SampleStop();
+  sampleTickFn = tickFn;
+
+  // CTC mode, clk/8 prescaler, interrupt on compare match A.
+  TCCR1A = 0;
+  TCCR1B = 1 << WGM12 | 1 << CS11;
+  OCR1A = (uint16_t)(cntsPerTick - 1);
+  TCNT1 = 0;
+  TIMSK1 = 1 << OCIE1A;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            STOP SAMPLE CLOCK
+ *                                        
+ * Description : Stops the TIMER1 interrupt started by timer_SampleStart.
+ * 
+ * Arguments   : void
+ * ----------------------------------------------------------------------------
+ */
+void timer_SampleStop(void)
+{
+  TIMSK1 = 0;
+  TCCR1B = 0;
+}
+
+/*
+ ******************************************************************************
+ *                                 INTERRUPTS
+ ******************************************************************************
+ */
+
+ISR(TIMER0_COMPA_vect)
+{
+  ++msCnt;
+}
+
+ISR(TIMER1_COMPA_vect)
+{
+  sampleTickFn();
+}
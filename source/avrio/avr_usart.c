@@ -10,9 +10,25 @@
  * the ATMega microcontroller. This is the implementation of AVR_USART.H
  */
 
+#include <stdint.h>
 #include <avr/io.h>
+#include <avr/interrupt.h>
 #include "avr_usart.h"
 
+#if USART_RX_BUF_LEN & (USART_RX_BUF_LEN - 1) || USART_RX_BUF_LEN > 256
+#error "USART_RX_BUF_LEN must be a power of 2, no more than 256"
+#endif
+
+//
+// receive buffer. While it is on, rxHead is only set by the interrupt and
+// rxTail only by usart_Receive. Each is a single byte, so neither needs an
+// atomic block.
+//
+static volatile uint8_t rxBuf[USART_RX_BUF_LEN];
+static volatile uint8_t rxHead;
+static volatile uint8_t rxTail;
+static uint8_t rxBufOn;
+
 /*
  ******************************************************************************
  *                                  FUNCTIONS
@@ -54,6 +70,18 @@ void usart_Init(void)
  */
 uint8_t usart_Receive(void)
 {
+  if (rxBufOn)
+  {
+    uint8_t data;
+
+    // wait for the interrupt to add a byte.
+    while (rxHead == rxTail)
+      ;
+    data = rxBuf[rxTail];
+    rxTail = (rxTail + 1) & (USART_RX_BUF_LEN - 1);
+    return data;
+  }
+
   // poll the RX complete flag, until it is set
   while ( !(UCSR0A & 1 << RXC0))
     ;
@@ -80,3 +108,70 @@ void usart_Transmit(uint8_t data)
   // load data into usart buffer which will transmit it.
   UDR0 = data;
 }
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                  USART RECEIVE BUFFER ON/OFF
+ *
+ * Description : usart_RxBufferOn starts the receive complete interrupt, which
+ *               adds each byte received to a buffer of USART_RX_BUF_LEN
+ *               bytes, and empties the buffer. usart_RxBufferOff stops it.
+ *
+ * Arguments   : void
+ *
+ * Notes       : 1) While the buffer is on, usart_Receive returns the bytes of
+ *                  the buffer, in the order they were received, so bytes
+ *                  received while the program is busy are not lost.
+ *               2) Bytes received while the buffer is full are dropped.
+ *               3) Global interrupts must be enabled, e.g. with sei().
+ * ----------------------------------------------------------------------------
+ */
+void usart_RxBufferOn(void)
+{
+  rxHead = 0;
+  rxTail = 0;
+  rxBufOn = 1;
+  UCSR0B |= 1 << RXCIE0;
+}
+
+void usart_RxBufferOff(void)
+{
+  UCSR0B &= ~(1 << RXCIE0);
+  rxBufOn = 0;
+  rxTail = rxHead;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                     USART RECEIVE BYTE COUNT
+ *
+ * Description : Returns the number of bytes waiting in the receive buffer.
+ *
+ * Arguments   : void
+ *
+ * Returns     : bytes in the receive buffer, or 0 if the buffer is off.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t usart_RxCount(void)
+{
+  return (rxHead - rxTail) & (USART_RX_BUF_LEN - 1);
+}
+
+/*
+ ******************************************************************************
+ *                                 INTERRUPTS
+ ******************************************************************************
+ */
+
+ISR(USART0_RX_vect)
+{
+  uint8_t data = UDR0;
+  uint8_t next = (rxHead + 1) & (USART_RX_BUF_LEN - 1);
+
+  // drop the byte if the buffer is full.
+  if (next != rxTail)
+  {
+    rxBuf[rxHead] = data;
+    rxHead = next;
+  }
+}
@@ -14,6 +14,8 @@
 #include "fat_bpb.h"
 #include "fat.h"
 #include "fat_to_disk_if.h"
+#include "fat_cache.h"
+#include "fat_neg.h"
 
 /*
  ******************************************************************************
@@ -21,6 +23,34 @@
  ******************************************************************************
  */
 
+// states of a FatDirStep. The work its next step will do.
+#define DIR_STEP_READ_SEC        0       // read sector of secNumInClus
+#define DIR_STEP_SEARCH_SEC      1       // search the sector in secArr
+#define DIR_STEP_NEXT_CLUS       2       // read FAT for next cluster index
+
+// snPos of a FatDirStep when no long name spans into the next sector.
+#define NO_SPAN                  0xFFFF
+
+// state passed to pvt_CountSector by fat_ReadFileSectors.
+struct SecCounter
+{
+  FatSectorFn secFn;
+  void       *arg;
+  uint32_t    secsLeft;
+  uint8_t     stopped;
+};
+
+// state passed to pvt_SinkSector by fat_StreamFile.
+struct StreamSink
+{
+  FatFile    *file;
+  uint32_t    len;                     // bytes left to pass to sinkFn
+  FatSinkFn   sinkFn;
+  void       *arg;
+  const BPB  *bpb;
+  uint8_t     stopped;                 // 1 if sinkFn took fewer bytes
+};
+
 static void pvt_UpdateFatEntryMembers(FatEntry *ent, const char lnStr[], 
                 const uint8_t secArr[], uint16_t snPos,
                 uint8_t snEntSecNumInClus, uint32_t snEntClusIndx);
@@ -28,9 +58,22 @@ static uint8_t pvt_CheckName(const char nameStr[]);
 static uint8_t pvt_SetDirToParent(FatDir *dir, const BPB *bpb);
 static void pvt_LoadLongName(int lnFirstEnt, int lnLastEnt, 
                              const uint8_t secArr[], char lnStr[]);
-static uint32_t pvt_GetNextClusIndex(uint32_t clusIndex, const BPB *bpb);
-static void pvt_PrintEntFields(const uint8_t *byte, uint8_t flags);
-static uint8_t pvt_PrintFile(const uint8_t snEnt[], const BPB *bpb);
+static uint8_t pvt_GetNextClusIndex(uint32_t *clusIndx, const BPB *bpb);
+static void pvt_DecodeEntry(FatEntryInfo *info, const uint8_t snEnt[]);
+static void pvt_PrintEntFields(const FatEntryInfo *info, uint8_t flags);
+static uint8_t pvt_PrintEntry(FatEntry *ent, uint8_t entFlds);
+static uint8_t pvt_PrintFile(const FatEntryInfo *info, const BPB *bpb);
+static uint16_t pvt_PrintSpan(const uint8_t spanArr[], uint16_t len,
+                              void *arg);
+static uint8_t pvt_SetFileClus(FatFile *file, const BPB *bpb);
+static uint8_t pvt_StepFileClus(FatFile *file, const BPB *bpb);
+static void pvt_StepToNextSec(FatDirStep *step, const BPB *bpb);
+static uint8_t pvt_EndSpanningName(FatDirStep *step);
+static uint8_t pvt_CountSector(const uint8_t secArr[], void *arg);
+static uint8_t pvt_SinkSector(const uint8_t secArr[], void *arg);
+static void pvt_SetEntClusSize(uint8_t secArr[], uint16_t entPos,
+                               uint32_t fstClusIndx, uint32_t fileSize);
+static uint8_t pvt_SnChkSum(const uint8_t snEnt[]);
 
 /*
  ******************************************************************************
@@ -84,6 +127,7 @@ void fat_InitEntry(FatEntry *ent, const BPB *bpb)
   // fill short name entry array with 0's
   for(uint8_t entByte = 0; entByte < ENTRY_LEN; ++entByte)
     ent->snEnt[entByte] = 0;
+  pvt_DecodeEntry(&ent->info, ent->snEnt);
 
   // set rest of the FatEntry members to 0. 
   ent->snEntSecNumInClus = 0;
@@ -109,185 +153,18 @@ void fat_InitEntry(FatEntry *ent, const BPB *bpb)
  * ----------------------------------------------------------------------------
  */
 uint8_t fat_SetNextEntry(FatEntry *currEnt, const BPB *bpb)
-{  
-  //
-  // this section sets the initial values of the different nested loop
-  // counters for the first time they are entered during a single function 
-  // call. These are set according to the state of the currEnt members.
-  //
-
-  // index of the cluster where the previous short name entry was found
-  uint32_t clusIndx = currEnt->snEntClusIndx;
-  // sector num in the cluster where the previous short name entry was found
-  uint8_t  secNumInClus = currEnt->snEntSecNumInClus;
-  // position of entry following previous short name entry in the sector
-  uint16_t entPos = currEnt->nextEntPos;
+{
+  uint8_t err;
 
   //
-  // if previous short name entry occupied the last entry position of a sector
-  // then increment secNumInClus and set entPos to 0 so that the search for the
-  // next entry will begin on this function call at the first entry of the next
-  // sector. For the case when the the next sector is beyond the cluster limit 
-  // it will be handled in the nested loops.
+  // search from the entry of currEnt. The step search keeps the sector it is
+  // searching, but it is only used for a single entry here.
   //
-  if (entPos == SECTOR_LEN)
-  {
-    ++secNumInClus;
-    entPos = 0;
-  }
-
-  // loop over clusters beginning at clusIndx to search for next entry.
-  do 
-  {
-    //
-    // loop over sectors in the cluster to find the next entry. If this loop is
-    // re-entered in a single function call then secNumInClus will be reset to
-    // 0 in the outer cluser loop. The first time it is entered it should be
-    // initialized to the value of the snEntSecNumInClus member of the currEnt
-    // instance of FatEntry.
-    //
-    for (; secNumInClus < bpb->secPerClus; ++secNumInClus)
-    {
-      // calculate location of sector on the disk
-      uint32_t secNumOnDisk = secNumInClus + bpb->dataRegionFirstSector
-                            + (clusIndx - bpb->rootClus) 
-                            * bpb->secPerClus;
-      
-      // create and load array with data bytes from the disk sector
-      uint8_t secArr[bpb->bytesPerSec];  
-      if (FATtoDisk_ReadSingleSector(secNumOnDisk, secArr) 
-          == FAILED_READ_SECTOR)
-        return FAILED_READ_SECTOR;
-
-      //
-      // loop over entries in the sector to search for the next entry. If this 
-      // loop is re-entered in a single function call then entPos will be reset 
-      // to 0 in the sector loop. The first time it is entered entPos should be
-      // initialized to the value of the nextEntPos member of the currEnt
-      // instance of FatEntry.
-      //
-      for (; entPos < bpb->bytesPerSec; entPos += ENTRY_LEN)
-      {
-        // if first byte of an entry is 0, remaining entries should be empty
-        if (!secArr[entPos])                                                       
-          return END_OF_DIRECTORY;
-
-        if (secArr[entPos] == DELETED_ENTRY_TOKEN)
-          continue;
-
-        // check attribute byte to see if entPos points to a long name entry
-        if ((secArr[entPos + ATTR_BYTE_OFFSET] & LN_ATTR_MASK) == LN_ATTR_MASK)
-        {
-          // entPos must be pointing to the last entry of a long name here.
-          if (!(secArr[entPos] & LN_LAST_ENTRY_FLAG))
-            return CORRUPT_FAT_ENTRY;
-          
-          // initialize empty long name string 
-          char lnStr[LN_STR_LEN_MAX] = {'\0'};   
-
-          // calculate position of short name relative to first byte in sector
-          uint16_t snPos = entPos + ENTRY_LEN * (LN_ORD_MASK & secArr[entPos]);
-
-          // enter if short name is in the next sector
-          if (snPos >= bpb->bytesPerSec)
-          {              
-            uint8_t nextSecArr[bpb->bytesPerSec]; 
-
-            //
-            // locate next sector. Depending on the number of the sector in the 
-            // cluster, the next sector will either be in the next cluster or 
-            // it will be the next sector in the cluster and on the disk.
-            //
-            if (secNumInClus == bpb->secPerClus - 1)  // next sec in next clus
-            {
-              // calculate location of next sector in next clus on the disk
-              secNumOnDisk = bpb->dataRegionFirstSector 
-                           + (pvt_GetNextClusIndex(clusIndx, bpb)
-                           - bpb->rootClus)
-                           * bpb->secPerClus;
-              secNumInClus = 0;
-            }
-            else                  // next sector is the next physical sector 
-            {
-              ++secNumOnDisk;
-              ++secNumInClus;
-            }
-
-            // load next sector into nextSecArr[].
-            if (FATtoDisk_ReadSingleSector(secNumOnDisk, nextSecArr) 
-                == FAILED_READ_SECTOR)
-              return FAILED_READ_SECTOR;
-            
-            // snPos to point to sn entry relative to first byte of next sector
-            snPos -= bpb->bytesPerSec;
-            
-            // verify snPos does not point to long name
-            if ((nextSecArr[snPos + ATTR_BYTE_OFFSET] & LN_ATTR_MASK) 
-                 == LN_ATTR_MASK)
-              return CORRUPT_FAT_ENTRY;
-            
-            //
-            // check if a ln spans the sector boundary. At this point, sn is in
-            // next sector, but if sn is not first entry (i.e. snPos != 0) then 
-            // entries for ln are in the current sector and next sector.
-            //
-            if (snPos)
-            {
-              // Entry preceeding short name must be first entry of long name      
-              if ((nextSecArr[snPos - ENTRY_LEN] & LN_ORD_MASK) != 1)
-                return CORRUPT_FAT_ENTRY;
-
-              // Call twice for both current and next sector.
-              pvt_LoadLongName(snPos - ENTRY_LEN, FIRST_ENT_POS_IN_SEC,
-                               nextSecArr, lnStr);
-              pvt_LoadLongName(LAST_ENTRY_POS_IN_SEC, entPos, secArr, lnStr);
-            }
-            else   // full ln in current sec, but sn is first ent in next sec
-            {
-              // Entry preceeding short name must be first entry of long name
-              if ((secArr[LAST_ENTRY_POS_IN_SEC] & LN_ORD_MASK) != 1)
-                return CORRUPT_FAT_ENTRY;
-
-              pvt_LoadLongName(LAST_ENTRY_POS_IN_SEC, entPos, secArr, lnStr);
-            }
-            pvt_UpdateFatEntryMembers(currEnt, lnStr, nextSecArr, snPos,
-                                      secNumInClus, clusIndx);
-            return SUCCESS;
-          }
-          else          // Long and short name are in the current sector.
-          {   
-            // Verify snPos does not point to long name
-            if ((secArr[snPos + ATTR_BYTE_OFFSET] & LN_ATTR_MASK) 
-                 == LN_ATTR_MASK)
-              return CORRUPT_FAT_ENTRY;
-    
-            // entry preceeding short name must be first entry of long name
-            if ((secArr[snPos - ENTRY_LEN] & LN_ORD_MASK) != 1)
-              return CORRUPT_FAT_ENTRY;
-            
-            pvt_LoadLongName(snPos - ENTRY_LEN, entPos, secArr, lnStr);
-            pvt_UpdateFatEntryMembers(currEnt, lnStr, secArr, snPos, 
-                                      secNumInClus, clusIndx);
-            return SUCCESS;                          
-          }                   
-        }
-        else            // Long name does not exist. Use short name instead.
-        {
-          // passing empty string for long name
-          pvt_UpdateFatEntryMembers(currEnt, "", secArr, entPos,
-                                    secNumInClus, clusIndx);
-          return SUCCESS;  
-        }
-      }
-      entPos = FIRST_ENT_POS_IN_SEC;      // reset counter for entry loop
-    }
-    secNumInClus = FIRST_SEC_POS_IN_CLUS;// reset counter for sector loop
-  }
-  // get index of next cluster and continue looping if not last cluster
-  while ((clusIndx = pvt_GetNextClusIndex(clusIndx, bpb)) != END_CLUSTER);
-
-  // return here if the end of the dir was reached without finding a next entry
-  return END_OF_DIRECTORY;
+  FatDirStep step;
+  fat_InitDirStep(&step, currEnt);
+  while ((err = fat_StepNextEntry(&step, bpb)) == STEP_BUSY)
+    ;
+  return err;
 }
 
 /*
@@ -337,64 +214,93 @@ uint8_t fat_SetDir(FatDir *dir, const char newDirStr[], const BPB *bpb)
   }
 
   // 
-  // Create and initialize a FatEntry instance. This will set the snEntClusIndx
-  // member to the root directory and all other members to 0 or null strings, 
-  // then update the snEntClusIndx to point to the first cluster index of the 
-  // FatDir instance (dir).
+  // Search FatDir directory for a child directory matching newDirStr. Note
+  // that the lnStr member of an entry will be the same as the snStr if a
+  // lnStr does not exist for the entry, therefore, short names can only be
+  // used when a lnStr does not exist for the entry. A search that misses
+  // fills the directory's negative lookup filter, so the next miss does not
+  // read the disk.
   //
-  FatEntry ent;
-  fat_InitEntry(&ent, bpb);
-  ent.snEntClusIndx = dir->fstClusIndx;
+  FatLookupStep lk;
+  fat_InitLookupStep(&lk, dir, newDirStr, DIR_ENTRY_ATTR, bpb);
+  while ((err = fat_StepLookup(&lk, bpb)) == STEP_BUSY)
+    ;
 
-  // 
-  // Search FatDir directory to see if a child directory matches newDirStr.
-  // Done by repeatedly calling fat_SetNextEntry() to set a FatEntry instance
-  // to the next entry in the directory and then comparing the lnStr member of 
-  // the instance to newDirStr. Note that the lnStr member will be the same as
-  // the snStr if a lnStr does not exist for the entry, therefore, short names
-  // can only be used when a lnStr does not exist for the entry.
-  //
-  while ((err = fat_SetNextEntry(&ent, bpb)) == SUCCESS)
+  // No matching entry found. FatDir is unchanged.
+  if (err == DIR_NOT_FOUND)
+    return END_OF_DIRECTORY;
+  if (err != SUCCESS)
+    return err;
+
+  // get value of the first cluster index in the FAT for that entry.
+  dir->fstClusIndx = lk.ent.info.fstClusIndx;
+
+  // fill short name array with its characters from the entry
+  char snStr[SN_NAME_CHAR_LEN + 1] = {'\0'};      
+  for (uint8_t strPos = 0; strPos < SN_NAME_CHAR_LEN; ++strPos)
+    snStr[strPos] = lk.ent.snEnt[strPos];
+
+  // Append current directory name to the short and long name paths
+  strcat (dir->lnPathStr, dir->lnStr);
+  strcat (dir->snPathStr, dir->snStr);
+
+  // Update dir to new dir name. If current dir != root dir append '/'
+  if (strcmp(dir->lnStr, "/"))
+    strcat(dir->lnPathStr, "/"); 
+  strcpy(dir->lnStr, newDirStr);
+
+  if (strcmp(dir->snStr, "/"))
+    strcat(dir->snPathStr, "/");
+  strcpy(dir->snStr, snStr);
+
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                        SET DIRECTORY TO PATH
+ *
+ * Description : Sets a FatDir instance to the directory at a path from the
+ *               root directory, one directory name at a time by fat_SetDir.
+ *
+ * Arguments   : dir       - Pointer to the FatDir instance to be set.
+ *               pathStr   - Path of the directory, with the names separated
+ *                           by '/'. A leading '/' is ignored.
+ *               bpb       - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, INVALID_NAME if a name is too long, or a FAT Error
+ *               Flag from fat_SetDir.
+ *
+ * Notes       : An empty path, or "/", is the root directory. If a name along
+ *               the path is not found, the FatDir instance is left at the
+ *               directory that should have contained it.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_SetDirToPath(FatDir *dir, const char pathStr[], const BPB *bpb)
+{
+  uint8_t err;
+  char    nameStr[LN_STR_LEN_MAX];
+
+  fat_SetDirToRoot(dir, bpb);
+  while (*pathStr)
   {
-    // if entry is not a directory entry, get next entry
-    if (!(ent.snEnt[ATTR_BYTE_OFFSET] & DIR_ENTRY_ATTR))
-      continue;
+    uint8_t len = 0;
 
-    // if entry matches newDirStr 
-    if (!strcmp(ent.lnStr, newDirStr))
-    {
-      // get value of the first cluster index in the FAT for that entry.
-      dir->fstClusIndx = ent.snEnt[FST_CLUS_INDX_BYTE_OFFSET_3];
-      dir->fstClusIndx <<= 8;
-      dir->fstClusIndx |= ent.snEnt[FST_CLUS_INDX_BYTE_OFFSET_2];
-      dir->fstClusIndx <<= 8;
-      dir->fstClusIndx |= ent.snEnt[FST_CLUS_INDX_BYTE_OFFSET_1];
-      dir->fstClusIndx <<= 8;
-      dir->fstClusIndx |= ent.snEnt[FST_CLUS_INDX_BYTE_OFFSET_0];
-      
-      // fill short name array with its characters from the entry
-      char snStr[SN_NAME_CHAR_LEN + 1] = {'\0'};      
-      for (uint8_t strPos = 0; strPos < SN_NAME_CHAR_LEN; ++strPos)
-        snStr[strPos] = ent.snEnt[strPos];
-
-      // Append current directory name to the short and long name paths
-      strcat (dir->lnPathStr, dir->lnStr);
-      strcat (dir->snPathStr, dir->snStr);
-
-      // Update dir to new dir name. If current dir != root dir append '/'
-      if (strcmp(dir->lnStr, "/"))
-        strcat(dir->lnPathStr, "/"); 
-      strcpy(dir->lnStr, newDirStr);
-      
-      if (strcmp(dir->snStr, "/"))
-        strcat(dir->snPathStr, "/");
-      strcpy(dir->snStr, snStr);
+    while (*pathStr == '/')
+      ++pathStr;
+    while (pathStr[len] && pathStr[len] != '/')
+      if (++len >= LN_STR_LEN_MAX)
+        return INVALID_NAME;
+    if (len == 0)
+      break;
 
-      return SUCCESS;
-    }
+    memcpy(nameStr, pathStr, len);
+    nameStr[len] = '\0';
+    if ((err = fat_SetDir(dir, nameStr, bpb)) != SUCCESS)
+      return err;
+    pathStr += len;
   }
-  // No matching entry found. FatDir is unchanged.
-  return err;
+  return SUCCESS;
 }
 
 /*
@@ -425,114 +331,1223 @@ uint8_t fat_SetDir(FatDir *dir, const char newDirStr[], const BPB *bpb)
  *                  Once for the long name and once for the short name.
  * ----------------------------------------------------------------------------
  */
-uint8_t fat_PrintDir(const FatDir *dir, uint8_t entFlds, const BPB *bpb)
+uint8_t fat_PrintDir(const FatDir *dir, uint8_t entFlds, const BPB *bpb)
+{
+  // for function return errors. This is the loop cond. and the return value.
+  uint8_t err;
+
+  // 
+  // Create and initialize a FatEntry instance. This will set the snEntClusIndx
+  // member to the root directory and all other members to 0 or null strings, 
+  // then update the snEntClusIndx to point to the first cluster index of the 
+  // FatDir instance (dir).
+  //
+  FatEntry ent;
+  fat_InitEntry(&ent, bpb);
+  ent.snEntClusIndx = dir->fstClusIndx;
+
+  // 
+  // set the ent FatEntry instance to the next entry in the directory, then 
+  // print the entry and fields according to entFlds. After all entries in the
+  // dir have been loaded, fat_SetNextEntry will return END_OF_DIRECTORY.
+  //
+  while ((err = fat_SetNextEntry(&ent, bpb)) == SUCCESS)
+    pvt_PrintEntry(&ent, entFlds);
+
+  // return END_OF_DIRECTORY if successful. Any other value returned is error.
+  return err;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                  INITIALIZE DIRECTORY CURSOR
+ *
+ * Description : Sets a FatDirCursor instance to the first entry of a
+ *               directory.
+ *
+ * Arguments   : cur   - Pointer to the FatDirCursor instance to be set.
+ *               dir   - Pointer to a FatDir instance of the directory.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void fat_InitDirCursor(FatDirCursor *cur, const FatDir *dir)
+{
+  cur->clusIndx = dir->fstClusIndx;
+  cur->secNumInClus = 0;
+  cur->entPos = 0;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                            CURSOR TO ENTRY / ENTRY TO CURSOR
+ *
+ * Description : fat_SetEntryToCursor sets a FatEntry instance so the next
+ *               call of fat_SetNextEntry, or fat_StepNextEntry, finds the
+ *               first entry after a cursor. fat_SetCursorToEntry sets a
+ *               cursor to the position after the entry a FatEntry instance
+ *               was last set to.
+ *
+ * Arguments   : ent   - Pointer to a FatEntry instance.
+ *               cur   - Pointer to a FatDirCursor instance.
+ *               bpb   - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, or CORRUPT_FAT_ENTRY if the cursor is not a position
+ *               between the entries of a cluster, in which case the FatEntry
+ *               instance is not changed.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_SetEntryToCursor(FatEntry *ent, const FatDirCursor *cur,
+                             const BPB *bpb)
+{
+  // the cursor may come from a client, so it must be checked.
+  if (cur->clusIndx < 2 || cur->secNumInClus >= BPB_SEC_PER_CLUS(bpb)
+      || cur->entPos > BPB_BYTES_PER_SEC(bpb) || cur->entPos % ENTRY_LEN)
+    return CORRUPT_FAT_ENTRY;
+
+  fat_InitEntry(ent, bpb);
+  ent->snEntClusIndx = cur->clusIndx;
+  ent->snEntSecNumInClus = cur->secNumInClus;
+  ent->nextEntPos = cur->entPos;
+  return SUCCESS;
+}
+
+void fat_SetCursorToEntry(FatDirCursor *cur, const FatEntry *ent)
+{
+  cur->clusIndx = ent->snEntClusIndx;
+  cur->secNumInClus = ent->snEntSecNumInClus;
+  cur->entPos = ent->nextEntPos;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                  PRINT A PAGE OF A DIRECTORY
+ *
+ * Description : Prints the entries of a directory after a cursor, as
+ *               fat_PrintDir, until entCnt entries are printed or the end of
+ *               the directory is reached, and moves the cursor past the last
+ *               entry printed.
+ *
+ * Arguments   : cur       - Pointer to a FatDirCursor instance.
+ *               entFlds   - Any combination of the FAT ENTRY FIELD FLAGS, as
+ *                           for fat_PrintDir.
+ *               entCnt    - Most entries to print.
+ *               bpb       - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS if entCnt entries were printed, END_OF_DIRECTORY if
+ *               the end of the directory was reached, or another FAT Error
+ *               Flag, e.g. CORRUPT_FAT_ENTRY if the cursor is not valid. The
+ *               cursor is only moved on SUCCESS or END_OF_DIRECTORY.
+ *
+ * Notes       : Entries that entFlds does not print, e.g. hidden entries, are
+ *               passed over and not counted. The sectors read are those of
+ *               the page only, whatever the position of the cursor.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_PrintDirPage(FatDirCursor *cur, uint8_t entFlds, uint16_t entCnt,
+                         const BPB *bpb)
+{
+  uint8_t  err;
+  FatEntry ent;
+
+  if ((err = fat_SetEntryToCursor(&ent, cur, bpb)) != SUCCESS)
+    return err;
+
+  // the cursor is moved past each entry printed, so it ends after the last.
+  while (entCnt && (err = fat_SetNextEntry(&ent, bpb)) == SUCCESS)
+    if (pvt_PrintEntry(&ent, entFlds))
+    {
+      fat_SetCursorToEntry(cur, &ent);
+      --entCnt;
+    }
+
+  // at the end of the directory, the cursor is moved past any entries that
+  // were passed over, so the next page does not read them again.
+  if (err == END_OF_DIRECTORY)
+    fat_SetCursorToEntry(cur, &ent);
+  return err;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                               PACK / UNPACK DIRECTORY CURSOR
+ *
+ * Description : fat_PackCursor stores a FatDirCursor in DIR_CURSOR_LEN bytes,
+ *               e.g. to be sent to a client that is paging through a
+ *               directory, and fat_UnpackCursor sets a FatDirCursor from
+ *               those bytes.
+ *
+ * Arguments   : cur      - Pointer to the FatDirCursor instance.
+ *               curArr   - Pointer to an array of DIR_CURSOR_LEN bytes.
+ *
+ * Returns     : void
+ *
+ * Notes       : The cluster index and entry position are stored little
+ *               endian, with the sector number between them.
+ * ----------------------------------------------------------------------------
+ */
+void fat_PackCursor(const FatDirCursor *cur, uint8_t curArr[])
+{
+  curArr[0] = cur->clusIndx;
+  curArr[1] = cur->clusIndx >> 8;
+  curArr[2] = cur->clusIndx >> 16;
+  curArr[3] = cur->clusIndx >> 24;
+  curArr[4] = cur->secNumInClus;
+  curArr[5] = cur->entPos;
+  curArr[6] = cur->entPos >> 8;
+}
+
+void fat_UnpackCursor(FatDirCursor *cur, const uint8_t curArr[])
+{
+  cur->clusIndx = LOAD_LE32(curArr);
+  cur->secNumInClus = curArr[4];
+  cur->entPos = LOAD_LE16(&curArr[5]);
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                         PRINT FILE TO SCREEN
+ *                                       
+ * Description : Prints the contents of any file entry to the screen. 
+ * 
+ * Arguments   : dir        - Pointer to a FatDir instance. This directory must
+ *                            contain the entry for the file to be printed.
+ *               fileStr    - Pointer to a string. This is the name of the file
+ *                            who's contents will be printed.
+ *               bpb        - Pointer to the BPB struct instance.
+ *
+ * Returns     : FAT Error Flag. If any value other than END_OF_FILE is 
+ *               returned, then an issue has occurred.
+ *  
+ * Notes       : fileStr must be a long name unless a long name for a given
+ *               entry does not exist, in which case it must be a short name.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_PrintFile(const FatDir *dir, const char fileStr[], const BPB *bpb)
+{
+  // for function return errors. This is the loop cond. and the return value.
+  uint8_t err;
+    
+  if (pvt_CheckName(fileStr) == INVALID_NAME)
+    return INVALID_NAME;
+
+  // 
+  // Search for a file matching fileStr in the current directory. Once a
+  // match is found then the "private" function, pvt_PrintFile() is called to
+  // print this file. A search that misses fills the directory's negative
+  // lookup filter, as in fat_OpenFile.
+  //
+  FatLookupStep lk;
+  fat_InitLookupStep(&lk, dir, fileStr, 0, bpb);
+  while ((err = fat_StepLookup(&lk, bpb)) == STEP_BUSY)
+    ;
+  if (err == FILE_NOT_FOUND)
+    return END_OF_DIRECTORY;                // no matching file was found.
+  if (err != SUCCESS)
+    return err;
+
+  print_Str("\n\n\r");
+  return pvt_PrintFile(&lk.ent.info, bpb);  //END_OF_FILE or FAILED_READ_SECTOR
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                    OPEN FILE
+ *
+ * Description : Sets a FatFile instance to the file entry specified by fileStr
+ *               and positions it at the first byte of the file.
+ *
+ * Arguments   : file       - Pointer to the FatFile instance to be set.
+ *               dir        - Pointer to a FatDir instance. This directory must
+ *                            contain the entry for the file to be opened.
+ *               fileStr    - Pointer to a string. This is the name of the file
+ *                            to be opened.
+ *               bpb        - Pointer to the BPB struct instance.
+ *
+ * Returns     : A FAT Error Flag. If any value other than SUCCESS is returned
+ *               then the FatFile instance was not set. FILE_NOT_FOUND is
+ *               returned if the directory does not contain fileStr.
+ *
+ * Notes       : fileStr must be a long name unless a long name for a given
+ *               entry does not exist, in which case it must be a short name.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_OpenFile(FatFile *file, const FatDir *dir, const char fileStr[],
+                     const BPB *bpb)
+{
+  // for function return errors. This is the loop cond. and the return value.
+  uint8_t err;
+
+  if (pvt_CheckName(fileStr) == INVALID_NAME)
+    return INVALID_NAME;
+
+  // search dir for a file entry matching fileStr.
+  FatLookupStep lk;
+  fat_InitLookupStep(&lk, dir, fileStr, 0, bpb);
+  while ((err = fat_StepLookup(&lk, bpb)) == STEP_BUSY)
+    ;
+  if (err != SUCCESS)
+    return err;
+
+  // get value of the first cluster index in the FAT for that entry.
+  file->fstClusIndx = lk.ent.info.fstClusIndx;
+  file->fileSize = lk.ent.info.fileSize;
+
+  // position at the first byte of the file.
+  file->currPos = 0;
+  file->currClusIndx = file->fstClusIndx;
+  file->currClusNum = 0;
+
+  // location of the short name entry, needed to update the entry.
+  file->entClusIndx = lk.ent.snEntClusIndx;
+  file->entSecNumInClus = lk.ent.snEntSecNumInClus;
+  file->entPos = lk.ent.nextEntPos - ENTRY_LEN;
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                    SEEK FILE
+ *
+ * Description : Sets the byte position in the file of the next read.
+ *
+ * Arguments   : file   - Pointer to a FatFile instance set by fat_OpenFile.
+ *               pos    - Byte position in the file.
+ *               bpb    - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, or END_OF_FILE if pos is beyond the end of the file,
+ *               in which case the file position is unchanged.
+ *
+ * Notes       : No sectors are read here. The cluster chain is followed to
+ *               the new position by the next call to fat_ReadFile.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_SeekFile(FatFile *file, uint32_t pos, const BPB *bpb)
+{
+  if (pos > file->fileSize)
+    return END_OF_FILE;
+
+  file->currPos = pos;
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                    READ FILE
+ *
+ * Description : Reads bytes from the file's current position into an array
+ *               and advances the position by the number of bytes read.
+ *
+ * Arguments   : file      - Pointer to a FatFile instance set by fat_OpenFile.
+ *               dataArr   - Pointer to the array that will be loaded with the
+ *                           bytes read from the file.
+ *               len       - Number of bytes to read.
+ *               bpb       - Pointer to the BPB struct instance.
+ *
+ * Returns     : A FAT Error Flag. SUCCESS if len bytes were read. END_OF_FILE
+ *               if the end of the file was reached first, in which case the
+ *               bytes up to the end of the file were still loaded. The number
+ *               of bytes read can be found from the change in file->currPos.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_ReadFile(FatFile *file, uint8_t dataArr[], uint16_t len,
+                     const BPB *bpb)
+{
+  uint8_t err;
+
+  FatReadStep rd;
+  fat_InitReadStep(&rd, file, dataArr, len);
+  while ((err = fat_StepReadFile(&rd, bpb)) == STEP_BUSY)
+    ;
+  return err;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            READ FILE SECTORS
+ *
+ * Description : Reads every sector of a file that holds file bytes, in order,
+ *               and passes each one to secFn. Runs of consecutive clusters are
+ *               read with a single multiple sector read from the disk.
+ *
+ * Arguments   : file      - Pointer to a FatFile instance set by fat_OpenFile.
+ *               secFn     - Function each sector is passed to. If it returns
+ *                           a non-zero value, no more sectors are read.
+ *               arg       - Pointer passed to secFn with each sector.
+ *               bpb       - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, FAILED_READ_SECTOR, or CORRUPT_FAT_ENTRY if the
+ *               cluster chain ends before the end of the file.
+ *
+ * Notes       : 1) Only the first fileSize % bytesPerSec bytes of the last
+ *                  sector are file bytes, unless that value is 0.
+ *               2) The file's position is not used or changed.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_ReadFileSectors(const FatFile *file, FatSectorFn secFn, void *arg,
+                            const BPB *bpb)
+{
+  // sectors holding file bytes that have not yet been passed to secFn
+  uint32_t secCnt = BPB_POS_TO_SEC_CNT(bpb, file->fileSize
+                                           + BPB_BYTES_PER_SEC(bpb) - 1);
+
+  //
+  // secFn is called through pvt_CountSector so that reading stops at the
+  // last sector of the file, and so a stop by secFn ends every later run.
+  //
+  struct SecCounter counter = { secFn, arg, secCnt, 0 };
+  uint8_t  err;
+  uint8_t  secArr[BPB_BYTES_PER_SEC(bpb)];
+  uint32_t clusIndx = file->fstClusIndx;
+
+  while (counter.secsLeft && !counter.stopped)
+  {
+    if (clusIndx == END_CLUSTER)
+      return CORRUPT_FAT_ENTRY;
+
+    // extend the run while the next cluster in the chain is the next on disk.
+    uint32_t runFstClusIndx = clusIndx;
+    uint32_t runSecCnt = BPB_SEC_PER_CLUS(bpb);
+    while (runSecCnt < counter.secsLeft)
+    {
+      if ((err = pvt_GetNextClusIndex(&clusIndx, bpb)) != SUCCESS)
+        return err;
+      if (clusIndx != runFstClusIndx 
+                      + (runSecCnt >> BPB_SEC_PER_CLUS_SHIFT(bpb)))
+        break;
+      runSecCnt += BPB_SEC_PER_CLUS(bpb);
+    }
+    if (runSecCnt >= counter.secsLeft)
+      runSecCnt = counter.secsLeft;
+
+    uint32_t secNumOnDisk = BPB_CLUS_TO_SEC(bpb, runFstClusIndx);
+
+    // the run is read around the sector cache, so it must be written first.
+    if ((err = fat_CacheSyncRange(secNumOnDisk, runSecCnt)) != SUCCESS)
+      return err;
+    if (FATtoDisk_ReadMultipleSectors(secNumOnDisk, runSecCnt, secArr,
+                                      pvt_CountSector, &counter)
+        == FAILED_READ_SECTOR)
+      return FAILED_READ_SECTOR;
+  }
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                  STREAM FILE
+ *
+ * Description : Passes len bytes of a file, from pos, to a sink function a
+ *               span at a time, without copying them into an array first.
+ *               Each span is the bytes of the range in one sector.
+ *
+ * Arguments   : file      - Pointer to a FatFile instance set by fat_OpenFile.
+ *               pos       - Byte position in the file of the first byte.
+ *               len       - Number of bytes to pass.
+ *               sinkFn    - Function the spans are passed to.
+ *               arg       - Pointer passed to sinkFn with each span.
+ *               bpb       - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS if sinkFn took all len bytes. END_OF_FILE if the end
+ *               of the file was reached first, or pos is beyond it. STEP_BUSY
+ *               if sinkFn took fewer bytes than it was passed. Otherwise
+ *               FAILED_READ_SECTOR, FAILED_WRITE_SECTOR or CORRUPT_FAT_ENTRY.
+ *
+ * Notes       : 1) The file's position is left after the last byte taken by
+ *                  sinkFn, so after STEP_BUSY the stream is continued by
+ *                  calling this again with pos set to file->currPos and len
+ *                  reduced by the bytes already taken.
+ *               2) A sector held in the sector cache is passed from the
+ *                  cache. Runs of sectors that are not are read with a single
+ *                  multiple sector read, and each sector is passed from the
+ *                  disk driver's array as it is read, so they do not take the
+ *                  place of the FAT and directory sectors in the cache.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_StreamFile(FatFile *file, uint32_t pos, uint32_t len,
+                       FatSinkFn sinkFn, void *arg, const BPB *bpb)
+{
+  uint8_t err;
+
+  if ((err = fat_SeekFile(file, pos, bpb)) != SUCCESS)
+    return err;
+
+  struct StreamSink sink = { file, len, sinkFn, arg, bpb, 0 };
+
+  // each pass of the loop passes a sector from the cache, or a run of them
+  // from the disk.
+  while (sink.len)
+  {
+    if (file->currPos >= file->fileSize)
+      return END_OF_FILE;
+
+    // follow the cluster chain to the cluster holding currPos
+    if ((err = pvt_SetFileClus(file, bpb)) != SUCCESS)
+      return err;
+
+    uint32_t secNumOnDisk = BPB_SEC_IN_CLUS(bpb, file->currPos)
+                          + BPB_CLUS_TO_SEC(bpb, file->currClusIndx);
+    const uint8_t *cachedArr = fat_CachePeek(secNumOnDisk);
+    if (cachedArr)
+      pvt_SinkSector(cachedArr, &sink);
+    else
+    {
+      // the run ends at the sector of the last byte of the range.
+      uint32_t endPos = file->fileSize - file->currPos < sink.len
+                      ? file->fileSize : file->currPos + sink.len;
+      uint32_t numOfSecs = BPB_POS_TO_SEC_CNT(bpb, endPos - 1)
+                         - BPB_POS_TO_SEC_CNT(bpb, file->currPos) + 1;
+      if ((err = fat_GetFileRun(file, &secNumOnDisk, &numOfSecs, numOfSecs,
+                                bpb)) != SUCCESS)
+        return err;
+
+      // the run is read around the sector cache, so it must be written first.
+      if ((err = fat_CacheSyncRange(secNumOnDisk, numOfSecs)) != SUCCESS)
+        return err;
+      uint8_t secArr[BPB_BYTES_PER_SEC(bpb)];
+      if (FATtoDisk_ReadMultipleSectors(secNumOnDisk, numOfSecs, secArr,
+                                        pvt_SinkSector, &sink)
+          == FAILED_READ_SECTOR)
+        return FAILED_READ_SECTOR;
+    }
+    if (sink.stopped)
+      return STEP_BUSY;
+  }
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                   WRITE FILE
+ *
+ * Description : Writes bytes from an array to the file's current position and
+ *               advances the position by the number of bytes written.
+ *
+ * Arguments   : file      - Pointer to a FatFile instance set by fat_OpenFile.
+ *               dataArr   - Pointer to the array holding the bytes that will
+ *                           be written to the file.
+ *               len       - Number of bytes to write.
+ *               bpb       - Pointer to the BPB struct instance.
+ *
+ * Returns     : A FAT Error Flag. SUCCESS if len bytes were written.
+ *               END_OF_FILE if the end of the file was reached first, in which
+ *               case the bytes up to the end of the file were still written.
+ *
+ * Notes       : 1) The file is never extended. Only bytes that already exist
+ *                  in the file, i.e. before fileSize, can be overwritten.
+ *               2) A sector that is only partially written is first read so
+ *                  the rest of its bytes are kept. A sector that is written
+ *                  entirely is not read.
+ *               3) The sectors are written to the sector cache of FAT_CACHE.H.
+ *                  They reach the disk when the cache is flushed, e.g. by
+ *                  fat_Sync.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_WriteFile(FatFile *file, const uint8_t dataArr[], uint16_t len,
+                      const BPB *bpb)
+{
+  uint8_t err;
+
+  // each pass of the loop writes the bytes that go to a single sector.
+  while (len)
+  {
+    if (file->currPos >= file->fileSize)
+      return END_OF_FILE;
+
+    // follow the cluster chain to the cluster holding currPos
+    if ((err = pvt_SetFileClus(file, bpb)) != SUCCESS)
+      return err;
+
+    // calculate location of the sector holding currPos on the disk
+    uint32_t secNumOnDisk = BPB_SEC_IN_CLUS(bpb, file->currPos)
+                          + BPB_CLUS_TO_SEC(bpb, file->currClusIndx);
+
+    // number of bytes to write to this sector. Same limits as fat_ReadFile.
+    uint16_t bytePos = BPB_POS_IN_SEC(bpb, file->currPos);
+    uint16_t byteCnt = BPB_BYTES_PER_SEC(bpb) - bytePos;
+    if (byteCnt > len)
+      byteCnt = len;
+    if (byteCnt > file->fileSize - file->currPos)
+      byteCnt = file->fileSize - file->currPos;
+
+    // keep the bytes of the sector that are not being written.
+    uint8_t secArr[BPB_BYTES_PER_SEC(bpb)];
+    if (byteCnt < BPB_BYTES_PER_SEC(bpb) 
+        && (err = fat_CacheRead(secNumOnDisk, secArr, CACHE_DATA)) != SUCCESS)
+      return err;
+
+    memcpy(&secArr[bytePos], dataArr, byteCnt);
+    if ((err = fat_CacheWrite(secNumOnDisk, secArr, CACHE_DATA)) != SUCCESS)
+      return err;
+
+    dataArr += byteCnt;
+    len -= byteCnt;
+    file->currPos += byteCnt;
+  }
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                          GET FILE SECTOR RUN
+ *
+ * Description : Finds the run of consecutive sectors on the disk that starts
+ *               with the sector holding the file's current position, i.e. the
+ *               sectors that can be transferred with a single multiple sector
+ *               read or write.
+ *
+ * Arguments   : file        - Pointer to a FatFile instance set by
+ *                             fat_OpenFile.
+ *               secNum      - Pointer to a variable set to the disk sector of
+ *                             the first sector of the run.
+ *               numOfSecs   - Pointer to a variable set to the number of
+ *                             sectors in the run.
+ *               secsMax     - Largest number of sectors the run can have.
+ *               bpb         - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, END_OF_FILE if the position is at or beyond the end
+ *               of the file, CORRUPT_FAT_ENTRY if the cluster chain ends
+ *               before the position, or FAILED_READ_SECTOR if a FAT sector
+ *               could not be read.
+ *
+ * Notes       : 1) The run ends at the last sector holding file bytes, or
+ *                  where the next cluster in the chain is not the next on the
+ *                  disk.
+ *               2) The file's position is not changed.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_GetFileRun(FatFile *file, uint32_t *secNum, uint32_t *numOfSecs,
+                       uint32_t secsMax, const BPB *bpb)
+{
+  uint8_t err;
+
+  if (file->currPos >= file->fileSize)
+    return END_OF_FILE;
+
+  // follow the cluster chain to the cluster holding currPos
+  if ((err = pvt_SetFileClus(file, bpb)) != SUCCESS)
+    return err;
+
+  uint8_t  secNumInClus = BPB_SEC_IN_CLUS(bpb, file->currPos);
+  *secNum = secNumInClus + BPB_CLUS_TO_SEC(bpb, file->currClusIndx);
+
+  // sectors from the current one to the last one holding file bytes
+  uint32_t secsLeft = BPB_POS_TO_SEC_CNT(bpb, file->fileSize - 1)
+                    - BPB_POS_TO_SEC_CNT(bpb, file->currPos) + 1;
+  if (secsLeft > secsMax)
+    secsLeft = secsMax;
+
+  // extend the run while the next cluster in the chain is the next on disk.
+  uint32_t clusIndx = file->currClusIndx;
+  uint32_t runSecCnt = BPB_SEC_PER_CLUS(bpb) - secNumInClus;
+  while (runSecCnt < secsLeft)
+  {
+    uint32_t nextClusIndx = clusIndx;
+    if ((err = pvt_GetNextClusIndex(&nextClusIndx, bpb)) != SUCCESS)
+      return err;
+    if (nextClusIndx != clusIndx + 1)
+      break;
+    clusIndx = nextClusIndx;
+    runSecCnt += BPB_SEC_PER_CLUS(bpb);
+  }
+  *numOfSecs = (runSecCnt < secsLeft) ? runSecCnt : secsLeft;
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                               SET FILE ENTRY
+ *
+ * Description : Sets the first cluster index and file size fields of a file's
+ *               short name entry, and of the FatFile instance, to the values
+ *               passed in.
+ *
+ * Arguments   : file          - Pointer to a FatFile instance set by
+ *                               fat_OpenFile.
+ *               fstClusIndx   - New index of the file's first cluster.
+ *               fileSize      - New file size in bytes.
+ *               bpb           - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, FAILED_READ_SECTOR or FAILED_WRITE_SECTOR.
+ *
+ * Notes       : The FAT is not modified, so the new first cluster must be the
+ *               start of a cluster chain that is not used by another entry.
+ *               The file is repositioned to its first byte.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_SetFileEntry(FatFile *file, uint32_t fstClusIndx,
+                         uint32_t fileSize, const BPB *bpb)
+{
+  uint32_t secNumOnDisk = file->entSecNumInClus
+                        + BPB_CLUS_TO_SEC(bpb, file->entClusIndx);
+
+  uint8_t err;
+  uint8_t secArr[BPB_BYTES_PER_SEC(bpb)];
+  if ((err = fat_CacheRead(secNumOnDisk, secArr, CACHE_DIR)) != SUCCESS)
+    return err;
+
+  pvt_SetEntClusSize(secArr, file->entPos, fstClusIndx, fileSize);
+  if ((err = fat_CacheWrite(secNumOnDisk, secArr, CACHE_DIR)) != SUCCESS)
+    return err;
+
+  file->fstClusIndx = fstClusIndx;
+  file->fileSize = fileSize;
+  file->currPos = 0;
+  file->currClusIndx = fstClusIndx;
+  file->currClusNum = 0;
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                   SWAP FILES
+ *
+ * Description : Exchanges the contents of two files by swapping the first
+ *               cluster index and file size fields of their short name
+ *               entries. The FatFile instances are swapped to match, so each
+ *               still corresponds to the same name.
+ *
+ * Arguments   : fileA   - Pointer to a FatFile instance set by fat_OpenFile.
+ *               fileB   - Pointer to a FatFile instance set by fat_OpenFile.
+ *               bpb     - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, FAILED_READ_SECTOR or FAILED_WRITE_SECTOR.
+ *
+ * Notes       : 1) If both entries are in the same sector, the swap is a
+ *                  single sector write. Otherwise fileA's entry is written
+ *                  first, and if the second write does not happen both
+ *                  entries will point to fileB's original clusters.
+ *               2) Both files are repositioned to their first byte.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_SwapFiles(FatFile *fileA, FatFile *fileB, const BPB *bpb)
+{
+  uint8_t  err;
+  uint32_t fstClusIndxA = fileA->fstClusIndx;
+  uint32_t fileSizeA = fileA->fileSize;
+
+  // entries in different sectors must be written one at a time.
+  if (fileA->entClusIndx != fileB->entClusIndx
+      || fileA->entSecNumInClus != fileB->entSecNumInClus)
+  {
+    if ((err = fat_SetFileEntry(fileA, fileB->fstClusIndx, fileB->fileSize,
+                                bpb)) != SUCCESS)
+      return err;
+    return fat_SetFileEntry(fileB, fstClusIndxA, fileSizeA, bpb);
+  }
+
+  uint32_t secNumOnDisk = fileA->entSecNumInClus
+                        + BPB_CLUS_TO_SEC(bpb, fileA->entClusIndx);
+
+  uint8_t secArr[BPB_BYTES_PER_SEC(bpb)];
+  if ((err = fat_CacheRead(secNumOnDisk, secArr, CACHE_DIR)) != SUCCESS)
+    return err;
+
+  pvt_SetEntClusSize(secArr, fileA->entPos, fileB->fstClusIndx,
+                     fileB->fileSize);
+  pvt_SetEntClusSize(secArr, fileB->entPos, fstClusIndxA, fileSizeA);
+  if ((err = fat_CacheWrite(secNumOnDisk, secArr, CACHE_DIR)) != SUCCESS)
+    return err;
+
+  fileA->fstClusIndx = fileB->fstClusIndx;
+  fileA->fileSize = fileB->fileSize;
+  fileB->fstClusIndx = fstClusIndxA;
+  fileB->fileSize = fileSizeA;
+
+  // position both at the first byte of the file.
+  fileA->currPos = 0;
+  fileA->currClusIndx = fileA->fstClusIndx;
+  fileA->currClusNum = 0;
+  fileB->currPos = 0;
+  fileB->currClusIndx = fileB->fstClusIndx;
+  fileB->currClusNum = 0;
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                          SET ENTRY REFERENCE
+ *
+ * Description : Sets a FatEntryRef instance to the short name entry of a
+ *               FatEntry instance.
+ *
+ * Arguments   : ref   - Pointer to the FatEntryRef instance to be set.
+ *               ent   - Pointer to a FatEntry instance set to an entry, e.g.
+ *                       by fat_SetNextEntry.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void fat_SetEntryRef(FatEntryRef *ref, const FatEntry *ent)
+{
+  ref->clusIndx = ent->snEntClusIndx;
+  ref->secNumInClus = ent->snEntSecNumInClus;
+  ref->slot = (ent->nextEntPos - ENTRY_LEN) / ENTRY_LEN;
+  ref->snChkSum = pvt_SnChkSum(ent->snEnt);
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                     GET FILE ENTRY REFERENCE
+ *
+ * Description : Sets a FatEntryRef instance to the short name entry of an
+ *               open file.
+ *
+ * Arguments   : file   - Pointer to a FatFile instance set by fat_OpenFile or
+ *                        fat_OpenRef.
+ *               ref    - Pointer to the FatEntryRef instance to be set.
+ *               bpb    - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS or FAILED_READ_SECTOR.
+ *
+ * Notes       : The entry's sector is read, from the cache if it is held, for
+ *               the short name.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_GetFileRef(const FatFile *file, FatEntryRef *ref,
+                       const BPB *bpb)
+{
+  uint32_t secNumOnDisk = file->entSecNumInClus
+                        + BPB_CLUS_TO_SEC(bpb, file->entClusIndx);
+
+  uint8_t err;
+  uint8_t secArr[BPB_BYTES_PER_SEC(bpb)];
+  if ((err = fat_CacheRead(secNumOnDisk, secArr, CACHE_DIR)) != SUCCESS)
+    return err;
+
+  ref->clusIndx = file->entClusIndx;
+  ref->secNumInClus = file->entSecNumInClus;
+  ref->slot = file->entPos / ENTRY_LEN;
+  ref->snChkSum = pvt_SnChkSum(&secArr[file->entPos]);
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                       OPEN FILE BY REFERENCE
+ *
+ * Description : Sets a FatFile instance to the file at a FatEntryRef, and
+ *               positions it at the first byte of the file, as fat_OpenFile,
+ *               but by reading only the sector of the file's entry.
+ *
+ * Arguments   : file   - Pointer to the FatFile instance to be set.
+ *               ref    - Pointer to a FatEntryRef instance.
+ *               bpb    - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, FAILED_READ_SECTOR, or FILE_NOT_FOUND if the entry at
+ *               the reference is not a file entry, or the checksum of its
+ *               short name does not match, i.e. the reference is stale. The
+ *               FatFile instance is only set on SUCCESS.
+ *
+ * Notes       : A file whose reference is stale should be opened again with
+ *               fat_OpenFile, and its reference renewed.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_OpenRef(FatFile *file, const FatEntryRef *ref, const BPB *bpb)
+{
+  uint16_t entPos = (uint16_t)ref->slot * ENTRY_LEN;
+
+  // a reference that is not within a cluster of the data region is stale.
+  if (ref->clusIndx < 2 || ref->secNumInClus >= BPB_SEC_PER_CLUS(bpb)
+      || entPos >= BPB_BYTES_PER_SEC(bpb))
+    return FILE_NOT_FOUND;
+
+  uint32_t secNumOnDisk = ref->secNumInClus
+                        + BPB_CLUS_TO_SEC(bpb, ref->clusIndx);
+
+  uint8_t err;
+  uint8_t secArr[BPB_BYTES_PER_SEC(bpb)];
+  if ((err = fat_CacheRead(secNumOnDisk, secArr, CACHE_DIR)) != SUCCESS)
+    return err;
+
+  //
+  // the entry must still be a file's short name entry, i.e. not free,
+  // deleted, a long name, directory or volume ID, and have the same name.
+  //
+  const uint8_t *snEnt = &secArr[entPos];
+  if (snEnt[0] == 0 || snEnt[0] == DELETED_ENTRY_TOKEN
+      || snEnt[ATTR_BYTE_OFFSET] & (DIR_ENTRY_ATTR | VOLUME_ID_ATTR)
+      || pvt_SnChkSum(snEnt) != ref->snChkSum)
+    return FILE_NOT_FOUND;
+
+  FatEntryInfo info;
+  pvt_DecodeEntry(&info, snEnt);
+  file->fstClusIndx = info.fstClusIndx;
+  file->fileSize = info.fileSize;
+
+  // position at the first byte of the file.
+  file->currPos = 0;
+  file->currClusIndx = file->fstClusIndx;
+  file->currClusNum = 0;
+
+  // location of the short name entry, needed to update the entry.
+  file->entClusIndx = ref->clusIndx;
+  file->entSecNumInClus = ref->secNumInClus;
+  file->entPos = entPos;
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                PACK / UNPACK ENTRY REFERENCE
+ *
+ * Description : fat_PackRef stores a FatEntryRef in ENTRY_REF_LEN bytes, e.g.
+ *               to be saved to EEPROM or a file, and fat_UnpackRef sets a
+ *               FatEntryRef from those bytes.
+ *
+ * Arguments   : ref      - Pointer to the FatEntryRef instance.
+ *               refArr   - Pointer to an array of ENTRY_REF_LEN bytes.
+ *
+ * Returns     : void
+ *
+ * Notes       : The cluster index is stored little endian, followed by the
+ *               sector number, slot and checksum, so the bytes can be read
+ *               on any machine.
+ * ----------------------------------------------------------------------------
+ */
+void fat_PackRef(const FatEntryRef *ref, uint8_t refArr[])
+{
+  refArr[0] = ref->clusIndx;
+  refArr[1] = ref->clusIndx >> 8;
+  refArr[2] = ref->clusIndx >> 16;
+  refArr[3] = ref->clusIndx >> 24;
+  refArr[4] = ref->secNumInClus;
+  refArr[5] = ref->slot;
+  refArr[6] = ref->snChkSum;
+}
+
+void fat_UnpackRef(FatEntryRef *ref, const uint8_t refArr[])
+{
+  ref->clusIndx = LOAD_LE32(refArr);
+  ref->secNumInClus = refArr[4];
+  ref->slot = refArr[5];
+  ref->snChkSum = refArr[6];
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                    INITIALIZE DIRECTORY STEP
+ *
+ * Description : Sets a FatDirStep instance to search for the entries of a
+ *               directory that follow the entry of a FatEntry instance.
+ *
+ * Arguments   : step    - Pointer to the FatDirStep instance to be set.
+ *               ent     - Pointer to a FatEntry instance. Its members will be
+ *                         updated to each entry found by fat_StepNextEntry.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void fat_InitDirStep(FatDirStep *step, FatEntry *ent)
+{
+  step->ent = ent;
+  step->clusIndx = ent->snEntClusIndx;
+  step->secNumInClus = ent->snEntSecNumInClus;
+  step->entPos = ent->nextEntPos;
+  step->snPos = NO_SPAN;
+  step->state = DIR_STEP_READ_SEC;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                       STEP TO THE NEXT ENTRY
+ *
+ * Description : Performs the next step of a search for the next entry of a
+ *               directory. Each step reads at most one sector from the disk.
+ *
+ * Arguments   : step    - Pointer to a FatDirStep instance set by
+ *                         fat_InitDirStep.
+ *               bpb     - Pointer to the BPB struct instance.
+ *
+ * Returns     : STEP_BUSY if the search is not complete. SUCCESS if the next
+ *               entry was found, in which case step->ent has been updated to
+ *               it, and the next call will search for the entry after it.
+ *               Otherwise a FAT Error Flag, e.g. END_OF_DIRECTORY.
+ *
+ * Notes       : fat_SetNextEntry is the blocking form of this function.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_StepNextEntry(FatDirStep *step, const BPB *bpb)
+{
+  uint8_t err;
+
+  // the sector of the entry following the previous one may be the next one.
+  if (step->entPos >= BPB_BYTES_PER_SEC(bpb))
+    pvt_StepToNextSec(step, bpb);
+
+  if (step->state == DIR_STEP_NEXT_CLUS)
+  {
+    uint32_t nextClusIndx = step->clusIndx;
+    if ((err = pvt_GetNextClusIndex(&nextClusIndx, bpb)) != SUCCESS)
+      return err;
+
+    // a long name with no short name following it is corrupt.
+    if (nextClusIndx == END_CLUSTER)
+      return step->snPos == NO_SPAN ? END_OF_DIRECTORY : CORRUPT_FAT_ENTRY;
+
+    step->clusIndx = nextClusIndx;
+    step->secNumInClus = FIRST_SEC_POS_IN_CLUS;
+    step->state = DIR_STEP_READ_SEC;
+    return STEP_BUSY;
+  }
+
+  if (step->state == DIR_STEP_READ_SEC)
+  {
+    // calculate location of sector on the disk
+    uint32_t secNumOnDisk = step->secNumInClus
+                          + BPB_CLUS_TO_SEC(bpb, step->clusIndx);
+
+    if ((err = fat_CacheRead(secNumOnDisk, step->secArr, CACHE_DIR))
+        != SUCCESS)
+      return err;
+    step->state = DIR_STEP_SEARCH_SEC;
+
+    // finish a long name from the previous sector.
+    if (step->snPos != NO_SPAN)
+      return pvt_EndSpanningName(step);
+  }
+
+  // search the entries of the sector, from entPos, for the next entry.
+  const uint8_t *secArr = step->secArr;
+  for (; step->entPos < BPB_BYTES_PER_SEC(bpb); step->entPos += ENTRY_LEN)
+  {
+    uint16_t entPos = step->entPos;
+
+    // if first byte of an entry is 0, remaining entries should be empty
+    if (!secArr[entPos])
+      return END_OF_DIRECTORY;
+
+    if (secArr[entPos] == DELETED_ENTRY_TOKEN)
+      continue;
+
+    // Long name does not exist. Use short name instead.
+    if ((secArr[entPos + ATTR_BYTE_OFFSET] & LN_ATTR_MASK) != LN_ATTR_MASK)
+    {
+      pvt_UpdateFatEntryMembers(step->ent, "", secArr, entPos,
+                                step->secNumInClus, step->clusIndx);
+      step->entPos = step->ent->nextEntPos;
+      return SUCCESS;
+    }
+
+    // entPos must be pointing to the last entry of a long name here.
+    if (!(secArr[entPos] & LN_LAST_ENTRY_FLAG))
+      return CORRUPT_FAT_ENTRY;
+
+    // calculate position of short name relative to first byte in sector
+    uint16_t snPos = entPos + ENTRY_LEN * (LN_ORD_MASK & secArr[entPos]);
+
+    //
+    // if the short name is in the next sector, keep the part of the long name
+    // in this sector and finish it once the next sector has been read.
+    //
+    if (snPos >= BPB_BYTES_PER_SEC(bpb))
+    {
+      // if sn is the first entry of the next sector, the ln is all here.
+      if (snPos == BPB_BYTES_PER_SEC(bpb)
+          && (secArr[LAST_ENTRY_POS_IN_SEC] & LN_ORD_MASK) != 1)
+        return CORRUPT_FAT_ENTRY;
+
+      memset(step->lnStr, 0, LN_STR_LEN_MAX);
+      pvt_LoadLongName(LAST_ENTRY_POS_IN_SEC, entPos, secArr, step->lnStr);
+      step->snPos = snPos - BPB_BYTES_PER_SEC(bpb);
+      pvt_StepToNextSec(step, bpb);
+      return STEP_BUSY;
+    }
+
+    // Verify snPos does not point to long name
+    if ((secArr[snPos + ATTR_BYTE_OFFSET] & LN_ATTR_MASK) == LN_ATTR_MASK)
+      return CORRUPT_FAT_ENTRY;
+
+    // entry preceeding short name must be first entry of long name
+    if ((secArr[snPos - ENTRY_LEN] & LN_ORD_MASK) != 1)
+      return CORRUPT_FAT_ENTRY;
+
+    char lnStr[LN_STR_LEN_MAX] = {'\0'};
+    pvt_LoadLongName(snPos - ENTRY_LEN, entPos, secArr, lnStr);
+    pvt_UpdateFatEntryMembers(step->ent, lnStr, secArr, snPos,
+                              step->secNumInClus, step->clusIndx);
+    step->entPos = step->ent->nextEntPos;
+    return SUCCESS;
+  }
+
+  // no more entries in this sector.
+  pvt_StepToNextSec(step, bpb);
+  return STEP_BUSY;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                       INITIALIZE LOOKUP STEP
+ *
+ * Description : Sets a FatLookupStep instance to search a directory for a
+ *               file or directory.
+ *
+ * Arguments   : lk        - Pointer to the FatLookupStep instance to be set.
+ *               dir       - Pointer to the FatDir instance of the directory
+ *                           to be searched.
+ *               nameStr   - Pointer to the name of the file or directory.
+ *               attr      - DIR_ENTRY_ATTR to find a directory, or 0 to find
+ *                           a file.
+ *               bpb       - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS or INVALID_NAME.
+ *
+ * Warnings    : nameStr is not copied, so it must not change until the
+ *               lookup is complete.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_InitLookupStep(FatLookupStep *lk, const FatDir *dir,
+                           const char nameStr[], uint8_t attr,
+                           const BPB *bpb)
+{
+  if (pvt_CheckName(nameStr) == INVALID_NAME)
+    return INVALID_NAME;
+
+  // point the entry to the first entry of dir.
+  fat_InitEntry(&lk->ent, bpb);
+  lk->ent.snEntClusIndx = dir->fstClusIndx;
+  fat_InitDirStep(&lk->dirStep, &lk->ent);
+
+  lk->nameStr = nameStr;
+  lk->attr = attr;
+
+  //
+  // a name not in the directory's negative lookup filter is not searched
+  // for. Otherwise the search adds the directory's names to the filter.
+  //
+  lk->isAbsent = fat_NegIsAbsent(dir->fstClusIndx, nameStr);
+  lk->negTag = lk->isAbsent ? NEG_NO_TAG : fat_NegBegin(dir->fstClusIndx);
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                              STEP THE LOOKUP
+ *
+ * Description : Performs the next step of a search of a directory for a file
+ *               or directory. Each step reads at most one sector from the
+ *               disk.
+ *
+ * Arguments   : lk      - Pointer to a FatLookupStep instance set by
+ *                         fat_InitLookupStep.
+ *               bpb     - Pointer to the BPB struct instance.
+ *
+ * Returns     : STEP_BUSY if the search is not complete. SUCCESS if it was
+ *               found, in which case lk->ent is its entry. FILE_NOT_FOUND or
+ *               DIR_NOT_FOUND if the directory does not contain it, or
+ *               another FAT Error Flag.
+ *
+ * Notes       : The names found are added to the directory's filter in
+ *               FAT_NEG.H. Once a search has reached the end of the
+ *               directory, a name the filter rules out is not found at the
+ *               first step, without reading the disk.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_StepLookup(FatLookupStep *lk, const BPB *bpb)
 {
-  // for function return errors. This is the loop cond. and the return value.
-  uint8_t err;
+  if (lk->isAbsent)
+    return lk->attr ? DIR_NOT_FOUND : FILE_NOT_FOUND;
 
-  // 
-  // Create and initialize a FatEntry instance. This will set the snEntClusIndx
-  // member to the root directory and all other members to 0 or null strings, 
-  // then update the snEntClusIndx to point to the first cluster index of the 
-  // FatDir instance (dir).
-  //
-  FatEntry ent;
-  fat_InitEntry(&ent, bpb);
-  ent.snEntClusIndx = dir->fstClusIndx;
+  uint8_t err = fat_StepNextEntry(&lk->dirStep, bpb);
 
-  // 
-  // set the ent FatEntry instance to the next entry in the directory, then 
-  // print the entry and fields according to entFlds. After all entries in the
-  // dir have been loaded, fat_SetNextEntry will return END_OF_DIRECTORY.
-  //
-  while ((err = fat_SetNextEntry(&ent, bpb)) == SUCCESS)
-  { 
-    // Do not print entry if it is hidden and hidden filter flag is not set
-    if (ent.snEnt[ATTR_BYTE_OFFSET] & HIDDEN_ATTR && !(entFlds & HIDDEN))
-      continue;
+  if (err == SUCCESS)
+  {
+    fat_NegAdd(lk->negTag, lk->ent.lnStr);
 
-    // Do not print entry if it is the Volume ID entry
-    if (ent.snEnt[ATTR_BYTE_OFFSET] & VOLUME_ID_ATTR)
-      continue;
-    
-    // Print short names if the SHORT_NAME filter flag is set.
-    if ((entFlds & SHORT_NAME) == SHORT_NAME)
-    {
-      pvt_PrintEntFields(ent.snEnt, entFlds);
-      print_Str(ent.snStr);
-    }
+    // continue if the entry is not of the type, or name, being searched for.
+    if ((lk->ent.info.attr & DIR_ENTRY_ATTR) != lk->attr
+        || strcmp(lk->ent.lnStr, lk->nameStr))
+      return STEP_BUSY;
+    return SUCCESS;
+  }
 
-    // Print long names if the LONG_NAME filter flag is set.
-    if ((entFlds & LONG_NAME) == LONG_NAME)
-    {
-      pvt_PrintEntFields(ent.snEnt, entFlds);
-      print_Str(ent.lnStr);
-    }
+  // no matching entry was found, and every name is now in the filter.
+  if (err == END_OF_DIRECTORY)
+  {
+    fat_NegEnd(lk->negTag);
+    return lk->attr ? DIR_NOT_FOUND : FILE_NOT_FOUND;
   }
-  // return END_OF_DIRECTORY if successful. Any other value returned is error.
   return err;
 }
 
 /*
  * ----------------------------------------------------------------------------
- *                                                         PRINT FILE TO SCREEN
- *                                       
- * Description : Prints the contents of any file entry to the screen. 
- * 
- * Arguments   : dir        - Pointer to a FatDir instance. This directory must
- *                            contain the entry for the file to be printed.
- *               fileStr    - Pointer to a string. This is the name of the file
- *                            who's contents will be printed.
- *               bpb        - Pointer to the BPB struct instance.
+ *                                                         INITIALIZE READ STEP
  *
- * Returns     : FAT Error Flag. If any value other than END_OF_FILE is 
- *               returned, then an issue has occurred.
- *  
- * Notes       : fileStr must be a long name unless a long name for a given
- *               entry does not exist, in which case it must be a short name.
+ * Description : Sets a FatReadStep instance to read bytes from the file's
+ *               current position.
+ *
+ * Arguments   : rd        - Pointer to the FatReadStep instance to be set.
+ *               file      - Pointer to a FatFile instance set by fat_OpenFile.
+ *               dataArr   - Pointer to the array that will be loaded with the
+ *                           bytes read from the file.
+ *               len       - Number of bytes to read.
+ *
+ * Returns     : void
  * ----------------------------------------------------------------------------
  */
-uint8_t fat_PrintFile(const FatDir *dir, const char fileStr[], const BPB *bpb)
+void fat_InitReadStep(FatReadStep *rd, FatFile *file, uint8_t dataArr[],
+                      uint16_t len)
 {
-  // for function return errors. This is the loop cond. and the return value.
-  uint8_t err;
-    
-  if (pvt_CheckName(fileStr) == INVALID_NAME)
-    return INVALID_NAME;
+  rd->file = file;
+  rd->dataArr = dataArr;
+  rd->len = len;
+}
 
-  // 
-  // Create and initialize a FatEntry instance. This will set the snEntClusIndx
-  // member to the root directory and all other members to 0 or null strings, 
-  // then, update the snEntClusIndx to point to the first cluster index of the 
-  // FatDir instance (dir).
-  //
-  FatEntry ent;
-  fat_InitEntry(&ent, bpb);
-  ent.snEntClusIndx = dir->fstClusIndx;
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           STEP THE FILE READ
+ *
+ * Description : Performs the next step of a read of a file. Each step reads
+ *               at most one sector from the disk, either a sector of the file
+ *               or a sector of the FAT to follow its cluster chain.
+ *
+ * Arguments   : rd      - Pointer to a FatReadStep instance set by
+ *                         fat_InitReadStep.
+ *               bpb     - Pointer to the BPB struct instance.
+ *
+ * Returns     : STEP_BUSY if the read is not complete. Otherwise the same as
+ *               fat_ReadFile, which is the blocking form of this function.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_StepReadFile(FatReadStep *rd, const BPB *bpb)
+{
+  uint8_t  err;
+  FatFile *file = rd->file;
 
-  // 
-  // Search for a file matching fileStr in the current directory. Do this
-  // by calling fat_SetNextEntry() to set the FatEntry instance to the next
-  // entry in the directory. This is repeated until a file name is returned
-  // that matches fileStr. Once a match is found then the "private"
-  // function, pvt_PrintFile() is called to print this file. If no matching 
-  // file is found, then the loop will exit once END_OF_DIRECTORY is returned.
-  //
-  while ((err = fat_SetNextEntry(&ent, bpb)) == SUCCESS) 
-  { 
-    // if entry is a directory, continue
-    if (ent.snEnt[ATTR_BYTE_OFFSET] & DIR_ENTRY_ATTR)
-      continue;
+  if (!rd->len)
+    return SUCCESS;
+  if (file->currPos >= file->fileSize)
+    return END_OF_FILE;
 
-    // if matching file is found print its contents
-    if (!strcmp(ent.lnStr, fileStr))
-    {
-      print_Str("\n\n\r");
-      err = pvt_PrintFile(ent.snEnt, bpb);  //END_OF_FILE or FAILED_READ_SECTOR
-      return err;
-    }
-  }
-  return err;                               // no matching file was found.
+  // follow the cluster chain, one FAT sector per step, to currPos's cluster.
+  if ((err = pvt_StepFileClus(file, bpb)) != SUCCESS)
+    return err;
+
+  // calculate location of the sector holding currPos on the disk
+  uint32_t secNumOnDisk = BPB_SEC_IN_CLUS(bpb, file->currPos)
+                        + BPB_CLUS_TO_SEC(bpb, file->currClusIndx);
+
+  uint8_t secArr[BPB_BYTES_PER_SEC(bpb)];
+  if ((err = fat_CacheRead(secNumOnDisk, secArr, CACHE_DATA)) != SUCCESS)
+    return err;
+
+  //
+  // number of bytes to copy from this sector. Limited by the end of the
+  // sector, the number of bytes requested and the end of the file.
+  //
+  uint16_t bytePos = BPB_POS_IN_SEC(bpb, file->currPos);
+  uint16_t byteCnt = BPB_BYTES_PER_SEC(bpb) - bytePos;
+  if (byteCnt > rd->len)
+    byteCnt = rd->len;
+  if (byteCnt > file->fileSize - file->currPos)
+    byteCnt = file->fileSize - file->currPos;
+
+  memcpy(rd->dataArr, &secArr[bytePos], byteCnt);
+  rd->dataArr += byteCnt;
+  rd->len -= byteCnt;
+  file->currPos += byteCnt;
+  return rd->len ? STEP_BUSY : SUCCESS;
 }
 
 /*
@@ -574,6 +1589,9 @@ void fat_PrintError (uint8_t err)
     case FAILED_READ_SECTOR:
       print_Str("\n\rFAILED_READ_SECTOR");
       break;
+    case FAILED_WRITE_SECTOR:
+      print_Str("\n\rFAILED_WRITE_SECTOR");
+      break;
     default:
       print_Str("\n\rUNKNOWN_ERROR");
   }
@@ -616,6 +1634,9 @@ static void pvt_UpdateFatEntryMembers(FatEntry *ent, const char lnStr[],
   // copy short name entry bytes into *snEnt FatEntry member
   for (uint8_t byteNum = 0; byteNum < ENTRY_LEN; ++byteNum)
     ent->snEnt[byteNum] = secArr[snPos + byteNum];
+
+  // decode the fields once here, so users of the entry do not.
+  pvt_DecodeEntry(&ent->info, ent->snEnt);
   
   //
   // The section parses the short name name + ext chars in the short name 
@@ -712,25 +1733,20 @@ static uint8_t pvt_CheckName(const char nameStr[])
 static uint8_t pvt_SetDirToParent(FatDir *dir, const BPB *bpb)
 {
   uint32_t parentDirFirstClus, secNumOnDisk;
-  uint8_t  secArr[bpb->bytesPerSec];
+  uint8_t  err;
+  uint8_t  secArr[BPB_BYTES_PER_SEC(bpb)];
 
   // sector number/address on disk
-  secNumOnDisk = bpb->dataRegionFirstSector 
-               + (dir->fstClusIndx - bpb->rootClus) 
-               * bpb->secPerClus;
+  secNumOnDisk = BPB_CLUS_TO_SEC(bpb, dir->fstClusIndx);
                 
   // load secArr with disk sector at secNumOnDisk
-  if (FATtoDisk_ReadSingleSector(secNumOnDisk, secArr) == FAILED_READ_SECTOR)
-   return FAILED_READ_SECTOR;
-
-  // load first cluster index of the parent directory.
-  parentDirFirstClus = secArr[FST_CLUS_INDX_BYTE_OFFSET_3 + ENTRY_LEN];
-  parentDirFirstClus <<= 8;
-  parentDirFirstClus |= secArr[FST_CLUS_INDX_BYTE_OFFSET_2 + ENTRY_LEN];
-  parentDirFirstClus <<= 8;
-  parentDirFirstClus |= secArr[FST_CLUS_INDX_BYTE_OFFSET_1 + ENTRY_LEN];
-  parentDirFirstClus <<= 8;
-  parentDirFirstClus |= secArr[FST_CLUS_INDX_BYTE_OFFSET_0 + ENTRY_LEN];
+  if ((err = fat_CacheRead(secNumOnDisk, secArr, CACHE_DIR)) != SUCCESS)
+   return err;
+
+  // load first cluster index of the parent directory, the ".." entry.
+  FatEntryInfo parentInfo;
+  pvt_DecodeEntry(&parentInfo, &secArr[ENTRY_LEN]);
+  parentDirFirstClus = parentInfo.fstClusIndx;
 
   if (dir->fstClusIndx == bpb->rootClus);   // current dir is root dir.
   else if (parentDirFirstClus == 0)         // parent dir is root dir
@@ -825,34 +1841,38 @@ static void pvt_LoadLongName(int lnFirstEnt, int lnLastEnt,
  * ----------------------------------------------------------------------------
  *                              (PRIVATE) GET THE FAT INDEX OF THE NEXT CLUSTER
  * 
- * Description : Finds and returns the next FAT cluster index.
+ * Description : Finds the next FAT cluster index of a file or dir.
  * 
- * Arguments   : clusIndex   - The current cluster's FAT index.
+ * Arguments   : clusIndx    - Pointer to the current cluster's FAT index. It
+ *                             is set to the next cluster's FAT index. If this
+ *                             is END_CLUSTER, the current cluster is the last
+ *                             of the file or dir.
  *               bpb         - Pointer to the BPB struct instance.
  * 
- * Returns     : A file or dir's next FAT cluster index. If END_CLUSTER is 
- *               returned, the current cluster is the last of the file or dir.
+ * Returns     : SUCCESS, or the error of fat_CacheRead if the FAT sector could
+ *               not be read, in which case *clusIndx is not changed.
  * 
- * Notes       : The returned value locates the index in the FAT. The index is
- *               offset (typically by -2) from the actual cluster number in the
- *               data region. The root cluster is always cluster 0 in the data
+ * Notes       : The index locates the entry in the FAT. The index is offset
+ *               (typically by -2) from the actual cluster number in the data
+ *               region. The root cluster is always cluster 0 in the data
  *               region, but its FAT index is 2 or higher.
  * ----------------------------------------------------------------------------
  */
-static uint32_t pvt_GetNextClusIndex(uint32_t clusIndx, const BPB *bpb)
+static uint8_t pvt_GetNextClusIndex(uint32_t *clusIndx, const BPB *bpb)
 {
+  uint8_t err;
+
   // calculate address of sector containing the current cluster index
-  uint16_t fatIndxsPerSec = bpb->bytesPerSec / BYTES_PER_INDEX;
-  uint32_t fatSectorToRead = (clusIndx / fatIndxsPerSec) + bpb->rsvdSecCnt;
+  uint32_t fatSectorToRead = BPB_FAT_SEC(bpb, *clusIndx);
 
   // load current cluster's index sector into secArr
-  uint8_t secArr[bpb->bytesPerSec];
-  FATtoDisk_ReadSingleSector(fatSectorToRead, secArr);
+  uint8_t secArr[BPB_BYTES_PER_SEC(bpb)];
+  if ((err = fat_CacheRead(fatSectorToRead, secArr, CACHE_FAT)) != SUCCESS)
+    return err;
 
   // Value at the current cluster index is the index of the next cluster.
   uint32_t nextClusIndx = 0;
-  uint16_t posNextClusIndxInSec = BYTES_PER_INDEX 
-                                  * (clusIndx % fatIndxsPerSec);
+  uint16_t posNextClusIndxInSec = BPB_FAT_POS(bpb, *clusIndx);
  
   // load the index of the next cluster.
   for (uint8_t offset = BYTES_PER_INDEX - 1; offset > 0; --offset)
@@ -862,7 +1882,72 @@ static uint32_t pvt_GetNextClusIndex(uint32_t clusIndx, const BPB *bpb)
   }
   nextClusIndx |= secArr[posNextClusIndxInSec];
 
-  return nextClusIndx;
+  *clusIndx = nextClusIndx;
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                (PRIVATE) DECODE A SHORT NAME
+ *
+ * Description : Decodes the fields of a short name entry.
+ *
+ * Arguments   : info    - Pointer to the FatEntryInfo instance to be set.
+ *               snEnt   - Pointer to the 32 bytes of the short name entry.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+static void pvt_DecodeEntry(FatEntryInfo *info, const uint8_t snEnt[])
+{
+  info->attr = snEnt[ATTR_BYTE_OFFSET];
+  info->fstClusIndx = LOAD_LE16(&snEnt[FST_CLUS_INDX_BYTE_OFFSET_0])
+                    | (uint32_t)LOAD_LE16(&snEnt[FST_CLUS_INDX_BYTE_OFFSET_2])
+                      << 16;
+  info->fileSize = LOAD_LE32(&snEnt[FILE_SIZE_BYTE_OFFSET_0]);
+  info->createDateTime = LOAD_LE32(&snEnt[CREATION_TIME_BYTE_OFFSET_0]);
+  info->writeDateTime = LOAD_LE32(&snEnt[WRITE_TIME_BYTE_OFFSET_0]);
+  info->lastAccDate = LOAD_LE16(&snEnt[LAST_ACCESS_DATE_BYTE_OFFSET_0]);
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                     (PRIVATE) PRINT AN ENTRY
+ *
+ * Description : Prints the names, and fields, of an entry requested by
+ *               entFlds, unless entFlds passes over the entry.
+ *
+ * Arguments   : ent       - Pointer to a FatEntry instance set to the entry.
+ *               entFlds   - Any combination of the FAT ENTRY FIELD FLAGS.
+ *
+ * Returns     : 1 if the entry was printed. 0 if it is hidden and HIDDEN is
+ *               not in entFlds, or it is the volume ID.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_PrintEntry(FatEntry *ent, uint8_t entFlds)
+{
+  // Do not print entry if it is hidden and hidden filter flag is not set
+  if (ent->info.attr & HIDDEN_ATTR && !(entFlds & HIDDEN))
+    return 0;
+
+  // Do not print entry if it is the Volume ID entry
+  if (ent->info.attr & VOLUME_ID_ATTR)
+    return 0;
+  
+  // Print short names if the SHORT_NAME filter flag is set.
+  if ((entFlds & SHORT_NAME) == SHORT_NAME)
+  {
+    pvt_PrintEntFields(&ent->info, entFlds);
+    print_Str(ent->snStr);
+  }
+
+  // Print long names if the LONG_NAME filter flag is set.
+  if ((entFlds & LONG_NAME) == LONG_NAME)
+  {
+    pvt_PrintEntFields(&ent->info, entFlds);
+    print_Str(ent->lnStr);
+  }
+  return 1;
 }
 
 /*
@@ -871,30 +1956,22 @@ static uint32_t pvt_GetNextClusIndex(uint32_t clusIndx, const BPB *bpb)
  * 
  * Description : Prints a FatEntry instance's fields according to flags param.
  *
- * Arguments   : secArr   - Pointer to an array holding then 32 bit short name
- *                          entry to be printed. Field values are located here.
+ * Arguments   : info     - Pointer to the decoded fields of the entry to be
+ *                          printed.
  *               flags    - Entry Field Flags specifying which fields to print.
  * 
  * Returns     : void 
  * ----------------------------------------------------------------------------
  */
-static void pvt_PrintEntFields(const uint8_t secArr[], uint8_t flags)
+static void pvt_PrintEntFields(const FatEntryInfo *info, uint8_t flags)
 {
   print_Str ("\n\r");
 
   // Print creation date and time 
   if (CREATION & flags)
   {
-    uint16_t createTime;
-    uint16_t createDate;
-
-    // load create date and time
-    createDate = secArr[CREATION_DATE_BYTE_OFFSET_1];
-    createDate <<= 8;
-    createDate |= secArr[CREATION_DATE_BYTE_OFFSET_0];
-    createTime = secArr[CREATION_TIME_BYTE_OFFSET_1];
-    createTime <<= 8;
-    createTime |= secArr[CREATION_TIME_BYTE_OFFSET_0];
+    uint16_t createTime = TIME_OF(info->createDateTime);
+    uint16_t createDate = DATE_OF(info->createDateTime);
 
     // print month
     print_Str("    ");
@@ -939,12 +2016,7 @@ static void pvt_PrintEntFields(const uint8_t secArr[], uint8_t flags)
   // Print last access date
   if (LAST_ACCESS & flags)
   {
-    uint16_t lastAccDate;
-
-    // load last access date
-    lastAccDate = secArr[LAST_ACCESS_DATE_BYTE_OFFSET_1];
-    lastAccDate <<= 8;
-    lastAccDate |= secArr[LAST_ACCESS_DATE_BYTE_OFFSET_0];
+    uint16_t lastAccDate = info->lastAccDate;
 
     // print month
     print_Str("     ");
@@ -968,17 +2040,8 @@ static void pvt_PrintEntFields(const uint8_t secArr[], uint8_t flags)
   // Print last modified date / time
   if (LAST_MODIFIED & flags)
   {
-    uint16_t writeDate;
-    uint16_t writeTime;
-    
-    // Load last modified write date and time
-    writeDate = secArr[WRITE_DATE_BYTE_OFFSET_1];
-    writeDate <<= 8;
-    writeDate |= secArr[WRITE_DATE_BYTE_OFFSET_0];
-
-    writeTime = secArr[WRITE_TIME_BYTE_OFFSET_1];
-    writeTime <<= 8;
-    writeTime |= secArr[WRITE_TIME_BYTE_OFFSET_0];
+    uint16_t writeDate = DATE_OF(info->writeDateTime);
+    uint16_t writeTime = TIME_OF(info->writeDateTime);
   
     // print month
     print_Str("     ");
@@ -1024,16 +2087,7 @@ static void pvt_PrintEntFields(const uint8_t secArr[], uint8_t flags)
   // Print file size in bytes
   if (FILE_SIZE & flags)
   {
-    uint32_t fileSize;    
-    
-    // load file size
-    fileSize = secArr[FILE_SIZE_BYTE_OFFSET_3];
-    fileSize <<= 8;
-    fileSize |= secArr[FILE_SIZE_BYTE_OFFSET_2];
-    fileSize <<= 8;
-    fileSize |= secArr[FILE_SIZE_BYTE_OFFSET_1];
-    fileSize <<= 8;
-    fileSize |= secArr[FILE_SIZE_BYTE_OFFSET_0];
+    uint32_t fileSize = info->fileSize;
 
     // Print spaces for formatting output. Add 1 to prevent starting at 0.
     for (uint64_t sp = 1 + fileSize / FS_UNIT; sp < GIGA / FS_UNIT; sp *= 10)
@@ -1050,7 +2104,7 @@ static void pvt_PrintEntFields(const uint8_t secArr[], uint8_t flags)
   // print entry type
   if (TYPE & flags)
   {
-    if (secArr[ATTR_BYTE_OFFSET] & DIR_ENTRY_ATTR) 
+    if (info->attr & DIR_ENTRY_ATTR) 
       print_Str(" <DIR>   ");
     else 
       print_Str(" <FILE>  ");
@@ -1064,84 +2118,327 @@ static void pvt_PrintEntFields(const uint8_t secArr[], uint8_t flags)
  * Description : Performs 'print file' operation. This will output the contents
  *               of any file to the screen.
  * 
- * Arguments   : snEnt   - Pointer to 32 byte array holding the sn entry.
+ * Arguments   : info    - Pointer to the decoded fields of the file's entry.
  *               bpb     - Pointer to the BPB struct instance.
  * 
- * Returns     : END_OF_FILE (success) or FAILED_READ_SECTOR fat error flag.
+ * Returns     : END_OF_FILE (success), FAILED_READ_SECTOR, FAILED_WRITE_SECTOR
+ *               or CORRUPT_FAT_ENTRY fat error flag.
+ *
+ * Notes       : The file is streamed to pvt_PrintSpan by fat_StreamFile, so
+ *               its bytes are printed from the cache or the disk driver's
+ *               array without being copied first. Only the fileSize bytes of
+ *               the file are printed.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_PrintFile(const FatEntryInfo *info, const BPB *bpb)
+{
+  uint8_t err;
+
+  // the file is only read, so the location of its entry is not needed.
+  FatFile file = { 0 };
+  file.fstClusIndx = info->fstClusIndx;
+  file.fileSize = info->fileSize;
+  file.currClusIndx = info->fstClusIndx;
+
+  err = fat_StreamFile(&file, 0, info->fileSize, pvt_PrintSpan, NULL, bpb);
+  return err == SUCCESS ? END_OF_FILE : err;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                  (PRIVATE) PRINT A FILE SPAN
+ *
+ * Description : Sink function of pvt_PrintFile. Prints the bytes of a span of
+ *               the file to the screen.
+ *
+ * Arguments   : spanArr   - Pointer to the bytes of the span.
+ *               len       - Number of bytes at spanArr.
+ *               arg       - Not used.
+ *
+ * Returns     : len. Every byte is taken.
  * ----------------------------------------------------------------------------
  */
-static uint8_t pvt_PrintFile(const uint8_t snEnt[], const BPB *bpb)
+static uint16_t pvt_PrintSpan(const uint8_t spanArr[], uint16_t len,
+                              void *arg)
 {
-  //get FAT index for file's first cluster
-  uint32_t clus; 
-  clus = snEnt[FST_CLUS_INDX_BYTE_OFFSET_3];
-  clus <<= 8;
-  clus |= snEnt[FST_CLUS_INDX_BYTE_OFFSET_2];
-  clus <<= 8;
-  clus |= snEnt[FST_CLUS_INDX_BYTE_OFFSET_1];
-  clus <<= 8;
-  clus |= snEnt[FST_CLUS_INDX_BYTE_OFFSET_0];
-
-  // loop over clusters to read in and print file
-  do
+  (void)arg;
+
+  for (uint16_t byteNum = 0; byteNum < len; ++byteNum)
   {
-    // loop over sectors in the cluster to read in and print file
-    for (uint32_t secNumInClus = 0; secNumInClus < bpb->secPerClus; 
-         ++secNumInClus)
+    // 
+    // for output formatting. Currently reads are NOT text mode, so "\n\r"
+    // is not automatically printed when "\n" is present by itself.
+    //
+    if (spanArr[byteNum] == '\n') 
+      print_Str ("\n\r");
+    
+    // else if not 0, just print the character directly to the screen.
+    else if (spanArr[byteNum])
     {
-      // calculate address of the sector on the physical disk
-      uint32_t secNumOnDisk = secNumInClus + bpb->dataRegionFirstSector
-                          + (clus - bpb->rootClus) * bpb->secPerClus;
+      // two byte array for single char string, to use print_Str.
+      char str[2] = {spanArr[byteNum], '\0'};
+      print_Str(str);
+    }
+  }
+  return len;
+}
 
-      // read disk sector into the sector array
-      uint8_t secArr[bpb->bytesPerSec];
-      if (FATtoDisk_ReadSingleSector(secNumOnDisk, secArr) 
-          == FAILED_READ_SECTOR)
-        return FAILED_READ_SECTOR;
+/*
+ * ----------------------------------------------------------------------------
+ *                                      (PRIVATE) SET FILE TO CLUSTER OF ITS POS
+ *
+ * Description : Follows a file's cluster chain until currClusIndx is the
+ *               cluster holding the byte at the file's current position.
+ *
+ * Arguments   : file   - Pointer to a FatFile instance set by fat_OpenFile.
+ *               bpb    - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, or CORRUPT_FAT_ENTRY if the chain ends before the
+ *               cluster holding the file's current position.
+ *
+ * Notes       : Only searches forward along the chain. If currPos is in a
+ *               cluster before currClusIndx, the search restarts from the
+ *               file's first cluster.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_SetFileClus(FatFile *file, const BPB *bpb)
+{
+  uint8_t err;
 
-      for (uint16_t byteNum = 0; byteNum < bpb->bytesPerSec; ++byteNum)
-      {
-        // end of file flag. Set to 1 if eof is detected.
-        uint8_t eof = 0;
-
-        // 
-        // for output formatting. Currently reads are NOT text mode, so "\n\r"
-        // is not automatically printed when "\n" is present by itself.
-        //
-        if (secArr[byteNum] == '\n') 
-          print_Str ("\n\r");
-        
-        // else if not 0, just print the character directly to the screen.
-        else if (secArr[byteNum])
-        {
-          // two byte array for single char string, to use print_Str.
-          char str[2] = {secArr[byteNum], '\0'};
-          print_Str(str);
-        }
-        // else character is zero. Possible indicatin of eof.
-        else 
-        {
-          // assume eof and set flag
-          eof = 1;
-          
-          // confirm rest of bytes in the current sector are 0
-          for (++byteNum; byteNum < bpb->bytesPerSec; ++byteNum)
-          {
-            // if any byte is not 0 then not at eof. Reset eof to 0
-            if (secArr[byteNum]) 
-            { 
-              --byteNum;
-              eof = 0;
-              break;
-            }
-          }
-        }
-        if (eof)
-          return END_OF_FILE;
-      }
-    }
-  } 
-  while ((clus = pvt_GetNextClusIndex(clus, bpb)) != END_CLUSTER);
-  
-  return END_OF_FILE;
+  while ((err = pvt_StepFileClus(file, bpb)) == STEP_BUSY)
+    ;
+  return err;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                        (PRIVATE) STEP FILE TO CLUSTER OF POS
+ *
+ * Description : Moves a file's currClusIndx one cluster along the chain
+ *               towards the cluster holding the file's current position.
+ *
+ * Arguments   : file   - Pointer to a FatFile instance set by fat_OpenFile.
+ *               bpb    - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS if currClusIndx is already the cluster holding the
+ *               current position. STEP_BUSY if it was moved one cluster, which
+ *               reads one FAT sector. CORRUPT_FAT_ENTRY if the chain ends
+ *               first, or FAILED_READ_SECTOR if the FAT sector could not be
+ *               read, in which case currClusIndx is not moved.
+ *
+ * Notes       : Only moves forward along the chain. If currPos is in a
+ *               cluster before currClusIndx, it restarts from the file's
+ *               first cluster.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_StepFileClus(FatFile *file, const BPB *bpb)
+{
+  uint8_t  err;
+  uint32_t clusNum = BPB_POS_TO_CLUS_NUM(bpb, file->currPos);
+
+  // chain can only be followed forward, so restart from the first cluster.
+  if (clusNum < file->currClusNum)
+  {
+    file->currClusIndx = file->fstClusIndx;
+    file->currClusNum = 0;
+  }
+
+  if (file->currClusNum == clusNum)
+    return SUCCESS;
+
+  if ((err = pvt_GetNextClusIndex(&file->currClusIndx, bpb)) != SUCCESS)
+    return err;
+  if (file->currClusIndx == END_CLUSTER)
+  {
+    // reset to a valid position in the chain before returning the error.
+    file->currClusIndx = file->fstClusIndx;
+    file->currClusNum = 0;
+    return CORRUPT_FAT_ENTRY;
+  }
+  ++file->currClusNum;
+  return STEP_BUSY;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                         (PRIVATE) SET ENTRY CLUSTER AND SIZE
+ *
+ * Description : Sets the first cluster index and file size fields of the
+ *               short name entry at entPos in secArr.
+ *
+ * Arguments   : secArr        - Pointer to the array holding the sector that
+ *                               contains the short name entry.
+ *               entPos        - Position in secArr of the short name entry.
+ *               fstClusIndx   - Value of the first cluster index field.
+ *               fileSize      - Value of the file size field.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+static void pvt_SetEntClusSize(uint8_t secArr[], uint16_t entPos,
+                               uint32_t fstClusIndx, uint32_t fileSize)
+{
+  uint8_t *snEnt = &secArr[entPos];
+
+  snEnt[FST_CLUS_INDX_BYTE_OFFSET_0] = fstClusIndx;
+  snEnt[FST_CLUS_INDX_BYTE_OFFSET_1] = fstClusIndx >> 8;
+  snEnt[FST_CLUS_INDX_BYTE_OFFSET_2] = fstClusIndx >> 16;
+  snEnt[FST_CLUS_INDX_BYTE_OFFSET_3] = fstClusIndx >> 24;
+
+  snEnt[FILE_SIZE_BYTE_OFFSET_0] = fileSize;
+  snEnt[FILE_SIZE_BYTE_OFFSET_1] = fileSize >> 8;
+  snEnt[FILE_SIZE_BYTE_OFFSET_2] = fileSize >> 16;
+  snEnt[FILE_SIZE_BYTE_OFFSET_3] = fileSize >> 24;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                          (PRIVATE) COUNT SECTOR OF FILE READ
+ *
+ * Description : Passes a sector read by fat_ReadFileSectors to the caller's
+ *               function, and counts it.
+ *
+ * Arguments   : secArr   - Pointer to the array holding the sector.
+ *               arg      - Pointer to the SecCounter of the read.
+ *
+ * Returns     : Non-zero to stop the read, if the caller's function stopped
+ *               it or this was the last sector of the file. Otherwise 0.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_CountSector(const uint8_t secArr[], void *arg)
+{
+  struct SecCounter *counter = arg;
+
+  --counter->secsLeft;
+  if (counter->secFn(secArr, counter->arg))
+    counter->stopped = 1;
+  return counter->stopped || !counter->secsLeft;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                              (PRIVATE) PASS SECTOR TO A SINK
+ *
+ * Description : Passes the bytes of the stream in a sector, from the file's
+ *               current position, to the sink function of fat_StreamFile, and
+ *               advances the position by the number of bytes it took.
+ *
+ * Arguments   : secArr   - Pointer to the array holding the sector of the
+ *                          file's current position.
+ *               arg      - Pointer to the StreamSink of the stream.
+ *
+ * Returns     : Non-zero to stop a multiple sector read, if the sink took
+ *               fewer bytes than it was passed or the stream has ended.
+ *               Otherwise 0.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_SinkSector(const uint8_t secArr[], void *arg)
+{
+  struct StreamSink *sink = arg;
+  FatFile *file = sink->file;
+
+  // number of bytes to pass from this sector. Same limits as fat_ReadFile.
+  uint16_t bytePos = BPB_POS_IN_SEC(sink->bpb, file->currPos);
+  uint16_t byteCnt = BPB_BYTES_PER_SEC(sink->bpb) - bytePos;
+  if (byteCnt > sink->len)
+    byteCnt = sink->len;
+  if (byteCnt > file->fileSize - file->currPos)
+    byteCnt = file->fileSize - file->currPos;
+
+  uint16_t takenCnt = sink->sinkFn(&secArr[bytePos], byteCnt, sink->arg);
+  if (takenCnt > byteCnt)
+    takenCnt = byteCnt;
+  file->currPos += takenCnt;
+  sink->len -= takenCnt;
+
+  sink->stopped = takenCnt < byteCnt;
+  return sink->stopped || !sink->len || file->currPos >= file->fileSize;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                      (PRIVATE) STEP DIRECTORY TO NEXT SECTOR
+ *
+ * Description : Sets a FatDirStep instance so its next step reads the sector
+ *               of the directory that follows the sector in secArr.
+ *
+ * Arguments   : step   - Pointer to a FatDirStep instance.
+ *               bpb    - Pointer to the BPB struct instance.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+static void pvt_StepToNextSec(FatDirStep *step, const BPB *bpb)
+{
+  step->entPos = FIRST_ENT_POS_IN_SEC;
+  if (++step->secNumInClus < BPB_SEC_PER_CLUS(bpb))
+    step->state = DIR_STEP_READ_SEC;
+  else
+    step->state = DIR_STEP_NEXT_CLUS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                        (PRIVATE) END LONG NAME SPANNING SECS
+ *
+ * Description : Finishes the entry of a long name that began in the previous
+ *               sector, once the sector holding its short name is in secArr.
+ *
+ * Arguments   : step   - Pointer to a FatDirStep instance. Its lnStr holds
+ *                        the part of the long name from the previous sector,
+ *                        and snPos is the position of the short name.
+ *
+ * Returns     : SUCCESS, or CORRUPT_FAT_ENTRY.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_EndSpanningName(FatDirStep *step)
+{
+  const uint8_t *secArr = step->secArr;
+  uint16_t snPos = step->snPos;
+
+  // verify snPos does not point to long name
+  if ((secArr[snPos + ATTR_BYTE_OFFSET] & LN_ATTR_MASK) == LN_ATTR_MASK)
+    return CORRUPT_FAT_ENTRY;
+
+  //
+  // if sn is not the first entry of the sector then the first entries of the
+  // ln are in this sector, and come before the part in the previous sector.
+  //
+  char lnStr[LN_STR_LEN_MAX] = {'\0'};
+  if (snPos)
+  {
+    // Entry preceeding short name must be first entry of long name
+    if ((secArr[snPos - ENTRY_LEN] & LN_ORD_MASK) != 1)
+      return CORRUPT_FAT_ENTRY;
+    pvt_LoadLongName(snPos - ENTRY_LEN, FIRST_ENT_POS_IN_SEC, secArr, lnStr);
+  }
+  strcat(lnStr, step->lnStr);
+
+  pvt_UpdateFatEntryMembers(step->ent, lnStr, secArr, snPos,
+                            step->secNumInClus, step->clusIndx);
+  step->entPos = step->ent->nextEntPos;
+  step->snPos = NO_SPAN;
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                (PRIVATE) SHORT NAME CHECKSUM
+ *
+ * Description : Calculates the checksum of the 11 bytes of a short name, as
+ *               stored in the entries of its long name.
+ *
+ * Arguments   : snEnt   - Pointer to the short name entry.
+ *
+ * Returns     : The checksum.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_SnChkSum(const uint8_t snEnt[])
+{
+  uint8_t sum = 0;
+
+  for (uint8_t byteNum = 0; byteNum < SN_NAME_CHAR_LEN + SN_EXT_CHAR_LEN;
+       ++byteNum)
+    sum = ((sum & 1) << 7) + (sum >> 1) + snEnt[byteNum];
+  return sum;
 }
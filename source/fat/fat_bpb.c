@@ -12,6 +12,7 @@
 #include <string.h>
 #include "prints.h"
 #include "fat_bpb.h"
+#include "fat.h"
 #include "fat_to_disk_if.h"
 
 /*
@@ -80,6 +81,12 @@ uint8_t fat_SetBPB(BPB *bpb)
     // check that secPerClus is a valid value.   
     if (!CHK_VLD_SEC_PER_CLUS(bpb->secPerClus))
       return INVALID_SECTORS_PER_CLUSTER;
+
+    // a build for a fixed geometry cannot use a volume of any other.
+    #ifdef FAT_FIXED_SEC_PER_CLUS
+    if (bpb->secPerClus != FAT_FIXED_SEC_PER_CLUS)
+      return INVALID_SECTORS_PER_CLUSTER;
+    #endif//FAT_FIXED_SEC_PER_CLUS
     
     // number of reserved sectors
     bpb->rsvdSecCnt = bootSecArr[RSVD_SEC_CNT_POS_MSB];
@@ -114,6 +121,22 @@ uint8_t fat_SetBPB(BPB *bpb)
     //
     bpb->dataRegionFirstSector = bootSecAddr + bpb->rsvdSecCnt 
                                + bpb->numOfFats * bpb->fatSize32;
+
+    //
+    // Both sizes were checked to be powers of 2, so the geometry of the 
+    // volume is kept as shifts and masks. See VOLUME GEOMETRY.
+    //
+    for (bpb->secPerClusShift = 0; 
+         (1U << bpb->secPerClusShift) < bpb->secPerClus; 
+         ++bpb->secPerClusShift)
+      ;
+    for (bpb->bytesPerSecShift = 0; 
+         (1U << bpb->bytesPerSecShift) < bpb->bytesPerSec; 
+         ++bpb->bytesPerSecShift)
+      ;
+    bpb->bytesPerClusShift = bpb->bytesPerSecShift + bpb->secPerClusShift;
+    bpb->bytesPerClusMask = ((uint32_t)1 << bpb->bytesPerClusShift) - 1;
+    bpb->fatIndxsPerSecShift = bpb->bytesPerSecShift - FAT32_INDX_SHIFT;
     return BPB_VALID;
   }
   else 
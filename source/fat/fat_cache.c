@@ -0,0 +1,760 @@
+/*
+ * File       : FAT_CACHE.C
+ * Version    : 2.0
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Implementation of FAT_CACHE.H
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "fat_bpb.h"
+#include "fat.h"
+#include "fat_to_disk_if.h"
+#include "fat_ioq.h"
+#include "fat_cache.h"
+
+/*
+ ******************************************************************************
+ *                 "PRIVATE" FUNCTION PROTOTYPES (and MACROS)
+ ******************************************************************************
+ */
+
+// dirtySeq of a sector that is not waiting to be written.
+#define CLEAN                   0
+
+//
+// a sector held in the cache. Written sectors are flushed in order of
+// (cls, dirtySeq).
+//
+typedef struct
+{
+  uint32_t secNum;                     // block number on the disk
+  uint32_t dirtySeq;                   // order first written, or CLEAN
+  uint32_t dirtyMs;                    // time first written
+  uint32_t lastUse;                    // for least recently used eviction
+  uint8_t  cls;                        // see SECTOR CLASSES
+  uint8_t  valid;                      // 1 if the line holds a sector
+  uint8_t  loading;                    // 1 until fat_CacheLoad reads it
+  uint8_t  secArr[SECTOR_LEN];
+}
+CacheLine;
+
+// lines a pvt_PickVictim may choose from.
+#define PICK_ANY                0      // any line
+#define PICK_CLASS              1      // lines of the class
+#define PICK_CLEAN_CLASS        2      // lines of the class not waiting
+
+//
+// state of a fat_CacheLoad, passed to pvt_LoadSector with each sector.
+//
+typedef struct
+{
+  uint32_t secNum;                     // block number of the next sector
+}
+LoadArg;
+
+static CacheLine lines[FAT_CACHE_SECS];
+static uint32_t  useCnt;               // incremented on each access
+static uint32_t  seqCnt;               // incremented on each first write
+static uint32_t  nextDataSec;          // sector after the last data read
+
+// quota of each class, indexed by class.
+static const uint8_t quotas[] =
+{
+  FAT_CACHE_DATA_SECS, FAT_CACHE_FAT_SECS, FAT_CACHE_DIR_SECS
+};
+
+static uint8_t pvt_GetLine(uint32_t secNum, uint8_t cls, uint8_t load,
+                           CacheLine **line);
+static CacheLine *pvt_PickVictim(uint8_t cls, uint8_t pick);
+static uint8_t pvt_FlushUpTo(uint8_t cls, uint32_t dirtySeq);
+static CacheLine *pvt_NextToFlush(uint8_t cls, uint32_t dirtySeq,
+                                  const CacheLine *after);
+static const uint8_t *pvt_RunSector(uint32_t secIndx, void *arg);
+static uint8_t pvt_LoadSector(const uint8_t secArr[], void *arg);
+static uint8_t pvt_IsHeld(uint32_t secNum);
+static void pvt_EndLoad(void);
+static uint8_t pvt_QueueLines(CacheLine *lineArr[], uint8_t lineCnt,
+                              uint8_t op);
+
+/*
+ ******************************************************************************
+ *                                FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           READ CACHED SECTOR
+ *
+ * Description : Loads a sector into an array, from the cache if it is held
+ *               there, otherwise from the disk, in which case it is added to
+ *               the cache.
+ *
+ * Arguments   : secNum   - Block number of the sector on the disk.
+ *               secArr   - Pointer to the array that will be loaded with the
+ *                          sector. Must be of length SECTOR_LEN.
+ *               cls      - Class of the sector. See SECTOR CLASSES.
+ *
+ * Returns     : SUCCESS, FAILED_READ_SECTOR, or FAILED_WRITE_SECTOR if a
+ *               written sector could not be flushed to make room.
+ *
+ * Notes       : A CACHE_DATA sector that is not held, and is the sector after
+ *               the last CACHE_DATA sector read, takes the place of the least
+ *               recently used data sector that is not waiting to be written.
+ *               A file read from start to end therefore passes through a
+ *               single line of the cache.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_CacheRead(uint32_t secNum, uint8_t secArr[], uint8_t cls)
+{
+  uint8_t    err;
+  CacheLine *line;
+
+  if ((err = fat_CacheAutoFlush()) != SUCCESS)
+    return err;
+  if ((err = pvt_GetLine(secNum, cls, 1, &line)) != SUCCESS)
+    return err;
+
+  if (line->dirtySeq == CLEAN)
+    line->cls = cls;
+  if (cls == CACHE_DATA)
+    nextDataSec = secNum + 1;
+  memcpy(secArr, line->secArr, SECTOR_LEN);
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           PEEK CACHED SECTOR
+ *
+ * Description : Gets the cache's copy of a sector if it is held there, so it
+ *               can be used without copying it. The disk is not read.
+ *
+ * Arguments   : secNum   - Block number of the sector on the disk.
+ *
+ * Returns     : Pointer to the SECTOR_LEN bytes of the sector, or NULL if
+ *               the sector is not held.
+ *
+ * Warnings    : The pointer is only valid until the next call to any other
+ *               function of the cache, which may reuse the line.
+ * ----------------------------------------------------------------------------
+ */
+const uint8_t *fat_CachePeek(uint32_t secNum)
+{
+  for (uint8_t i = 0; i < FAT_CACHE_SECS; ++i)
+    if (lines[i].valid && lines[i].secNum == secNum)
+    {
+      lines[i].lastUse = ++useCnt;
+      return lines[i].secArr;
+    }
+  return NULL;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                          WRITE CACHED SECTOR
+ *
+ * Description : Writes an array to a sector in the cache. The sector is
+ *               written to the disk when the cache is next flushed.
+ *
+ * Arguments   : secNum   - Block number of the sector on the disk.
+ *               secArr   - Pointer to the array holding the sector. Must be
+ *                          of length SECTOR_LEN.
+ *               cls      - Class of the sector. See SECTOR CLASSES.
+ *
+ * Returns     : SUCCESS, or FAILED_WRITE_SECTOR if a written sector could not
+ *               be flushed to make room.
+ *
+ * Notes       : If the sector is already waiting to be written, its data is
+ *               replaced, so it is only written to the disk once.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_CacheWrite(uint32_t secNum, const uint8_t secArr[], uint8_t cls)
+{
+  uint8_t    err;
+  CacheLine *line;
+
+  if ((err = fat_CacheAutoFlush()) != SUCCESS)
+    return err;
+  if ((err = pvt_GetLine(secNum, cls, 0, &line)) != SUCCESS)
+    return err;
+
+  //
+  // a sector keeps its place in the flush order from when it was first
+  // written, so later writes to it are combined into that one write.
+  //
+  if (line->dirtySeq == CLEAN)
+  {
+    line->dirtySeq = ++seqCnt;
+    line->dirtyMs = FATtoDisk_GetTimeMs();
+    line->cls = cls;
+  }
+  memcpy(line->secArr, secArr, SECTOR_LEN);
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            LOAD SECTOR RANGE
+ *
+ * Description : Reads a range of sectors from the disk into the cache, with a
+ *               single multiple sector read, so that later reads of them by
+ *               fat_CacheRead are served from the cache.
+ *
+ * Arguments   : secNum      - Block number of the first sector of the range.
+ *               numOfSecs   - Number of sectors in the range.
+ *               cls         - Class of the sectors. See SECTOR CLASSES.
+ *
+ * Returns     : SUCCESS, FAILED_READ_SECTOR, or FAILED_WRITE_SECTOR if a
+ *               written sector could not be flushed to make room.
+ *
+ * Notes       : 1) Sectors at either end of the range that are already held
+ *                  are not read. Sectors of the range waiting to be written
+ *                  keep the data written to them.
+ *               2) Only the last sectors of a range longer than the quota of
+ *                  its class are read, as the cache would not keep the
+ *                  others.
+ *               3) The lines for the sectors are taken, and any of them
+ *                  waiting to be written flushed, before the read starts, as
+ *                  the disk cannot be written during a multiple sector read.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_CacheLoad(uint32_t secNum, uint32_t numOfSecs, uint8_t cls)
+{
+  uint8_t    err;
+  uint8_t    secArr[SECTOR_LEN];
+  LoadArg    load;
+  CacheLine *line;
+  CacheLine *loadArr[FAT_CACHE_SECS];
+  uint8_t    loadCnt = 0;
+  uint32_t   maxSecs = quotas[cls] < FAT_CACHE_SECS ? quotas[cls]
+                                                    : FAT_CACHE_SECS;
+
+  if ((err = fat_CacheAutoFlush()) != SUCCESS)
+    return err;
+
+  if (numOfSecs > maxSecs)
+  {
+    secNum += numOfSecs - maxSecs;
+    numOfSecs = maxSecs;
+  }
+
+  // sectors at either end of the range that are already held are not read.
+  while (numOfSecs && pvt_IsHeld(secNum))
+  {
+    ++secNum;
+    --numOfSecs;
+  }
+  while (numOfSecs && pvt_IsHeld(secNum + numOfSecs - 1))
+    --numOfSecs;
+  if (numOfSecs == 0)
+    return SUCCESS;
+
+  // lines are taken first, so no sector is flushed inside the read.
+  for (uint32_t i = 0; i < numOfSecs; ++i)
+  {
+    if (pvt_IsHeld(secNum + i))
+      continue;
+    if ((err = pvt_GetLine(secNum + i, cls, 0, &line)) != SUCCESS)
+    {
+      pvt_EndLoad();
+      return err;
+    }
+    line->loading = 1;
+    loadArr[loadCnt++] = line;
+  }
+
+  // through a queue, each line is a request, and the queue merges them.
+  if (fat_IoqIsAttached())
+  {
+    err = pvt_QueueLines(loadArr, loadCnt, IOQ_READ);
+    for (uint8_t i = 0; err == SUCCESS && i < loadCnt; ++i)
+      loadArr[i]->loading = 0;
+  }
+  else
+  {
+    load.secNum = secNum;
+    err = FATtoDisk_ReadMultipleSectors(secNum, numOfSecs, secArr,
+                                        pvt_LoadSector, &load);
+    err = (err == READ_SECTOR_SUCCESS) ? SUCCESS : FAILED_READ_SECTOR;
+  }
+  pvt_EndLoad();
+  return err;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                 SYNC TO DISK
+ *
+ * Description : Writes every sector waiting in the cache to the disk, in the
+ *               order described in SECTOR CLASSES. Consecutive sectors are
+ *               written with a single multiple sector write.
+ *
+ * Arguments   : void
+ *
+ * Returns     : SUCCESS or FAILED_WRITE_SECTOR. Sectors not written are kept
+ *               waiting.
+ *
+ * Notes       : This is a barrier. Nothing written after it returns SUCCESS
+ *               reaches the disk before what was written before it.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_Sync(void)
+{
+  return pvt_FlushUpTo(CACHE_DIR, seqCnt);
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                      SYNC CACHE SECTOR RANGE
+ *
+ * Description : Calls fat_Sync if any sector in a range of sectors is waiting
+ *               in the cache. Used before the range is read from the disk
+ *               around the cache.
+ *
+ * Arguments   : secNum      - Block number of the first sector of the range.
+ *               numOfSecs   - Number of sectors in the range.
+ *
+ * Returns     : SUCCESS or FAILED_WRITE_SECTOR.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_CacheSyncRange(uint32_t secNum, uint32_t numOfSecs)
+{
+  for (uint8_t i = 0; i < FAT_CACHE_SECS; ++i)
+    if (lines[i].valid && lines[i].dirtySeq != CLEAN
+        && lines[i].secNum - secNum < numOfSecs)
+      return fat_Sync();
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                   DISCARD CACHE SECTOR RANGE
+ *
+ * Description : Removes the sectors in a range of sectors from the cache. Used
+ *               when the range is written to the disk around the cache, so
+ *               the cache does not hold the old data.
+ *
+ * Arguments   : secNum      - Block number of the first sector of the range.
+ *               numOfSecs   - Number of sectors in the range.
+ *
+ * Returns     : void
+ *
+ * Warnings    : Sectors of the range waiting to be written are lost. Call
+ *               fat_CacheSyncRange first to keep them.
+ * ----------------------------------------------------------------------------
+ */
+void fat_CacheDiscardRange(uint32_t secNum, uint32_t numOfSecs)
+{
+  for (uint8_t i = 0; i < FAT_CACHE_SECS; ++i)
+    if (lines[i].valid && lines[i].secNum - secNum < numOfSecs)
+    {
+      lines[i].valid = 0;
+      lines[i].dirtySeq = CLEAN;
+    }
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             AUTO-FLUSH CACHE
+ *
+ * Description : Calls fat_Sync if the oldest sector waiting in the cache was
+ *               first written FAT_CACHE_AGE_MS or more ago.
+ *
+ * Arguments   : void
+ *
+ * Returns     : SUCCESS or FAILED_WRITE_SECTOR.
+ *
+ * Notes       : This is called by fat_CacheRead and fat_CacheWrite. It should
+ *               also be called periodically from the main loop, so sectors
+ *               are flushed when the FAT functions are not being used.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_CacheAutoFlush(void)
+{
+  uint32_t nowMs = FATtoDisk_GetTimeMs();
+
+  for (uint8_t i = 0; i < FAT_CACHE_SECS; ++i)
+    if (lines[i].valid && lines[i].dirtySeq != CLEAN
+        && nowMs - lines[i].dirtyMs >= FAT_CACHE_AGE_MS)
+      return fat_Sync();
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             INVALIDATE CACHE
+ *
+ * Description : Removes every sector from the cache, e.g. after the disk is
+ *               changed.
+ *
+ * Arguments   : void
+ *
+ * Returns     : void
+ *
+ * Warnings    : Sectors waiting to be written are lost. Call fat_Sync first
+ *               to keep them.
+ * ----------------------------------------------------------------------------
+ */
+void fat_CacheInvalidate(void)
+{
+  for (uint8_t i = 0; i < FAT_CACHE_SECS; ++i)
+  {
+    lines[i].valid = 0;
+    lines[i].dirtySeq = CLEAN;
+  }
+}
+
+/*
+ ******************************************************************************
+ *                           "PRIVATE" FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                     (PRIVATE) GET CACHE LINE
+ *
+ * Description : Finds the cache line holding a sector. If the sector is not
+ *               held, a line is given to it by pvt_PickVictim. This is a line
+ *               of the sector's class if the class is at its quota, or, for
+ *               a sequential read of file data, a data line not waiting to be
+ *               written if there is one. Otherwise it is any line.
+ *
+ * Arguments   : secNum   - Block number of the sector on the disk.
+ *               cls      - Class of the sector. See SECTOR CLASSES.
+ *               load     - 1 to load a sector that is not held from the
+ *                          disk. 0 if it is about to be written entirely.
+ *               line     - Pointer to the pointer to the line, set here.
+ *
+ * Returns     : SUCCESS, FAILED_READ_SECTOR, or FAILED_WRITE_SECTOR.
+ *
+ * Notes       : A line that is waiting to be written is flushed, with every
+ *               line before it in the flush order, before it is reused.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_GetLine(uint32_t secNum, uint8_t cls, uint8_t load,
+                           CacheLine **line)
+{
+  uint8_t    err;
+  uint8_t    clsCnt = 0;
+  CacheLine *victim = NULL;
+
+  ++useCnt;
+  for (uint8_t i = 0; i < FAT_CACHE_SECS; ++i)
+  {
+    CacheLine *ln = &lines[i];
+    if (ln->valid && ln->secNum == secNum)
+    {
+      ln->lastUse = useCnt;
+      *line = ln;
+      return SUCCESS;
+    }
+    if (ln->valid && ln->cls == cls)
+      ++clsCnt;
+  }
+
+  // a sequential read only reuses a clean data line, so it never flushes.
+  if (load && cls == CACHE_DATA && secNum == nextDataSec)
+    victim = pvt_PickVictim(cls, PICK_CLEAN_CLASS);
+  if (!victim && clsCnt >= quotas[cls])
+    victim = pvt_PickVictim(cls, PICK_CLASS);
+  if (!victim)
+    victim = pvt_PickVictim(cls, PICK_ANY);
+
+  if (victim->valid && victim->dirtySeq != CLEAN
+      && (err = pvt_FlushUpTo(victim->cls, victim->dirtySeq)) != SUCCESS)
+    return err;
+
+  victim->valid = 0;
+  victim->loading = 0;
+  if (load)
+  {
+    IoReq req = { secNum, victim->secArr, 1, IOQ_PRIO_NORMAL, IOQ_READ, 0 };
+    if (fat_IoqTransfer(&req) != SUCCESS)
+      return FAILED_READ_SECTOR;
+  }
+
+  victim->secNum = secNum;
+  victim->valid = 1;
+  victim->dirtySeq = CLEAN;
+  victim->lastUse = useCnt;
+  victim->cls = cls;
+  *line = victim;
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                   (PRIVATE) PICK VICTIM LINE
+ *
+ * Description : Chooses the line to give to a sector that is not held in the
+ *               cache, preferring an empty line, then a line not waiting to
+ *               be written, then the least recently used line.
+ *
+ * Arguments   : cls    - Class of the sector. See SECTOR CLASSES.
+ *               pick   - PICK_ANY to choose from every line, PICK_CLASS from
+ *                        the lines of class cls, or PICK_CLEAN_CLASS from the
+ *                        lines of class cls not waiting to be written.
+ *
+ * Returns     : Pointer to the line, or NULL if there is no line to choose
+ *               from.
+ *
+ * Notes       : Lines taken by fat_CacheLoad and not yet read are never
+ *               chosen.
+ * ----------------------------------------------------------------------------
+ */
+static CacheLine *pvt_PickVictim(uint8_t cls, uint8_t pick)
+{
+  CacheLine *victim = NULL;
+
+  for (uint8_t i = 0; i < FAT_CACHE_SECS; ++i)
+  {
+    CacheLine *ln = &lines[i];
+    if (ln->loading)
+      continue;
+    if (pick != PICK_ANY && (!ln->valid || ln->cls != cls))
+      continue;
+    if (pick == PICK_CLEAN_CLASS && ln->dirtySeq != CLEAN)
+      continue;
+
+    if (!victim)
+      victim = ln;
+    else if (victim->valid
+             && (!ln->valid
+                 || (ln->dirtySeq == CLEAN && victim->dirtySeq != CLEAN)
+                 || ((ln->dirtySeq == CLEAN) == (victim->dirtySeq == CLEAN)
+                     && ln->lastUse < victim->lastUse)))
+      victim = ln;
+  }
+  return victim;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                           (PRIVATE) FLUSH CACHE UP TO A LINE
+ *
+ * Description : Writes the lines waiting to be written, in flush order, up to
+ *               and including the line at (cls, dirtySeq) in the order.
+ *               Lines that are next to each other in the order and on the
+ *               disk are written with a single multiple sector write.
+ *
+ * Arguments   : cls        - Class of the last line to write.
+ *               dirtySeq   - dirtySeq of the last line to write.
+ *
+ * Returns     : SUCCESS or FAILED_WRITE_SECTOR.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_FlushUpTo(uint8_t cls, uint32_t dirtySeq)
+{
+  CacheLine *run[FAT_CACHE_SECS];
+  CacheLine *ln;
+
+  while ((ln = pvt_NextToFlush(cls, dirtySeq, NULL)))
+  {
+    uint8_t runLen = 0;
+    uint8_t err;
+
+    // take the lines from the order while each is the sector after the last.
+    do
+    {
+      run[runLen++] = ln;
+      ln = pvt_NextToFlush(cls, dirtySeq, ln);
+    }
+    while (ln && ln->secNum == run[runLen - 1]->secNum + 1);
+
+    if (fat_IoqIsAttached())
+      err = pvt_QueueLines(run, runLen, IOQ_WRITE);
+    else if (runLen == 1)
+      err = FATtoDisk_WriteSingleSector(run[0]->secNum, run[0]->secArr);
+    else
+      err = FATtoDisk_WriteMultipleSectors(run[0]->secNum, runLen,
+                                           pvt_RunSector, run);
+    if (err != WRITE_SECTOR_SUCCESS)
+      return FAILED_WRITE_SECTOR;
+
+    for (uint8_t i = 0; i < runLen; ++i)
+      run[i]->dirtySeq = CLEAN;
+  }
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                 (PRIVATE) NEXT LINE TO FLUSH
+ *
+ * Description : Finds the first line in the flush order that is waiting to
+ *               be written, and is after a line, but not after the line at
+ *               (cls, dirtySeq).
+ *
+ * Arguments   : cls        - Class of the last line that can be returned.
+ *               dirtySeq   - dirtySeq of the last line that can be returned.
+ *               after      - Pointer to the line the returned line must be
+ *                            after in the order. NULL for the first line.
+ *
+ * Returns     : Pointer to the line, or NULL if there is none.
+ * ----------------------------------------------------------------------------
+ */
+static CacheLine *pvt_NextToFlush(uint8_t cls, uint32_t dirtySeq,
+                                  const CacheLine *after)
+{
+  CacheLine *next = NULL;
+
+  for (uint8_t i = 0; i < FAT_CACHE_SECS; ++i)
+  {
+    CacheLine *ln = &lines[i];
+    if (!ln->valid || ln->dirtySeq == CLEAN || ln->cls > cls
+        || (ln->cls == cls && ln->dirtySeq > dirtySeq))
+      continue;
+    if (after && (ln->cls < after->cls
+                  || (ln->cls == after->cls
+                      && ln->dirtySeq <= after->dirtySeq)))
+      continue;
+    if (!next || ln->cls < next->cls
+        || (ln->cls == next->cls && ln->dirtySeq < next->dirtySeq))
+      next = ln;
+  }
+  return next;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                    (PRIVATE) RUN SECTOR DATA
+ *
+ * Description : FatSectorSrcFn that returns the data of each line of a run
+ *               being written by pvt_FlushUpTo.
+ *
+ * Arguments   : secIndx  - Index of the sector in the run.
+ *               arg      - Pointer to the array of lines in the run.
+ *
+ * Returns     : Pointer to the sector data of the line.
+ * ----------------------------------------------------------------------------
+ */
+static const uint8_t *pvt_RunSector(uint32_t secIndx, void *arg)
+{
+  CacheLine **run = arg;
+  return run[secIndx]->secArr;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                   (PRIVATE) LOAD SECTOR DATA
+ *
+ * Description : FatSectorFn that copies each sector read by fat_CacheLoad to
+ *               the line taken for it. Sectors that were already held are
+ *               skipped.
+ *
+ * Arguments   : secArr   - Pointer to the array holding the sector.
+ *               arg      - Pointer to the LoadArg of the fat_CacheLoad.
+ *
+ * Returns     : 0 to continue reading.
+ *
+ * Notes       : This is called during the multiple sector read, so it must
+ *               not use the disk, i.e. it never takes or flushes a line.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_LoadSector(const uint8_t secArr[], void *arg)
+{
+  LoadArg *load = arg;
+  uint32_t secNum = load->secNum++;
+
+  for (uint8_t i = 0; i < FAT_CACHE_SECS; ++i)
+    if (lines[i].valid && lines[i].loading && lines[i].secNum == secNum)
+    {
+      memcpy(lines[i].secArr, secArr, SECTOR_LEN);
+      lines[i].loading = 0;
+      break;
+    }
+  return 0;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                     (PRIVATE) IS SECTOR HELD
+ *
+ * Description : Checks whether a sector is held in the cache.
+ *
+ * Arguments   : secNum   - Block number of the sector on the disk.
+ *
+ * Returns     : 1 if the sector is held, otherwise 0.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_IsHeld(uint32_t secNum)
+{
+  for (uint8_t i = 0; i < FAT_CACHE_SECS; ++i)
+    if (lines[i].valid && lines[i].secNum == secNum)
+      return 1;
+  return 0;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           (PRIVATE) END LOAD
+ *
+ * Description : Frees the lines taken by fat_CacheLoad that were not read,
+ *               e.g. after a failed read.
+ *
+ * Arguments   : void
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+static void pvt_EndLoad(void)
+{
+  for (uint8_t i = 0; i < FAT_CACHE_SECS; ++i)
+    if (lines[i].loading)
+    {
+      lines[i].valid = 0;
+      lines[i].loading = 0;
+    }
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                    (PRIVATE) QUEUE LINE DATA
+ *
+ * Description : Reads or writes the sectors of lines through the I/O queue
+ *               attached by fat_IoqAttach, as one request for each line at
+ *               IOQ_PRIO_NORMAL, and waits for all of them. Lines next to
+ *               each other on the disk are merged into one transfer by the
+ *               queue.
+ *
+ * Arguments   : lineArr   - Pointer to the array of lines.
+ *               lineCnt   - Number of lines. Not more than FAT_CACHE_SECS.
+ *               op        - IOQ_READ or IOQ_WRITE.
+ *
+ * Returns     : SUCCESS, FAILED_READ_SECTOR or FAILED_WRITE_SECTOR if any
+ *               of the sectors failed.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_QueueLines(CacheLine *lineArr[], uint8_t lineCnt,
+                              uint8_t op)
+{
+  uint8_t status = SUCCESS;
+  IoReq   reqArr[FAT_CACHE_SECS];
+
+  for (uint8_t i = 0; i < lineCnt; ++i)
+  {
+    reqArr[i].secNum = lineArr[i]->secNum;
+    reqArr[i].secArr = lineArr[i]->secArr;
+    reqArr[i].numOfSecs = 1;
+    reqArr[i].prio = IOQ_PRIO_NORMAL;
+    reqArr[i].op = op;
+    fat_IoqSend(&reqArr[i]);
+  }
+
+  // every request is waited for, as each one points to its line.
+  for (uint8_t i = 0; i < lineCnt; ++i)
+  {
+    uint8_t err;
+    while ((err = fat_IoqPoll(&reqArr[i])) == STEP_BUSY)
+      ;
+    if (err != SUCCESS)
+      status = err;
+  }
+  return status;
+}
@@ -0,0 +1,531 @@
+/*
+ * File       : FAT_IOQ.C
+ * Version    : 2.0
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Implementation of FAT_IOQ.H
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "fat_bpb.h"
+#include "fat.h"
+#include "fat_to_disk_if.h"
+#include "fat_ioq.h"
+
+/*
+ ******************************************************************************
+ *                 "PRIVATE" FUNCTION PROTOTYPES (and MACROS)
+ ******************************************************************************
+ */
+
+//
+// the requests merged into a single transfer, in order on the disk, and the
+// position in them of the next sector to transfer.
+//
+typedef struct
+{
+  IoReq   *reqArr[IOQ_LEN_MAX];
+  uint8_t  cnt;
+  uint8_t  reqIndx;
+  uint16_t secInReq;
+}
+IoRun;
+
+// queue the FAT modules send their transfers to, or NULL.
+static FatIoq *attachedQ;
+
+static uint8_t pvt_IsBlocked(const FatIoq *q, uint8_t indx);
+static uint8_t pvt_SelectReq(FatIoq *q);
+static void pvt_MergeReqs(const FatIoq *q, IoRun *run);
+static uint8_t pvt_LoadSector(const uint8_t secArr[], void *arg);
+static const uint8_t *pvt_NextSector(uint32_t secIndx, void *arg);
+
+/*
+ ******************************************************************************
+ *                                FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                         INITIALIZE I/O QUEUE
+ *
+ * Description : Sets a FatIoq instance to an empty queue.
+ *
+ * Arguments   : q    - Pointer to the FatIoq instance to be set.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void fat_IoqInit(FatIoq *q)
+{
+  q->cnt = 0;
+  q->upward = 1;
+  q->headSecNum = 0;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           SUBMIT I/O REQUEST
+ *
+ * Description : Adds a request to the queue. The request is transferred by a
+ *               later call to fat_IoqService or fat_IoqWait.
+ *
+ * Arguments   : q      - Pointer to a FatIoq instance.
+ *               req    - Pointer to the request. Its secNum, secArr,
+ *                        numOfSecs, prio and op members must be set.
+ *
+ * Returns     : SUCCESS, IOQ_FULL if IOQ_LEN_MAX requests are queued, or
+ *               IOQ_INVALID_REQ if numOfSecs is 0, or prio or op is not
+ *               valid.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_IoqSubmit(FatIoq *q, IoReq *req)
+{
+  if (!req->numOfSecs || req->prio >= IOQ_PRIO_CNT
+      || (req->op != IOQ_READ && req->op != IOQ_WRITE))
+    return IOQ_INVALID_REQ;
+  if (q->cnt == IOQ_LEN_MAX)
+    return IOQ_FULL;
+
+  req->status = STEP_BUSY;
+  q->reqArr[q->cnt++] = req;
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            SERVICE I/O QUEUE
+ *
+ * Description : Makes a single transfer to or from the disk. The request
+ *               transferred is the next one, in elevator order, of the
+ *               highest priority with a request that can be transferred.
+ *               Queued requests of the same priority and operation that
+ *               are next to it on the disk are merged into the transfer.
+ *
+ * Arguments   : q      - Pointer to a FatIoq instance.
+ *
+ * Returns     : Number of requests still queued.
+ *
+ * Notes       : 1) This is meant to be called from the main loop, so the
+ *                  disk is only used for one transfer at a time.
+ *               2) A request is not transferred before an older request
+ *                  for any of the same sectors, if either one is a write, so
+ *                  a read always returns the data of the writes submitted
+ *                  before it.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_IoqService(FatIoq *q)
+{
+  IoRun    run;
+  IoReq   *first;
+  uint8_t  status;
+  uint16_t numOfSecs = 0;
+
+  if (!q->cnt)
+    return 0;
+
+  run.reqArr[0] = q->reqArr[pvt_SelectReq(q)];
+  run.cnt = 1;
+  run.reqIndx = 0;
+  run.secInReq = 0;
+  pvt_MergeReqs(q, &run);
+  first = run.reqArr[0];                    // first on the disk
+  for (uint8_t i = 0; i < run.cnt; ++i)
+    numOfSecs += run.reqArr[i]->numOfSecs;
+
+  //
+  // a single sector is transferred straight to or from the request's array.
+  // Otherwise the merged requests are transferred with a single multiple
+  // sector transfer, and each sector is copied to or taken from its request.
+  //
+  if (first->op == IOQ_READ)
+  {
+    uint8_t err;
+    if (numOfSecs == 1)
+      err = FATtoDisk_ReadSingleSector(first->secNum, first->secArr);
+    else
+    {
+      uint8_t secArr[SECTOR_LEN];
+      err = FATtoDisk_ReadMultipleSectors(first->secNum, numOfSecs, secArr,
+                                          pvt_LoadSector, &run);
+    }
+    status = (err == READ_SECTOR_SUCCESS) ? SUCCESS : FAILED_READ_SECTOR;
+  }
+  else
+  {
+    uint8_t err;
+    if (numOfSecs == 1)
+      err = FATtoDisk_WriteSingleSector(first->secNum, first->secArr);
+    else
+      err = FATtoDisk_WriteMultipleSectors(first->secNum, numOfSecs,
+                                           pvt_NextSector, &run);
+    status = (err == WRITE_SECTOR_SUCCESS) ? SUCCESS : FAILED_WRITE_SECTOR;
+  }
+
+  // remove the transferred requests, keeping the rest in submitted order.
+  uint8_t kept = 0;
+  for (uint8_t i = 0; i < q->cnt; ++i)
+  {
+    uint8_t inRun = 0;
+    for (uint8_t j = 0; j < run.cnt; ++j)
+      if (q->reqArr[i] == run.reqArr[j])
+        inRun = 1;
+    if (!inRun)
+      q->reqArr[kept++] = q->reqArr[i];
+  }
+  q->cnt = kept;
+
+  for (uint8_t j = 0; j < run.cnt; ++j)
+    run.reqArr[j]->status = status;
+
+  q->headSecNum = q->upward ? first->secNum + numOfSecs : first->secNum;
+  return q->cnt;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                         WAIT FOR I/O REQUEST
+ *
+ * Description : Services the queue until a request has been transferred.
+ *
+ * Arguments   : q      - Pointer to a FatIoq instance.
+ *               req    - Pointer to a request submitted to q.
+ *
+ * Returns     : The status of the request. SUCCESS, FAILED_READ_SECTOR or
+ *               FAILED_WRITE_SECTOR.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_IoqWait(FatIoq *q, IoReq *req)
+{
+  while (req->status == STEP_BUSY && fat_IoqService(q))
+    ;
+  return req->status;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             ATTACH I/O QUEUE
+ *
+ * Description : Sets the queue the FAT modules send their transfers to. The
+ *               sector cache of FAT_CACHE.H sends its reads and writes at
+ *               IOQ_PRIO_NORMAL, and FatStream and FatRing send their writes
+ *               at IOQ_PRIO_RT, so the sectors of a logger are written before
+ *               those of, e.g., a directory listing.
+ *
+ * Arguments   : q      - Pointer to a FatIoq instance set by fat_IoqInit, or
+ *                        NULL for the modules to use the disk directly.
+ *
+ * Returns     : void
+ *
+ * Notes       : 1) The queue is serviced by the modules while they wait for
+ *                  their requests, and by each fat_StreamService, so the
+ *                  application does not have to call fat_IoqService.
+ *               2) FatPlay, fat_ProbeRun and the multiple sector reads of
+ *                  FAT.H still use the disk directly.
+ *
+ * Warnings    : Only change the attached queue while it is empty and no
+ *               FatStream is open.
+ * ----------------------------------------------------------------------------
+ */
+void fat_IoqAttach(FatIoq *q)
+{
+  attachedQ = q;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                        IS I/O QUEUE ATTACHED
+ *
+ * Description : Checks if a queue has been attached by fat_IoqAttach.
+ *
+ * Arguments   : void
+ *
+ * Returns     : 1 if a queue is attached, otherwise 0.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_IoqIsAttached(void)
+{
+  return attachedQ != NULL;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             SEND I/O REQUEST
+ *
+ * Description : Submits a request to the attached queue. If the queue is
+ *               full, it is serviced until there is room.
+ *
+ * Arguments   : req    - Pointer to the request, as for fat_IoqSubmit.
+ *
+ * Returns     : SUCCESS or IOQ_INVALID_REQ.
+ *
+ * Warnings    : Only call while a queue is attached.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_IoqSend(IoReq *req)
+{
+  uint8_t err;
+
+  while ((err = fat_IoqSubmit(attachedQ, req)) == IOQ_FULL)
+    fat_IoqService(attachedQ);
+  return err;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             POLL I/O REQUEST
+ *
+ * Description : Makes a single transfer of the attached queue if a request
+ *               sent to it is still queued.
+ *
+ * Arguments   : req    - Pointer to a request sent by fat_IoqSend.
+ *
+ * Returns     : The status of the request. STEP_BUSY while it is queued,
+ *               then SUCCESS, FAILED_READ_SECTOR or FAILED_WRITE_SECTOR.
+ *
+ * Notes       : The transfer made may be of another request of a higher
+ *               priority, or nearer the elevator.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_IoqPoll(const IoReq *req)
+{
+  if (req->status == STEP_BUSY && attachedQ)
+    fat_IoqService(attachedQ);
+  return req->status;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                         TRANSFER I/O REQUEST
+ *
+ * Description : Transfers a request and waits for it. It is sent to the
+ *               attached queue if there is one, otherwise it is transferred
+ *               directly.
+ *
+ * Arguments   : req    - Pointer to the request, as for fat_IoqSubmit.
+ *
+ * Returns     : SUCCESS, FAILED_READ_SECTOR, FAILED_WRITE_SECTOR or
+ *               IOQ_INVALID_REQ.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_IoqTransfer(IoReq *req)
+{
+  uint8_t err;
+  FatIoq  q;
+
+  if (attachedQ)
+  {
+    if ((err = fat_IoqSend(req)) != SUCCESS)
+      return err;
+    return fat_IoqWait(attachedQ, req);
+  }
+
+  // a queue of one request makes the same transfer fat_IoqService would.
+  fat_IoqInit(&q);
+  if ((err = fat_IoqSubmit(&q, req)) != SUCCESS)
+    return err;
+  return fat_IoqWait(&q, req);
+}
+
+/*
+ ******************************************************************************
+ *                           "PRIVATE" FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                 (PRIVATE) REQUEST IS BLOCKED
+ *
+ * Description : Determines if a queued request must wait for an older one
+ *               because they are for some of the same sectors, and one of
+ *               them is a write.
+ *
+ * Arguments   : q       - Pointer to a FatIoq instance.
+ *               indx    - Index of the request in q->reqArr.
+ *
+ * Returns     : 1 if the request is blocked, otherwise 0.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_IsBlocked(const FatIoq *q, uint8_t indx)
+{
+  const IoReq *req = q->reqArr[indx];
+
+  for (uint8_t i = 0; i < indx; ++i)
+  {
+    const IoReq *old = q->reqArr[i];
+    if ((req->op == IOQ_WRITE || old->op == IOQ_WRITE)
+        && req->secNum < old->secNum + old->numOfSecs
+        && old->secNum < req->secNum + req->numOfSecs)
+      return 1;
+  }
+  return 0;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                     (PRIVATE) SELECT REQUEST
+ *
+ * Description : Selects the next request to transfer. This is the request
+ *               nearest the elevator, in its direction, of the highest
+ *               priority with a request that is not blocked. If there is none
+ *               in that direction, the elevator changes direction.
+ *
+ * Arguments   : q       - Pointer to a FatIoq instance. Must not be empty.
+ *
+ * Returns     : Index of the request in q->reqArr.
+ *
+ * Notes       : The oldest request is never blocked, so one is always found.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_SelectReq(FatIoq *q)
+{
+  uint8_t prio = IOQ_PRIO_CNT;
+  uint8_t best = IOQ_LEN_MAX;
+  uint8_t canSel[IOQ_LEN_MAX];
+
+  for (uint8_t i = 0; i < q->cnt; ++i)
+  {
+    canSel[i] = !pvt_IsBlocked(q, i);
+    if (canSel[i] && q->reqArr[i]->prio < prio)
+      prio = q->reqArr[i]->prio;
+  }
+  for (uint8_t i = 0; i < q->cnt; ++i)
+    canSel[i] = canSel[i] && q->reqArr[i]->prio == prio;
+
+  for (uint8_t pass = 0; pass < 2 && best == IOQ_LEN_MAX; ++pass)
+  {
+    if (pass)
+      q->upward = !q->upward;
+
+    for (uint8_t i = 0; i < q->cnt; ++i)
+    {
+      uint32_t secNum = q->reqArr[i]->secNum;
+      if (!canSel[i])
+        continue;
+      if (q->upward)
+      {
+        if (secNum >= q->headSecNum
+            && (best == IOQ_LEN_MAX || secNum < q->reqArr[best]->secNum))
+          best = i;
+      }
+      else if (secNum < q->headSecNum
+               && (best == IOQ_LEN_MAX || secNum > q->reqArr[best]->secNum))
+        best = i;
+    }
+  }
+  return best;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                     (PRIVATE) MERGE REQUESTS
+ *
+ * Description : Adds the queued requests that are next to a run on the disk,
+ *               before or after it, and have the same priority and operation
+ *               as its requests, to the run. Stops when no request is next to
+ *               it, or adding one would make the run longer than
+ *               IOQ_MERGE_MAX.
+ *
+ * Arguments   : q       - Pointer to a FatIoq instance.
+ *               run     - Pointer to the run. Must hold the selected request.
+ *
+ * Returns     : void
+ *
+ * Notes       : Requests before the run are merged too, so the elevator
+ *               still makes a single transfer of adjacent requests when it
+ *               is moving down.
+ * ----------------------------------------------------------------------------
+ */
+static void pvt_MergeReqs(const FatIoq *q, IoRun *run)
+{
+  const IoReq *sel = run->reqArr[0];
+  uint32_t startSecNum = sel->secNum;
+  uint32_t endSecNum = sel->secNum + sel->numOfSecs;
+
+  for (uint8_t i = 0; i < q->cnt; )
+  {
+    IoReq *req = q->reqArr[i];
+    if (req->op != sel->op || req->prio != sel->prio
+        || endSecNum - startSecNum + req->numOfSecs > IOQ_MERGE_MAX
+        || pvt_IsBlocked(q, i))
+      ++i;
+    else if (req->secNum == endSecNum)
+    {
+      run->reqArr[run->cnt++] = req;
+      endSecNum += req->numOfSecs;
+      i = 0;                            // look for one next to it again
+    }
+    else if (req->secNum + req->numOfSecs == startSecNum)
+    {
+      memmove(&run->reqArr[1], &run->reqArr[0],
+              run->cnt++ * sizeof(run->reqArr[0]));
+      run->reqArr[0] = req;
+      startSecNum = req->secNum;
+      i = 0;
+    }
+    else
+      ++i;
+  }
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                   (PRIVATE) LOAD READ SECTOR
+ *
+ * Description : FatSectorFn that copies each sector of a multiple sector read
+ *               into the array of the request it belongs to.
+ *
+ * Arguments   : secArr  - Pointer to the array holding the sector.
+ *               arg     - Pointer to the IoRun of the transfer.
+ *
+ * Returns     : 0, to read every sector.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_LoadSector(const uint8_t secArr[], void *arg)
+{
+  IoRun *run = arg;
+  IoReq *req = run->reqArr[run->reqIndx];
+
+  memcpy(&req->secArr[(uint32_t)run->secInReq * SECTOR_LEN], secArr,
+         SECTOR_LEN);
+  if (++run->secInReq == req->numOfSecs)
+  {
+    ++run->reqIndx;
+    run->secInReq = 0;
+  }
+  return 0;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                  (PRIVATE) NEXT WRITE SECTOR
+ *
+ * Description : FatSectorSrcFn that returns each sector of a multiple sector
+ *               write from the array of the request it belongs to.
+ *
+ * Arguments   : secIndx - Index of the sector in the write. Not used, as the
+ *                         sectors are requested in order.
+ *               arg     - Pointer to the IoRun of the transfer.
+ *
+ * Returns     : Pointer to the sector in the request's array.
+ * ----------------------------------------------------------------------------
+ */
+static const uint8_t *pvt_NextSector(uint32_t secIndx, void *arg)
+{
+  IoRun *run = arg;
+  IoReq *req = run->reqArr[run->reqIndx];
+  const uint8_t *secArr = &req->secArr[(uint32_t)run->secInReq * SECTOR_LEN];
+
+  (void)secIndx;
+  if (++run->secInReq == req->numOfSecs)
+  {
+    ++run->reqIndx;
+    run->secInReq = 0;
+  }
+  return secArr;
+}
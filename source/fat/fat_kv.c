@@ -0,0 +1,845 @@
+/*
+ * File       : FAT_KV.C
+ * Version    : 2.0
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Implementation of FAT_KV.H
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "fat_bpb.h"
+#include "fat.h"
+#include "fat_cache.h"
+#include "fat_kv.h"
+
+/*
+ ******************************************************************************
+ *                 "PRIVATE" FUNCTION PROTOTYPES (and MACROS)
+ ******************************************************************************
+ */
+
+static uint8_t pvt_Write(FatKv *kv, const char keyStr[], const uint8_t valArr[],
+                         uint8_t valLen, const BPB *bpb);
+static uint8_t pvt_FindSlot(FatKv *kv, const uint8_t keyArr[], uint8_t keyLen,
+                            uint8_t *slot, const BPB *bpb);
+static uint8_t pvt_Replay(FatKv *kv, uint32_t snapEnd, const BPB *bpb);
+static uint8_t pvt_Append(FatFile *file, uint32_t gen, uint32_t *tailPos,
+                          const uint8_t recArr[], uint8_t recLen,
+                          uint32_t *recPos, const BPB *bpb);
+static uint8_t pvt_ReadRec(FatFile *file, uint32_t pos, uint8_t recArr[],
+                           uint8_t *recLen, const BPB *bpb);
+static uint8_t pvt_RecLen(const uint8_t recArr[], uint16_t avail);
+static uint8_t pvt_ReadHdr(FatFile *file, uint8_t hdrArr[], const BPB *bpb);
+static uint8_t pvt_WriteHdr(FatFile *file, uint32_t gen, uint32_t snapEnd,
+                            const FatFile *prev, const BPB *bpb);
+static uint16_t pvt_Hash(const uint8_t keyArr[], uint8_t keyLen);
+static uint8_t pvt_Crc8(const uint8_t arr[], uint8_t len);
+static void pvt_Store32(uint8_t arr[], uint32_t val);
+
+// states of a compaction
+#define COMPACT_IDLE      0
+#define COMPACT_SLOTS     1
+#define COMPACT_TAIL      2
+
+// generation in a header whose magic is valid, or 0.
+#define HDR_GEN(HDR)      (memcmp(HDR, KV_MAGIC, KV_MAGIC_LEN) ? 0 \
+                           : LOAD_LE32(&HDR[KV_HDR_GEN_POS]))
+
+/*
+ ******************************************************************************
+ *                                FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                              FORMAT KV STORE
+ *
+ * Description : Writes the headers of an empty store to the two files, and
+ *               then mounts it.
+ *
+ * Arguments   : kv        - Pointer to the FatKv instance to be set.
+ *               dir       - Pointer to a FatDir instance. This directory must
+ *                           contain the entries of both files.
+ *               storeStr  - Pointer to a string. Name of the store file.
+ *               tempStr   - Pointer to a string. Name of the second file.
+ *               bpb       - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, KV_NOT_FORMATTED if either file is less than two
+ *               sectors long, or a FAT Error Flag.
+ *
+ * Notes       : 1) The files must already exist. Their size is the capacity
+ *                  of the store and is never changed.
+ *               2) Any contents of the store are lost.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_KvFormat(FatKv *kv, const FatDir *dir, const char storeStr[],
+                     const char tempStr[], const BPB *bpb)
+{
+  uint8_t err;
+  uint8_t hdrArr[KV_HDR_LEN];
+  uint32_t gen = 0;
+
+  for (uint8_t f = 0; f < 2; ++f)
+  {
+    if ((err = fat_OpenFile(&kv->files[f], dir, f ? tempStr : storeStr, bpb))
+        != SUCCESS)
+      return err;
+    if (kv->files[f].fileSize < 2 * (uint32_t)BPB_BYTES_PER_SEC(bpb))
+      return KV_NOT_FORMATTED;
+
+    //
+    // log sectors left from a previous store must not match the generation
+    // of the new store, so it is higher than any found in the headers.
+    //
+    if ((err = pvt_ReadHdr(&kv->files[f], hdrArr, bpb)) != SUCCESS)
+      return err;
+    if (HDR_GEN(hdrArr) > gen)
+      gen = HDR_GEN(hdrArr);
+  }
+
+  if ((err = pvt_WriteHdr(&kv->files[1], 0, 0, &kv->files[1], bpb))
+      != SUCCESS)
+    return err;
+  if ((err = pvt_WriteHdr(&kv->files[0], gen + 1, BPB_BYTES_PER_SEC(bpb),
+                          &kv->files[1], bpb)) != SUCCESS)
+    return err;
+
+  return fat_KvMount(kv, dir, storeStr, tempStr, bpb);
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                               MOUNT KV STORE
+ *
+ * Description : Opens the two files of a store and builds its hash index by
+ *               replaying the snapshot and then the rest of the log.
+ *
+ * Arguments   : kv        - Pointer to the FatKv instance to be set.
+ *               dir       - Pointer to a FatDir instance. This directory must
+ *                           contain the entries of both files.
+ *               storeStr  - Pointer to a string. Name of the store file.
+ *               tempStr   - Pointer to a string. Name of the second file.
+ *               bpb       - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, KV_NOT_FORMATTED, KV_INDEX_FULL, or a FAT Error
+ *               Flag.
+ *
+ * Notes       : If a compaction was interrupted after the second file was
+ *               complete, the swap of the directory entries is finished here.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_KvMount(FatKv *kv, const FatDir *dir, const char storeStr[],
+                    const char tempStr[], const BPB *bpb)
+{
+  uint8_t err;
+  uint8_t hdrArr[2][KV_HDR_LEN];
+
+  for (uint8_t f = 0; f < 2; ++f)
+  {
+    if ((err = fat_OpenFile(&kv->files[f], dir, f ? tempStr : storeStr, bpb))
+        != SUCCESS)
+      return err;
+    if (kv->files[f].fileSize < 2 * (uint32_t)BPB_BYTES_PER_SEC(bpb))
+      return KV_NOT_FORMATTED;
+  }
+
+  if ((err = pvt_ReadHdr(&kv->files[0], hdrArr[0], bpb)) != SUCCESS)
+    return err;
+  if (!HDR_GEN(hdrArr[0]))
+    return KV_NOT_FORMATTED;
+
+  //
+  // if the swap was interrupted between the writes of two entries, both
+  // point to the new store. Its header holds the clusters of the old one.
+  //
+  if (kv->files[0].fstClusIndx == kv->files[1].fstClusIndx
+      && (err = fat_SetFileEntry(&kv->files[1],
+                        LOAD_LE32(&hdrArr[0][KV_HDR_PREV_CLUS_POS]),
+                        LOAD_LE32(&hdrArr[0][KV_HDR_PREV_SIZE_POS]), bpb))
+         != SUCCESS)
+    return err;
+
+  //
+  // a complete second file with a higher generation means a compaction was
+  // interrupted before the swap. Its header is written last, after all of
+  // its records, so it can be swapped in now.
+  //
+  if ((err = pvt_ReadHdr(&kv->files[1], hdrArr[1], bpb)) != SUCCESS)
+    return err;
+  if (HDR_GEN(hdrArr[1]) > HDR_GEN(hdrArr[0])
+      && LOAD_LE32(&hdrArr[1][KV_HDR_SNAP_END_POS]))
+  {
+    if ((err = fat_SwapFiles(&kv->files[0], &kv->files[1], bpb)) != SUCCESS)
+      return err;
+    memcpy(hdrArr[0], hdrArr[1], KV_HDR_LEN);
+  }
+
+  kv->gen = HDR_GEN(hdrArr[0]);
+  kv->topGen = kv->gen;
+  if (HDR_GEN(hdrArr[1]) > kv->topGen)
+    kv->topGen = HDR_GEN(hdrArr[1]);
+  kv->compPhase = COMPACT_IDLE;
+
+  return pvt_Replay(kv, LOAD_LE32(&hdrArr[0][KV_HDR_SNAP_END_POS]), bpb);
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                GET KEY VALUE
+ *
+ * Description : Loads the value of a key into an array.
+ *
+ * Arguments   : kv       - Pointer to a mounted FatKv instance.
+ *               keyStr   - Pointer to the key string.
+ *               valArr   - Pointer to the array that will be loaded with the
+ *                          value. Must be at least KV_VAL_LEN_MAX long.
+ *               valLen   - Pointer to the value's length, set here.
+ *               bpb      - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, KV_KEY_NOT_FOUND, KV_INVALID_KEY, or a FAT Error
+ *               Flag.
+ *
+ * Notes       : Reads the sector holding the key's record, only.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_KvGet(FatKv *kv, const char keyStr[], uint8_t valArr[],
+                  uint8_t *valLen, const BPB *bpb)
+{
+  uint8_t err, slot, recLen;
+  uint8_t recArr[KV_REC_LEN_MAX];
+  size_t  keyLen = strlen(keyStr);
+
+  if (keyLen == 0 || keyLen > KV_KEY_LEN_MAX)
+    return KV_INVALID_KEY;
+
+  if ((err = pvt_FindSlot(kv, (const uint8_t *)keyStr, keyLen, &slot, bpb))
+      != SUCCESS)
+    return err;
+  if (kv->slotPos[slot] & KV_DELETED_FLAG)
+    return KV_KEY_NOT_FOUND;
+
+  if ((err = pvt_ReadRec(&kv->files[0], kv->slotPos[slot], recArr, &recLen,
+                         bpb)) != SUCCESS)
+    return err;
+  if (!recLen)
+    return KV_KEY_NOT_FOUND;
+
+  *valLen = recArr[1];
+  memcpy(valArr, &recArr[KV_REC_HDR_LEN + keyLen], *valLen);
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                PUT KEY VALUE
+ *
+ * Description : Sets the value of a key, adding the key if it does not exist.
+ *
+ * Arguments   : kv       - Pointer to a mounted FatKv instance.
+ *               keyStr   - Pointer to the key string. 1 to KV_KEY_LEN_MAX
+ *                          characters.
+ *               valArr   - Pointer to the array holding the value.
+ *               valLen   - Length of the value. 0 to KV_VAL_LEN_MAX.
+ *               bpb      - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, KV_INVALID_KEY, KV_VALUE_TOO_LONG if valLen is more
+ *               than KV_VAL_LEN_MAX, KV_INDEX_FULL, KV_STORE_FULL, or a FAT
+ *               Error Flag.
+ *
+ * Notes       : 1) Appends one record to the log. This writes the last sector
+ *                  of the log, which is read first unless the record starts
+ *                  a new sector.
+ *               2) If KV_STORE_FULL is returned, the store must be compacted
+ *                  by calling fat_KvCompactStep before the put is retried.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_KvPut(FatKv *kv, const char keyStr[], const uint8_t valArr[],
+                  uint8_t valLen, const BPB *bpb)
+{
+  if (valLen > KV_VAL_LEN_MAX)
+    return KV_VALUE_TOO_LONG;
+  return pvt_Write(kv, keyStr, valArr, valLen, bpb);
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                   DELETE KEY
+ *
+ * Description : Deletes a key from the store by appending a tombstone record.
+ *
+ * Arguments   : kv       - Pointer to a mounted FatKv instance.
+ *               keyStr   - Pointer to the key string.
+ *               bpb      - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, KV_KEY_NOT_FOUND, KV_INVALID_KEY, KV_STORE_FULL, or
+ *               a FAT Error Flag.
+ *
+ * Notes       : The key's index slot is not freed until the next compaction.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_KvDelete(FatKv *kv, const char keyStr[], const BPB *bpb)
+{
+  return pvt_Write(kv, keyStr, NULL, KV_TOMBSTONE, bpb);
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           STEP KV COMPACTION
+ *
+ * Description : Performs one step of a compaction of the store, beginning one
+ *               if the log is more than KV_COMPACT_PCT percent of the store
+ *               file. Each step copies one live record into the second file.
+ *               The last step writes its header, swaps the directory entries
+ *               of the two files, and rebuilds the index from the new store.
+ *
+ * Arguments   : kv       - Pointer to a mounted FatKv instance.
+ *               bpb      - Pointer to the BPB struct instance.
+ *
+ * Returns     : KV_COMPACTING while a compaction is in progress. SUCCESS if
+ *               none is in progress, or one was just finished. KV_STORE_FULL
+ *               if the live records do not fit in the second file, in which
+ *               case the compaction is abandoned. Otherwise a FAT Error Flag.
+ *
+ * Notes       : 1) Gets, puts and deletes can be called between steps. Any
+ *                  records appended to the store after a compaction begins
+ *                  are copied in order after the index slots.
+ *               2) If a compaction is interrupted, e.g. by a power loss, the
+ *                  store is unchanged, or the swap is finished when the store
+ *                  is next mounted.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_KvCompactStep(FatKv *kv, const BPB *bpb)
+{
+  uint8_t  err, recLen;
+  uint8_t  recArr[KV_REC_LEN_MAX];
+  uint32_t recPos;
+  FatFile *store = &kv->files[0];
+  FatFile *temp = &kv->files[1];
+
+  if (kv->compPhase == COMPACT_IDLE)
+  {
+    uint32_t logLen = kv->tailPos - BPB_BYTES_PER_SEC(bpb);
+    uint32_t logCap = store->fileSize - BPB_BYTES_PER_SEC(bpb);
+    if (logLen / KV_COMPACT_PCT < logCap / 100)
+      return SUCCESS;
+
+    //
+    // the generation is recorded in the second file's header, and synced to
+    // the disk, before any of its records are written, so that an interrupted
+    // compaction never leaves records with a generation that a later store
+    // will use.
+    //
+    if ((err = pvt_WriteHdr(temp, ++kv->topGen, 0, store, bpb)) != SUCCESS
+        || (err = fat_Sync()) != SUCCESS)
+      return err;
+
+    kv->compSlot = 0;
+    kv->compSrcPos = kv->tailPos;
+    kv->compDstPos = BPB_BYTES_PER_SEC(bpb);
+    kv->compPhase = COMPACT_SLOTS;
+    return KV_COMPACTING;
+  }
+
+  if (kv->compPhase == COMPACT_SLOTS)
+  {
+    // skip empty slots and deleted keys.
+    while (kv->compSlot < KV_INDEX_SLOTS
+           && (!kv->slotHash[kv->compSlot]
+               || (kv->slotPos[kv->compSlot] & KV_DELETED_FLAG)))
+      ++kv->compSlot;
+
+    if (kv->compSlot == KV_INDEX_SLOTS)
+    {
+      kv->compSnapEnd = kv->compDstPos;
+      kv->compPhase = COMPACT_TAIL;
+      return KV_COMPACTING;
+    }
+
+    recPos = kv->slotPos[kv->compSlot++];
+  }
+  else
+  {
+    if (kv->compSrcPos >= kv->tailPos)
+    {
+      //
+      // all records are copied. Sync them to the disk, then write the header
+      // that makes the second file a valid store, and swap the entries so it
+      // becomes the store.
+      //
+      kv->compPhase = COMPACT_IDLE;
+      if ((err = fat_Sync()) != SUCCESS)
+        return err;
+      if ((err = pvt_WriteHdr(temp, kv->topGen, kv->compSnapEnd, store, bpb))
+          != SUCCESS)
+        return err;
+      if ((err = fat_SwapFiles(store, temp, bpb)) != SUCCESS)
+        return err;
+
+      kv->gen = kv->topGen;
+      return pvt_Replay(kv, kv->compSnapEnd, bpb);
+    }
+
+    // skip the generation at the start of each log sector.
+    if (BPB_POS_IN_SEC(bpb, kv->compSrcPos) == 0)
+      kv->compSrcPos += KV_SEC_HDR_LEN;
+    recPos = kv->compSrcPos;
+  }
+
+  if ((err = pvt_ReadRec(store, recPos, recArr, &recLen, bpb)) != SUCCESS)
+    return err;
+
+  // no more records in the sector holding the position.
+  if (!recLen)
+  {
+    if (kv->compPhase == COMPACT_TAIL)
+      kv->compSrcPos += BPB_BYTES_PER_SEC(bpb)
+                        - BPB_POS_IN_SEC(bpb, kv->compSrcPos);
+    return KV_COMPACTING;
+  }
+
+  if ((err = pvt_Append(temp, kv->topGen, &kv->compDstPos, recArr, recLen,
+                        &recPos, bpb)) != SUCCESS)
+  {
+    if (err == KV_STORE_FULL)
+      kv->compPhase = COMPACT_IDLE;
+    return err;
+  }
+
+  if (kv->compPhase == COMPACT_TAIL)
+    kv->compSrcPos += recLen;
+  return KV_COMPACTING;
+}
+
+/*
+ ******************************************************************************
+ *                           "PRIVATE" FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                   (PRIVATE) WRITE KEY RECORD
+ *
+ * Description : Appends a record for a key to the store and points the key's
+ *               index slot at it.
+ *
+ * Arguments   : kv       - Pointer to a mounted FatKv instance.
+ *               keyStr   - Pointer to the key string.
+ *               valArr   - Pointer to the array holding the value.
+ *               valLen   - Length of the value, or KV_TOMBSTONE to delete.
+ *               bpb      - Pointer to the BPB struct instance.
+ *
+ * Returns     : Same as fat_KvPut and fat_KvDelete.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_Write(FatKv *kv, const char keyStr[], const uint8_t valArr[],
+                         uint8_t valLen, const BPB *bpb)
+{
+  uint8_t  err, slot;
+  uint8_t  recArr[KV_REC_LEN_MAX];
+  uint32_t recPos;
+  size_t   keyLen = strlen(keyStr);
+
+  if (keyLen == 0 || keyLen > KV_KEY_LEN_MAX)
+    return KV_INVALID_KEY;
+
+  err = pvt_FindSlot(kv, (const uint8_t *)keyStr, keyLen, &slot, bpb);
+  if (err == KV_KEY_NOT_FOUND)
+  {
+    if (valLen == KV_TOMBSTONE)
+      return KV_KEY_NOT_FOUND;
+    if (slot == KV_INDEX_SLOTS)
+      return KV_INDEX_FULL;
+  }
+  else if (err != SUCCESS)
+    return err;
+  else if (valLen == KV_TOMBSTONE && (kv->slotPos[slot] & KV_DELETED_FLAG))
+    return KV_KEY_NOT_FOUND;
+
+  // build the record
+  uint8_t recLen = KV_REC_HDR_LEN;
+  recArr[0] = keyLen;
+  recArr[1] = valLen;
+  memcpy(&recArr[recLen], keyStr, keyLen);
+  recLen += keyLen;
+  if (valLen != KV_TOMBSTONE)
+  {
+    memcpy(&recArr[recLen], valArr, valLen);
+    recLen += valLen;
+  }
+  recArr[recLen] = pvt_Crc8(recArr, recLen);
+  ++recLen;
+
+  if ((err = pvt_Append(&kv->files[0], kv->gen, &kv->tailPos, recArr, recLen,
+                        &recPos, bpb)) != SUCCESS)
+    return err;
+
+  kv->slotHash[slot] = pvt_Hash((const uint8_t *)keyStr, keyLen);
+  kv->slotPos[slot] = recPos;
+  if (valLen == KV_TOMBSTONE)
+    kv->slotPos[slot] |= KV_DELETED_FLAG;
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                             (PRIVATE) FIND INDEX SLOT OF KEY
+ *
+ * Description : Probes the hash index for the slot holding a key.
+ *
+ * Arguments   : kv       - Pointer to a FatKv instance.
+ *               keyArr   - Pointer to the array holding the key.
+ *               keyLen   - Length of the key.
+ *               slot     - Pointer to the slot number, set here. If the key
+ *                          is not found, this is the first empty slot that
+ *                          was probed, or KV_INDEX_SLOTS if there are none.
+ *               bpb      - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, KV_KEY_NOT_FOUND, or a FAT Error Flag.
+ *
+ * Notes       : The record of any slot whose hash matches is read from the
+ *               store to compare its key. A slot holding a deleted key is
+ *               still returned as found.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_FindSlot(FatKv *kv, const uint8_t keyArr[], uint8_t keyLen,
+                            uint8_t *slot, const BPB *bpb)
+{
+  uint8_t  err, recLen;
+  uint8_t  recArr[KV_REC_LEN_MAX];
+  uint16_t hash = pvt_Hash(keyArr, keyLen);
+  uint8_t  s = hash & (KV_INDEX_SLOTS - 1);
+
+  for (uint8_t probe = 0; probe < KV_INDEX_SLOTS; ++probe)
+  {
+    if (!kv->slotHash[s])
+    {
+      *slot = s;
+      return KV_KEY_NOT_FOUND;
+    }
+
+    if (kv->slotHash[s] == hash)
+    {
+      if ((err = pvt_ReadRec(&kv->files[0],
+                             kv->slotPos[s] & ~KV_DELETED_FLAG,
+                             recArr, &recLen, bpb)) != SUCCESS)
+        return err;
+      if (recLen && recArr[0] == keyLen
+          && !memcmp(&recArr[KV_REC_HDR_LEN], keyArr, keyLen))
+      {
+        *slot = s;
+        return SUCCESS;
+      }
+    }
+    s = (s + 1) & (KV_INDEX_SLOTS - 1);
+  }
+
+  *slot = KV_INDEX_SLOTS;
+  return KV_KEY_NOT_FOUND;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                 (PRIVATE) REPLAY THE KV LOG
+ *
+ * Description : Rebuilds the hash index and finds the end of the log by
+ *               reading the log sectors of the store in order.
+ *
+ * Arguments   : kv        - Pointer to a FatKv instance whose store file and
+ *                           generation are set.
+ *               snapEnd   - End of the snapshot records, from the header.
+ *               bpb       - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, KV_INDEX_FULL, or a FAT Error Flag.
+ *
+ * Notes       : Records before snapEnd each have a different key, so they are
+ *               put in the first empty slot without reading any record back.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_Replay(FatKv *kv, uint32_t snapEnd, const BPB *bpb)
+{
+  uint8_t  err, slot;
+  FatFile *store = &kv->files[0];
+  uint8_t  secArr[BPB_BYTES_PER_SEC(bpb)];
+
+  memset(kv->slotHash, 0, sizeof(kv->slotHash));
+  kv->tailPos = BPB_BYTES_PER_SEC(bpb);
+
+  for (uint32_t secPos = BPB_BYTES_PER_SEC(bpb);
+       secPos + BPB_BYTES_PER_SEC(bpb) <= store->fileSize;
+       secPos += BPB_BYTES_PER_SEC(bpb))
+  {
+    fat_SeekFile(store, secPos, bpb);
+    if ((err = fat_ReadFile(store, secArr, BPB_BYTES_PER_SEC(bpb), bpb))
+        != SUCCESS)
+      return err;
+
+    // sector is left over from an older store.
+    if (LOAD_LE32(secArr) != kv->gen)
+      break;
+
+    uint16_t bytePos = KV_SEC_HDR_LEN;
+    uint8_t  recLen;
+    while ((recLen = pvt_RecLen(&secArr[bytePos],
+                                BPB_BYTES_PER_SEC(bpb) - bytePos)))
+    {
+      const uint8_t *recArr = &secArr[bytePos];
+      uint16_t hash = pvt_Hash(&recArr[KV_REC_HDR_LEN], recArr[0]);
+
+      if (secPos + bytePos < snapEnd)
+      {
+        for (slot = hash & (KV_INDEX_SLOTS - 1); kv->slotHash[slot];
+             slot = (slot + 1) & (KV_INDEX_SLOTS - 1))
+          ;
+      }
+      else
+      {
+        err = pvt_FindSlot(kv, &recArr[KV_REC_HDR_LEN], recArr[0], &slot, bpb);
+        if (err != SUCCESS && err != KV_KEY_NOT_FOUND)
+          return err;
+        if (slot == KV_INDEX_SLOTS)
+          return KV_INDEX_FULL;
+      }
+
+      kv->slotHash[slot] = hash;
+      kv->slotPos[slot] = secPos + bytePos;
+      if (recArr[1] == KV_TOMBSTONE)
+        kv->slotPos[slot] |= KV_DELETED_FLAG;
+      bytePos += recLen;
+    }
+    kv->tailPos = secPos + bytePos;
+  }
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                 (PRIVATE) APPEND LOG RECORD
+ *
+ * Description : Writes a record at the end of the log of a file.
+ *
+ * Arguments   : file      - Pointer to the FatFile instance of the log.
+ *               gen       - Generation written at the start of a new sector.
+ *               tailPos   - Pointer to the end of the log. Advanced here.
+ *               recArr    - Pointer to the array holding the record.
+ *               recLen    - Length of the record.
+ *               recPos    - Pointer to the record's position, set here.
+ *               bpb       - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, KV_STORE_FULL, or a FAT Error Flag.
+ *
+ * Notes       : A record that does not fit in the rest of the last sector is
+ *               written to the start of the next one. That sector is written
+ *               whole, with zeros after the record, so it is not read first.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_Append(FatFile *file, uint32_t gen, uint32_t *tailPos,
+                          const uint8_t recArr[], uint8_t recLen,
+                          uint32_t *recPos, const BPB *bpb)
+{
+  uint8_t  err;
+  uint16_t bytePos = BPB_POS_IN_SEC(bpb, *tailPos);
+
+  if (bytePos == 0 || bytePos + recLen > BPB_BYTES_PER_SEC(bpb))
+  {
+    uint32_t secPos = *tailPos - bytePos;
+    if (bytePos)
+      secPos += BPB_BYTES_PER_SEC(bpb);
+    if (secPos + BPB_BYTES_PER_SEC(bpb) > file->fileSize)
+      return KV_STORE_FULL;
+
+    uint8_t secArr[BPB_BYTES_PER_SEC(bpb)];
+    memset(secArr, 0, BPB_BYTES_PER_SEC(bpb));
+    pvt_Store32(secArr, gen);
+    memcpy(&secArr[KV_SEC_HDR_LEN], recArr, recLen);
+
+    fat_SeekFile(file, secPos, bpb);
+    if ((err = fat_WriteFile(file, secArr, BPB_BYTES_PER_SEC(bpb), bpb))
+        != SUCCESS)
+      return err;
+    *recPos = secPos + KV_SEC_HDR_LEN;
+  }
+  else
+  {
+    fat_SeekFile(file, *tailPos, bpb);
+    if ((err = fat_WriteFile(file, recArr, recLen, bpb)) != SUCCESS)
+      return err;
+    *recPos = *tailPos;
+  }
+
+  *tailPos = *recPos + recLen;
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                   (PRIVATE) READ LOG RECORD
+ *
+ * Description : Reads the record at a position in a log file.
+ *
+ * Arguments   : file      - Pointer to the FatFile instance of the log.
+ *               pos       - Position of the record in the file.
+ *               recArr    - Pointer to the array the record is loaded into.
+ *                           Must be KV_REC_LEN_MAX long.
+ *               recLen    - Pointer to the record length, set here. This is
+ *                           0 if there is no valid record at pos.
+ *               bpb       - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS or a FAT Error Flag.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_ReadRec(FatFile *file, uint32_t pos, uint8_t recArr[],
+                           uint8_t *recLen, const BPB *bpb)
+{
+  uint8_t  err;
+  uint16_t avail = BPB_BYTES_PER_SEC(bpb) - BPB_POS_IN_SEC(bpb, pos);
+
+  if (avail > KV_REC_LEN_MAX)
+    avail = KV_REC_LEN_MAX;
+
+  *recLen = 0;
+  if (fat_SeekFile(file, pos, bpb) != SUCCESS)
+    return SUCCESS;
+  err = fat_ReadFile(file, recArr, avail, bpb);
+  if (err != SUCCESS && err != END_OF_FILE)
+    return err;
+
+  *recLen = pvt_RecLen(recArr, avail);
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                             (PRIVATE) GET VALID RECORD LENGTH
+ *
+ * Description : Checks the record at the start of an array.
+ *
+ * Arguments   : recArr   - Pointer to the array holding the record.
+ *               avail    - Number of bytes in recArr, i.e. to the end of the
+ *                          sector holding the record.
+ *
+ * Returns     : The length of the record, or 0 if the array does not begin
+ *               with a complete record whose CRC matches.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_RecLen(const uint8_t recArr[], uint16_t avail)
+{
+  if (avail < KV_REC_HDR_LEN + 1)
+    return 0;
+
+  uint8_t keyLen = recArr[0];
+  uint8_t valLen = recArr[1] == KV_TOMBSTONE ? 0 : recArr[1];
+  if (keyLen == 0 || keyLen > KV_KEY_LEN_MAX || valLen > KV_VAL_LEN_MAX)
+    return 0;
+
+  uint8_t recLen = KV_REC_HDR_LEN + keyLen + valLen;
+  if (recLen + 1 > avail || pvt_Crc8(recArr, recLen) != recArr[recLen])
+    return 0;
+  return recLen + 1;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                  (PRIVATE) READ FILE HEADER
+ *
+ * Description : Loads the first KV_HDR_LEN bytes of a file into hdrArr.
+ *
+ * Returns     : SUCCESS or a FAT Error Flag.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_ReadHdr(FatFile *file, uint8_t hdrArr[], const BPB *bpb)
+{
+  fat_SeekFile(file, 0, bpb);
+  return fat_ReadFile(file, hdrArr, KV_HDR_LEN, bpb);
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                 (PRIVATE) WRITE FILE HEADER
+ *
+ * Description : Writes the header sector of a file.
+ *
+ * Arguments   : file      - Pointer to the FatFile instance to write.
+ *               gen       - Generation. If 0 the header is cleared.
+ *               snapEnd   - End of the snapshot records.
+ *               prev      - Pointer to the FatFile instance of the file the
+ *                           records are copied from.
+ *               bpb       - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS or a FAT Error Flag.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_WriteHdr(FatFile *file, uint32_t gen, uint32_t snapEnd,
+                            const FatFile *prev, const BPB *bpb)
+{
+  uint8_t secArr[BPB_BYTES_PER_SEC(bpb)];
+
+  memset(secArr, 0, BPB_BYTES_PER_SEC(bpb));
+  if (gen)
+  {
+    memcpy(secArr, KV_MAGIC, KV_MAGIC_LEN);
+    pvt_Store32(&secArr[KV_HDR_GEN_POS], gen);
+    pvt_Store32(&secArr[KV_HDR_SNAP_END_POS], snapEnd);
+    pvt_Store32(&secArr[KV_HDR_PREV_CLUS_POS], prev->fstClusIndx);
+    pvt_Store32(&secArr[KV_HDR_PREV_SIZE_POS], prev->fileSize);
+  }
+
+  fat_SeekFile(file, 0, bpb);
+  return fat_WriteFile(file, secArr, BPB_BYTES_PER_SEC(bpb), bpb);
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                       (PRIVATE) HASH OF KEY
+ *
+ * Description : Returns a 16-bit hash of a key. Never 0, which marks an empty
+ *               index slot.
+ * ----------------------------------------------------------------------------
+ */
+static uint16_t pvt_Hash(const uint8_t keyArr[], uint8_t keyLen)
+{
+  uint16_t hash = 5381;
+  for (uint8_t i = 0; i < keyLen; ++i)
+    hash = (hash << 5) + hash + keyArr[i];
+  return hash ? hash : 1;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                     (PRIVATE) CRC-8 OF BYTES
+ *
+ * Description : Returns the CRC-8 (polynomial 0x07) of an array. Used to
+ *               detect a record that was not completely written.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_Crc8(const uint8_t arr[], uint8_t len)
+{
+  uint8_t crc = 0;
+  while (len--)
+  {
+    crc ^= *arr++;
+    for (uint8_t bit = 0; bit < 8; ++bit)
+      crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+  }
+  return crc;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                    (PRIVATE) STORE 32-BIT LE
+ *
+ * Description : Stores the little-endian 32-bit fields of the headers. They
+ *               are loaded with LOAD_LE32.
+ * ----------------------------------------------------------------------------
+ */
+static void pvt_Store32(uint8_t arr[], uint32_t val)
+{
+  arr[0] = val;
+  arr[1] = val >> 8;
+  arr[2] = val >> 16;
+  arr[3] = val >> 24;
+}
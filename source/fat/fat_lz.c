@@ -0,0 +1,243 @@
+/*
+ * File       : FAT_LZ.C
+ * Version    : 2.0
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Implementation of FAT_LZ.H
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "fat_bpb.h"
+#include "fat.h"
+#include "fat_lz.h"
+
+/*
+ ******************************************************************************
+ *                 "PRIVATE" FUNCTION PROTOTYPES (and MACROS)
+ ******************************************************************************
+ */
+
+static uint8_t pvt_GetBits(FatLz *lz, uint8_t bitLen, uint16_t *val,
+                           const BPB *bpb);
+static uint8_t pvt_LoadInput(FatLz *lz, const BPB *bpb);
+
+/*
+ ******************************************************************************
+ *                                FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                         OPEN COMPRESSED FILE
+ *
+ * Description : Sets a FatLz instance to decompress a file from its first
+ *               plaintext byte.
+ *
+ * Arguments   : lz      - Pointer to the FatLz instance to be set.
+ *               file    - Pointer to a FatFile instance, set by fat_OpenFile,
+ *                         of the compressed file.
+ *               bpb     - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, LZ_INVALID_FORMAT if the header is not valid or the
+ *               window is larger than 2^LZ_WIN_BITS_MAX, or a FAT Error Flag.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_OpenCompressed(FatLz *lz, const FatFile *file, const BPB *bpb)
+{
+  uint8_t err;
+
+  lz->file = *file;
+  fat_SeekFile(&lz->file, 0, bpb);
+  lz->inPos = 0;
+  lz->inLen = 0;
+
+  //
+  // the header is read through the input buffer, so the following reads of
+  // the buffer stay aligned to the sectors of the file.
+  //
+  if ((err = pvt_LoadInput(lz, bpb)) != SUCCESS)
+    return err;
+  if (lz->inLen < LZ_HDR_LEN || memcmp(lz->inArr, LZ_MAGIC, LZ_MAGIC_LEN))
+    return LZ_INVALID_FORMAT;
+
+  lz->winBits = lz->inArr[LZ_WIN_BITS_POS];
+  lz->lenBits = lz->inArr[LZ_LEN_BITS_POS];
+  if (lz->winBits == 0 || lz->winBits > LZ_WIN_BITS_MAX
+      || lz->lenBits == 0 || lz->lenBits > LZ_LEN_BITS_MAX)
+    return LZ_INVALID_FORMAT;
+
+  lz->outSize = LOAD_LE32(&lz->inArr[LZ_SIZE_POS]);
+
+  lz->inPos = LZ_HDR_LEN;
+  lz->outPos = 0;
+  lz->winPos = 0;
+  lz->refLen = 0;
+  lz->bitCnt = 0;
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                         READ COMPRESSED FILE
+ *
+ * Description : Decompresses the next bytes of plaintext of a compressed file
+ *               into an array.
+ *
+ * Arguments   : lz        - Pointer to a FatLz instance set by
+ *                           fat_OpenCompressed.
+ *               dataArr   - Pointer to the array that will be loaded with the
+ *                           plaintext bytes.
+ *               len       - Number of plaintext bytes to read.
+ *               bpb       - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS if len bytes were read. END_OF_FILE if the end of the
+ *               plaintext was reached first, in which case the bytes up to the
+ *               end were still loaded. The number of bytes read can be found
+ *               from the change in lz->outPos. LZ_CORRUPT_DATA if the stream
+ *               is not valid, or a FAT Error Flag.
+ *
+ * Notes       : The plaintext can only be read in order. To read it again,
+ *               pass the instance to fat_OpenCompressed.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_ReadCompressed(FatLz *lz, uint8_t dataArr[], uint16_t len,
+                           const BPB *bpb)
+{
+  uint8_t  err;
+  uint16_t winMask = (1 << lz->winBits) - 1;
+  uint16_t val = 0;
+
+  while (len)
+  {
+    if (lz->outPos >= lz->outSize)
+      return END_OF_FILE;
+
+    // decode the next token if there is no reference left to copy.
+    if (!lz->refLen)
+    {
+      if ((err = pvt_GetBits(lz, 1, &val, bpb)) != SUCCESS)
+        return err;
+
+      if (val)
+      {
+        if ((err = pvt_GetBits(lz, 8, &val, bpb)) != SUCCESS)
+          return err;
+        lz->refDist = 0;
+        lz->refLen = 1;
+      }
+      else
+      {
+        if ((err = pvt_GetBits(lz, lz->winBits, &lz->refDist, bpb))
+            != SUCCESS)
+          return err;
+        if ((err = pvt_GetBits(lz, lz->lenBits, &lz->refLen, bpb))
+            != SUCCESS)
+          return err;
+        ++lz->refDist;
+        lz->refLen += LZ_MIN_LEN;
+
+        // reference to before the start of the plaintext.
+        if (lz->refDist > lz->outPos)
+          return LZ_CORRUPT_DATA;
+      }
+    }
+
+    // a literal has a distance of 0 and is in val.
+    uint8_t byte = lz->refDist ? lz->win[(lz->winPos - lz->refDist) & winMask]
+                               : val;
+    --lz->refLen;
+
+    lz->win[lz->winPos] = byte;
+    lz->winPos = (lz->winPos + 1) & winMask;
+    *dataArr++ = byte;
+    ++lz->outPos;
+    --len;
+  }
+  return SUCCESS;
+}
+
+/*
+ ******************************************************************************
+ *                           "PRIVATE" FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                             (PRIVATE) GET BITS OF COMPRESSED
+ *
+ * Description : Reads the next bits of the compressed stream.
+ *
+ * Arguments   : lz       - Pointer to a FatLz instance.
+ *               bitLen   - Number of bits to read. 1 to 16.
+ *               val      - Pointer to the value of the bits, set here. The
+ *                          first bit read is the most significant.
+ *               bpb      - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, LZ_CORRUPT_DATA if the end of the compressed file
+ *               is reached, or a FAT Error Flag.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_GetBits(FatLz *lz, uint8_t bitLen, uint16_t *val,
+                           const BPB *bpb)
+{
+  uint8_t err;
+
+  *val = 0;
+  while (bitLen)
+  {
+    if (!lz->bitCnt)
+    {
+      if (lz->inPos == lz->inLen)
+      {
+        if ((err = pvt_LoadInput(lz, bpb)) != SUCCESS)
+          return err;
+        if (!lz->inLen)
+          return LZ_CORRUPT_DATA;
+      }
+      lz->bitBuf = lz->inArr[lz->inPos++];
+      lz->bitCnt = 8;
+    }
+
+    // take as many bits as are needed, and left, from the current byte.
+    uint8_t take = bitLen < lz->bitCnt ? bitLen : lz->bitCnt;
+    lz->bitCnt -= take;
+    *val = (*val << take)
+         | ((lz->bitBuf >> lz->bitCnt) & ((1 << take) - 1));
+    bitLen -= take;
+  }
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                              (PRIVATE) LOAD COMPRESSED BYTES
+ *
+ * Description : Loads the next bytes of the compressed file into the input
+ *               buffer, up to the next multiple of LZ_IN_BUF_LEN in the file.
+ *
+ * Arguments   : lz       - Pointer to a FatLz instance.
+ *               bpb      - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS or a FAT Error Flag. lz->inLen is 0 if the end of
+ *               the file was reached.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_LoadInput(FatLz *lz, const BPB *bpb)
+{
+  uint8_t  err;
+  uint32_t startPos = lz->file.currPos;
+
+  err = fat_ReadFile(&lz->file, lz->inArr,
+                     LZ_IN_BUF_LEN - startPos % LZ_IN_BUF_LEN, bpb);
+  if (err != SUCCESS && err != END_OF_FILE)
+    return err;
+
+  lz->inPos = 0;
+  lz->inLen = lz->file.currPos - startPos;
+  return SUCCESS;
+}
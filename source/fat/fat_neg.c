@@ -0,0 +1,262 @@
+/*
+ * File       : FAT_NEG.C
+ * Version    : 2.0
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Implementation of FAT_NEG.H
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "fat_neg.h"
+
+/*
+ ******************************************************************************
+ *                 "PRIVATE" FUNCTION PROTOTYPES (and MACROS)
+ ******************************************************************************
+ */
+
+// dirClusIndx of a filter not given to a directory. No directory starts here.
+#define NO_DIR                  0
+
+// a tag is the index of the filter in the upper byte, and its gen below.
+#define TAG(I, GEN)             ((uint16_t)(I) << 8 | (GEN))
+#define TAG_INDX(T)             ((T) >> 8)
+#define TAG_GEN(T)              ((uint8_t)(T))
+
+//
+// filter of the names in a directory. gen is incremented each time the
+// filter is cleared, so a search that began before cannot add to it.
+//
+typedef struct
+{
+  uint32_t dirClusIndx;                // directory of the filter, or NO_DIR
+  uint16_t lastUse;                    // for least recently claimed reuse
+  uint8_t  gen;                        // generation of the filter's tags
+  uint8_t  complete;                   // 1 if every entry has been added
+  uint8_t  bits[FAT_NEG_BITS / 8];
+}
+NegFilter;
+
+static NegFilter filters[FAT_NEG_DIRS];
+static uint16_t  useCnt;               // incremented on each claim
+
+static NegFilter *pvt_FindFilter(uint32_t dirClusIndx);
+static void pvt_Clear(NegFilter *flt, uint32_t dirClusIndx);
+static uint32_t pvt_Hash(const char nameStr[]);
+
+/*
+ ******************************************************************************
+ *                                FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           IS NAME NOT IN DIR
+ *
+ * Description : Checks the filter of a directory for a name.
+ *
+ * Arguments   : dirClusIndx   - Index of the directory's first cluster.
+ *               nameStr       - Pointer to the name, as it would be compared
+ *                               to the lnStr member of a FatEntry.
+ *
+ * Returns     : 1 if the directory does not hold an entry of that name.
+ *               0 if it might, or there is no complete filter for it.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_NegIsAbsent(uint32_t dirClusIndx, const char nameStr[])
+{
+  NegFilter *flt = pvt_FindFilter(dirClusIndx);
+  if (!flt || !flt->complete)
+    return 0;
+
+  uint32_t hash = pvt_Hash(nameStr);
+  uint16_t bit1 = hash & (FAT_NEG_BITS - 1);
+  uint16_t bit2 = (hash >> 16) & (FAT_NEG_BITS - 1);
+  return !(flt->bits[bit1 >> 3] & 1 << (bit1 & 7))
+         || !(flt->bits[bit2 >> 3] & 1 << (bit2 & 7));
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           BEGIN FILTER BUILD
+ *
+ * Description : Gets the filter of a directory for a search of it that
+ *               starts at its first entry. If there is no filter for the
+ *               directory, the least recently claimed one is cleared and
+ *               given to it.
+ *
+ * Arguments   : dirClusIndx   - Index of the directory's first cluster.
+ *
+ * Returns     : Tag of the filter, to be passed to fat_NegAdd and fat_NegEnd.
+ *
+ * Notes       : The tag of a filter that is cleared, or given to another
+ *               directory, during the search is no longer valid, so nothing
+ *               is added to the filter with it.
+ * ----------------------------------------------------------------------------
+ */
+uint16_t fat_NegBegin(uint32_t dirClusIndx)
+{
+  NegFilter *flt = pvt_FindFilter(dirClusIndx);
+
+  if (!flt)
+  {
+    flt = &filters[0];
+    for (uint8_t i = 1; i < FAT_NEG_DIRS; ++i)
+      if ((uint16_t)(useCnt - filters[i].lastUse)
+          > (uint16_t)(useCnt - flt->lastUse))
+        flt = &filters[i];
+    pvt_Clear(flt, dirClusIndx);
+  }
+  flt->lastUse = ++useCnt;
+  return TAG(flt - filters, flt->gen);
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           ADD NAME TO FILTER
+ *
+ * Description : Adds the name of an entry found by a search to the filter of
+ *               the directory being searched.
+ *
+ * Arguments   : tag       - Tag returned by fat_NegBegin, or NEG_NO_TAG.
+ *               nameStr   - Pointer to the lnStr member of the FatEntry.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void fat_NegAdd(uint16_t tag, const char nameStr[])
+{
+  if (tag == NEG_NO_TAG || filters[TAG_INDX(tag)].gen != TAG_GEN(tag))
+    return;
+
+  NegFilter *flt = &filters[TAG_INDX(tag)];
+  uint32_t hash = pvt_Hash(nameStr);
+  uint16_t bit1 = hash & (FAT_NEG_BITS - 1);
+  uint16_t bit2 = (hash >> 16) & (FAT_NEG_BITS - 1);
+  flt->bits[bit1 >> 3] |= 1 << (bit1 & 7);
+  flt->bits[bit2 >> 3] |= 1 << (bit2 & 7);
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             END FILTER BUILD
+ *
+ * Description : Marks the filter of a directory as complete, once a search
+ *               that added every entry to it has reached END_OF_DIRECTORY.
+ *               fat_NegIsAbsent only answers from complete filters.
+ *
+ * Arguments   : tag   - Tag returned by fat_NegBegin, or NEG_NO_TAG.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void fat_NegEnd(uint16_t tag)
+{
+  if (tag != NEG_NO_TAG && filters[TAG_INDX(tag)].gen == TAG_GEN(tag))
+    filters[TAG_INDX(tag)].complete = 1;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                    INVALIDATE NEGATIVE CACHE
+ *
+ * Description : fat_NegInvalidate clears the filter of a directory, and
+ *               fat_NegInvalidateAll clears every filter.
+ *
+ * Arguments   : dirClusIndx   - Index of the directory's first cluster.
+ *
+ * Returns     : void
+ *
+ * Warnings    : Any code that creates or renames an entry of a directory must
+ *               call fat_NegInvalidate for the directory, otherwise the new
+ *               name can be reported as not found. Call fat_NegInvalidateAll
+ *               with fat_CacheInvalidate when the disk is changed.
+ * ----------------------------------------------------------------------------
+ */
+void fat_NegInvalidate(uint32_t dirClusIndx)
+{
+  NegFilter *flt = pvt_FindFilter(dirClusIndx);
+  if (flt)
+    pvt_Clear(flt, NO_DIR);
+}
+
+void fat_NegInvalidateAll(void)
+{
+  for (uint8_t i = 0; i < FAT_NEG_DIRS; ++i)
+    pvt_Clear(&filters[i], NO_DIR);
+}
+
+/*
+ ******************************************************************************
+ *                           "PRIVATE" FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                        (PRIVATE) FIND FILTER
+ *
+ * Description : Finds the filter given to a directory.
+ *
+ * Arguments   : dirClusIndx   - Index of the directory's first cluster.
+ *
+ * Returns     : Pointer to the filter, or NULL if there is none.
+ * ----------------------------------------------------------------------------
+ */
+static NegFilter *pvt_FindFilter(uint32_t dirClusIndx)
+{
+  for (uint8_t i = 0; i < FAT_NEG_DIRS; ++i)
+    if (filters[i].dirClusIndx == dirClusIndx && dirClusIndx != NO_DIR)
+      return &filters[i];
+  return NULL;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                       (PRIVATE) CLEAR FILTER
+ *
+ * Description : Clears a filter and gives it to a directory. Tags of the
+ *               filter given out before are no longer valid.
+ *
+ * Arguments   : flt           - Pointer to the filter.
+ *               dirClusIndx   - Index of the directory's first cluster, or
+ *                               NO_DIR.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+static void pvt_Clear(NegFilter *flt, uint32_t dirClusIndx)
+{
+  flt->dirClusIndx = dirClusIndx;
+  flt->complete = 0;
+  ++flt->gen;
+  memset(flt->bits, 0, sizeof(flt->bits));
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                          (PRIVATE) NAME HASH
+ *
+ * Description : 32-bit FNV-1a hash of a name. Its lower and upper halves
+ *               give the 2 bits the name sets in a filter.
+ *
+ * Arguments   : nameStr   - Pointer to the name.
+ *
+ * Returns     : The hash.
+ * ----------------------------------------------------------------------------
+ */
+static uint32_t pvt_Hash(const char nameStr[])
+{
+  uint32_t hash = 2166136261UL;
+
+  while (*nameStr)
+  {
+    hash ^= (uint8_t)*nameStr++;
+    hash *= 16777619UL;
+  }
+  return hash;
+}
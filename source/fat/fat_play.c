@@ -0,0 +1,505 @@
+/*
+ * File       : FAT_PLAY.C
+ * Version    : 2.0
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Implementation of FAT_PLAY.H
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "fat_bpb.h"
+#include "fat.h"
+#include "fat_to_disk_if.h"
+#include "fat_cache.h"
+#include "fat_play.h"
+
+/*
+ ******************************************************************************
+ *                 "PRIVATE" FUNCTION PROTOTYPES (and MACROS)
+ ******************************************************************************
+ */
+
+// sectors in the ring. The counts wrap at 256, so this is always correct.
+#define RING_CNT(play)          ((uint8_t)((play)->headSec - (play)->tailSec))
+
+static uint8_t pvt_FindRun(FatPlay *play, const BPB *bpb);
+static uint8_t pvt_StartRun(FatPlay *play);
+static uint8_t pvt_StopRun(FatPlay *play);
+static uint8_t pvt_ReadSector(FatPlay *play);
+static uint32_t pvt_GetRingBytes(const FatPlay *play);
+
+/*
+ ******************************************************************************
+ *                                FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                               OPEN FILE PLAY
+ *
+ * Description : Sets a FatPlay instance to play a file from the file's
+ *               current position to its end.
+ *
+ * Arguments   : play       - Pointer to the FatPlay instance to be set.
+ *               file       - Pointer to a FatFile instance set by
+ *                            fat_OpenFile.
+ *               frameLen   - Number of bytes taken by each fat_PlayDrain,
+ *                            e.g. the bytes of one sample of each channel.
+ *               byteRate   - Number of bytes played each second. Only used
+ *                            to give the margin in milliseconds.
+ *               bpb        - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS. PLAY_NOT_ALIGNED if the file's position is not at
+ *               the start of a sector, or the sectors are not SECTOR_LEN
+ *               bytes. PLAY_BAD_FRAME if frameLen or byteRate is 0, or
+ *               frameLen does not divide SECTOR_LEN.
+ *
+ * Notes       : Bytes at the end of the file that do not fill a frame are
+ *               not played.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_PlayOpen(FatPlay *play, FatFile *file, uint16_t frameLen,
+                     uint32_t byteRate, const BPB *bpb)
+{
+  if (BPB_BYTES_PER_SEC(bpb) != SECTOR_LEN || file->currPos % SECTOR_LEN)
+    return PLAY_NOT_ALIGNED;
+
+  // a frame that spans two sectors could not be taken from the ring at once.
+  if (!frameLen || SECTOR_LEN % frameLen || !byteRate)
+    return PLAY_BAD_FRAME;
+
+  uint32_t playLen = 0;
+  if (file->currPos < file->fileSize)
+    playLen = (file->fileSize - file->currPos) / frameLen * frameLen;
+
+  play->file = file;
+  play->readPos = file->currPos;
+  play->endPos = file->currPos + playLen;
+  play->byteRate = byteRate;
+  play->frameLen = frameLen;
+  play->runIndx = 0;
+  play->runCnt = 0;
+  play->runOpen = 0;
+  play->headSec = 0;
+  play->tailSec = 0;
+  play->tailPos = 0;
+  play->isEnd = (playLen == 0);
+  play->isRunning = 0;
+  play->underrunCnt = 0;
+  play->marginMin = UINT32_MAX;
+  play->secsRead = 0;
+  play->runsFound = 0;
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                              START FILE PLAY
+ *
+ * Description : Fills the ring, then lets fat_PlayDrain take frames from it.
+ *
+ * Arguments   : play   - Pointer to a FatPlay instance.
+ *               bpb    - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS or a FAT Error Flag.
+ *
+ * Notes       : This waits on the disk while the ring is filled. Start the
+ *               timer that calls fat_PlayDrain after it returns.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_PlayStart(FatPlay *play, const BPB *bpb)
+{
+  uint8_t err;
+
+  while ((err = fat_PlayService(play, bpb)) == STEP_BUSY)
+    ;
+  if (err != SUCCESS && err != END_OF_FILE)
+    return err;
+
+  play->isRunning = 1;
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            SERVICE FILE PLAY
+ *
+ * Description : Refills the ring from the disk's read stream, without waiting
+ *               while the disk reads a sector. A read stream is started for
+ *               each run of consecutive sectors of the file. Runs are found,
+ *               by reading the FAT, only while no read stream is started and
+ *               either the ring is full or no run is left to read, so a
+ *               lookup is never made while the ring is short of sectors.
+ *
+ * Arguments   : play   - Pointer to a FatPlay instance.
+ *               bpb    - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS if the ring is full and every run that can be found
+ *               ahead has been. STEP_BUSY if it should be called again.
+ *               END_OF_FILE once the last sector of the file is in the ring.
+ *               Otherwise FAILED_READ_SECTOR or a FAT Error Flag from
+ *               finding the file's sectors, in which case the read stream is
+ *               stopped and the sector is read again by the next call.
+ *
+ * Notes       : This is meant to be called from the main loop, as often as
+ *               possible while the file plays. Each call does at most one
+ *               step, i.e. reads one sector, starts or stops a read stream,
+ *               or finds one run.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_PlayService(FatPlay *play, const BPB *bpb)
+{
+  uint8_t isFull = (RING_CNT(play) == PLAY_RING_SECS);
+  uint8_t isAhead = (play->runCnt < PLAY_RUNS_MAX
+                     && play->file->currPos < play->endPos);
+
+  if (play->isEnd)
+    return END_OF_FILE;
+
+  if (play->runOpen)
+  {
+    //
+    // the ring is full and no run is found after the one being read. Stop
+    // the read stream, so the next runs are found while the ring drains,
+    // and not when the read reaches the end of this run.
+    //
+    if (isFull && isAhead && play->runCnt < 2)
+      return pvt_StopRun(play) == SUCCESS ? STEP_BUSY : FAILED_READ_SECTOR;
+
+    if (isFull)
+      return SUCCESS;
+
+    // the disk is still reading the next sector. Do not wait for it.
+    if (!FATtoDisk_IsReadReady())
+      return STEP_BUSY;
+    return pvt_ReadSector(play);
+  }
+
+  // the FAT is only read while the ring has the most time left in it.
+  if (isAhead && (isFull || !play->runCnt))
+    return pvt_FindRun(play, bpb);
+
+  if (isFull || !play->runCnt)
+    return SUCCESS;
+  return pvt_StartRun(play);
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                              DRAIN FILE PLAY
+ *
+ * Description : Copies the next frame from the ring. Called at the file's
+ *               frame rate, e.g. from a timer interrupt.
+ *
+ * Arguments   : play       - Pointer to a FatPlay instance.
+ *               frameArr   - Pointer to the array the frame is copied to.
+ *                            Must be at least frameLen bytes.
+ *
+ * Returns     : SUCCESS if a frame was copied. PLAY_UNDERRUN if the ring is
+ *               empty, in which case the frame's time is lost and it is
+ *               counted. END_OF_FILE once every frame has been taken, or
+ *               before fat_PlayStart.
+ *
+ * Notes       : This never uses the disk, so it can be called from an
+ *               interrupt while fat_PlayService runs in the main loop.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_PlayDrain(FatPlay *play, uint8_t frameArr[])
+{
+  uint8_t tailSec = play->tailSec;
+
+  if (!play->isRunning)
+    return END_OF_FILE;
+
+  // isEnd is only set once the last sector is in the ring.
+  if (tailSec == play->headSec)
+  {
+    if (play->isEnd)
+    {
+      play->isRunning = 0;
+      return END_OF_FILE;
+    }
+    if (play->underrunCnt != UINT16_MAX)
+      ++play->underrunCnt;
+    return PLAY_UNDERRUN;
+  }
+
+  uint8_t  slot = tailSec & (PLAY_RING_SECS - 1);
+  uint16_t tailPos = play->tailPos;
+  memcpy(frameArr, &play->ringArr[slot][tailPos], play->frameLen);
+  tailPos += play->frameLen;
+
+  // the sector is given back to fat_PlayService once its last frame is taken.
+  if (tailPos >= play->lenArr[slot])
+  {
+    play->tailPos = 0;
+    play->tailSec = tailSec + 1;
+  }
+  else
+    play->tailPos = tailPos;
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                              IS FILE PLAYING
+ *
+ * Description : Checks if fat_PlayDrain is still taking frames.
+ *
+ * Arguments   : play   - Pointer to a FatPlay instance.
+ *
+ * Returns     : 1 from fat_PlayStart until every frame has been taken, or
+ *               fat_PlayClose is called. Otherwise 0.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_PlayIsPlaying(const FatPlay *play)
+{
+  return play->isRunning;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                          GET FILE PLAY STATS
+ *
+ * Description : Loads the counts kept while the file plays into a
+ *               FatPlayStats instance.
+ *
+ * Arguments   : play    - Pointer to a FatPlay instance.
+ *               stats   - Pointer to the FatPlayStats instance to be set.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void fat_PlayGetStats(const FatPlay *play, FatPlayStats *stats)
+{
+  uint16_t underrunCnt;
+
+  // the count is set by fat_PlayDrain, so it can change while it is read.
+  do
+    underrunCnt = play->underrunCnt;
+  while (underrunCnt != play->underrunCnt);
+
+  stats->underrunCnt = underrunCnt;
+  stats->secsRead = play->secsRead;
+  stats->runsFound = play->runsFound;
+  stats->marginMs = UINT16_MAX;
+  if (play->marginMin != UINT32_MAX)
+  {
+    // the ring holds at most 128 sectors, so this does not overflow.
+    uint32_t marginMs = play->marginMin * 1000 / play->byteRate;
+    stats->marginMs = marginMs < UINT16_MAX ? marginMs : UINT16_MAX - 1;
+  }
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                              CLOSE FILE PLAY
+ *
+ * Description : Stops fat_PlayDrain taking frames and stops the disk's read
+ *               stream.
+ *
+ * Arguments   : play   - Pointer to a FatPlay instance.
+ *
+ * Returns     : SUCCESS or FAILED_READ_SECTOR.
+ *
+ * Notes       : The file's currPos is left after the last run found, not
+ *               after the last frame played.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_PlayClose(FatPlay *play)
+{
+  play->isRunning = 0;
+  if (play->runOpen)
+    return pvt_StopRun(play);
+  return SUCCESS;
+}
+
+/*
+ ******************************************************************************
+ *                           "PRIVATE" FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                         (PRIVATE) FIND A RUN
+ *
+ * Description : Finds the run of consecutive sectors of the file that starts
+ *               at the file's position, adds it to the runs to read, and
+ *               moves the file's position to the end of it.
+ *
+ * Arguments   : play   - Pointer to a FatPlay instance.
+ *               bpb    - Pointer to the BPB struct instance.
+ *
+ * Returns     : STEP_BUSY, or a FAT Error Flag from fat_GetFileRun.
+ *
+ * Warnings    : Only call while no read stream is started, and there is room
+ *               for another run.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_FindRun(FatPlay *play, const BPB *bpb)
+{
+  uint8_t  err;
+  uint32_t secNum;
+  uint32_t numOfSecs;
+
+  if ((err = fat_GetFileRun(play->file, &secNum, &numOfSecs,
+                            PLAY_RUN_SECS_MAX, bpb)) != SUCCESS)
+    return err;
+
+  uint8_t runIndx = (play->runIndx + play->runCnt) % PLAY_RUNS_MAX;
+  play->runSecArr[runIndx] = secNum;
+  play->runLenArr[runIndx] = numOfSecs;
+  ++play->runCnt;
+  ++play->runsFound;
+  play->file->currPos += numOfSecs * SECTOR_LEN;
+  return STEP_BUSY;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                (PRIVATE) START DISK READ RUN
+ *
+ * Description : Starts a read stream of the disk for the sectors left in the
+ *               run being read.
+ *
+ * Arguments   : play   - Pointer to a FatPlay instance.
+ *
+ * Returns     : STEP_BUSY, FAILED_READ_SECTOR, or a FAT Error Flag from
+ *               fat_CacheSyncRange.
+ *
+ * Notes       : Sectors of the run waiting in the sector cache are written
+ *               first, because the stream reads the run around the cache.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_StartRun(FatPlay *play)
+{
+  uint8_t  err;
+  uint32_t secNum = play->runSecArr[play->runIndx];
+  uint32_t numOfSecs = play->runLenArr[play->runIndx];
+
+  if ((err = fat_CacheSyncRange(secNum, numOfSecs)) != SUCCESS)
+    return err;
+
+  if (FATtoDisk_StartReadStream(secNum, numOfSecs) != READ_SECTOR_SUCCESS)
+    return FAILED_READ_SECTOR;
+  play->runOpen = 1;
+  return STEP_BUSY;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                 (PRIVATE) STOP DISK READ RUN
+ *
+ * Description : Stops the disk's read stream. The sectors left in the run
+ *               are read by the next stream started.
+ *
+ * Arguments   : play   - Pointer to a FatPlay instance.
+ *
+ * Returns     : SUCCESS or FAILED_READ_SECTOR.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_StopRun(FatPlay *play)
+{
+  play->runOpen = 0;
+  if (FATtoDisk_StopReadStream() != READ_SECTOR_SUCCESS)
+    return FAILED_READ_SECTOR;
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                   (PRIVATE) READ RING SECTOR
+ *
+ * Description : Reads the next sector of the read stream into the head of
+ *               the ring, and adds it to the ring. The read stream is
+ *               stopped at the end of the run, or of the file.
+ *
+ * Arguments   : play   - Pointer to a FatPlay instance.
+ *
+ * Returns     : STEP_BUSY, END_OF_FILE if it was the last sector, or
+ *               FAILED_READ_SECTOR.
+ *
+ * Warnings    : Only call while a read stream is started and the ring is not
+ *               full.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_ReadSector(FatPlay *play)
+{
+  uint8_t slot = play->headSec & (PLAY_RING_SECS - 1);
+
+  // on failure the read stream is stopped, and the sector is read again.
+  if (FATtoDisk_ReadStreamSector(play->ringArr[slot]) != READ_SECTOR_SUCCESS)
+  {
+    pvt_StopRun(play);
+    return FAILED_READ_SECTOR;
+  }
+
+  // the time left in the ring when the sector arrived.
+  if (play->isRunning)
+  {
+    uint32_t ringBytes = pvt_GetRingBytes(play);
+    if (ringBytes < play->marginMin)
+      play->marginMin = ringBytes;
+  }
+
+  uint32_t lenLeft = play->endPos - play->readPos;
+  play->lenArr[slot] = lenLeft < SECTOR_LEN ? lenLeft : SECTOR_LEN;
+  play->readPos += SECTOR_LEN;
+  ++play->secsRead;
+  ++play->runSecArr[play->runIndx];
+  --play->runLenArr[play->runIndx];
+
+  // the sector is handed to fat_PlayDrain here, after its bytes and length.
+  ++play->headSec;
+  if (play->readPos >= play->endPos)
+    play->isEnd = 1;
+
+  if (!play->runLenArr[play->runIndx] || play->isEnd)
+  {
+    play->runIndx = (play->runIndx + 1) % PLAY_RUNS_MAX;
+    --play->runCnt;
+    if (pvt_StopRun(play) != SUCCESS)
+      return FAILED_READ_SECTOR;
+  }
+  return play->isEnd ? END_OF_FILE : STEP_BUSY;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                              (PRIVATE) GET BYTES IN THE RING
+ *
+ * Description : Returns the number of bytes in the ring that fat_PlayDrain
+ *               has not taken.
+ *
+ * Arguments   : play   - Pointer to a FatPlay instance.
+ *
+ * Returns     : Number of bytes.
+ *
+ * Notes       : Only the last sector of the file has fewer than SECTOR_LEN
+ *               bytes to play, and no sector is added after it, so every
+ *               sector counted is a full sector.
+ * ----------------------------------------------------------------------------
+ */
+static uint32_t pvt_GetRingBytes(const FatPlay *play)
+{
+  uint8_t  tailSec;
+  uint16_t tailPos;
+
+  // tailSec and tailPos are set by fat_PlayDrain, so read them until stable.
+  do
+  {
+    tailSec = play->tailSec;
+    tailPos = play->tailPos;
+  }
+  while (tailSec != play->tailSec || tailPos != play->tailPos);
+
+  uint8_t secCnt = (uint8_t)(play->headSec - tailSec);
+  if (!secCnt)
+    return 0;
+  return (uint32_t)secCnt * SECTOR_LEN - tailPos;
+}
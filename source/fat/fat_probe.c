@@ -0,0 +1,236 @@
+/*
+ * File       : FAT_PROBE.C
+ * Version    : 2.0
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Implementation of FAT_PROBE.H
+ */
+
+#include <stdint.h>
+#include "fat_bpb.h"
+#include "fat.h"
+#include "fat_to_disk_if.h"
+#include "fat_cache.h"
+#include "fat_probe.h"
+
+/*
+ ******************************************************************************
+ *                 "PRIVATE" FUNCTION PROTOTYPES (and MACROS)
+ ******************************************************************************
+ */
+
+static uint8_t pvt_WriteRun(uint32_t secNum, uint32_t numOfSecs,
+                            const uint8_t secArr[], uint16_t *secMsMax);
+
+/*
+ ******************************************************************************
+ *                                FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                       INITIALIZE WRITE PROBE
+ *
+ * Description : Sets the settings of a FatProbe instance and clears its
+ *               results.
+ *
+ * Arguments   : probe      - Pointer to the FatProbe instance to be set.
+ *               secCnt     - Number of sectors written by each probe.
+ *               periodMs   - Time between the probes run by
+ *                            fat_ProbeService.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void fat_ProbeInit(FatProbe *probe, uint16_t secCnt, uint32_t periodMs)
+{
+  probe->secCnt = secCnt;
+  probe->periodMs = periodMs;
+  probe->startMs = 0;
+  probe->runCnt = 0;
+  probe->failCnt = 0;
+  probe->lastMs = 0;
+  probe->lastRate = 0;
+  probe->minRate = UINT16_MAX;
+  probe->maxRate = 0;
+  probe->lastSecMsMax = 0;
+  probe->secMsMax = 0;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                              RUN WRITE PROBE
+ *
+ * Description : Writes the first secCnt sectors of a scratch file and times
+ *               the writes. The results are added to the FatProbe instance.
+ *
+ * Arguments   : probe   - Pointer to a FatProbe instance.
+ *               file    - Pointer to a FatFile instance set by fat_OpenFile.
+ *               bpb     - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, FAILED_WRITE_SECTOR, PROBE_TOO_SMALL if the file
+ *               has fewer than secCnt sectors, PROBE_NOT_ALIGNED if the
+ *               sectors are not SECTOR_LEN bytes, or a FAT Error Flag from
+ *               finding the file's sectors. On failure only the failCnt and
+ *               startMs members of the FatProbe instance are changed.
+ *
+ * Notes       : 1) Each run of consecutive sectors of the file is written
+ *                  with one multiple sector write of the disk, so the rate is
+ *                  that of a contiguous file, e.g. a FatStream or FatRing.
+ *               2) The file's position is left after the last sector written.
+ *
+ * Warnings    : The contents of the file are overwritten. Only pass a file
+ *               created for the probe.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_ProbeRun(FatProbe *probe, FatFile *file, const BPB *bpb)
+{
+  uint8_t  err;
+  uint8_t  secArr[SECTOR_LEN];
+  uint32_t secNum;
+  uint32_t numOfSecs;
+  uint16_t secMsMax = 0;
+  uint32_t secsLeft = probe->secCnt;
+
+  if (BPB_BYTES_PER_SEC(bpb) != SECTOR_LEN)
+    return PROBE_NOT_ALIGNED;
+  if (secsLeft == 0 || file->fileSize / SECTOR_LEN < secsLeft)
+    return PROBE_TOO_SMALL;
+
+  // the data is changed each probe, so it is never the data already there.
+  for (uint16_t byte = 0; byte < SECTOR_LEN; ++byte)
+    secArr[byte] = byte + probe->runCnt;
+
+  probe->startMs = FATtoDisk_GetTimeMs();
+  err = fat_SeekFile(file, 0, bpb);
+  while (err == SUCCESS && secsLeft)
+  {
+    err = fat_GetFileRun(file, &secNum, &numOfSecs, secsLeft, bpb);
+
+    // the probe writes around the cache, as a stream does.
+    if (err == SUCCESS)
+      err = fat_CacheSyncRange(secNum, numOfSecs);
+    if (err == SUCCESS)
+    {
+      fat_CacheDiscardRange(secNum, numOfSecs);
+      err = pvt_WriteRun(secNum, numOfSecs, secArr, &secMsMax);
+    }
+    if (err == SUCCESS)
+    {
+      file->currPos += numOfSecs * SECTOR_LEN;
+      secsLeft -= numOfSecs;
+    }
+  }
+  if (err != SUCCESS)
+  {
+    ++probe->failCnt;
+    return err;
+  }
+
+  uint32_t probeMs = FATtoDisk_GetTimeMs() - probe->startMs;
+  uint32_t rate = (uint32_t)probe->secCnt * SECTOR_LEN
+                  / (probeMs ? probeMs : 1);
+  if (rate > UINT16_MAX)
+    rate = UINT16_MAX;
+
+  probe->lastMs = probeMs;
+  probe->lastRate = rate;
+  probe->lastSecMsMax = secMsMax;
+  if (rate < probe->minRate)
+    probe->minRate = rate;
+  if (rate > probe->maxRate)
+    probe->maxRate = rate;
+  if (secMsMax > probe->secMsMax)
+    probe->secMsMax = secMsMax;
+  ++probe->runCnt;
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                          SERVICE WRITE PROBE
+ *
+ * Description : Runs a probe, as fat_ProbeRun, if periodMs has passed since
+ *               the last probe started, or no probe has been run.
+ *
+ * Arguments   : probe   - Pointer to a FatProbe instance.
+ *               file    - Pointer to a FatFile instance set by fat_OpenFile.
+ *               bpb     - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS if no probe was due, otherwise as fat_ProbeRun. The
+ *               runCnt member of the FatProbe instance is incremented by each
+ *               successful probe. A probe that fails is run again when the
+ *               next one is due.
+ *
+ * Notes       : This is meant to be called from the main loop while the disk
+ *               is otherwise idle. A probe takes the disk for as long as it
+ *               takes to write secCnt sectors.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_ProbeService(FatProbe *probe, FatFile *file, const BPB *bpb)
+{
+  if ((probe->runCnt || probe->failCnt)
+      && FATtoDisk_GetTimeMs() - probe->startMs < probe->periodMs)
+    return SUCCESS;
+  return fat_ProbeRun(probe, file, bpb);
+}
+
+/*
+ ******************************************************************************
+ *                           "PRIVATE" FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                        (PRIVATE) WRITE A RUN
+ *
+ * Description : Writes a run of consecutive sectors with one multiple sector
+ *               write of the disk, timing each sector.
+ *
+ * Arguments   : secNum     - Disk sector of the first sector of the run.
+ *               numOfSecs  - Number of sectors in the run.
+ *               secArr     - Pointer to the array written to each sector.
+ *               secMsMax   - Pointer to the longest sector time, raised here
+ *                            if a sector of the run took longer.
+ *
+ * Returns     : SUCCESS or FAILED_WRITE_SECTOR.
+ *
+ * Notes       : 1) A sector's time is from when it is sent until the disk is
+ *                  no longer busy writing it.
+ *               2) A sector still being written after PROBE_BUSY_MS fails
+ *                  the run, and the disk write is ended.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_WriteRun(uint32_t secNum, uint32_t numOfSecs,
+                            const uint8_t secArr[], uint16_t *secMsMax)
+{
+  if (FATtoDisk_StartStream(secNum) != WRITE_SECTOR_SUCCESS)
+    return FAILED_WRITE_SECTOR;
+
+  while (numOfSecs--)
+  {
+    uint32_t secMs = FATtoDisk_GetTimeMs();
+    if (FATtoDisk_StreamSector(secArr) != WRITE_SECTOR_SUCCESS)
+    {
+      FATtoDisk_StopStream();
+      return FAILED_WRITE_SECTOR;
+    }
+    while (FATtoDisk_IsBusy())
+      if (FATtoDisk_GetTimeMs() - secMs > PROBE_BUSY_MS)
+      {
+        FATtoDisk_StopStream();
+        return FAILED_WRITE_SECTOR;
+      }
+    secMs = FATtoDisk_GetTimeMs() - secMs;
+    if (secMs > *secMsMax)
+      *secMsMax = secMs > UINT16_MAX ? UINT16_MAX : secMs;
+  }
+
+  if (FATtoDisk_StopStream() != WRITE_SECTOR_SUCCESS)
+    return FAILED_WRITE_SECTOR;
+  return SUCCESS;
+}
@@ -0,0 +1,413 @@
+/*
+ * File       : FAT_RING.C
+ * Version    : 2.0
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Implementation of FAT_RING.H
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "fat_bpb.h"
+#include "fat.h"
+#include "fat_to_disk_if.h"
+#include "fat_cache.h"
+#include "fat_ioq.h"
+#include "fat_ring.h"
+
+/*
+ ******************************************************************************
+ *                 "PRIVATE" FUNCTION PROTOTYPES (and MACROS)
+ ******************************************************************************
+ */
+
+// positions of the fields in the header of a ring sector
+#define HDR_SEQ_POS             0
+#define HDR_LEN_POS             4
+#define HDR_MAGIC_POS           6
+#define HDR_CHECK_POS           7
+
+static uint8_t pvt_IsSeqAt(const FatRing *ring, uint32_t indx, uint32_t seq,
+                           uint8_t secArr[], uint8_t *isSeq);
+static uint8_t pvt_HdrIsValid(const uint8_t secArr[], uint32_t seq);
+static uint8_t pvt_HdrCheck(const uint8_t secArr[]);
+static uint8_t pvt_WriteHead(FatRing *ring);
+static uint8_t pvt_Transfer(uint32_t secNum, uint8_t secArr[], uint8_t op);
+
+/*
+ ******************************************************************************
+ *                                FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                OPEN RING LOG
+ *
+ * Description : Sets a FatRing instance to the ring kept in a file, and finds
+ *               its head sector by a binary search of the sectors' sequence
+ *               numbers. If the last sector written is not full, log data
+ *               added to the ring continues in it.
+ *
+ * Arguments   : ring   - Pointer to the FatRing instance to be set.
+ *               file   - Pointer to a FatFile instance set by fat_OpenFile.
+ *               bpb    - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, FAILED_READ_SECTOR, RING_TOO_SMALL if the file has
+ *               fewer than 2 whole sectors or the sectors are not SECTOR_LEN
+ *               bytes, RING_NOT_CONTIG if the file's clusters are not
+ *               consecutive on the disk, or CORRUPT_FAT_ENTRY.
+ *
+ * Notes       : 1) Only the whole sectors of the file are used.
+ *               2) The file should be filled with zeros when it is created. A
+ *                  new ring then starts at its first sector.
+ *               3) The ring's sectors are written around the sector cache of
+ *                  FAT_CACHE.H. Any sector of the file waiting in the cache is
+ *                  written, and then removed from the cache, by this function.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_RingOpen(FatRing *ring, FatFile *file, const BPB *bpb)
+{
+  uint8_t  err;
+  uint8_t  isSeq;
+  uint32_t runSecs;
+
+  if (BPB_BYTES_PER_SEC(bpb) != SECTOR_LEN || file->fileSize / SECTOR_LEN < 2)
+    return RING_TOO_SMALL;
+  ring->secCnt = file->fileSize / SECTOR_LEN;
+
+  // the ring is only addressed by disk sector, so it must be a single run.
+  fat_SeekFile(file, 0, bpb);
+  if ((err = fat_GetFileRun(file, &ring->fstSecNum, &runSecs, ring->secCnt,
+                            bpb)) != SUCCESS)
+    return err;
+  if (runSecs != ring->secCnt)
+    return RING_NOT_CONTIG;
+
+  if ((err = fat_CacheSyncRange(ring->fstSecNum, ring->secCnt)) != SUCCESS)
+    return err;
+  fat_CacheDiscardRange(ring->fstSecNum, ring->secCnt);
+
+  ring->headIndx = 0;
+  ring->headSeq = 0;
+  ring->fillLen = 0;
+
+  //
+  // sector i of the ring holds sequence number seq0 + i for each sector
+  // written in the current pass over the ring, and a lower one, or none,
+  // for the sectors after them. Without a valid first sector, the ring is
+  // empty.
+  //
+  if (pvt_Transfer(ring->fstSecNum, ring->secArr, IOQ_READ) != SUCCESS)
+    return FAILED_READ_SECTOR;
+  uint32_t seq0 = 0;
+  memcpy(&seq0, &ring->secArr[HDR_SEQ_POS], sizeof seq0);
+  if (!pvt_HdrIsValid(ring->secArr, seq0) || seq0 % ring->secCnt)
+    return SUCCESS;
+
+  // binary search for the first sector not written in the current pass.
+  uint32_t lo = 1;
+  uint32_t hi = ring->secCnt;
+  while (lo < hi)
+  {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if ((err = pvt_IsSeqAt(ring, mid, seq0 + mid, ring->secArr, &isSeq))
+        != SUCCESS)
+      return err;
+    if (isSeq)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  // the last sector written is the head, unless it is full.
+  uint32_t lastIndx = lo - 1;
+  if ((err = pvt_IsSeqAt(ring, lastIndx, seq0 + lastIndx, ring->secArr,
+                         &isSeq)) != SUCCESS)
+    return err;
+  ring->headIndx = lastIndx;
+  ring->headSeq = seq0 + lastIndx;
+  memcpy(&ring->fillLen, &ring->secArr[HDR_LEN_POS], sizeof ring->fillLen);
+  if (ring->fillLen == RING_DATA_LEN)
+  {
+    ring->headIndx = (lastIndx + 1 == ring->secCnt) ? 0 : lastIndx + 1;
+    ++ring->headSeq;
+    ring->fillLen = 0;
+  }
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           APPEND TO RING LOG
+ *
+ * Description : Adds bytes to the head sector of the ring. Each time the head
+ *               sector is full it is written to the disk, and the next sector
+ *               of the ring, overwriting the oldest, becomes the head.
+ *
+ * Arguments   : ring      - Pointer to a FatRing instance.
+ *               dataArr   - Pointer to the array holding the bytes.
+ *               len       - Number of bytes to add.
+ *
+ * Returns     : SUCCESS or FAILED_WRITE_SECTOR. On failure the full head
+ *               sector is kept, and written by the next call to this function
+ *               or fat_RingFlush, but the bytes of dataArr after it are not
+ *               added.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_RingAppend(FatRing *ring, const uint8_t dataArr[], uint16_t len)
+{
+  uint8_t err;
+
+  for (;;)
+  {
+    // a full head sector is written, and the next sector becomes the head.
+    if (ring->fillLen == RING_DATA_LEN)
+    {
+      if ((err = pvt_WriteHead(ring)) != SUCCESS)
+        return err;
+      if (++ring->headIndx == ring->secCnt)
+        ring->headIndx = 0;
+      ++ring->headSeq;
+      ring->fillLen = 0;
+    }
+    if (len == 0)
+      return SUCCESS;
+
+    uint16_t byteCnt = RING_DATA_LEN - ring->fillLen;
+    if (byteCnt > len)
+      byteCnt = len;
+    memcpy(&ring->secArr[RING_HDR_LEN + ring->fillLen], dataArr, byteCnt);
+    ring->fillLen += byteCnt;
+    dataArr += byteCnt;
+    len -= byteCnt;
+  }
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                               FLUSH RING LOG
+ *
+ * Description : Writes the head sector to the disk, if it holds any bytes,
+ *               without moving to the next sector.
+ *
+ * Arguments   : ring   - Pointer to a FatRing instance.
+ *
+ * Returns     : SUCCESS or FAILED_WRITE_SECTOR.
+ *
+ * Notes       : The head sector is written again each time it is flushed
+ *               until it is full, so flushing more often than necessary
+ *               wears the disk.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_RingFlush(FatRing *ring)
+{
+  // a full head sector is written and replaced by fat_RingAppend.
+  if (ring->fillLen == RING_DATA_LEN)
+    return fat_RingAppend(ring, NULL, 0);
+  if (ring->fillLen)
+    return pvt_WriteHead(ring);
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                     INITIALIZE RING ITERATOR
+ *
+ * Description : Sets a FatRingIter instance to the oldest sector of a ring.
+ *
+ * Arguments   : it     - Pointer to the FatRingIter instance to be set.
+ *               ring   - Pointer to a FatRing instance set by fat_RingOpen.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void fat_RingIterInit(FatRingIter *it, const FatRing *ring)
+{
+  // the head sector is only included once it holds log data.
+  it->endSeq = ring->headSeq + (ring->fillLen ? 1 : 0);
+
+  // once the ring has wrapped, the oldest sector is the one after the last.
+  it->seq = 0;
+  if (it->endSeq > ring->secCnt)
+    it->seq = it->endSeq - ring->secCnt;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             NEXT RING SECTOR
+ *
+ * Description : Loads the next sector of a ring, in the order the log data
+ *               was added, into an array.
+ *
+ * Arguments   : it       - Pointer to a FatRingIter instance.
+ *               ring     - Pointer to the FatRing instance it was set with.
+ *               secArr   - Pointer to an array of length SECTOR_LEN that will
+ *                          be loaded with the sector. The log data starts at
+ *                          secArr[RING_HDR_LEN].
+ *               len      - Pointer to a variable set to the number of bytes
+ *                          of log data in the sector.
+ *
+ * Returns     : SUCCESS, FAILED_READ_SECTOR, or END_OF_FILE if there are no
+ *               more sectors.
+ *
+ * Notes       : 1) Sectors whose header is not valid, or whose sequence
+ *                  number is not the one expected, are skipped.
+ *               2) Sectors are read from the disk, so bytes added to the head
+ *                  sector since it was last written are not returned. Call
+ *                  fat_RingFlush first to include them.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_RingIterNext(FatRingIter *it, const FatRing *ring,
+                         uint8_t secArr[], uint16_t *len)
+{
+  while (it->seq < it->endSeq)
+  {
+    uint32_t seq = it->seq++;
+    if (pvt_Transfer(ring->fstSecNum + seq % ring->secCnt, secArr, IOQ_READ)
+        != SUCCESS)
+      return FAILED_READ_SECTOR;
+
+    if (pvt_HdrIsValid(secArr, seq))
+    {
+      memcpy(len, &secArr[HDR_LEN_POS], sizeof *len);
+      return SUCCESS;
+    }
+  }
+  return END_OF_FILE;
+}
+
+/*
+ ******************************************************************************
+ *                           "PRIVATE" FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                           (PRIVATE) CHECK SEQUENCE AT SECTOR
+ *
+ * Description : Reads a sector of the ring, and checks if it is valid and
+ *               holds the sequence number seq.
+ *
+ * Arguments   : ring     - Pointer to a FatRing instance.
+ *               indx     - Number of the sector in the ring.
+ *               seq      - The sequence number expected.
+ *               secArr   - Pointer to an array of length SECTOR_LEN that will
+ *                          be loaded with the sector.
+ *               isSeq    - Pointer to a variable set to 1 if the sector holds
+ *                          seq, or 0 if it does not.
+ *
+ * Returns     : SUCCESS or FAILED_READ_SECTOR.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_IsSeqAt(const FatRing *ring, uint32_t indx, uint32_t seq,
+                           uint8_t secArr[], uint8_t *isSeq)
+{
+  if (pvt_Transfer(ring->fstSecNum + indx, secArr, IOQ_READ) != SUCCESS)
+    return FAILED_READ_SECTOR;
+  *isSeq = pvt_HdrIsValid(secArr, seq);
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                    (PRIVATE) IS HEADER VALID
+ *
+ * Description : Checks the header of a ring sector.
+ *
+ * Arguments   : secArr   - Pointer to the array holding the sector.
+ *               seq      - The sequence number the sector should hold.
+ *
+ * Returns     : 1 if the header is valid and holds seq, otherwise 0.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_HdrIsValid(const uint8_t secArr[], uint32_t seq)
+{
+  uint32_t hdrSeq;
+  uint16_t hdrLen;
+
+  memcpy(&hdrSeq, &secArr[HDR_SEQ_POS], sizeof hdrSeq);
+  memcpy(&hdrLen, &secArr[HDR_LEN_POS], sizeof hdrLen);
+  return secArr[HDR_MAGIC_POS] == RING_MAGIC
+         && secArr[HDR_CHECK_POS] == pvt_HdrCheck(secArr)
+         && hdrSeq == seq && hdrLen <= RING_DATA_LEN;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                  (PRIVATE) HEADER CHECK BYTE
+ *
+ * Description : Calculates the check byte of a ring sector's header.
+ *
+ * Arguments   : secArr   - Pointer to the array holding the sector.
+ *
+ * Returns     : The inverse of the exclusive-or of the header bytes before
+ *               the check byte.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_HdrCheck(const uint8_t secArr[])
+{
+  uint8_t check = 0;
+
+  for (uint8_t pos = 0; pos < HDR_CHECK_POS; ++pos)
+    check ^= secArr[pos];
+  return ~check;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                  (PRIVATE) WRITE HEAD SECTOR
+ *
+ * Description : Sets the header of the head sector and writes it to its
+ *               sector of the ring.
+ *
+ * Arguments   : ring   - Pointer to a FatRing instance.
+ *
+ * Returns     : SUCCESS or FAILED_WRITE_SECTOR.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_WriteHead(FatRing *ring)
+{
+  // the header is little endian, as is the AVR.
+  memcpy(&ring->secArr[HDR_SEQ_POS], &ring->headSeq, sizeof ring->headSeq);
+  memcpy(&ring->secArr[HDR_LEN_POS], &ring->fillLen, sizeof ring->fillLen);
+  ring->secArr[HDR_MAGIC_POS] = RING_MAGIC;
+  ring->secArr[HDR_CHECK_POS] = pvt_HdrCheck(ring->secArr);
+
+  if (pvt_Transfer(ring->fstSecNum + ring->headIndx, ring->secArr, IOQ_WRITE)
+      != SUCCESS)
+    return FAILED_WRITE_SECTOR;
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                  (PRIVATE) TRANSFER A SECTOR
+ *
+ * Description : Reads or writes a sector of the ring with fat_IoqTransfer,
+ *               so it goes through the I/O queue of FAT_IOQ.H if one is
+ *               attached. Writes are IOQ_PRIO_RT, as the ring is a log, and
+ *               reads are IOQ_PRIO_NORMAL.
+ *
+ * Arguments   : secNum   - Disk sector of the sector.
+ *               secArr   - Pointer to the array of length SECTOR_LEN to read
+ *                          the sector into or write it from.
+ *               op       - IOQ_READ or IOQ_WRITE.
+ *
+ * Returns     : SUCCESS, FAILED_READ_SECTOR or FAILED_WRITE_SECTOR.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_Transfer(uint32_t secNum, uint8_t secArr[], uint8_t op)
+{
+  IoReq req;
+
+  req.secNum = secNum;
+  req.secArr = secArr;
+  req.numOfSecs = 1;
+  req.prio = (op == IOQ_WRITE) ? IOQ_PRIO_RT : IOQ_PRIO_NORMAL;
+  req.op = op;
+  return fat_IoqTransfer(&req);
+}
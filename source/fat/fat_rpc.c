@@ -0,0 +1,588 @@
+/*
+ * File       : FAT_RPC.C
+ * Version    : 2.0
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Implementation of FAT_RPC.H
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "fat_bpb.h"
+#include "fat.h"
+#include "fat_to_disk_if.h"
+#include "fat_cache.h"
+#include "fat_sum.h"
+#include "fat_rpc.h"
+
+/*
+ ******************************************************************************
+ *                 "PRIVATE" FUNCTION PROTOTYPES (and MACROS)
+ ******************************************************************************
+ */
+
+// bytes of an entry in a listing, before its long name.
+#define RPC_ENT_LEN             (1 + 4 + 4 + ENTRY_REF_LEN + 1)
+
+#if RPC_PAYLOAD_MAX < 1 + DIR_CURSOR_LEN + 1 + RPC_ENT_LEN + LN_STR_LEN_MAX
+#error "RPC_PAYLOAD_MAX is too small for a listing of the longest name"
+#endif
+
+static uint8_t pvt_Serve(FatRpc *rpc, uint16_t reqLen, const BPB *bpb);
+static uint8_t pvt_List(uint8_t payArr[], uint16_t reqLen, uint16_t *respLen,
+                        const BPB *bpb);
+static uint8_t pvt_Stat(uint8_t payArr[], uint16_t *respLen, const BPB *bpb);
+static uint8_t pvt_Lookup(FatLookupStep *lk, const FatDir *dir,
+                          const char nameStr[], uint8_t attr, const BPB *bpb);
+static uint8_t pvt_OpenRef(FatRpc *rpc, const uint8_t refArr[],
+                           uint32_t *pos, const BPB *bpb);
+static void pvt_SendResp(FatRpc *rpc, uint8_t sts, uint16_t respLen);
+static void pvt_StoreLE(uint8_t byteArr[], uint32_t val, uint8_t len);
+static uint16_t pvt_Crc16(const uint8_t byteArr[], uint16_t len);
+
+/*
+ ******************************************************************************
+ *                                FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                        INITIALIZE RPC SERVER
+ *
+ * Description : Sets a FatRpc instance to wait for the first byte of a frame.
+ *
+ * Arguments   : rpc     - Pointer to the FatRpc instance to be set.
+ *               txFn    - Function the bytes of the responses are sent with.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void fat_RpcInit(FatRpc *rpc, FatRpcTxFn txFn)
+{
+  rpc->txFn = txFn;
+  rpc->inFrame = 0;
+  rpc->rxLen = 0;
+  rpc->frameCnt = 0;
+  rpc->badCnt = 0;
+  rpc->isOpen = 0;
+  rpc->isPrefetch = 0;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                          RECEIVE AN RPC BYTE
+ *
+ * Description : Adds a byte received from the host to the frame being
+ *               received. When the frame is complete and its CRC is good,
+ *               the request is carried out and its response sent.
+ *
+ * Arguments   : rpc     - Pointer to a FatRpc instance.
+ *               byte    - The byte received.
+ *               bpb     - Pointer to the BPB struct instance.
+ *
+ * Returns     : STEP_BUSY while a frame is being received, or after a frame
+ *               is dropped. Otherwise the status of the response sent, or
+ *               RPC_EXIT if it was the response to RPC_OP_EXIT.
+ *
+ * Notes       : Bytes before RPC_SOF are ignored, e.g. the echo of the
+ *               command that started the server.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_RpcRxByte(FatRpc *rpc, uint8_t byte, const BPB *bpb)
+{
+  uint16_t reqLen;
+
+  if (!rpc->inFrame)
+  {
+    rpc->inFrame = byte == RPC_SOF;
+    rpc->rxLen = 0;
+    return STEP_BUSY;
+  }
+
+  rpc->frameArr[rpc->rxLen++] = byte;
+  if (rpc->rxLen < RPC_HDR_LEN - 1)
+    return STEP_BUSY;
+
+  // a length that is too long is taken as a lost RPC_SOF.
+  reqLen = LOAD_LE16(&rpc->frameArr[2]);
+  if (reqLen > RPC_PAYLOAD_MAX)
+  {
+    rpc->inFrame = 0;
+    ++rpc->badCnt;
+    return STEP_BUSY;
+  }
+  if (rpc->rxLen < RPC_HDR_LEN - 1 + reqLen + RPC_CRC_LEN)
+    return STEP_BUSY;
+
+  rpc->inFrame = 0;
+  if (pvt_Crc16(rpc->frameArr, RPC_HDR_LEN - 1 + reqLen)
+      != LOAD_LE16(&rpc->frameArr[RPC_HDR_LEN - 1 + reqLen]))
+  {
+    ++rpc->badCnt;
+    return STEP_BUSY;
+  }
+  ++rpc->frameCnt;
+  return pvt_Serve(rpc, reqLen, bpb);
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                RPC IDLE STEP
+ *
+ * Description : Reads up to RPC_PREFETCH_SECS sectors of the file, from the
+ *               end of the last range read, into the cache, so the next range
+ *               of a file read in order is already in the cache when its
+ *               request arrives.
+ *
+ * Arguments   : rpc     - Pointer to a FatRpc instance.
+ *               bpb     - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, or a FAT Error Flag from reading the sectors. Any
+ *               error is found again by the next read of the file.
+ *
+ * Notes       : Call this while no bytes are waiting to be received. It
+ *               reads at most one run of sectors, with a single multiple
+ *               sector read of the disk, and returns at once when there is
+ *               nothing to read.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_RpcIdle(FatRpc *rpc, const BPB *bpb)
+{
+  uint8_t  err;
+  uint32_t secNum;
+  uint32_t numOfSecs;
+
+  if (!rpc->isPrefetch)
+    return SUCCESS;
+  rpc->isPrefetch = 0;
+
+  // the run starts with the sector the last range ended in, which the cache
+  // already holds, so it is not read again.
+  err = fat_GetFileRun(&rpc->file, &secNum, &numOfSecs, RPC_PREFETCH_SECS,
+                       bpb);
+  if (err == SUCCESS)
+    err = fat_CacheLoad(secNum, numOfSecs, CACHE_DATA);
+  return err == END_OF_FILE ? SUCCESS : err;
+}
+
+/*
+ ******************************************************************************
+ *                           "PRIVATE" FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                      (PRIVATE) SERVE REQUEST
+ *
+ * Description : Carries out the request in the frame received and sends its
+ *               response.
+ *
+ * Arguments   : rpc      - Pointer to a FatRpc instance holding the frame.
+ *               reqLen   - Length of the request's payload.
+ *               bpb      - Pointer to the BPB struct instance.
+ *
+ * Returns     : The status of the response, or RPC_EXIT.
+ *
+ * Notes       : The response is built in frameArr, over the request, so the
+ *               request's arguments are read before any of it is set. Only
+ *               the status is sent when the request fails.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_Serve(FatRpc *rpc, uint16_t reqLen, const BPB *bpb)
+{
+  uint8_t  err;
+  uint8_t *payArr = &rpc->frameArr[RPC_HDR_LEN - 1];
+  uint8_t  op = rpc->frameArr[1];
+  uint16_t respLen = 0;
+  uint32_t pos;
+
+  // paths are used as strings, so the payload is null terminated over the
+  // CRC, which has been checked.
+  payArr[reqLen] = '\0';
+
+  switch (op)
+  {
+    case RPC_OP_HELLO:
+      err = reqLen ? RPC_BAD_LEN : SUCCESS;
+      if (err == SUCCESS)
+      {
+        payArr[1] = RPC_VERSION;
+        pvt_StoreLE(&payArr[2], RPC_PAYLOAD_MAX, 2);
+        pvt_StoreLE(&payArr[4], RPC_WINDOW_BYTES, 2);
+        respLen = 5;
+      }
+      break;
+
+    case RPC_OP_LIST:
+      err = pvt_List(payArr, reqLen, &respLen, bpb);
+      break;
+
+    case RPC_OP_STAT:
+      err = pvt_Stat(payArr, &respLen, bpb);
+      break;
+
+    case RPC_OP_READ:
+      err = reqLen != ENTRY_REF_LEN + 6 ? RPC_BAD_LEN
+            : pvt_OpenRef(rpc, payArr, &pos, bpb);
+      if (err == SUCCESS)
+      {
+        uint16_t len = LOAD_LE16(&payArr[ENTRY_REF_LEN + 4]);
+
+        if (len > RPC_PAYLOAD_MAX - 1)
+          len = RPC_PAYLOAD_MAX - 1;
+        err = fat_ReadFile(&rpc->file, &payArr[1], len, bpb);
+        if (err == SUCCESS || err == END_OF_FILE)
+          respLen = rpc->file.currPos - pos;
+        rpc->isPrefetch = err == SUCCESS;
+      }
+      break;
+
+    case RPC_OP_WRITE:
+      err = reqLen < ENTRY_REF_LEN + 4 ? RPC_BAD_LEN
+            : pvt_OpenRef(rpc, payArr, &pos, bpb);
+      if (err == SUCCESS)
+      {
+        err = fat_WriteFile(&rpc->file, &payArr[ENTRY_REF_LEN + 4],
+                            reqLen - ENTRY_REF_LEN - 4, bpb);
+        if (err == SUCCESS || err == END_OF_FILE)
+        {
+          pvt_StoreLE(&payArr[1], rpc->file.currPos - pos, 2);
+          respLen = 2;
+        }
+      }
+      break;
+
+    case RPC_OP_SUM:
+      err = reqLen != ENTRY_REF_LEN + 1 ? RPC_BAD_LEN
+            : pvt_OpenRef(rpc, payArr, NULL, bpb);
+      if (err == SUCCESS)
+      {
+        uint32_t sum;
+
+        err = fat_Checksum(&rpc->file, payArr[ENTRY_REF_LEN], &sum, bpb);
+        if (err == SUCCESS)
+        {
+          pvt_StoreLE(&payArr[1], sum, 4);
+          respLen = 4;
+        }
+      }
+      break;
+
+    case RPC_OP_SYNC:
+      err = reqLen ? RPC_BAD_LEN : fat_Sync();
+      break;
+
+    case RPC_OP_EXIT:
+      err = SUCCESS;
+      break;
+
+    default:
+      err = RPC_BAD_OP;
+      break;
+  }
+
+  pvt_SendResp(rpc, err, respLen);
+  return op == RPC_OP_EXIT ? RPC_EXIT : err;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                     (PRIVATE) LIST DIRECTORY
+ *
+ * Description : Carries out an RPC_OP_LIST request. The entries after the
+ *               cursor are added to the response until the most entries
+ *               requested are added, the next one does not fit, or the end
+ *               of the directory is reached.
+ *
+ * Arguments   : payArr    - Pointer to the payload of the request, which is
+ *                           replaced by the response, after its status.
+ *               reqLen    - Length of the request's payload.
+ *               respLen   - Pointer to the length of the response after its
+ *                           status, set here.
+ *               bpb       - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, END_OF_DIRECTORY, RPC_BAD_LEN, or a FAT Error Flag
+ *               from finding the directory or reading its entries.
+ *
+ * Notes       : The cursor returned is after the last entry added, or at the
+ *               end of the directory, so an entry that did not fit is the
+ *               first of the next page.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_List(uint8_t payArr[], uint16_t reqLen, uint16_t *respLen,
+                        const BPB *bpb)
+{
+  uint8_t      err;
+  uint8_t      entMax;
+  uint8_t      entCnt = 0;
+  uint16_t     pos = 1 + DIR_CURSOR_LEN + 1;
+  FatDirCursor cur;
+  FatEntry     ent;
+  FatEntryRef  ref;
+
+  if (reqLen < DIR_CURSOR_LEN + 1)
+    return RPC_BAD_LEN;
+  fat_UnpackCursor(&cur, payArr);
+  entMax = payArr[DIR_CURSOR_LEN];
+
+  // no cluster index is 0, so only the cursor of all zeros has it.
+  if (cur.clusIndx == 0)
+  {
+    FatDir dir;
+
+    err = fat_SetDirToPath(&dir, (char *)&payArr[DIR_CURSOR_LEN + 1], bpb);
+    if (err != SUCCESS)
+      return err;
+    fat_InitDirCursor(&cur, &dir);
+  }
+  if ((err = fat_SetEntryToCursor(&ent, &cur, bpb)) != SUCCESS)
+    return err;
+
+  while (entCnt < entMax && (err = fat_SetNextEntry(&ent, bpb)) == SUCCESS)
+  {
+    uint8_t lnLen = strlen(ent.lnStr);
+
+    if (ent.info.attr & VOLUME_ID_ATTR)
+      continue;
+    if (pos + RPC_ENT_LEN + lnLen > RPC_PAYLOAD_MAX)
+      break;
+
+    payArr[pos] = ent.info.attr;
+    pvt_StoreLE(&payArr[pos + 1], ent.info.fileSize, 4);
+    pvt_StoreLE(&payArr[pos + 5], ent.info.writeDateTime, 4);
+    fat_SetEntryRef(&ref, &ent);
+    fat_PackRef(&ref, &payArr[pos + 9]);
+    payArr[pos + 9 + ENTRY_REF_LEN] = lnLen;
+    memcpy(&payArr[pos + RPC_ENT_LEN], ent.lnStr, lnLen);
+    pos += RPC_ENT_LEN + lnLen;
+
+    fat_SetCursorToEntry(&cur, &ent);
+    ++entCnt;
+  }
+  if (err == END_OF_DIRECTORY)
+    fat_SetCursorToEntry(&cur, &ent);
+  else if (err != SUCCESS)
+    return err;
+
+  fat_PackCursor(&cur, &payArr[1]);
+  payArr[1 + DIR_CURSOR_LEN] = entCnt;
+  *respLen = pos - 1;
+  return err;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                             (PRIVATE) STAT FILE OR DIRECTORY
+ *
+ * Description : Carries out an RPC_OP_STAT request. The path is looked up as
+ *               a file, and then as a directory.
+ *
+ * Arguments   : payArr    - Pointer to the payload of the request, a null
+ *                           terminated path, which is replaced by the
+ *                           response, after its status.
+ *               respLen   - Pointer to the length of the response after its
+ *                           status, set here.
+ *               bpb       - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, FILE_NOT_FOUND, DIR_NOT_FOUND if the path is not of
+ *               a file or directory, or another FAT Error Flag.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_Stat(uint8_t payArr[], uint16_t *respLen, const BPB *bpb)
+{
+  uint8_t       err;
+  const char   *dirStr = "";
+  char         *nameStr = strrchr((char *)payArr, '/');
+  FatDir        dir;
+  FatLookupStep lk;
+  FatEntryRef   ref;
+
+  // the directory is the path up to the last '/', if there is one.
+  if (nameStr == NULL)
+    nameStr = (char *)payArr;
+  else
+  {
+    *nameStr++ = '\0';
+    dirStr = (char *)payArr;
+  }
+
+  err = fat_SetDirToPath(&dir, dirStr, bpb);
+  if (err == SUCCESS)
+    err = pvt_Lookup(&lk, &dir, nameStr, 0, bpb);
+  if (err == FILE_NOT_FOUND)
+    err = pvt_Lookup(&lk, &dir, nameStr, DIR_ENTRY_ATTR, bpb);
+  if (err != SUCCESS)
+    return err;
+
+  payArr[1] = lk.ent.info.attr;
+  pvt_StoreLE(&payArr[2], lk.ent.info.fileSize, 4);
+  pvt_StoreLE(&payArr[6], lk.ent.info.createDateTime, 4);
+  pvt_StoreLE(&payArr[10], lk.ent.info.writeDateTime, 4);
+  pvt_StoreLE(&payArr[14], lk.ent.info.lastAccDate, 2);
+  fat_SetEntryRef(&ref, &lk.ent);
+  fat_PackRef(&ref, &payArr[16]);
+  *respLen = 15 + ENTRY_REF_LEN;
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                     (PRIVATE) LOOK UP A NAME
+ *
+ * Description : Searches a directory for a file or directory, running
+ *               fat_StepLookup until the search is complete.
+ *
+ * Arguments   : lk        - Pointer to the FatLookupStep instance used.
+ *               dir       - Pointer to the FatDir instance of the directory.
+ *               nameStr   - Pointer to the name of the file or directory.
+ *               attr      - DIR_ENTRY_ATTR to find a directory, or 0 to find
+ *                           a file.
+ *               bpb       - Pointer to the BPB struct instance.
+ *
+ * Returns     : As fat_InitLookupStep and fat_StepLookup, other than
+ *               STEP_BUSY.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_Lookup(FatLookupStep *lk, const FatDir *dir,
+                          const char nameStr[], uint8_t attr, const BPB *bpb)
+{
+  uint8_t err = fat_InitLookupStep(lk, dir, nameStr, attr, bpb);
+
+  if (err == SUCCESS)
+    while ((err = fat_StepLookup(lk, bpb)) == STEP_BUSY)
+      ;
+  return err;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                        (PRIVATE) OPEN REFERENCE AND POSITION
+ *
+ * Description : Sets the server's file to the reference at the start of a
+ *               request, and positions it at the byte position after the
+ *               reference, if the request has one.
+ *
+ * Arguments   : rpc      - Pointer to a FatRpc instance.
+ *               refArr   - Pointer to the packed reference, followed by the
+ *                          byte position (4 bytes) if pos is not NULL.
+ *               pos      - Pointer to a variable set to the position, or
+ *                          NULL if the request has no position.
+ *               bpb      - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, or a FAT Error Flag from fat_OpenRef.
+ *
+ * Notes       : 1) If the reference is that of the file already open, the
+ *                  file is not opened again, so its place in the cluster
+ *                  chain is kept.
+ *               2) A position past the end of the file is moved to the end,
+ *                  so a range there reads or writes no bytes.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_OpenRef(FatRpc *rpc, const uint8_t refArr[],
+                           uint32_t *pos, const BPB *bpb)
+{
+  uint8_t     err;
+  FatEntryRef ref;
+
+  if (!rpc->isOpen || memcmp(rpc->refArr, refArr, ENTRY_REF_LEN))
+  {
+    rpc->isOpen = 0;
+    rpc->isPrefetch = 0;
+    fat_UnpackRef(&ref, refArr);
+    if ((err = fat_OpenRef(&rpc->file, &ref, bpb)) != SUCCESS)
+      return err;
+    memcpy(rpc->refArr, refArr, ENTRY_REF_LEN);
+    rpc->isOpen = 1;
+  }
+
+  if (pos == NULL)
+    return SUCCESS;
+  *pos = LOAD_LE32(&refArr[ENTRY_REF_LEN]);
+  if (*pos > rpc->file.fileSize)
+    *pos = rpc->file.fileSize;
+  return fat_SeekFile(&rpc->file, *pos, bpb);
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                      (PRIVATE) SEND RESPONSE
+ *
+ * Description : Sends the response built in the frame of the request, with
+ *               the request's sequence number.
+ *
+ * Arguments   : rpc       - Pointer to a FatRpc instance.
+ *               sts       - Status of the response.
+ *               respLen   - Length of the response's payload after the
+ *                           status.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+static void pvt_SendResp(FatRpc *rpc, uint8_t sts, uint16_t respLen)
+{
+  uint8_t *frameArr = rpc->frameArr;
+  uint16_t frameLen = RPC_HDR_LEN + respLen;
+  uint16_t crc;
+
+  frameArr[1] |= RPC_RESP;
+  pvt_StoreLE(&frameArr[2], respLen + 1, 2);
+  frameArr[RPC_HDR_LEN - 1] = sts;
+  crc = pvt_Crc16(frameArr, frameLen);
+
+  rpc->txFn(RPC_SOF);
+  for (uint16_t byte = 0; byte < frameLen; ++byte)
+    rpc->txFn(frameArr[byte]);
+  rpc->txFn(crc);
+  rpc->txFn(crc >> 8);
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                (PRIVATE) STORE LITTLE ENDIAN
+ *
+ * Description : Stores the len low bytes of a value, least significant first.
+ *
+ * Arguments   : byteArr   - Pointer to the array the bytes are stored in.
+ *               val       - The value.
+ *               len       - Number of bytes to store.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+static void pvt_StoreLE(uint8_t byteArr[], uint32_t val, uint8_t len)
+{
+  for (uint8_t byte = 0; byte < len; ++byte, val >>= 8)
+    byteArr[byte] = val;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                          (PRIVATE) FRAME CRC
+ *
+ * Description : Calculates the CRC-16/CCITT-FALSE of an array of bytes.
+ *
+ * Arguments   : byteArr   - Pointer to the array.
+ *               len       - Number of bytes in the array.
+ *
+ * Returns     : The CRC.
+ *
+ * Notes       : The CRC is calculated a bit at a time, without a table, as
+ *               the link is much slower than the calculation.
+ * ----------------------------------------------------------------------------
+ */
+static uint16_t pvt_Crc16(const uint8_t byteArr[], uint16_t len)
+{
+  uint16_t crc = 0xFFFF;
+
+  while (len--)
+  {
+    crc ^= (uint16_t)*byteArr++ << 8;
+    for (uint8_t bit = 0; bit < 8; ++bit)
+      crc = crc & 0x8000 ? crc << 1 ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
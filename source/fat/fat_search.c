@@ -0,0 +1,341 @@
+/*
+ * File       : FAT_SEARCH.C
+ * Version    : 2.0
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Implementation of FAT_SEARCH.H
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "fat_bpb.h"
+#include "fat.h"
+#include "fat_search.h"
+
+/*
+ ******************************************************************************
+ *                 "PRIVATE" FUNCTION PROTOTYPES (and MACROS)
+ ******************************************************************************
+ */
+
+static uint8_t pvt_ReadAt(FatFile *file, const FatFile *anchor, uint32_t pos,
+                          uint8_t dataArr[], uint16_t len, const BPB *bpb);
+static int8_t pvt_CompareKeys(const FatSearch *srch, const uint8_t keyA[],
+                              const uint8_t keyB[]);
+static uint32_t pvt_KeyValue(const FatSearch *srch, const uint8_t keyArr[]);
+
+// flags used by fat_SearchKey to track which bounding key values are known
+#define LO_VAL_KNOWN      0x01
+#define HI_VAL_KNOWN      0x02
+
+/*
+ ******************************************************************************
+ *                                FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            INITIALIZE SEARCH
+ *
+ * Description : Sets the record format of a sorted file in a FatSearch
+ *               instance and loads the keys of the top levels of the search
+ *               tree from the file into its cache.
+ *
+ * Arguments   : srch        - Pointer to the FatSearch instance to be set.
+ *               file        - Pointer to a FatFile instance, set by
+ *                             fat_OpenFile, of the sorted file.
+ *               recLen      - Byte length of each record.
+ *               keyOffset   - Byte offset of the key in each record.
+ *               keyLen      - Byte length of the key.
+ *               keyType     - One of the KEY TYPES.
+ *               bpb         - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, INVALID_RECORD_FORMAT, or a FAT Error Flag if the
+ *               cached keys could not be read.
+ *
+ * Notes       : 1) The file must hold a whole number of records, sorted in
+ *                  ascending order of their keys.
+ *               2) This reads (2^FS_CACHE_LVLS - 1) records, at most.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_InitSearch(FatSearch *srch, const FatFile *file, uint16_t recLen,
+                       uint8_t keyOffset, uint8_t keyLen, uint8_t keyType,
+                       const BPB *bpb)
+{
+  uint8_t err;
+
+  // key must be within the record. Numeric keys must fit in 32 bits.
+  if (!recLen || !keyLen || keyLen > FS_KEY_LEN_MAX
+      || keyOffset + keyLen > recLen || keyType > FS_KEY_UINT_BE
+      || (keyType != FS_KEY_BYTES && keyLen > sizeof(uint32_t))
+      || file->fileSize % recLen)
+    return INVALID_RECORD_FORMAT;
+
+  srch->file = *file;
+  srch->numOfRecs = file->fileSize / recLen;
+  srch->recLen = recLen;
+  srch->keyOffset = keyOffset;
+  srch->keyLen = keyLen;
+  srch->keyType = keyType;
+
+  //
+  // Load the key of the middle record of each cached node's range. The nodes
+  // are visited in-order (i.e. in order of their record position) so the
+  // file's cluster chain only has to be followed forward once. For in-order
+  // count k, the node is at level (FS_CACHE_LVLS - 1 - tz), where tz is the
+  // number of trailing zero bits in k.
+  //
+  for (uint16_t k = 1; k <= FS_CACHE_NODES; ++k)
+  {
+    uint8_t tz = 0;
+    while (!(k & (1 << tz)))
+      ++tz;
+    uint16_t node = (k >> (tz + 1)) + (1 << (FS_CACHE_LVLS - 1 - tz));
+
+    // find range of records, [lo, hi), of the node by descending from root.
+    uint32_t lo = 0, hi = srch->numOfRecs;
+    for (uint8_t lvl = FS_CACHE_LVLS - 1 - tz; lvl > 0 && lo < hi; --lvl)
+    {
+      uint32_t mid = lo + (hi - lo) / 2;
+      if (node & (1 << (lvl - 1)))          // right child
+        lo = mid + 1;
+      else                                  // left child
+        hi = mid;
+    }
+
+    // node is never reached by a search if its range is empty.
+    if (lo >= hi)
+      continue;
+
+    uint32_t mid = lo + (hi - lo) / 2;
+    err = pvt_ReadAt(&srch->file, file, mid * recLen + keyOffset,
+                     srch->cacheKeys[node - 1], keyLen, bpb);
+    if (err != SUCCESS)
+      return err;
+    srch->cacheClus[node - 1] = srch->file.currClusIndx;
+  }
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                        SEARCH FOR RECORD KEY
+ *
+ * Description : Searches the sorted file for the record whose key matches
+ *               keyArr, and loads the record into recArr if it is found.
+ *
+ * Arguments   : srch     - Pointer to a FatSearch instance set by
+ *                          fat_InitSearch.
+ *               keyArr   - Pointer to an array holding the key to search for.
+ *                          Must be of length keyLen and in the key's format.
+ *               recArr   - Pointer to the array that will be loaded with the
+ *                          matching record. Must be of length recLen.
+ *               bpb      - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS if found, KEY_NOT_FOUND, or a FAT Error Flag if a
+ *               record could not be read.
+ *
+ * Notes       : A lookup costs about log2(numOfRecs) - FS_CACHE_LVLS record
+ *               reads, and fewer with interpolation of numeric keys.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_SearchKey(FatSearch *srch, const uint8_t keyArr[],
+                      uint8_t recArr[], const BPB *bpb)
+{
+  uint8_t err;
+  int8_t  cmp;
+
+  //
+  // The matching record, if any, is in the range [lo, hi). For numeric keys,
+  // loVal is the key of record lo - 1 and hiVal is the key of record hi,
+  // once these are known.
+  //
+  uint32_t lo = 0, hi = srch->numOfRecs;
+  uint32_t loVal = 0, hiVal = 0;
+  uint8_t  valsKnown = 0;
+  uint32_t keyVal = pvt_KeyValue(srch, keyArr);
+
+  //
+  // anchor is a file position at or before record lo. Any record in [lo, hi)
+  // can be reached by following the cluster chain forward from here.
+  //
+  FatFile anchor = srch->file;
+  anchor.currClusIndx = anchor.fstClusIndx;
+  anchor.currClusNum = 0;
+
+  // descend the cached levels of the tree without reading the disk.
+  for (uint16_t node = 1; node <= FS_CACHE_NODES && lo < hi; )
+  {
+    uint32_t mid = lo + (hi - lo) / 2;
+    cmp = pvt_CompareKeys(srch, keyArr, srch->cacheKeys[node - 1]);
+    if (!cmp)
+    {
+      FatFile file = anchor;
+      return pvt_ReadAt(&file, &anchor, mid * srch->recLen, recArr,
+                        srch->recLen, bpb);
+    }
+    else if (cmp < 0)
+    {
+      hi = mid;
+      hiVal = pvt_KeyValue(srch, srch->cacheKeys[node - 1]);
+      valsKnown |= HI_VAL_KNOWN;
+      node = 2 * node;
+    }
+    else
+    {
+      lo = mid + 1;
+      loVal = pvt_KeyValue(srch, srch->cacheKeys[node - 1]);
+      valsKnown |= LO_VAL_KNOWN;
+
+      // cached cluster holds the end of the key of record mid.
+      anchor.currClusIndx = srch->cacheClus[node - 1];
+      anchor.currClusNum = BPB_POS_TO_CLUS_NUM(bpb, mid * srch->recLen
+                                               + srch->keyOffset
+                                               + srch->keyLen - 1);
+      node = 2 * node + 1;
+    }
+  }
+
+  //
+  // continue the search on the disk. For numeric keys, interpolation and
+  // bisection are alternated when both bounding key values are known. This
+  // keeps the number of probes within twice that of a binary search when
+  // the keys are not evenly distributed.
+  //
+  FatFile file = anchor;
+  for (uint8_t interp = 1; lo < hi; interp = !interp)
+  {
+    uint32_t probe = lo + (hi - lo) / 2;
+    if (interp && srch->keyType != FS_KEY_BYTES
+        && valsKnown == (LO_VAL_KNOWN | HI_VAL_KNOWN) && hiVal > loVal)
+    {
+      // estimate position of keyVal between records lo - 1 and hi
+      uint64_t est = (uint64_t)(keyVal - loVal) * (hi - lo + 1)
+                   / (hiVal - loVal);
+      probe = lo + (uint32_t)est;
+      probe = (probe > lo) ? probe - 1 : lo;
+      if (probe >= hi)
+        probe = hi - 1;
+    }
+
+    uint8_t probeKey[FS_KEY_LEN_MAX];
+    err = pvt_ReadAt(&file, &anchor, probe * srch->recLen + srch->keyOffset,
+                     probeKey, srch->keyLen, bpb);
+    if (err != SUCCESS)
+      return err;
+
+    cmp = pvt_CompareKeys(srch, keyArr, probeKey);
+    if (!cmp)
+      return pvt_ReadAt(&file, &anchor, probe * srch->recLen, recArr,
+                        srch->recLen, bpb);
+    else if (cmp < 0)
+    {
+      hi = probe;
+      hiVal = pvt_KeyValue(srch, probeKey);
+      valsKnown |= HI_VAL_KNOWN;
+    }
+    else
+    {
+      lo = probe + 1;
+      loVal = pvt_KeyValue(srch, probeKey);
+      valsKnown |= LO_VAL_KNOWN;
+      anchor = file;                        // file is now at end of probe key
+    }
+  }
+  return KEY_NOT_FOUND;
+}
+
+/*
+ ******************************************************************************
+ *                           "PRIVATE" FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                         (PRIVATE) READ BYTES AT FILE POSITION
+ *
+ * Description : Reads len bytes from position pos of a file. If pos is in a
+ *               cluster before the file's current cluster, the file is first
+ *               reset to the anchor so that the chain is not followed from
+ *               the file's first cluster.
+ *
+ * Arguments   : file      - Pointer to the FatFile instance to read from.
+ *               anchor    - Pointer to a FatFile instance of the same file at
+ *                           a cluster at or before the one holding pos.
+ *               pos       - Byte position in the file to read from.
+ *               dataArr   - Pointer to the array that will be loaded.
+ *               len       - Number of bytes to read.
+ *               bpb       - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS or a FAT Error Flag. END_OF_FILE is returned if len
+ *               bytes are not available at pos.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_ReadAt(FatFile *file, const FatFile *anchor, uint32_t pos,
+                          uint8_t dataArr[], uint16_t len, const BPB *bpb)
+{
+  if (BPB_POS_TO_CLUS_NUM(bpb, pos) < file->currClusNum)
+    *file = *anchor;
+
+  if (fat_SeekFile(file, pos, bpb) != SUCCESS)
+    return END_OF_FILE;
+  return fat_ReadFile(file, dataArr, len, bpb);
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                      (PRIVATE) COMPARE KEYS
+ *
+ * Description : Compares two keys according to the key type of the search.
+ *
+ * Arguments   : srch   - Pointer to the FatSearch instance.
+ *               keyA   - Pointer to the first key.
+ *               keyB   - Pointer to the second key.
+ *
+ * Returns     : Negative if keyA < keyB, 0 if equal, positive if keyA > keyB.
+ *
+ * Notes       : Big-endian numeric keys compare the same as byte strings.
+ * ----------------------------------------------------------------------------
+ */
+static int8_t pvt_CompareKeys(const FatSearch *srch, const uint8_t keyA[],
+                              const uint8_t keyB[])
+{
+  if (srch->keyType == FS_KEY_UINT_LE)
+  {
+    uint32_t valA = pvt_KeyValue(srch, keyA);
+    uint32_t valB = pvt_KeyValue(srch, keyB);
+    return (valA > valB) - (valA < valB);
+  }
+
+  int cmp = memcmp(keyA, keyB, srch->keyLen);
+  return (cmp > 0) - (cmp < 0);
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                            (PRIVATE) NUMERIC VALUE OF A KEY
+ *
+ * Description : Returns the unsigned integer value of a numeric key.
+ *
+ * Arguments   : srch     - Pointer to the FatSearch instance.
+ *               keyArr   - Pointer to the key.
+ *
+ * Returns     : Value of the key, or 0 if the key type is FS_KEY_BYTES.
+ * ----------------------------------------------------------------------------
+ */
+static uint32_t pvt_KeyValue(const FatSearch *srch, const uint8_t keyArr[])
+{
+  uint32_t val = 0;
+
+  if (srch->keyType == FS_KEY_UINT_LE)
+    for (uint8_t byteNum = srch->keyLen; byteNum > 0; --byteNum)
+      val = (val << 8) | keyArr[byteNum - 1];
+  else if (srch->keyType == FS_KEY_UINT_BE)
+    for (uint8_t byteNum = 0; byteNum < srch->keyLen; ++byteNum)
+      val = (val << 8) | keyArr[byteNum];
+  return val;
+}
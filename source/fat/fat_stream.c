@@ -0,0 +1,391 @@
+/*
+ * File       : FAT_STREAM.C
+ * Version    : 2.0
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Implementation of FAT_STREAM.H
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "fat_bpb.h"
+#include "fat.h"
+#include "fat_to_disk_if.h"
+#include "fat_cache.h"
+#include "fat_ioq.h"
+#include "fat_stream.h"
+
+/*
+ ******************************************************************************
+ *                 "PRIVATE" FUNCTION PROTOTYPES (and MACROS)
+ ******************************************************************************
+ */
+
+static uint8_t pvt_FindRun(FatStream *strm, const BPB *bpb);
+static uint8_t pvt_StartRun(FatStream *strm, const BPB *bpb);
+static uint8_t pvt_QueueService(FatStream *strm, const BPB *bpb);
+static uint8_t pvt_EndSend(FatStream *strm);
+static void pvt_SwapBufs(FatStream *strm);
+
+/*
+ ******************************************************************************
+ *                                FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             OPEN FILE STREAM
+ *
+ * Description : Sets a FatStream instance to write a file from the file's
+ *               current position.
+ *
+ * Arguments   : strm   - Pointer to the FatStream instance to be set.
+ *               file   - Pointer to a FatFile instance set by fat_OpenFile.
+ *               bpb    - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, or STREAM_NOT_ALIGNED if the file's position is not
+ *               at the start of a sector, or the sectors are not SECTOR_LEN
+ *               bytes.
+ *
+ * Notes       : As with fat_WriteFile, the file is never extended. The file
+ *               should be created at its full size before it is streamed.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_StreamOpen(FatStream *strm, FatFile *file, const BPB *bpb)
+{
+  if (BPB_BYTES_PER_SEC(bpb) != SECTOR_LEN || file->currPos % SECTOR_LEN)
+    return STREAM_NOT_ALIGNED;
+
+  strm->file = file;
+  strm->runSecNum = 0;
+  strm->runSecsLeft = 0;
+  strm->fillLen = 0;
+  strm->fillIndx = 0;
+  strm->sendFull = 0;
+  strm->runOpen = 0;
+  strm->req.status = SUCCESS;
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            WRITE FILE STREAM
+ *
+ * Description : Copies bytes into the stream's buffers. This never uses the
+ *               disk, so it can be called with a deadline, e.g. by a sampling
+ *               loop. The buffers are sent to the disk by fat_StreamService.
+ *
+ * Arguments   : strm      - Pointer to a FatStream instance.
+ *               dataArr   - Pointer to the array holding the bytes.
+ *               len       - Number of bytes to write. Must not be more
+ *                           than SECTOR_LEN.
+ *
+ * Returns     : SUCCESS if all len bytes were copied. STREAM_FULL if there is
+ *               not room for them in the buffers, END_OF_FILE if they would go
+ *               past the end of the file, or STREAM_TOO_LONG, in which case
+ *               none are copied.
+ *
+ * Notes       : STREAM_FULL is the back-pressure of the stream. Both buffers
+ *               are full because the disk is slower than the data, so the
+ *               caller must either wait, calling fat_StreamService, or drop
+ *               the data.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_StreamWrite(FatStream *strm, const uint8_t dataArr[],
+                        uint16_t len)
+{
+  // longer writes might never fit, even with both buffers sent.
+  if (len > SECTOR_LEN)
+    return STREAM_TOO_LONG;
+
+  // bytes already accepted, from the position of the next sector to send.
+  uint32_t pendLen = strm->fillLen + (strm->sendFull ? SECTOR_LEN : 0);
+  if (strm->file->currPos + pendLen + len > strm->file->fileSize)
+    return END_OF_FILE;
+
+  // the fill buffer, and the other one if it has been sent.
+  uint16_t roomLen = SECTOR_LEN - strm->fillLen
+                   + (strm->sendFull ? 0 : SECTOR_LEN);
+  if (len > roomLen)
+    return STREAM_FULL;
+
+  while (len)
+  {
+    uint16_t byteCnt = SECTOR_LEN - strm->fillLen;
+    if (byteCnt > len)
+      byteCnt = len;
+    memcpy(&strm->bufArr[strm->fillIndx][strm->fillLen], dataArr, byteCnt);
+    strm->fillLen += byteCnt;
+    dataArr += byteCnt;
+    len -= byteCnt;
+
+    if (strm->fillLen == SECTOR_LEN && !strm->sendFull)
+      pvt_SwapBufs(strm);
+  }
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                          SERVICE FILE STREAM
+ *
+ * Description : Sends a full buffer to the disk, without waiting while the
+ *               disk is busy writing the buffer sent before it. A multiple
+ *               sector write is started when needed and stopped at the end of
+ *               each run of consecutive sectors of the file.
+ *
+ * Arguments   : strm   - Pointer to a FatStream instance.
+ *               bpb    - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS if there is no full buffer to send. STEP_BUSY if the
+ *               disk is busy or a full buffer is still waiting, in which case
+ *               this should be called again. Otherwise FAILED_WRITE_SECTOR or
+ *               a FAT Error Flag from finding the file's sectors, in which
+ *               case the buffer is kept and sent again by the next call.
+ *
+ * Notes       : 1) This is meant to be called from the main loop, as often as
+ *                  possible while data is being written.
+ *               2) While an I/O queue is attached, the full buffer is sent as
+ *                  an IOQ_PRIO_RT request, and each call makes at most one
+ *                  transfer of the queue until it is written.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_StreamService(FatStream *strm, const BPB *bpb)
+{
+  uint8_t err;
+
+  // with an I/O queue attached, each buffer is sent as a request of it.
+  if (fat_IoqIsAttached())
+    return pvt_QueueService(strm, bpb);
+
+  // the disk is still writing the last sector sent. Do not wait for it.
+  if (strm->runOpen && FATtoDisk_IsBusy())
+    return STEP_BUSY;
+
+  // the run of consecutive sectors has been sent, so end the disk write.
+  if (strm->runOpen && strm->runSecsLeft == 0)
+  {
+    strm->runOpen = 0;
+    if (FATtoDisk_StopStream() != WRITE_SECTOR_SUCCESS)
+      return FAILED_WRITE_SECTOR;
+  }
+
+  if (!strm->sendFull)
+    return SUCCESS;
+
+  if (!strm->runOpen && (err = pvt_StartRun(strm, bpb)) != SUCCESS)
+    return err;
+
+  // on failure the disk write is ended, and a new one is started next call.
+  if (FATtoDisk_StreamSector(strm->bufArr[strm->fillIndx ^ 1])
+      != WRITE_SECTOR_SUCCESS)
+  {
+    strm->runOpen = 0;
+    FATtoDisk_StopStream();
+    return FAILED_WRITE_SECTOR;
+  }
+  return pvt_EndSend(strm);
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            CLOSE FILE STREAM
+ *
+ * Description : Sends every full buffer, stops the disk's multiple sector
+ *               write, then writes the bytes of a partly filled buffer to the
+ *               file with fat_WriteFile.
+ *
+ * Arguments   : strm   - Pointer to a FatStream instance.
+ *               bpb    - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS or a FAT Error Flag.
+ *
+ * Notes       : The bytes of a partly filled buffer are written to the sector
+ *               cache of FAT_CACHE.H. Call fat_Sync to write them to the
+ *               disk. The file's currPos is left after the last byte written.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_StreamClose(FatStream *strm, const BPB *bpb)
+{
+  uint8_t err;
+
+  while ((err = fat_StreamService(strm, bpb)) == STEP_BUSY)
+    ;
+  if (err != SUCCESS)
+    return err;
+
+  if (strm->runOpen)
+  {
+    strm->runOpen = 0;
+    if (FATtoDisk_StopStream() != WRITE_SECTOR_SUCCESS)
+      return FAILED_WRITE_SECTOR;
+  }
+
+  // the bytes of a partly filled buffer keep the rest of their sector.
+  err = fat_WriteFile(strm->file, strm->bufArr[strm->fillIndx],
+                      strm->fillLen, bpb);
+  strm->fillLen = 0;
+  return err;
+}
+
+/*
+ ******************************************************************************
+ *                           "PRIVATE" FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                       (PRIVATE) FIND THE RUN
+ *
+ * Description : Finds the run of consecutive sectors of the file that starts
+ *               at the file's position, and sets the stream to send it.
+ *
+ * Arguments   : strm   - Pointer to a FatStream instance.
+ *               bpb    - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, FAILED_WRITE_SECTOR, or a FAT Error Flag from
+ *               fat_GetFileRun.
+ *
+ * Notes       : Sectors of the run waiting in the sector cache are written
+ *               first, and the run is then removed from the cache, because
+ *               the stream writes it around the cache.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_FindRun(FatStream *strm, const BPB *bpb)
+{
+  uint8_t  err;
+  uint32_t secNum;
+  uint32_t numOfSecs;
+
+  if ((err = fat_GetFileRun(strm->file, &secNum, &numOfSecs,
+                            STREAM_RUN_SECS_MAX, bpb)) != SUCCESS)
+    return err;
+
+  if ((err = fat_CacheSyncRange(secNum, numOfSecs)) != SUCCESS)
+    return err;
+  fat_CacheDiscardRange(secNum, numOfSecs);
+
+  strm->runSecNum = secNum;
+  strm->runSecsLeft = numOfSecs;
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                   (PRIVATE) START DISK WRITE
+ *
+ * Description : Starts a multiple sector write of the disk at the sector of
+ *               the file's position, for the run of consecutive sectors of
+ *               the file that starts there.
+ *
+ * Arguments   : strm   - Pointer to a FatStream instance.
+ *               bpb    - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, FAILED_WRITE_SECTOR, or a FAT Error Flag from
+ *               fat_GetFileRun.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_StartRun(FatStream *strm, const BPB *bpb)
+{
+  uint8_t err;
+
+  if ((err = pvt_FindRun(strm, bpb)) != SUCCESS)
+    return err;
+  if (FATtoDisk_StartStream(strm->runSecNum) != WRITE_SECTOR_SUCCESS)
+    return FAILED_WRITE_SECTOR;
+  strm->runOpen = 1;
+  return SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                 (PRIVATE) SERVICE WITH QUEUE
+ *
+ * Description : fat_StreamService while an I/O queue is attached. The full
+ *               buffer is sent as an IOQ_PRIO_RT request, and the queue is
+ *               then serviced once each call until it is written.
+ *
+ * Arguments   : strm   - Pointer to a FatStream instance.
+ *               bpb    - Pointer to the BPB struct instance.
+ *
+ * Returns     : As fat_StreamService.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_QueueService(FatStream *strm, const BPB *bpb)
+{
+  uint8_t err;
+
+  if (!strm->sendFull)
+    return SUCCESS;
+
+  // a failed request is sent again, to the same sector.
+  if (strm->req.status != STEP_BUSY)
+  {
+    if (!strm->runSecsLeft && (err = pvt_FindRun(strm, bpb)) != SUCCESS)
+      return err;
+
+    strm->req.secNum = strm->runSecNum;
+    strm->req.secArr = strm->bufArr[strm->fillIndx ^ 1];
+    strm->req.numOfSecs = 1;
+    strm->req.prio = IOQ_PRIO_RT;
+    strm->req.op = IOQ_WRITE;
+    if ((err = fat_IoqSend(&strm->req)) != SUCCESS)
+      return err;
+  }
+
+  if ((err = fat_IoqPoll(&strm->req)) == STEP_BUSY)
+    return STEP_BUSY;
+  if (err != SUCCESS)
+    return FAILED_WRITE_SECTOR;
+  return pvt_EndSend(strm);
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           (PRIVATE) END SEND
+ *
+ * Description : Moves the stream past the buffer that was just sent, and
+ *               marks the fill buffer to be sent if it has filled.
+ *
+ * Arguments   : strm   - Pointer to a FatStream instance.
+ *
+ * Returns     : STEP_BUSY if a full buffer is waiting, otherwise SUCCESS.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_EndSend(FatStream *strm)
+{
+  strm->sendFull = 0;
+  strm->file->currPos += SECTOR_LEN;
+  ++strm->runSecNum;
+  --strm->runSecsLeft;
+
+  // the fill buffer may have filled while the other was waiting.
+  if (strm->fillLen == SECTOR_LEN)
+    pvt_SwapBufs(strm);
+  return strm->sendFull ? STEP_BUSY : SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                       (PRIVATE) SWAP BUFFERS
+ *
+ * Description : Marks the full fill buffer as waiting to be sent, and makes
+ *               the other buffer the fill buffer.
+ *
+ * Arguments   : strm   - Pointer to a FatStream instance.
+ *
+ * Returns     : void
+ *
+ * Warnings    : Only call if the other buffer is not waiting to be sent.
+ * ----------------------------------------------------------------------------
+ */
+static void pvt_SwapBufs(FatStream *strm)
+{
+  strm->sendFull = 1;
+  strm->fillIndx ^= 1;
+  strm->fillLen = 0;
+}
@@ -0,0 +1,214 @@
+/*
+ * File       : FAT_SUM.C
+ * Version    : 2.0
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Implementation of FAT_SUM.H
+ */
+
+#include <stdint.h>
+#include "fat_bpb.h"
+#include "fat.h"
+#include "fat_sum.h"
+
+/*
+ ******************************************************************************
+ *                 "PRIVATE" FUNCTION PROTOTYPES (and MACROS)
+ ******************************************************************************
+ */
+
+// reflected CRC-32 polynomial
+#define CRC32_POLY              0xEDB88320
+
+// Adler-32 modulus, and the most bytes that can be summed before taking it.
+#define ADLER_MOD               65521
+#define ADLER_NMAX              5552
+
+// state of a checksum passed to pvt_SumSector.
+struct SumState
+{
+  uint8_t  algo;
+  uint16_t bytesPerSec;
+  uint32_t bytesLeft;                  // file bytes not yet summed
+  uint32_t crc;
+  uint32_t adlerA;
+  uint32_t adlerB;
+};
+
+static uint8_t pvt_SumSector(const uint8_t secArr[], void *arg);
+static uint32_t pvt_Crc32(uint32_t crc, const uint8_t byteArr[], uint16_t len);
+static void pvt_Adler32(struct SumState *st, const uint8_t byteArr[],
+                        uint16_t len);
+
+//
+// CRC-32 lookup table. On the AVR, the table of 16 entries is used, one
+// lookup per 4 bits, so the table takes 64 bytes of RAM instead of 1 KB.
+//
+#ifdef __AVR__
+static const uint32_t crcTbl[16] =
+{
+  0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+  0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+  0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+  0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+#else
+static uint32_t crcTbl[256];
+#endif//__AVR__
+
+/*
+ ******************************************************************************
+ *                                FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             CHECKSUM OF FILE
+ *
+ * Description : Calculates the checksum of every byte of a file.
+ *
+ * Arguments   : file    - Pointer to a FatFile instance set by fat_OpenFile.
+ *               algo    - Checksum algorithm. See CHECKSUM ALGORITHMS.
+ *               sum     - Pointer to the checksum, set here.
+ *               bpb     - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, SUM_INVALID_ALGO, or a FAT Error Flag.
+ *
+ * Notes       : 1) The file is read with fat_ReadFileSectors, so runs of
+ *                  consecutive clusters are read with a single multiple
+ *                  sector read from the disk.
+ *               2) On the AVR, CRC-32 uses a 16 entry table and takes two
+ *                  lookups per byte, to save RAM. Otherwise it uses a 256
+ *                  entry table and one lookup per byte.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_Checksum(const FatFile *file, uint8_t algo, uint32_t *sum,
+                     const BPB *bpb)
+{
+  uint8_t err;
+  struct SumState st = { algo, BPB_BYTES_PER_SEC(bpb), file->fileSize,
+                         0xFFFFFFFF, 1, 0 };
+
+  if (algo != FAT_SUM_CRC32 && algo != FAT_SUM_ADLER32)
+    return SUM_INVALID_ALGO;
+
+#ifndef __AVR__
+  // build the table on first use.
+  if (!crcTbl[1])
+  {
+    for (uint16_t i = 0; i < 256; ++i)
+    {
+      uint32_t crc = i;
+      for (uint8_t bit = 0; bit < 8; ++bit)
+        crc = (crc >> 1) ^ (crc & 1 ? CRC32_POLY : 0);
+      crcTbl[i] = crc;
+    }
+  }
+#endif//__AVR__
+
+  if ((err = fat_ReadFileSectors(file, pvt_SumSector, &st, bpb)) != SUCCESS)
+    return err;
+
+  if (algo == FAT_SUM_CRC32)
+    *sum = ~st.crc;
+  else
+    *sum = (st.adlerB << 16) | st.adlerA;
+  return SUCCESS;
+}
+
+/*
+ ******************************************************************************
+ *                           "PRIVATE" FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                    (PRIVATE) SUM FILE SECTOR
+ *
+ * Description : Adds the file bytes of a sector to a checksum. This is the
+ *               FatSectorFn passed to fat_ReadFileSectors by fat_Checksum.
+ *
+ * Arguments   : secArr   - Pointer to the array holding the sector.
+ *               arg      - Pointer to the SumState of the checksum.
+ *
+ * Returns     : 0, to read the rest of the file.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_SumSector(const uint8_t secArr[], void *arg)
+{
+  struct SumState *st = arg;
+  uint16_t len = st->bytesPerSec;
+
+  // only part of the last sector holds file bytes.
+  if (len > st->bytesLeft)
+    len = st->bytesLeft;
+  st->bytesLeft -= len;
+
+  if (st->algo == FAT_SUM_CRC32)
+    st->crc = pvt_Crc32(st->crc, secArr, len);
+  else
+    pvt_Adler32(st, secArr, len);
+  return 0;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                      (PRIVATE) UPDATE CRC-32
+ *
+ * Description : Adds bytes to a CRC-32.
+ *
+ * Arguments   : crc       - CRC of the bytes before these. Not inverted.
+ *               byteArr   - Pointer to the array of bytes.
+ *               len       - Number of bytes.
+ *
+ * Returns     : CRC including the bytes. Not inverted.
+ * ----------------------------------------------------------------------------
+ */
+static uint32_t pvt_Crc32(uint32_t crc, const uint8_t byteArr[], uint16_t len)
+{
+  while (len--)
+  {
+#ifdef __AVR__
+    crc ^= *byteArr++;
+    crc = (crc >> 4) ^ crcTbl[crc & 0x0F];
+    crc = (crc >> 4) ^ crcTbl[crc & 0x0F];
+#else
+    crc = (crc >> 8) ^ crcTbl[(crc ^ *byteArr++) & 0xFF];
+#endif//__AVR__
+  }
+  return crc;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                    (PRIVATE) UPDATE ADLER-32
+ *
+ * Description : Adds bytes to the sums of an Adler-32.
+ *
+ * Arguments   : st        - Pointer to the SumState holding the sums.
+ *               byteArr   - Pointer to the array of bytes.
+ *               len       - Number of bytes.
+ *
+ * Returns     : void
+ *
+ * Notes       : The modulus is only taken once, after every byte is added.
+ *               len must not be larger than ADLER_NMAX, the most bytes that
+ *               can be added before adlerB could overflow, so the sums are
+ *               updated once per sector.
+ * ----------------------------------------------------------------------------
+ */
+static void pvt_Adler32(struct SumState *st, const uint8_t byteArr[],
+                        uint16_t len)
+{
+  while (len--)
+  {
+    st->adlerA += *byteArr++;
+    st->adlerB += st->adlerA;
+  }
+  st->adlerA %= ADLER_MOD;
+  st->adlerB %= ADLER_MOD;
+}
@@ -9,9 +9,12 @@
  */
 
 #include <stdint.h>
+#include <string.h>
 #include "prints.h"
 #include "avr_spi.h"
+#include "avr_timer.h"
 #include "sd_spi_base.h"
+#include "sd_spi_info.h"
 #include "sd_spi_rwe.h"
 #include "fat_bpb.h"
 #include "fat.h"
@@ -22,14 +25,39 @@
  *                  "PRIVATE" FUNCTION PROTOTYPES and MACROS
  ******************************************************************************
  */
-static uint8_t pvt_GetCardType(void);
+static uint16_t pvt_GetAddrMult(uint32_t blkNum, uint32_t numOfBlks, 
+                                uint8_t isRead);
+static uint8_t  pvt_FindBadSlot(uint32_t blkNum);
+static void     pvt_FailSector(uint32_t blkNum, uint8_t isMediaErr);
+static void     pvt_PassSectors(uint32_t blkNum, uint32_t numOfBlks);
+static uint8_t  pvt_SaveBadList(void);
 
-// macros used in by pvt_GetCardType
-#define GET_CARD_TYPE_ERROR 0xFF
-#define CSD_STRUCT_MSK      0xC0
-#define CSD_VSN_1           0x00
-#define CSD_VSN_2           0x40
-#define CSD_BYTE_LEN        16
+// the SD card's info. Read from the card by pvt_GetAddrMult when first used.
+static SdInfo  sdInfo;
+static uint8_t sdInfoSet;
+
+// badListBlk of a bad sector list that is not saved.
+#define BAD_LIST_IN_RAM       0xFFFFFFFF
+
+// layout of the saved bad sector list. The sectors are 4 bytes, little endian.
+#define BAD_LIST_MAGIC        "BADSECS"
+#define BAD_LIST_MAGIC_LEN    7
+#define BAD_LIST_CNT_POS      7
+#define BAD_LIST_ARR_POS      8
+
+//
+// bad sector list, and the sector it is saved in, or BAD_LIST_IN_RAM. failArr
+// holds the number of operations on each sector that failed in a row. Once it
+// reaches DISK_BAD_FAILS the sector is bad, otherwise it is only suspect.
+//
+static uint32_t badArr[DISK_BAD_SECS_MAX];
+static uint8_t  failArr[DISK_BAD_SECS_MAX];
+static uint8_t  badCnt;
+static uint32_t badListBlk = BAD_LIST_IN_RAM;
+
+// first sector of the write stream, and the number sent so far.
+static uint32_t strmBlk;
+static uint32_t strmCnt;
 
 /*
  ******************************************************************************
@@ -61,10 +89,11 @@ uint32_t FATtoDisk_FindBootSector(void)
   // byte addressable, in which case the address of the block is the address
   // of the first byte in the block, thus the address would be found by
   // multiplying the number of the first byte in the block by BLOCK_LEN.
+  // Blocks past the end of the card, given by its CSD, are not used.
   // 
-  uint16_t addrMult = 1;                    // init for SDHC. Block addressable
-  if (pvt_GetCardType() == SDSC)            // SDSC is byte addressable
-    addrMult = BLOCK_LEN;
+  uint16_t addrMult = pvt_GetAddrMult(FBS_SEARCH_START_BLOCK, 1, 1);
+  if (!addrMult)
+    return FAILED_FIND_BOOT_SECTOR;
   
   // Send the READ MULTIPLE BLOCK command and confirm R1 Response is good.
   CS_SD_LOW;
@@ -139,6 +168,9 @@ uint32_t FATtoDisk_FindBootSector(void)
  * 
  * Returns     : READ_SECTOR_SUCCES if successful.
  *               READ_SECTOR_FAILED if failure.
+ *
+ * Notes       : A failed read is retried by the SD card driver. The sector is
+ *               then added to the bad sector list. See DISK_BAD_FAILS.
  * ----------------------------------------------------------------------------
  */
 uint8_t FATtoDisk_ReadSingleSector(uint32_t blkNum, uint8_t blkArr[])
@@ -149,17 +181,484 @@ uint8_t FATtoDisk_ReadSingleSector(uint32_t blkNum, uint8_t blkArr[])
   // is byte addressable, in which case the address of the block is the number
   // of the first byte in the block, thus the address would be found by
   // multiplying the number of the first byte in the block by BLOCK_LEN (=512).
+  // Blocks past the end of the card, given by its CSD, are not used.
   // 
-  uint16_t addrMult = 1;                    // init for SDHC. Block addressable
-  if (pvt_GetCardType() == SDSC)            // SDSC is block addressable
-    addrMult = BLOCK_LEN;
+  uint16_t addrMult = pvt_GetAddrMult(blkNum, 1, 1);
+  uint16_t err;
+
+  if (!addrMult)
+    return FAILED_READ_SECTOR;
 
+  //
   // Load data block into array by passing the array to the Read Block function
-  if (sd_ReadSingleBlock(blkNum * addrMult, blkArr) == READ_SUCCESS)
+  // It retries the block itself, resynchronizing the card before each retry.
+  //
+  err = sd_ReadSingleBlock(blkNum * addrMult, blkArr);
+  if (err == READ_SUCCESS)
+  {
+    pvt_PassSectors(blkNum, 1);
     return READ_SECTOR_SUCCESS; 
+  }
+  pvt_FailSector(blkNum, (err & 0xFF00) == DATA_ERROR_TKN_RECEIVED);
   return FAILED_READ_SECTOR;
 };
 
+/* 
+ * ----------------------------------------------------------------------------
+ *                                              READ MULTIPLE SECTORS FROM DISK
+ *                                       
+ * Description : Reads consecutive sectors/blocks from the disk, in order, and
+ *               passes each one to secFn as soon as it has been loaded.
+ *
+ * Arguments   : blkNum      - Block number address of the first sector/block
+ *                             to read.
+ *               numOfBlks   - Number of sectors/blocks to read.
+ *               blkArr      - Pointer to the array each sector/block is
+ *                             loaded into before it is passed to secFn. Must
+ *                             be the length of a sector.
+ *               secFn       - Function each sector/block is passed to. If it
+ *                             returns a non-zero value, no more are read.
+ *               arg         - Pointer passed to secFn with each sector/block.
+ * 
+ * Returns     : READ_SECTOR_SUCCESS if successful.
+ *               FAILED_READ_SECTOR if failure.
+ *
+ * Notes       : 1) This should use the disk's multiple block read, if it
+ *                  has one, so a run of sectors is read faster than by
+ *                  calling FATtoDisk_ReadSingleSector for each.
+ *               2) A failure is not retried, since some sectors may already
+ *                  have been passed to secFn. The read fails at once if any of
+ *                  the sectors is bad. See DISK_BAD_FAILS.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t FATtoDisk_ReadMultipleSectors(uint32_t blkNum, uint32_t numOfBlks,
+                                     uint8_t blkArr[], FatSectorFn secFn,
+                                     void *arg)
+{
+  // SDSC is byte addressable. See FATtoDisk_ReadSingleSector.
+  uint16_t addrMult = pvt_GetAddrMult(blkNum, numOfBlks, 1);
+  if (!addrMult)
+    return FAILED_READ_SECTOR;
+
+  // the blocks are passed straight from the SD card's multiple block read.
+  if ((sd_ReadMultipleBlocks(blkNum * addrMult, numOfBlks, blkArr, secFn, arg)
+       & 0xFF00) == READ_SUCCESS)
+  {
+    pvt_PassSectors(blkNum, numOfBlks);
+    return READ_SECTOR_SUCCESS;
+  }
+  sd_Resync();
+  return FAILED_READ_SECTOR;
+}
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                  WRITE SINGLE SECTOR TO DISK
+ *                                       
+ * Description : Writes the contents of the array, blkArr, to the sector/block
+ *               at the specified address on the SD card.
+ *
+ * Arguments   : blkNum    - Block number address of the sector/block on the SD
+ *                           card that blkArr should be written to.
+ * 
+ *               blkArr    - Pointer to the array holding the data that will
+ *                           be written to the sector/block on the SD card at
+ *                           block specified by blkNum.
+ * 
+ * Returns     : WRITE_SECTOR_SUCCESS if successful.
+ *               FAILED_WRITE_SECTOR if failure.
+ *
+ * Notes       : A failed write is retried by the SD card driver. The sector
+ *               is then added to the bad sector list, and a write that
+ *               succeeds removes it. See DISK_BAD_FAILS.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t FATtoDisk_WriteSingleSector(uint32_t blkNum, const uint8_t blkArr[])
+{
+  // SDSC is byte addressable. See FATtoDisk_ReadSingleSector.
+  uint16_t addrMult = pvt_GetAddrMult(blkNum, 1, 0);
+  uint16_t err;
+
+  if (!addrMult)
+    return FAILED_WRITE_SECTOR;
+
+  // Write the array to the data block by passing it to the Write Block func.
+  err = sd_WriteSingleBlock(blkNum * addrMult, blkArr) & 0xFF00;
+  if (err == DATA_WRITE_SUCCESS)
+  {
+    pvt_PassSectors(blkNum, 1);
+    return WRITE_SECTOR_SUCCESS; 
+  }
+  pvt_FailSector(blkNum, err == WRITE_ERROR_TKN_RECEIVED);
+  return FAILED_WRITE_SECTOR;
+}
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                               WRITE MULTIPLE SECTORS TO DISK
+ *                                       
+ * Description : Writes consecutive sectors/blocks to the disk, in order. The
+ *               data of each one is taken from secSrcFn just before it is
+ *               written.
+ *
+ * Arguments   : blkNum      - Block number address of the first sector/block
+ *                             to write.
+ *               numOfBlks   - Number of sectors/blocks to write.
+ *               secSrcFn    - Function that returns the data of each
+ *                             sector/block.
+ *               arg         - Pointer passed to secSrcFn with each
+ *                             sector/block.
+ * 
+ * Returns     : WRITE_SECTOR_SUCCESS if successful.
+ *               FAILED_WRITE_SECTOR if failure.
+ *
+ * Notes       : 1) This should use the disk's multiple block write, if it
+ *                  has one, so a run of sectors is written faster than by
+ *                  calling FATtoDisk_WriteSingleSector for each.
+ *               2) A failure is not retried, since some sectors may already
+ *                  have been written. A write that succeeds removes its
+ *                  sectors from the bad sector list.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t FATtoDisk_WriteMultipleSectors(uint32_t blkNum, uint32_t numOfBlks,
+                                      FatSectorSrcFn secSrcFn, void *arg)
+{
+  // SDSC is byte addressable. See FATtoDisk_ReadSingleSector.
+  uint16_t addrMult = pvt_GetAddrMult(blkNum, numOfBlks, 0);
+  if (!addrMult)
+    return FAILED_WRITE_SECTOR;
+
+  // the data of each block is taken from secSrcFn as it is sent to the card.
+  if ((sd_WriteMultipleBlocks(blkNum * addrMult, numOfBlks, secSrcFn, arg)
+       & 0xFF00) == DATA_WRITE_SUCCESS)
+  {
+    pvt_PassSectors(blkNum, numOfBlks);
+    return WRITE_SECTOR_SUCCESS;
+  }
+  sd_Resync();
+  return FAILED_WRITE_SECTOR;
+}
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                        GET MILLISECOND CLOCK
+ *                                       
+ * Description : Returns a clock that counts milliseconds. Used by the sector
+ *               cache in FAT_CACHE.C(H) to flush written sectors by age.
+ *
+ * Arguments   : void
+ * 
+ * Returns     : Milliseconds since any fixed point in time. The value may
+ *               wrap, as only differences of it are used.
+ * ----------------------------------------------------------------------------
+ */
+uint32_t FATtoDisk_GetTimeMs(void)
+{
+  // the clock kept by TIMER0. timer_Init must be called by the application.
+  return timer_GetMs();
+}
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                      START DISK WRITE STREAM
+ *                                       
+ * Description : Starts a write stream of consecutive sectors/blocks, starting
+ *               at blkNum. The sectors are then written, one at a time, by
+ *               FATtoDisk_StreamSector, and the stream is ended by
+ *               FATtoDisk_StopStream.
+ *
+ * Arguments   : blkNum      - Block number address of the first sector/block
+ *                             of the stream.
+ * 
+ * Returns     : WRITE_SECTOR_SUCCESS if successful.
+ *               FAILED_WRITE_SECTOR if failure.
+ *
+ * Warnings    : No other FATtoDisk function may be called while a stream is
+ *               started, except FATtoDisk_IsBusy and FATtoDisk_GetTimeMs.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t FATtoDisk_StartStream(uint32_t blkNum)
+{
+  // SDSC is byte addressable. See FATtoDisk_ReadSingleSector.
+  uint16_t addrMult = pvt_GetAddrMult(blkNum, 1, 0);
+  if (!addrMult)
+    return FAILED_WRITE_SECTOR;
+
+  if ((sd_StartStream(blkNum * addrMult) & 0xFF00) == DATA_WRITE_SUCCESS)
+  {
+    strmBlk = blkNum;
+    strmCnt = 0;
+    return WRITE_SECTOR_SUCCESS;
+  }
+  return FAILED_WRITE_SECTOR;
+}
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                  WRITE SECTOR TO DISK STREAM
+ *                                       
+ * Description : Sends the next sector/block of a stream started by
+ *               FATtoDisk_StartStream. This should return once the disk has
+ *               the data, without waiting while it is written.
+ *
+ * Arguments   : blkArr      - Pointer to the array holding the
+ *                             sector/block. Must be of length SECTOR_LEN.
+ * 
+ * Returns     : WRITE_SECTOR_SUCCESS if successful.
+ *               FAILED_WRITE_SECTOR if failure.
+ *
+ * Notes       : If the disk is still busy writing the previous sector/block,
+ *               this will wait for it first.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t FATtoDisk_StreamSector(const uint8_t blkArr[])
+{
+  if (sd_SendStreamBlock(blkArr) == DATA_WRITE_SUCCESS)
+  {
+    ++strmCnt;
+    return WRITE_SECTOR_SUCCESS;
+  }
+  return FAILED_WRITE_SECTOR;
+}
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                                 IS DISK BUSY
+ *                                       
+ * Description : Checks, without waiting, if the disk is busy writing a
+ *               sector/block sent by FATtoDisk_StreamSector.
+ *
+ * Arguments   : void
+ * 
+ * Returns     : 1 if the disk is busy, 0 if it is not.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t FATtoDisk_IsBusy(void)
+{
+  return sd_IsCardBusy();
+}
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                       STOP DISK WRITE STREAM
+ *                                       
+ * Description : Ends a stream started by FATtoDisk_StartStream, once the
+ *               last sector/block sent has been written.
+ *
+ * Arguments   : void
+ * 
+ * Returns     : WRITE_SECTOR_SUCCESS if successful.
+ *               FAILED_WRITE_SECTOR if failure.
+ *
+ * Notes       : The sectors of a stream that is stopped successfully are
+ *               removed from the bad sector list.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t FATtoDisk_StopStream(void)
+{
+  // the list may only be saved once the stream is stopped.
+  if (sd_StopStream() == DATA_WRITE_SUCCESS)
+  {
+    pvt_PassSectors(strmBlk, strmCnt);
+    return WRITE_SECTOR_SUCCESS;
+  }
+  return FAILED_WRITE_SECTOR;
+}
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                       START DISK READ STREAM
+ *                                       
+ * Description : Starts a read stream of numOfBlks consecutive sectors/blocks,
+ *               starting at blkNum. The sectors are then read, one at a time,
+ *               by FATtoDisk_ReadStreamSector, and the stream is ended by
+ *               FATtoDisk_StopReadStream.
+ *
+ * Arguments   : blkNum      - Block number address of the first sector/block
+ *                             of the stream.
+ *               numOfBlks   - Most sectors/blocks that will be read.
+ * 
+ * Returns     : READ_SECTOR_SUCCESS if successful.
+ *               FAILED_READ_SECTOR if failure.
+ *
+ * Warnings    : No other FATtoDisk function may be called while a stream is
+ *               started, except FATtoDisk_IsReadReady and FATtoDisk_GetTimeMs.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t FATtoDisk_StartReadStream(uint32_t blkNum, uint32_t numOfBlks)
+{
+  // SDSC is byte addressable. See FATtoDisk_ReadSingleSector.
+  uint16_t addrMult = pvt_GetAddrMult(blkNum, numOfBlks, 1);
+  if (!addrMult)
+    return FAILED_READ_SECTOR;
+
+  if ((sd_StartReadStream(blkNum * addrMult) & 0xFF00) == READ_SUCCESS)
+    return READ_SECTOR_SUCCESS;
+  return FAILED_READ_SECTOR;
+}
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                           IS DISK READ READY
+ *                                       
+ * Description : Checks, without waiting, if the next sector/block of a stream
+ *               started by FATtoDisk_StartReadStream can be read.
+ *
+ * Arguments   : void
+ * 
+ * Returns     : 1 if FATtoDisk_ReadStreamSector will not wait for the disk,
+ *               0 if it would.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t FATtoDisk_IsReadReady(void)
+{
+  return sd_IsBlockReady();
+}
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                 READ SECTOR FROM DISK STREAM
+ *                                       
+ * Description : Reads the next sector/block of a stream started by
+ *               FATtoDisk_StartReadStream.
+ *
+ * Arguments   : blkArr      - Pointer to the array the sector/block is
+ *                             loaded into. Must be of length SECTOR_LEN.
+ * 
+ * Returns     : READ_SECTOR_SUCCESS if successful.
+ *               FAILED_READ_SECTOR if failure.
+ *
+ * Notes       : If the disk is not ready, this will wait for it first.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t FATtoDisk_ReadStreamSector(uint8_t blkArr[])
+{
+  if (sd_ReceiveStreamBlock(blkArr) == READ_SUCCESS)
+    return READ_SECTOR_SUCCESS;
+  return FAILED_READ_SECTOR;
+}
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                        STOP DISK READ STREAM
+ *                                       
+ * Description : Ends a stream started by FATtoDisk_StartReadStream, whether
+ *               or not all of its sectors/blocks have been read.
+ *
+ * Arguments   : void
+ * 
+ * Returns     : READ_SECTOR_SUCCESS if successful.
+ *               FAILED_READ_SECTOR if failure.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t FATtoDisk_StopReadStream(void)
+{
+  if (sd_StopReadStream() == READ_SUCCESS)
+    return READ_SECTOR_SUCCESS;
+  return FAILED_READ_SECTOR;
+}
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                         OPEN BAD SECTOR LIST
+ *                                       
+ * Description : Sets the sector the bad sector list is kept in, and loads the
+ *               list saved there. From then on, the list is saved each time
+ *               a bad sector is added to it or removed from it.
+ *
+ * Arguments   : blkNum   - Block number address of a sector in a reserved
+ *                          area of the disk, e.g. the reserved region of the
+ *                          FAT volume.
+ * 
+ * Returns     : READ_SECTOR_SUCCESS, FAILED_READ_SECTOR, or 
+ *               FAILED_WRITE_SECTOR if a new list could not be saved.
+ *
+ * Notes       : 1) Until this is called the list is only kept in RAM.
+ *               2) Sectors added to the list before this is called are kept,
+ *                  and added to the saved list.
+ *               3) Only bad sectors are saved. Suspect ones, that have not
+ *                  failed DISK_BAD_FAILS times, are kept in RAM.
+ *
+ * Warnings    : If the sector does not hold a saved list, it is overwritten
+ *               with a new one, so it must not be used for anything else.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t FATtoDisk_OpenBadList(uint32_t blkNum)
+{
+  uint8_t  blkArr[BLOCK_LEN];
+  uint8_t  savedCnt = 0;
+  uint16_t addrMult = pvt_GetAddrMult(blkNum, 1, 0);
+
+  if (!addrMult || sd_ReadSingleBlock(blkNum * addrMult, blkArr) 
+                   != READ_SUCCESS)
+    return FAILED_READ_SECTOR;
+  badListBlk = blkNum;
+
+  // the saved sectors are added to the ones already in the list.
+  if (!memcmp(blkArr, BAD_LIST_MAGIC, BAD_LIST_MAGIC_LEN)
+      && blkArr[BAD_LIST_CNT_POS] <= DISK_BAD_SECS_MAX)
+  {
+    savedCnt = blkArr[BAD_LIST_CNT_POS];
+    for (uint8_t indx = 0; indx < savedCnt; ++indx)
+    {
+      const uint8_t *ent = &blkArr[BAD_LIST_ARR_POS + 4 * indx];
+      uint32_t badBlk = (uint32_t)ent[3] << 24 | (uint32_t)ent[2] << 16
+                        | (uint16_t)ent[1] << 8 | ent[0];
+      uint8_t  badIndx = pvt_FindBadSlot(badBlk);
+
+      if (badIndx < DISK_BAD_SECS_MAX)
+        failArr[badIndx] = DISK_BAD_FAILS;
+    }
+
+    // nothing to save if the list is the one on the disk.
+    if (FATtoDisk_GetBadCount() == savedCnt)
+      return READ_SECTOR_SUCCESS;
+  }
+  return pvt_SaveBadList();
+}
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                        CLEAR BAD SECTOR LIST
+ *                                       
+ * Description : Removes every sector from the bad sector list, e.g. after
+ *               the disk is replaced or reformatted.
+ *
+ * Arguments   : void
+ * 
+ * Returns     : WRITE_SECTOR_SUCCESS, or FAILED_WRITE_SECTOR if the list is
+ *               saved on the disk and could not be written.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t FATtoDisk_ClearBadList(void)
+{
+  badCnt = 0;
+  if (badListBlk == BAD_LIST_IN_RAM)
+    return WRITE_SECTOR_SUCCESS;
+  return pvt_SaveBadList();
+}
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                    GET BAD SECTOR LIST COUNT
+ *                                       
+ * Description : Returns the number of bad sectors in the bad sector list.
+ *
+ * Arguments   : void
+ * 
+ * Returns     : Number of bad sectors, up to DISK_BAD_SECS_MAX. Suspect
+ *               sectors are not counted.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t FATtoDisk_GetBadCount(void)
+{
+  uint8_t cnt = 0;
+
+  for (uint8_t indx = 0; indx < badCnt; ++indx)
+    cnt += (failArr[indx] >= DISK_BAD_FAILS);
+  return cnt;
+}
+
 /*
  ******************************************************************************
  *                            "PRIVATE" FUNCTION        
@@ -168,57 +667,188 @@ uint8_t FATtoDisk_ReadSingleSector(uint32_t blkNum, uint8_t blkArr[])
 
 /* 
  * ----------------------------------------------------------------------------
- *                                                             GET SD CARD TYPE
+ *                                                       GET SD CARD ADDRESSING
  *                                       
- * Description : Determines and returns the SD card type. The card type is used
- *               determine if the SD card is block or byte addressable.
+ * Description : Returns the number a block number is multiplied by to get
+ *               the address of the block on the SD card, and checks a range
+ *               of blocks can be used.
  * 
- * Arguments   : void
+ * Arguments   : blkNum      - Block number of the first block of the range.
+ *               numOfBlks   - Number of blocks in the range.
+ *               isRead      - 1 if the range is to be read, 0 if written.
  * 
- * Returns     : SD card type - SDSC or SDHC, or GET_CARD_TYPE_ERROR.
+ * Returns     : 1 if the SD card is block addressable (SDHC or later), or
+ *               BLOCK_LEN if it is byte addressable (SDSC). 0 if the card's
+ *               info could not be read, the range is not on the card, or it
+ *               is to be read and a block of it is bad.
+ *
+ * Notes       : The card's registers are only read the first time this is
+ *               called, so the card must not be changed while in use.
  * ----------------------------------------------------------------------------
  */
+static uint16_t pvt_GetAddrMult(uint32_t blkNum, uint32_t numOfBlks, 
+                                uint8_t isRead)
+{
+  if (!sdInfoSet)
+  {
+    if (sd_GetInfo(&sdInfo) != READ_SUCCESS)
+      return 0;
+    sdInfoSet = 1;
+  }
+
+  if (blkNum >= sdInfo.numOfBlks || numOfBlks > sdInfo.numOfBlks - blkNum)
+    return 0;
+
+  //
+  // reads of sectors known to be bad fail at once, rather than after every
+  // retry. Writes are always tried, as one that succeeds repairs the sector.
+  //
+  for (uint8_t indx = 0; isRead && indx < badCnt; ++indx)
+    if (failArr[indx] >= DISK_BAD_FAILS && badArr[indx] - blkNum < numOfBlks)
+      return 0;
+  return (sdInfo.csdVsn == CSD_VSN_1) ? BLOCK_LEN : 1;
+}
 
-static uint8_t pvt_GetCardType(void)
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                         FIND BAD SECTOR SLOT
+ *                                       
+ * Description : Returns the index of a sector in the bad sector list, adding
+ *               it as a suspect sector with no failures if it is not in it.
+ * 
+ * Arguments   : blkNum   - Block number of the sector.
+ * 
+ * Returns     : Index of the sector in badArr, or DISK_BAD_SECS_MAX if it is
+ *               not in the list and could not be added.
+ *
+ * Notes       : If the list is full, the sector takes the place of a suspect
+ *               one. It is not added if every sector in the list is bad.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_FindBadSlot(uint32_t blkNum)
 {
-  uint8_t cardType;
+  uint8_t indx;
 
-  CS_SD_LOW;
-  sd_SendCommand(SEND_CSD, 0);
-  if (sd_GetR1() != OUT_OF_IDLE) 
-  { 
-    CS_SD_HIGH; 
-    return GET_CARD_TYPE_ERROR;             // R1 error. Failed to get the CSD
+  for (indx = 0; indx < badCnt; ++indx)
+    if (badArr[indx] == blkNum)
+      return indx;
+
+  if (badCnt < DISK_BAD_SECS_MAX)
+    ++badCnt;
+  else
+    for (indx = 0; indx < badCnt && failArr[indx] >= DISK_BAD_FAILS; ++indx)
+      ;
+  if (indx < DISK_BAD_SECS_MAX)
+  {
+    badArr[indx] = blkNum;
+    failArr[indx] = 0;
   }
+  return indx;
+}
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                           RECORD SECTOR FAIL
+ *                                       
+ * Description : Records a failed operation on a sector. After DISK_BAD_FAILS
+ *               of them in a row, or one that failed with a media error, the
+ *               sector is bad, and the list is saved if it is kept on the card.
+ * 
+ * Arguments   : blkNum       - Block number of the sector.
+ *               isMediaErr   - 1 if the card reported the sector could not be
+ *                              read or written, 0 for any other failure.
+ * 
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+static void pvt_FailSector(uint32_t blkNum, uint8_t isMediaErr)
+{
+  uint8_t indx;
 
-  // Get CSD version to determine if card is SDHC or SDSC
-  for (uint16_t timeout = 0; ; ++timeout)
+  if (blkNum == badListBlk)
+    return;
+  indx = pvt_FindBadSlot(blkNum);
+  if (indx == DISK_BAD_SECS_MAX || failArr[indx] >= DISK_BAD_FAILS)
+    return;
+
+  failArr[indx] = isMediaErr ? DISK_BAD_FAILS : failArr[indx] + 1;
+  if (failArr[indx] >= DISK_BAD_FAILS && badListBlk != BAD_LIST_IN_RAM)
+    pvt_SaveBadList();
+}
+
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                          RECORD SECTORS PASS
+ *                                       
+ * Description : Removes a range of sectors that were read or written
+ *               successfully from the bad sector list, and saves the list if
+ *               a bad one was removed and it is kept on the card.
+ * 
+ * Arguments   : blkNum      - Block number of the first sector of the range.
+ *               numOfBlks   - Number of sectors in the range.
+ * 
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+static void pvt_PassSectors(uint32_t blkNum, uint32_t numOfBlks)
+{
+  uint8_t wasBad = 0;
+
+  for (uint8_t indx = 0; indx < badCnt; )
   {
-    if (timeout >= TIMEOUT_LIMIT)           // if timeout is reached
-    { 
-      // Read in rest of CSD bytes, though not used.
-      for(int byteNum = 0; byteNum < CSD_BYTE_LEN - 1; ++byteNum) 
-        sd_ReceiveByteSPI();
-      CS_SD_HIGH;
-      return GET_CARD_TYPE_ERROR;           // timeout fail                             
+    if (badArr[indx] - blkNum < numOfBlks)
+    {
+      wasBad |= (failArr[indx] >= DISK_BAD_FAILS);
+      --badCnt;
+      badArr[indx] = badArr[badCnt];
+      failArr[indx] = failArr[badCnt];
     }
+    else
+      ++indx;
+  }
+  if (wasBad && badListBlk != BAD_LIST_IN_RAM)
+    pvt_SaveBadList();
+}
 
-    uint8_t resp = sd_ReceiveByteSPI();
-    if ((resp & CSD_STRUCT_MSK) == CSD_VSN_1)
-    { 
-      cardType = SDSC; 
-      break;
-    }
-    else if ((resp & CSD_STRUCT_MSK) == CSD_VSN_2) 
-    { 
-      cardType = SDHC; 
-      break; 
-    } 
+/* 
+ * ----------------------------------------------------------------------------
+ *                                                         SAVE BAD SECTOR LIST
+ *                                       
+ * Description : Writes the bad sectors of the bad sector list to the sector
+ *               set by FATtoDisk_OpenBadList.
+ * 
+ * Arguments   : void
+ * 
+ * Returns     : WRITE_SECTOR_SUCCESS or FAILED_WRITE_SECTOR.
+ *
+ * Notes       : The sector is written around the bad sector list, so a
+ *               failure here is not added to the list.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_SaveBadList(void)
+{
+  uint8_t blkArr[BLOCK_LEN];
+  uint8_t cnt = 0;
+  uint16_t addrMult = (sdInfo.csdVsn == CSD_VSN_1) ? BLOCK_LEN : 1;
+
+  memset(blkArr, 0, BLOCK_LEN);
+  memcpy(blkArr, BAD_LIST_MAGIC, BAD_LIST_MAGIC_LEN);
+  for (uint8_t indx = 0; indx < badCnt; ++indx)
+  {
+    uint8_t *ent = &blkArr[BAD_LIST_ARR_POS + 4 * cnt];
+
+    if (failArr[indx] < DISK_BAD_FAILS)
+      continue;
+    ++cnt;
+    ent[0] = badArr[indx];
+    ent[1] = badArr[indx] >> 8;
+    ent[2] = badArr[indx] >> 16;
+    ent[3] = badArr[indx] >> 24;
   }
+  blkArr[BAD_LIST_CNT_POS] = cnt;
 
-  // Read in rest of CSD, though not used.
-  for(int byteNum = 0; byteNum < CSD_BYTE_LEN - 1; ++byteNum) 
-    sd_ReceiveByteSPI();
-  CS_SD_HIGH;
-  return cardType;                          // success
+  if ((sd_WriteSingleBlock(badListBlk * addrMult, blkArr) & 0xFF00)
+      == DATA_WRITE_SUCCESS)
+    return WRITE_SECTOR_SUCCESS;
+  return FAILED_WRITE_SECTOR;
 }
@@ -0,0 +1,151 @@
+/*
+ * File       : FAT_WARM.C
+ * Version    : 2.0
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Implementation of FAT_WARM.H
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "fat_bpb.h"
+#include "fat.h"
+#include "fat_to_disk_if.h"
+#include "fat_cache.h"
+#include "fat_warm.h"
+
+/*
+ ******************************************************************************
+ *                 "PRIVATE" FUNCTION PROTOTYPES (and MACROS)
+ ******************************************************************************
+ */
+
+static uint8_t pvt_WarmDir(uint32_t fstClusIndx, uint32_t startMs,
+                           uint32_t budgetMs, const BPB *bpb);
+
+/*
+ ******************************************************************************
+ *                                FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            PREWARM THE CACHE
+ *
+ * Description : Reads the first sectors of the root directory, then of each
+ *               hot directory in turn, into the sector cache, until they are
+ *               all read or the time budget is used up.
+ *
+ * Arguments   : hotDirs    - Array of paths of the hot directories, from the
+ *                            root directory, e.g. "config/net". NULL if there
+ *                            are none.
+ *               dirCnt     - Number of paths in hotDirs.
+ *               budgetMs   - Most time, in milliseconds, to spend reading.
+ *               bpb        - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, WARM_OUT_OF_TIME if the budget was used up before
+ *               every directory was read, FAILED_READ_SECTOR, or
+ *               FAILED_WRITE_SECTOR if a written sector could not be flushed
+ *               to make room.
+ *
+ * Notes       : 1) Call this once fat_SetBPB has returned BPB_VALID.
+ *               2) The budget is checked before each multiple sector read, so
+ *                  a read started within it may finish after it.
+ *               3) The directories along each path are looked up as by
+ *                  fat_SetDir, so their sectors are also read. A path that
+ *                  does not name a directory is skipped.
+ *               4) The cache keeps the sectors read last, by least recent
+ *                  use, so the directories most likely to be used first
+ *                  should be last in hotDirs.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t fat_Prewarm(const char *const hotDirs[], uint8_t dirCnt,
+                    uint32_t budgetMs, const BPB *bpb)
+{
+  uint8_t  err;
+  uint32_t startMs = FATtoDisk_GetTimeMs();
+
+  if ((err = pvt_WarmDir(bpb->rootClus, startMs, budgetMs, bpb)) != SUCCESS)
+    return err;
+
+  for (uint8_t i = 0; i < dirCnt; ++i)
+  {
+    FatDir dir;
+
+    if (FATtoDisk_GetTimeMs() - startMs >= budgetMs)
+      return WARM_OUT_OF_TIME;
+
+    err = fat_SetDirToPath(&dir, hotDirs[i], bpb);
+    if (err == INVALID_NAME || err == END_OF_DIRECTORY)
+      continue;
+    if (err == SUCCESS)
+      err = pvt_WarmDir(dir.fstClusIndx, startMs, budgetMs, bpb);
+    if (err != SUCCESS)
+      return err;
+  }
+  return SUCCESS;
+}
+
+/*
+ ******************************************************************************
+ *                           "PRIVATE" FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                     (PRIVATE) WARM DIRECTORY
+ *
+ * Description : Reads the FAT sector of a directory's first cluster, and then
+ *               up to FAT_WARM_DIR_SECS of the directory's sectors, into the
+ *               cache. Each run of consecutive sectors is read with a single
+ *               multiple sector read.
+ *
+ * Arguments   : fstClusIndx   - Index of the directory's first cluster.
+ *               startMs       - Time the prewarm started.
+ *               budgetMs      - Most time the prewarm can take.
+ *               bpb           - Pointer to the BPB struct instance.
+ *
+ * Returns     : SUCCESS, WARM_OUT_OF_TIME, FAILED_READ_SECTOR or
+ *               FAILED_WRITE_SECTOR.
+ *
+ * Notes       : The directory is walked as a file, so the FAT sectors of the
+ *               rest of its cluster chain are read through the cache as the
+ *               runs are found. A directory shorter than FAT_WARM_DIR_SECS
+ *               ends at the end of its cluster chain.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_WarmDir(uint32_t fstClusIndx, uint32_t startMs,
+                           uint32_t budgetMs, const BPB *bpb)
+{
+  uint8_t  err;
+  uint32_t secNum;
+  uint32_t numOfSecs;
+  FatFile  dirFile;
+
+  if (FATtoDisk_GetTimeMs() - startMs >= budgetMs)
+    return WARM_OUT_OF_TIME;
+  err = fat_CacheLoad(BPB_FAT_SEC(bpb, fstClusIndx), 1, CACHE_FAT);
+  if (err != SUCCESS)
+    return err;
+
+  // only the directory's cluster chain is used, so it has no entry.
+  memset(&dirFile, 0, sizeof(dirFile));
+  dirFile.fstClusIndx = fstClusIndx;
+  dirFile.currClusIndx = fstClusIndx;
+  dirFile.fileSize = (uint32_t)FAT_WARM_DIR_SECS * BPB_BYTES_PER_SEC(bpb);
+
+  while (fat_GetFileRun(&dirFile, &secNum, &numOfSecs, FAT_WARM_DIR_SECS, bpb)
+         == SUCCESS)
+  {
+    if (FATtoDisk_GetTimeMs() - startMs >= budgetMs)
+      return WARM_OUT_OF_TIME;
+    if ((err = fat_CacheLoad(secNum, numOfSecs, CACHE_DIR)) != SUCCESS)
+      return err;
+    dirFile.currPos += numOfSecs * BPB_BYTES_PER_SEC(bpb);
+  }
+  return SUCCESS;
+}
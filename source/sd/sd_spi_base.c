@@ -11,6 +11,7 @@
 
 #include <stdint.h>
 #include "avr_spi.h"
+#include "avr_timer.h"
 #include "prints.h"
 #include "sd_spi_base.h"
 
@@ -122,10 +123,10 @@ uint32_t sd_InitModeSPI(CTV *ctv)
   // Since SD_SEND_OP_COND is an ACMD type, the APP_CMD, must first be sent to
   // signal to the SD card that the next command is type ACMD. This process of
   // send APP_CMD then SD_SEND_OP_COND repeats until the R1 response to 
-  // SD_SEND_OP_COND signals the card is no longer in the idle state or timeout
-  // limit has been reached.
+  // SD_SEND_OP_COND signals the card is no longer in the idle state or
+  // SD_INIT_TIMEOUT_MS has passed.
   //
-  uint8_t  timeout = 0;
+  uint32_t startMs = timer_GetMs();
   do
   {
     CS_SD_LOW;
@@ -140,7 +141,7 @@ uint32_t sd_InitModeSPI(CTV *ctv)
     CS_SD_HIGH;
     if (r1 > IN_IDLE_STATE)
       return (FAILED_SD_SEND_OP_COND | r1);
-    if (++timeout >= TIMEOUT_LIMIT && r1 != OUT_OF_IDLE)
+    if (timer_GetMs() - startMs > SD_INIT_TIMEOUT_MS && r1 != OUT_OF_IDLE)
       return (FAILED_SD_SEND_OP_COND | OUT_OF_IDLE_TIMEOUT | r1);
   }
   while (r1 & IN_IDLE_STATE);
@@ -278,16 +279,17 @@ void sd_SendCommand(uint8_t cmd, uint32_t arg)
  * Notes       : 1) always call immediately after sd_SendCommand().
  *               2) pass the return value to sd_PrintR1() to print R1 response.
  *               3) if R1_TIMEOUT is returned, then the SD Card did not return
- *                  a response.
+ *                  a response within SD_CMD_TIMEOUT_MS.
  * ----------------------------------------------------------------------------
  */
 uint8_t sd_GetR1(void)
 {
-  uint8_t r1;
+  uint8_t  r1;
+  uint32_t startMs = timer_GetMs();
   
   // loop until SPDR has new values (i.e != dummy token or TO limit reached.
-  for (uint8_t timeout = 0; (r1 = sd_ReceiveByteSPI()) == DMY_TKN; ++timeout)
-    if(timeout >= TIMEOUT_LIMIT) 
+  while ((r1 = sd_ReceiveByteSPI()) == DMY_TKN)
+    if (timer_GetMs() - startMs > SD_CMD_TIMEOUT_MS) 
       return R1_TIMEOUT;
   return r1;
 }
@@ -0,0 +1,426 @@
+/*
+ * File       : SD_SPI_INFO.C
+ * Version    : 1.0
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Implementation of SD_SPI_INFO.H
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "avr_spi.h"
+#include "avr_timer.h"
+#include "prints.h"
+#include "sd_spi_base.h"
+#include "sd_spi_info.h"
+#include "sd_spi_rwe.h"
+
+/*
+ ******************************************************************************
+ *                 "PRIVATE" FUNCTION PROTOTYPES (and MACROS)
+ ******************************************************************************
+ */
+
+// SDSC (version 1.0 CSD) block lengths are a power of 2, and BLOCK_LEN is 2^9.
+#define BLOCK_LEN_SHIFT       9
+
+// SDHC and later card capacity is (C_SIZE + 1) x 512 KB.
+#define C_SIZE_UNIT_SHIFT     10
+
+// erase sector size of SDHC and later cards, i.e. 64 KB.
+#define SDHC_ERASE_BLKS       128
+
+// SCR spec versions, as SD spec version x 10, of the SD_SPEC field.
+#define SPEC_VSN_1_0          10
+#define SPEC_VSN_1_1          11
+#define SPEC_VSN_2_0          20
+#define SPEC_VSN_3_0          30
+#define SPEC_VSN_4_0          40
+
+// DAT_BUS_WIDTH of the SD Status for a 4 bit bus.
+#define SD_STS_BUS_4_BIT      2
+
+static void pvt_PrintStrField(const char *label, const char *str);
+static void pvt_PrintDecField(const char *label, uint32_t num);
+
+/*
+ ******************************************************************************
+ *                                 FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             GET SD CARD INFO
+ *
+ * Description : Reads the CSD, CID and SCR registers of the card and decodes
+ *               them into an SdInfo instance.
+ *
+ * Arguments   : info   - pointer to the SdInfo instance that will be set.
+ *
+ * Returns     : Read Block Error (upper byte) and R1 Response (lower byte) of
+ *               the first register that could not be read, or READ_SUCCESS.
+ *               A card that rejects the SCR command is not an error.
+ *
+ * Notes       : This should be called once the card is initialized by
+ *               sd_InitModeSPI. Its result can then be passed to
+ *               sd_SetMaxClock and sd_SetTimeouts.
+ * ----------------------------------------------------------------------------
+ */
+uint16_t sd_GetInfo(SdInfo *info)
+{
+  uint8_t  regArr[CSD_LEN];                 // CSD_LEN is the longest
+  uint16_t err;
+
+  memset(info, 0, sizeof *info);
+
+  err = sd_ReadCSD(regArr);
+  if (err != READ_SUCCESS)
+    return err;
+  sd_DecodeCSD(info, regArr);
+
+  err = sd_ReadCID(regArr);
+  if (err != READ_SUCCESS)
+    return err;
+  sd_DecodeCID(info, regArr);
+
+  // cards before version 1.10 of the spec may not support SEND_SCR.
+  err = sd_ReadSCR(regArr);
+  if (err == READ_SUCCESS)
+    sd_DecodeSCR(info, regArr);
+  else if (err & R1_ERROR)
+    err = READ_SUCCESS;
+  return err;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           DECODE CSD/CID/SCR
+ *
+ * Description : Decode the contents of a register, as read by sd_ReadCSD,
+ *               sd_ReadCID or sd_ReadSCR, into the members of an SdInfo
+ *               instance. Called by sd_GetInfo.
+ *
+ * Arguments   : info     - pointer to the SdInfo instance that will be set.
+ *               regArr   - pointer to the array holding the register, most
+ *                          significant byte first.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void sd_DecodeCSD(SdInfo *info, const uint8_t regArr[])
+{
+  // TAAC and TRAN_SPEED units, and the time/rate value x 10 of each field.
+  static const uint32_t taacUnitNs[8] =
+    { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000 };
+  static const uint32_t tranUnitHz[4] =
+    { 100000, 1000000, 10000000, 100000000 };
+  static const uint8_t  fieldVal[16] =
+    { 0, 10, 12, 13, 15, 20, 25, 30, 35, 40, 45, 50, 55, 60, 70, 80 };
+
+  info->csdVsn = (regArr[0] >> 6) + 1;                       // [127:126]
+
+  // these fields are at the same position in every CSD version.
+  info->taacNs = taacUnitNs[regArr[1] & 0x07]                // [119:112]
+                 * fieldVal[(regArr[1] >> 3) & 0x0F] / 10;
+  info->nsac = regArr[2];                                    // [111:104]
+  info->maxClkHz = tranUnitHz[regArr[3] & 0x03] / 10         // [103:96]
+                   * fieldVal[(regArr[3] >> 3) & 0x0F];
+  info->cmdClasses = (uint16_t)regArr[4] << 4 | regArr[5] >> 4; // [95:84]
+  info->readPartial = regArr[6] >> 7;                        // [79]
+  info->r2wFactor = (regArr[12] >> 2) & 0x07;                // [28:26]
+  info->writePartial = (regArr[13] >> 5) & 0x01;             // [21]
+  info->writeProt = (regArr[14] >> 4) & 0x03 ? 1 : 0;        // [13:12]
+
+  if (info->csdVsn == CSD_VSN_1)
+  {
+    uint8_t  readBlLen = regArr[5] & 0x0F;                   // [83:80]
+    uint8_t  writeBlLen = (regArr[12] & 0x03) << 2           // [25:22]
+                          | regArr[13] >> 6;
+    uint16_t cSize = (uint16_t)(regArr[6] & 0x03) << 10      // [73:62]
+                     | (uint16_t)regArr[7] << 2 | regArr[8] >> 6;
+    uint8_t  cSizeMult = (regArr[9] & 0x03) << 1             // [49:47]
+                         | regArr[10] >> 7;
+    uint8_t  sectorSize = (regArr[10] & 0x3F) << 1           // [45:39]
+                          | regArr[11] >> 7;
+
+    // capacity is (C_SIZE + 1) x 2^(C_SIZE_MULT + 2) x 2^READ_BL_LEN bytes.
+    info->numOfBlks = (uint32_t)(cSize + 1)
+                      << (cSizeMult + 2 + readBlLen - BLOCK_LEN_SHIFT);
+
+    // the erase sector is SECTOR_SIZE + 1 write blocks.
+    info->eraseBlks = (sectorSize + 1) << (writeBlLen - BLOCK_LEN_SHIFT);
+  }
+  else
+  {
+    // C_SIZE is 22 bits in a version 2.0 CSD, and 28 bits in version 3.0.
+    uint32_t cSize = (uint32_t)regArr[7] << 16                // [75:48]
+                     | (uint16_t)regArr[8] << 8 | regArr[9];
+    if (info->csdVsn == CSD_VSN_2)
+      cSize &= 0x3FFFFF;
+    else
+      cSize |= (uint32_t)(regArr[6] & 0x0F) << 24;
+
+    if (cSize + 1 > UINT32_MAX >> C_SIZE_UNIT_SHIFT)
+      info->numOfBlks = UINT32_MAX;
+    else
+      info->numOfBlks = (cSize + 1) << C_SIZE_UNIT_SHIFT;
+    info->eraseBlks = SDHC_ERASE_BLKS;
+  }
+}
+
+void sd_DecodeCID(SdInfo *info, const uint8_t regArr[])
+{
+  info->mfrId = regArr[0];                                   // [127:120]
+  memcpy(info->oemId, &regArr[1], 2);                        // [119:104]
+  info->oemId[2] = '\0';
+  memcpy(info->prodName, &regArr[3], 5);                     // [103:64]
+  info->prodName[5] = '\0';
+  info->prodRev = regArr[8];                                 // [63:56]
+  info->serialNum = (uint32_t)regArr[9] << 24                // [55:24]
+                    | (uint32_t)regArr[10] << 16
+                    | (uint16_t)regArr[11] << 8 | regArr[12];
+
+  // the date is the year since 2000 and the month.
+  info->mfgYear = 2000 + ((regArr[13] & 0x0F) << 4           // [19:8]
+                          | regArr[14] >> 4);
+  info->mfgMonth = regArr[14] & 0x0F;
+}
+
+void sd_DecodeSCR(SdInfo *info, const uint8_t regArr[])
+{
+  uint8_t sdSpec = regArr[0] & 0x0F;                         // [59:56]
+  uint8_t sdSpec3 = regArr[2] >> 7;                          // [47]
+  uint8_t sdSpec4 = (regArr[2] >> 2) & 0x01;                 // [42]
+  uint8_t sdSpecX = (regArr[2] & 0x03) << 2 | regArr[3] >> 6; // [41:38]
+
+  info->scrValid = 1;
+  info->eraseData = (regArr[1] >> 7) ? 0xFF : 0x00;          // [55]
+  info->busWidths = regArr[1] & 0x0F;                        // [51:48]
+  info->cmdSupport = regArr[3] & 0x0F;                       // [35:32]
+
+  // later versions are flagged by the fields added after SD_SPEC.
+  if (sdSpec == 0)
+    info->specVsn = SPEC_VSN_1_0;
+  else if (sdSpec == 1)
+    info->specVsn = SPEC_VSN_1_1;
+  else if (!sdSpec3)
+    info->specVsn = SPEC_VSN_2_0;
+  else if (sdSpecX)
+    info->specVsn = SPEC_VSN_4_0 + 10 * sdSpecX;
+  else if (sdSpec4)
+    info->specVsn = SPEC_VSN_4_0;
+  else
+    info->specVsn = SPEC_VSN_3_0;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           GET SD CARD STATUS
+ *
+ * Description : Reads the SD Status of the card and decodes it into an
+ *               SdStatus instance.
+ *
+ * Arguments   : sts   - pointer to the SdStatus instance that will be set.
+ *
+ * Returns     : Read Block Error (upper byte) and R1 Response (lower byte).
+ *               READ_SUCCESS if the status was read.
+ *
+ * Notes       : The SD Status is read from the card each call, but only
+ *               changes if the card is locked, secured or its bus changed.
+ * ----------------------------------------------------------------------------
+ */
+uint16_t sd_GetStatus(SdStatus *sts)
+{
+  uint8_t  regArr[SD_STATUS_LEN];
+  uint16_t err;
+
+  memset(sts, 0, sizeof *sts);
+  err = sd_ReadSdStatus(regArr);
+  if (err == READ_SUCCESS)
+    sd_DecodeSdStatus(sts, regArr);
+  return err;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                        DECODE SD CARD STATUS
+ *
+ * Description : Decode the SD Status, as read by sd_ReadSdStatus, into the
+ *               members of an SdStatus instance. Called by sd_GetStatus.
+ *
+ * Arguments   : sts      - pointer to the SdStatus instance that will be set.
+ *               regArr   - pointer to the array holding the SD Status, most
+ *                          significant byte first.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void sd_DecodeSdStatus(SdStatus *sts, const uint8_t regArr[])
+{
+  // class number of each SPEED_CLASS, and KB of each AU_SIZE.
+  static const uint8_t  speedClass[5] = { 0, 2, 4, 6, 10 };
+  static const uint32_t auSizeKB[16] =
+    { 0, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 12288,
+      16384, 24576, 32768, 65536 };
+
+  sts->busWidth = (regArr[0] >> 6) == SD_STS_BUS_4_BIT ? 4 : 1; // [511:510]
+  sts->securedMode = (regArr[0] >> 5) & 0x01;                // [509]
+  sts->cardType = (uint16_t)regArr[2] << 8 | regArr[3];      // [495:480]
+  sts->protArea = (uint32_t)regArr[4] << 24                  // [479:448]
+                  | (uint32_t)regArr[5] << 16
+                  | (uint16_t)regArr[6] << 8 | regArr[7];
+  if (regArr[8] < sizeof speedClass)                         // [447:440]
+    sts->speedClass = speedClass[regArr[8]];
+  sts->perfMove = regArr[9];                                 // [439:432]
+  sts->auSizeKB = auSizeKB[regArr[10] >> 4];                 // [431:428]
+  sts->eraseAUs = (uint16_t)regArr[11] << 8 | regArr[12];    // [423:408]
+  sts->eraseTimeoutS = regArr[13] >> 2;                      // [407:402]
+  sts->eraseOffsetS = regArr[13] & 0x03;                     // [401:400]
+  sts->uhsSpeedGrade = regArr[14] >> 4;                      // [399:396]
+  sts->videoClass = regArr[15];                              // [391:384]
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            SET MAXIMUM CLOCK
+ *
+ * Description : Sets the SPI clock to the fastest rate that is not faster
+ *               than the maximum clock rate of the card.
+ *
+ * Arguments   : info   - pointer to an SdInfo instance set by sd_GetInfo.
+ *
+ * Returns     : void
+ *
+ * Notes       : The read and write time limits depend on the SPI clock, so
+ *               sd_SetTimeouts should be called after this.
+ * ----------------------------------------------------------------------------
+ */
+void sd_SetMaxClock(const SdInfo *info)
+{
+  uint8_t div = SPI_CLK_DIV_2;
+
+  while (div < SPI_CLK_DIV_128 && (F_CPU >> (div + 1)) > info->maxClkHz)
+    ++div;
+  spi_SetClockDiv(div);
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           PRINT SD CARD INFO
+ *
+ * Description : Prints the members of an SdInfo instance to the screen.
+ *
+ * Arguments   : info   - pointer to an SdInfo instance set by sd_GetInfo.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void sd_PrintInfo(const SdInfo *info)
+{
+  pvt_PrintDecField("CSD VERSION     : ", info->csdVsn);
+  pvt_PrintDecField("CAPACITY (KB)   : ", info->numOfBlks / 2);
+  pvt_PrintDecField("BLOCKS          : ", info->numOfBlks);
+  pvt_PrintDecField("ERASE BLOCKS    : ", info->eraseBlks);
+  pvt_PrintDecField("MAX CLOCK (Hz)  : ", info->maxClkHz);
+  pvt_PrintDecField("TAAC (ns)       : ", info->taacNs);
+  pvt_PrintDecField("NSAC (x100 clk) : ", info->nsac);
+  pvt_PrintDecField("R2W FACTOR      : ", info->r2wFactor);
+  pvt_PrintDecField("PARTIAL READ    : ", info->readPartial);
+  pvt_PrintDecField("PARTIAL WRITE   : ", info->writePartial);
+  pvt_PrintDecField("WRITE PROTECTED : ", info->writeProt);
+  print_Str("\n\r CMD CLASSES     : 0x");
+  print_Hex(info->cmdClasses);
+
+  print_Str("\n\r MANUFACTURER ID : 0x");
+  print_Hex(info->mfrId);
+  pvt_PrintStrField("OEM ID          : ", info->oemId);
+  pvt_PrintStrField("PRODUCT NAME    : ", info->prodName);
+  print_Str("\n\r PRODUCT REV     : ");
+  print_Dec(info->prodRev >> 4);
+  print_Str(".");
+  print_Dec(info->prodRev & 0x0F);
+  pvt_PrintDecField("SERIAL NUMBER   : ", info->serialNum);
+  print_Str("\n\r MFG DATE        : ");
+  print_Dec(info->mfgYear);
+  print_Str("/");
+  print_Dec(info->mfgMonth);
+
+  if (!info->scrValid)
+  {
+    print_Str("\n\r SCR NOT AVAILABLE");
+    return;
+  }
+  print_Str("\n\r SD SPEC VERSION : ");
+  print_Dec(info->specVsn / 10);
+  print_Str(".");
+  print_Dec(info->specVsn % 10);
+  pvt_PrintDecField("BUS WIDTHS      : ", info->busWidths);
+  pvt_PrintDecField("CMD SUPPORT     : ", info->cmdSupport);
+  print_Str("\n\r ERASED DATA     : 0x");
+  print_Hex(info->eraseData);
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                         PRINT SD CARD STATUS
+ *
+ * Description : Prints the members of an SdStatus instance to the screen.
+ *
+ * Arguments   : sts   - pointer to an SdStatus instance set by sd_GetStatus.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void sd_PrintStatus(const SdStatus *sts)
+{
+  pvt_PrintDecField("BUS WIDTH       : ", sts->busWidth);
+  pvt_PrintDecField("SECURED MODE    : ", sts->securedMode);
+  print_Str("\n\r CARD TYPE       : 0x");
+  print_Hex(sts->cardType);
+  pvt_PrintDecField("PROTECTED AREA  : ", sts->protArea);
+  pvt_PrintDecField("SPEED CLASS     : ", sts->speedClass);
+  pvt_PrintDecField("UHS SPEED GRADE : ", sts->uhsSpeedGrade);
+  pvt_PrintDecField("VIDEO CLASS     : ", sts->videoClass);
+  pvt_PrintDecField("PERF MOVE (MB/s): ", sts->perfMove);
+  pvt_PrintDecField("AU SIZE (KB)    : ", sts->auSizeKB);
+  pvt_PrintDecField("ERASE AUs       : ", sts->eraseAUs);
+  pvt_PrintDecField("ERASE TIME (s)  : ", sts->eraseTimeoutS);
+  pvt_PrintDecField("ERASE OFFSET (s): ", sts->eraseOffsetS);
+}
+
+/*
+ ******************************************************************************
+ *                           "PRIVATE" FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                  (PRIVATE) PRINT INFO FIELDS
+ *
+ * Description : Print a label of sd_PrintInfo on a new line, followed by a
+ *               string or a decimal number.
+ *
+ * Arguments   : label   - the label, including the separator.
+ *               str     - the string to print.
+ *               num     - the number to print.
+ *
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+static void pvt_PrintStrField(const char *label, const char *str)
+{
+  print_Str("\n\r ");
+  print_Str((char *)label);
+  print_Str((char *)str);
+}
+
+static void pvt_PrintDecField(const char *label, uint32_t num)
+{
+  print_Str("\n\r ");
+  print_Str((char *)label);
+  print_Dec(num);
+}
@@ -9,11 +9,76 @@
  */
 
 #include <stdint.h>
+#include <string.h>
 #include "avr_spi.h"
+#include "avr_timer.h"
 #include "prints.h"
 #include "sd_spi_base.h"
+#include "sd_spi_info.h"
 #include "sd_spi_rwe.h"
 
+/*
+ ******************************************************************************
+ *                 "PRIVATE" FUNCTION PROTOTYPES (and MACROS)
+ ******************************************************************************
+ */
+
+// busy wait state. Set by sd_SetBusyYield, and updated by pvt_WaitWhileBusy.
+static SdYieldFn   busyYieldFn;
+static void       *busyYieldArg;
+static SdBusyStats busyStats[SD_BUSY_OP_CNT];
+
+// time limits. Set from the CSD register by sd_SetTimeouts.
+static uint16_t busyLimMs[SD_BUSY_OP_CNT] = 
+  { SD_WRITE_BUSY_MS, SD_ERASE_BUSY_MS, SD_STOP_BUSY_MS };
+static uint16_t readLimMs = SD_READ_TIMEOUT_MS;
+
+// read stream state. readStrmTkn is the token of the next block once it is
+// received, otherwise 0, and readStrmMs is when its read time limit started.
+static uint8_t  readStrmTkn;
+static uint32_t readStrmMs;
+
+// CSD fields the time limits are set from. csdValid is 0 until they are set.
+static uint8_t  csdValid, csdVsn, csdNsac, csdR2w, csdIsXC;
+static uint32_t csdTaacNs;
+
+// retry policy state. failRun is the number of bus errors in a row, okRun
+// the number of transfers in a row that succeeded at the first try, and
+// stepDowns the number of times the clock was slowed and not sped up again.
+static SdRetryStats retryStats;
+static uint8_t      failRun, stepDowns;
+static uint16_t     okRun;
+
+// the card's reply, while a read waits for the Start Block Token, is a Data
+// Error Token. 0x00 is not one, since no error bit is set.
+#define IS_DATA_ERROR_TKN(byte)  (!((byte) & DATA_ERROR_TKN_MASK) && (byte))
+
+// bytes clocked with the card deselected by sd_Resync.
+#define RESYNC_DMY_BYTES      4
+
+// SDSC (version 1.0 CSD) and later card limits in the SD specification.
+#define SDHC_BLKS_MAX         0x4000000        // 32 GB. Larger cards are SDXC
+#define SDSC_WRITE_LIM_MS     250
+#define SDXC_WRITE_LIM_MS     500
+
+// RD/WR bit of the GEN_CMD argument. Set for a read.
+#define GEN_CMD_RD            0x01
+#define READ_LIM_MS           100
+
+static uint16_t pvt_ReadSingleBlock(uint32_t blckAddr, uint8_t blckArr[]);
+static uint16_t pvt_WriteSingleBlock(uint32_t blckAddr, 
+                                     const uint8_t dataArr[]);
+static uint8_t  pvt_RetryAfter(uint16_t err, uint16_t okErr, 
+                               uint16_t retryErrs, uint16_t busErrs,
+                               uint8_t tries);
+static void     pvt_SetLimits(void);
+static uint16_t pvt_WaitStartTkn(void);
+static uint16_t pvt_ReadRegister(uint8_t cmd, uint32_t arg, 
+                                 uint8_t isAppCmd, uint8_t regArr[], 
+                                 uint16_t len);
+static uint16_t pvt_SendDataBlock(uint8_t startTkn, const uint8_t dataArr[]);
+static uint16_t pvt_WaitWhileBusy(uint8_t op);
+
 /*
  ******************************************************************************
  *                                 FUNCTIONS   
@@ -44,15 +109,60 @@
  *                            length BLOCK_LEN.
  * 
  * Returns     : Read Block Error (upper byte) and R1 Response (lower byte).   
+ *
+ * Notes       : A failed read is retried. See RETRY POLICY.
  * ----------------------------------------------------------------------------
  */
 uint16_t sd_ReadSingleBlock(uint32_t blckAddr, uint8_t blckArr[])
 {
-  uint8_t r1;                               // for R1 responses
+  uint16_t err;
 
-  // request contents of a single data block at blckAddr on the SD card.
+  for (uint8_t tries = 0; ; ++tries)
+  {
+    if (tries)
+      sd_Resync();
+    err = pvt_ReadSingleBlock(blckAddr, blckArr);
+    if (!pvt_RetryAfter(err, READ_SUCCESS, START_TOKEN_TIMEOUT, 0, tries))
+      return err;
+  }
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                         READ MULTIPLE BLOCKS
+ * 
+ * Description : Reads consecutive data blocks from the SD card with a single
+ *               READ_MULTIPLE_BLOCK command, and passes each block to blckFn
+ *               as it is received.
+ * 
+ * Arguments   : blckAddr     - address of the first data block to read.
+ *               numOfBlcks   - number of blocks to read.
+ *               blckArr      - pointer to the array each block is loaded into
+ *                              before it is passed to blckFn. Must be length
+ *                              BLOCK_LEN.
+ *               blckFn       - function each block is passed to. If it
+ *                              returns a non-zero value then no more blocks
+ *                              are read.
+ *               arg          - pointer passed to blckFn with each block.
+ * 
+ * Returns     : Read Block Error (upper byte) and R1 Response (lower byte).
+ *
+ * Notes       : 1) The command is only sent once, and the card streams the
+ *                  blocks, so this is faster than reading each block with
+ *                  sd_ReadSingleBlock.
+ *               2) The card is deselected while blckFn runs, so blckFn may
+ *                  use other devices on the SPI bus.
+ * ----------------------------------------------------------------------------
+ */
+uint16_t sd_ReadMultipleBlocks(uint32_t blckAddr, uint32_t numOfBlcks, 
+                               uint8_t blckArr[], SdBlockFn blckFn, void *arg)
+{
+  uint8_t  r1;                              // for R1 responses
+  uint16_t err;
+
+  // request the blocks starting at blckAddr on the SD card.
   CS_SD_LOW;
-  sd_SendCommand(READ_SINGLE_BLOCK, blckAddr);
+  sd_SendCommand(READ_MULTIPLE_BLOCK, blckAddr);
   r1 = sd_GetR1();
   if (r1 != OUT_OF_IDLE)
   {
@@ -60,30 +170,43 @@ uint16_t sd_ReadSingleBlock(uint32_t blckAddr, uint8_t blckArr[])
     return (R1_ERROR | r1);
   }
 
-  //
-  // loop until the 'Start Block Token' has been received from the SD card,
-  // which indicates data from requested blckAddr is about to be sent.
-  //
-  for (uint8_t timeout = 0; sd_ReceiveByteSPI() != START_BLOCK_TKN; ++timeout)
-    if (timeout >= TIMEOUT_LIMIT)
+  err = READ_SUCCESS;
+  for (uint32_t blckNum = 0; blckNum < numOfBlcks; ++blckNum)
+  {
+    // wait for the 'Start Block Token' of the next block.
+    err = pvt_WaitStartTkn();
+    if (err != READ_SUCCESS)
+      break;
+
+    // Load SD card block into the array.         
+    for (uint16_t byte = 0; byte < BLOCK_LEN; ++byte)
+      blckArr[byte] = sd_ReceiveByteSPI();
+
+    // Get 16-bit CRC. Don't need.
+    sd_ReceiveByteSPI();
+    sd_ReceiveByteSPI();
+
+    // the card holds the next block until it is selected again.
+    CS_SD_HIGH;
+    if (blckFn(blckArr, arg))
     {
-      CS_SD_HIGH;
-      return (START_TOKEN_TIMEOUT | r1);
+      CS_SD_LOW;
+      break;
     }
+    CS_SD_LOW;
+  }
 
-  // Load SD card block into the array.         
-  for (uint16_t byte = 0; byte < BLOCK_LEN; ++byte)
-    blckArr[byte] = sd_ReceiveByteSPI();
-
-  // Get 16-bit CRC. Don't need.
-  sd_ReceiveByteSPI();
+  //
+  // stop the card sending blocks. The R1b response is preceded by a stuff
+  // byte and is followed by busy (0) bytes until the card is ready.
+  //
+  sd_SendCommand(STOP_TRANSMISSION, 0);
   sd_ReceiveByteSPI();
-  
-  // clear any remaining data from the SPDR
-  sd_ReceiveByteSPI();          
+  sd_GetR1();
+  pvt_WaitWhileBusy(SD_BUSY_STOP);
 
   CS_SD_HIGH;
-  return (READ_SUCCESS | r1);
+  return (err | r1);
 }
 
 /*
@@ -174,229 +297,742 @@ void sd_PrintSingleBlock(const uint8_t blckArr[])
  *                            the SD card. Must be of length BLOCK_LEN.
  * 
  * Returns     : Write Block Error (upper byte) and R1 Response (lower byte).
+ *
+ * Notes       : A failed write is retried. See RETRY POLICY.
  * ----------------------------------------------------------------------------
  */
 uint16_t sd_WriteSingleBlock(uint32_t blckAddr, const uint8_t dataArr[])
+{
+  uint16_t err;
+
+  for (uint8_t tries = 0; ; ++tries)
+  {
+    if (tries)
+      sd_Resync();
+    err = pvt_WriteSingleBlock(blckAddr, dataArr);
+    if (!pvt_RetryAfter(err, DATA_WRITE_SUCCESS, 
+                        DATA_RESPONSE_TIMEOUT | CRC_ERROR_TKN_RECEIVED 
+                        | INVALID_DATA_RESPONSE, CRC_ERROR_TKN_RECEIVED, 
+                        tries))
+      return err;
+  }
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                        WRITE MULTIPLE BLOCKS
+ * 
+ * Description : Writes consecutive data blocks to the SD card with a single
+ *               WRITE_MULTIPLE_BLOCK command. The data of each block is taken
+ *               from blckSrcFn just before the block is sent.
+ * 
+ * Arguments   : blckAddr     - address of the first data block to write.
+ *               numOfBlcks   - number of blocks to write.
+ *               blckSrcFn    - function that returns the data of each block.
+ *               arg          - pointer passed to blckSrcFn with each block.
+ * 
+ * Returns     : Write Block Error (upper byte) and R1 Response (lower byte).
+ *
+ * Notes       : The write stops at the first block that is not written, and
+ *               the blocks after it are not written.
+ * ----------------------------------------------------------------------------
+ */
+uint16_t sd_WriteMultipleBlocks(uint32_t blckAddr, uint32_t numOfBlcks,
+                                SdBlockSrcFn blckSrcFn, void *arg)
 {
   uint8_t  r1;                              // for R1 response
-  uint8_t  dataRespTkn = 0;
+  uint16_t err = DATA_WRITE_SUCCESS;
 
-  // send the Write Single Block command to write data to blckAddr on SD card.
-  CS_SD_LOW;    
-  sd_SendCommand (WRITE_BLOCK, blckAddr);
+  // send the Write Multiple Block command to write from blckAddr on SD card.
+  CS_SD_LOW;
+  sd_SendCommand(WRITE_MULTIPLE_BLOCK, blckAddr);
   if ((r1 = sd_GetR1()) != OUT_OF_IDLE)
   {
     CS_SD_HIGH;
     return (R1_ERROR | r1);
   }
 
-  // send Start Block Token (0xFE) to initiate data transfer
-  sd_SendByteSPI(START_BLOCK_TKN); 
-
-  // send data to write to SD card.
-  for (uint16_t pos = 0; pos < BLOCK_LEN; ++pos) 
-    sd_SendByteSPI (dataArr[pos]);
-
-  // Send 16-bit CRC. CRC should be off (default), so these do not matter.
-  sd_SendByteSPI(DMY_TKN);
-  sd_SendByteSPI(DMY_TKN);
-  
-  // loop until valid data response token received or function exits on timeout
-  for (uint8_t timeout = 0; 
-       dataRespTkn != DATA_ACCEPTED_TKN
-       && dataRespTkn != CRC_ERROR_TKN 
-       && dataRespTkn != WRITE_ERROR_TKN;)
+  // each block is preceded by the multiple block write Start Block Token.
+  for (uint32_t blckNum = 0; blckNum < numOfBlcks; ++blckNum)
   {
-    dataRespTkn = sd_ReceiveByteSPI() & DATA_RESPONSE_TKN_MASK;
-    if (++timeout > TIMEOUT_LIMIT)
-    {
-      CS_SD_HIGH;
-      return (DATA_RESPONSE_TIMEOUT | r1);
-    }
+    err = pvt_SendDataBlock(START_MULT_WRITE_TKN, blckSrcFn(blckNum, arg));
+    if (err == DATA_WRITE_SUCCESS)
+      err = pvt_WaitWhileBusy(SD_BUSY_WRITE);
+    if (err != DATA_WRITE_SUCCESS)
+      break;
   }
-  
+
   //
-  // if SD card signals the data was accepted by returning the Data Accepted
-  // Token then the card will enter 'busy' state while it writes the data to 
-  // the block. While busy, the card will hold the DO line at 0. If the timeout
-  // limit is reached then the function will return CARD_BUSY_TIMEOUT.
+  // the Stop Tran Token ends the write. It is followed by a byte, then the
+  // card holds DO at 0 while it finishes programming the last block.
   //
-  if (dataRespTkn == DATA_ACCEPTED_TKN)
-  { 
-    for (uint16_t timeout = 0; sd_ReceiveByteSPI() == 0; ++timeout)
-      if (timeout > 4 * TIMEOUT_LIMIT)      // increased timeout limit
-      {
-        CS_SD_HIGH;
-        return (CARD_BUSY_TIMEOUT | r1);
-      }
+  sd_SendByteSPI(STOP_TRAN_TKN);
+  sd_ReceiveByteSPI();
+  if (pvt_WaitWhileBusy(SD_BUSY_STOP) != DATA_WRITE_SUCCESS
+      && err == DATA_WRITE_SUCCESS)
+    err = CARD_BUSY_TIMEOUT;
 
-    CS_SD_HIGH;
-    return (DATA_WRITE_SUCCESS | r1);
-  }
-  else if (dataRespTkn == CRC_ERROR_TKN) 
-  {
-    CS_SD_HIGH;
-    return (CRC_ERROR_TKN_RECEIVED | r1);
-  }
-  else if (dataRespTkn == WRITE_ERROR_TKN)
-  {
   CS_SD_HIGH;
-  return (WRITE_ERROR_TKN_RECEIVED | r1);
-  }
-
-  return (INVALID_DATA_RESPONSE | r1) ;
+  return (err | r1);
 }
 
 /*
  * ----------------------------------------------------------------------------
- *                                                                 ERASE BLOCKS
+ *                                                           START WRITE STREAM
  * 
- * Description : Erases the blocks between (and including) startBlckAddr and
- *               endBlckAddr.
+ * Description : Sends the WRITE_MULTIPLE_BLOCK command to begin a write
+ *               stream at blckAddr. Blocks are then sent one at a time by
+ *               sd_SendStreamBlock, and the stream is ended by sd_StopStream.
  * 
- * Arguments   : startBlckAddr   - address of the first block to be erased.
- *               endBlckAddr     - address of the last block to be erased.
+ * Arguments   : blckAddr   - address of the first data block to write.
  * 
- * Returns     : Erase Block Error (upper byte) and R1 Response (lower byte).
+ * Returns     : Write Block Error (upper byte) and R1 Response (lower byte).
+ *               DATA_WRITE_SUCCESS if the stream was started.
+ *
+ * Warnings    : No other command may be sent to the card until the stream is
+ *               ended by sd_StopStream.
  * ----------------------------------------------------------------------------
  */
-uint16_t sd_EraseBlocks(uint32_t startBlckAddr, uint32_t endBlckAddr)
+uint16_t sd_StartStream(uint32_t blckAddr)
 {
-  uint8_t r1;                               // for R1 responses
-  
-  // set Start Address for erase block
-  CS_SD_LOW;
-  sd_SendCommand(ERASE_WR_BLK_START_ADDR, startBlckAddr);
-  r1 = sd_GetR1();
-  CS_SD_HIGH;
-  if (r1 != OUT_OF_IDLE) 
-    return (SET_ERASE_START_ADDR_ERROR | R1_ERROR | r1);
-  
-  // set End Address for erase block
+  uint8_t  r1;                              // for R1 response
+
+  // send the Write Multiple Block command to write from blckAddr on SD card.
   CS_SD_LOW;
-  sd_SendCommand(ERASE_WR_BLK_END_ADDR, endBlckAddr);
+  sd_SendCommand(WRITE_MULTIPLE_BLOCK, blckAddr);
   r1 = sd_GetR1();
   CS_SD_HIGH;
-  if (r1 != OUT_OF_IDLE) 
-    return (SET_ERASE_END_ADDR_ERROR | R1_ERROR | r1);
+  if (r1 != OUT_OF_IDLE)
+    return (R1_ERROR | r1);
+
+  return (DATA_WRITE_SUCCESS | r1);
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            SEND STREAM BLOCK
+ * 
+ * Description : Sends the next data block of a write stream started by
+ *               sd_StartStream. This returns once the card has accepted the
+ *               block, without waiting while the card writes it.
+ * 
+ * Arguments   : blckArr   - pointer to the array holding the block. Must be of
+ *                           length BLOCK_LEN.
+ * 
+ * Returns     : Write Block Error. DATA_WRITE_SUCCESS if the block was
+ *               accepted.
+ *
+ * Notes       : If the card is still busy writing the previous block this
+ *               waits for it first. Call sd_IsCardBusy to avoid waiting.
+ * ----------------------------------------------------------------------------
+ */
+uint16_t sd_SendStreamBlock(const uint8_t blckArr[])
+{
+  uint16_t err;
 
-  // erase all blocks between, and including, start and end address
   CS_SD_LOW;
-  sd_SendCommand(ERASE, 0);                 // arg = 0 for this command      
-  r1 = sd_GetR1 ();
-  if (r1 != OUT_OF_IDLE)
-  {
-    CS_SD_HIGH;
-    return (ERASE_ERROR | R1_ERROR | r1);
-  }
+  err = pvt_WaitWhileBusy(SD_BUSY_WRITE);
+  if (err == DATA_WRITE_SUCCESS)
+    err = pvt_SendDataBlock(START_MULT_WRITE_TKN, blckArr);
+  CS_SD_HIGH;
+  return err;
+}
 
-  // wait for erase to finish. Busy (0) signal returned until erase completes.
-  for (uint16_t timeout = 0; sd_ReceiveByteSPI() == 0; ++timeout)
-    if(timeout++ > 4 * TIMEOUT_LIMIT) 
-      return (ERASE_BUSY_TIMEOUT | r1);
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                 IS CARD BUSY
+ * 
+ * Description : Checks, without waiting, if the card is busy writing a block.
+ * 
+ * Arguments   : void
+ * 
+ * Returns     : 1 if the card is busy, 0 if it is not.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t sd_IsCardBusy(void)
+{
+  uint8_t busy;
 
+  // while busy, the card holds the DO line at 0.
+  CS_SD_LOW;
+  busy = (sd_ReceiveByteSPI() == 0);
   CS_SD_HIGH;
-  return ERASE_SUCCESSFUL;
+  return busy;
 }
 
 /*
- * If either of the three print error functions below show that the R1_ERROR 
- * flag was set in the error response that was passed to it, then the error 
- * response should also be passed to sd_PrintR1() from SD_SPI_BASE.H/C to read 
- * the R1 Error.
+ * ----------------------------------------------------------------------------
+ *                                                            STOP WRITE STREAM
+ * 
+ * Description : Ends a write stream started by sd_StartStream, and waits
+ *               while the card writes the last block.
+ * 
+ * Arguments   : void
+ * 
+ * Returns     : Write Block Error. DATA_WRITE_SUCCESS or CARD_BUSY_TIMEOUT.
+ * ----------------------------------------------------------------------------
  */
+uint16_t sd_StopStream(void)
+{
+  uint16_t err;
+
+  //
+  // the Stop Tran Token is only sent once the last block is written. It is
+  // followed by a byte, then the card is busy again while it ends the write.
+  //
+  CS_SD_LOW;
+  err = pvt_WaitWhileBusy(SD_BUSY_WRITE);
+  sd_SendByteSPI(STOP_TRAN_TKN);
+  sd_ReceiveByteSPI();
+  if (pvt_WaitWhileBusy(SD_BUSY_STOP) != DATA_WRITE_SUCCESS)
+    err = CARD_BUSY_TIMEOUT;
+  CS_SD_HIGH;
+  return err;
+}
 
 /*
  * ----------------------------------------------------------------------------
- *                                                             PRINT READ ERROR
+ *                                                            START READ STREAM
  * 
- * Description : Print Read Error Flag returned by a SD card read function.  
+ * Description : Sends the READ_MULTIPLE_BLOCK command to begin a read stream
+ *               at blckAddr. Blocks are then received one at a time by
+ *               sd_ReceiveStreamBlock, and the stream is ended by
+ *               sd_StopReadStream.
  * 
- * Arguments   : err   - Read Error Response.
+ * Arguments   : blckAddr   - address of the first data block to read.
  * 
- * Returns     : void
+ * Returns     : Read Block Error (upper byte) and R1 Response (lower byte).
+ *               READ_SUCCESS if the stream was started.
+ *
+ * Warnings    : No other command may be sent to the card until the stream is
+ *               ended by sd_StopReadStream.
  * ----------------------------------------------------------------------------
  */
-void sd_PrintReadError(uint16_t err)
+uint16_t sd_StartReadStream(uint32_t blckAddr)
 {
-  // 0xFF00 filters out the lower byte which is the R1 response
-  switch (err & 0xFF00)
-  {
-    case R1_ERROR:
-      print_Str("\n\r R1_ERROR");
-      break;
-    case READ_SUCCESS:
-      print_Str("\n\r READ_SUCCESS");
-      break;
-    case START_TOKEN_TIMEOUT:
-      print_Str("\n\r START_TOKEN_TIMEOUT");
-      break;
-    default:
-      print_Str("\n\r UNKNOWN RESPONSE");
-  }
+  uint8_t  r1;                              // for R1 response
+
+  // request the blocks starting at blckAddr on the SD card.
+  CS_SD_LOW;
+  sd_SendCommand(READ_MULTIPLE_BLOCK, blckAddr);
+  r1 = sd_GetR1();
+  CS_SD_HIGH;
+  if (r1 != OUT_OF_IDLE)
+    return (R1_ERROR | r1);
+
+  readStrmTkn = 0;
+  readStrmMs = timer_GetMs();
+  return (READ_SUCCESS | r1);
 }
 
 /*
  * ----------------------------------------------------------------------------
- *                                                            PRINT WRITE ERROR
+ *                                                               IS BLOCK READY
  * 
- * Description : Print Write Error Flag returned by a SD card read function.  
+ * Description : Checks, without waiting, if the card has started sending the
+ *               next block of a read stream started by sd_StartReadStream.
  * 
- * Arguments   : err   - Write Error Response.
+ * Arguments   : void
  * 
- * Returns     : void
+ * Returns     : 1 if sd_ReceiveStreamBlock will not wait for the block, 0 if
+ *               the card is still reading it.
+ *
+ * Notes       : This also returns 1 once the card has sent a Data Error
+ *               Token, or the read time limit has passed since the stream
+ *               was started or the last block received, so
+ *               sd_ReceiveStreamBlock returns DATA_ERROR_TKN_RECEIVED or
+ *               START_TOKEN_TIMEOUT at once.
  * ----------------------------------------------------------------------------
  */
-void sd_PrintWriteError(uint16_t err)
+uint8_t sd_IsBlockReady(void)
 {
-  // 0xFF00 filters out the lower byte which is the R1 response
-  switch(err & 0xFF00)
+  // the card sends 0xFF until the 'Start Block Token' of the block.
+  if (!readStrmTkn)
   {
-    case DATA_WRITE_SUCCESS:
-      print_Str("\n\r DATA_WRITE_SUCCESS");
-      break;
-    case CRC_ERROR_TKN_RECEIVED:
-      print_Str("\n\r CRC_ERROR_TKN_RECEIVED");
-      break;
-    case WRITE_ERROR_TKN_RECEIVED:
-      print_Str("\n\r WRITE_ERROR_TKN_RECEIVED");
-      break;
-    case INVALID_DATA_RESPONSE:
-      print_Str("\n\r INVALID_DATA_RESPONSE");
-      break;
-    case DATA_RESPONSE_TIMEOUT:
-      print_Str("\n\r DATA_RESPONSE_TIMEOUT");
-      break;
-    case CARD_BUSY_TIMEOUT:
-      print_Str("\n\r CARD_BUSY_TIMEOUT");
-      break;
-    case R1_ERROR:
-      print_Str("\n\r R1_ERROR");
-      break;
-    default:
-      print_Str("\n\r UNKNOWN RESPONSE");
+    CS_SD_LOW;
+    readStrmTkn = sd_ReceiveByteSPI();
+    if (readStrmTkn != START_BLOCK_TKN && !IS_DATA_ERROR_TKN(readStrmTkn))
+      readStrmTkn = 0;
+    CS_SD_HIGH;
   }
+  return (readStrmTkn || timer_GetMs() - readStrmMs > readLimMs);
 }
 
 /*
  * ----------------------------------------------------------------------------
- *                                                            PRINT ERASE ERROR
+ *                                                         RECEIVE STREAM BLOCK
  * 
- * Description : Print Erase Error Flag returned by a SD card read function.  
+ * Description : Receives the next data block of a read stream started by
+ *               sd_StartReadStream.
  * 
- * Arguments   : err   - Erase Error Response.
+ * Arguments   : blckArr   - pointer to the array the block is loaded into.
+ *                           Must be of length BLOCK_LEN.
  * 
- * Returns     : void
+ * Returns     : Read Block Error. READ_SUCCESS, START_TOKEN_TIMEOUT, or
+ *               DATA_ERROR_TKN_RECEIVED if the card could not read the block.
+ *
+ * Notes       : If the card has not started sending the block this waits for
+ *               it first. Call sd_IsBlockReady to avoid waiting.
  * ----------------------------------------------------------------------------
  */
-void sd_PrintEraseError(uint16_t err)
+uint16_t sd_ReceiveStreamBlock(uint8_t blckArr[])
 {
-  // 0xFF00 filters out the lower byte which is the R1 response
-  switch(err & 0xFF00)
+  CS_SD_LOW;
+  while (!readStrmTkn)
   {
-    case ERASE_SUCCESSFUL:
-      print_Str("\n\r ERASE_SUCCESSFUL");
-      break;
+    readStrmTkn = sd_ReceiveByteSPI();
+    if (readStrmTkn != START_BLOCK_TKN && !IS_DATA_ERROR_TKN(readStrmTkn))
+      readStrmTkn = 0;
+    if (!readStrmTkn && timer_GetMs() - readStrmMs > readLimMs)
+    {
+      CS_SD_HIGH;
+      return START_TOKEN_TIMEOUT;
+    }
+  }
+
+  // the card could not read the block, and sends no data for it.
+  if (readStrmTkn != START_BLOCK_TKN)
+  {
+    CS_SD_HIGH;
+    readStrmTkn = 0;
+    return DATA_ERROR_TKN_RECEIVED;
+  }
+
+  // Load SD card block into the array.
+  for (uint16_t byte = 0; byte < BLOCK_LEN; ++byte)
+    blckArr[byte] = sd_ReceiveByteSPI();
+
+  // Get 16-bit CRC. Don't need.
+  sd_ReceiveByteSPI();
+  sd_ReceiveByteSPI();
+  CS_SD_HIGH;
+
+  // the read time limit of the next block starts now.
+  readStrmTkn = 0;
+  readStrmMs = timer_GetMs();
+  return READ_SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             STOP READ STREAM
+ * 
+ * Description : Ends a read stream started by sd_StartReadStream. Any block
+ *               the card has started sending is dropped.
+ * 
+ * Arguments   : void
+ * 
+ * Returns     : Read Block Error. READ_SUCCESS.
+ * ----------------------------------------------------------------------------
+ */
+uint16_t sd_StopReadStream(void)
+{
+  //
+  // stop the card sending blocks. The R1b response is preceded by a stuff
+  // byte and is followed by busy (0) bytes until the card is ready.
+  //
+  CS_SD_LOW;
+  sd_SendCommand(STOP_TRANSMISSION, 0);
+  sd_ReceiveByteSPI();
+  sd_GetR1();
+  pvt_WaitWhileBusy(SD_BUSY_STOP);
+  CS_SD_HIGH;
+
+  readStrmTkn = 0;
+  return READ_SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                               SET BUSY YIELD
+ * 
+ * Description : Sets the function called repeatedly while the card is busy.
+ *               See BUSY YIELD FUNCTION.
+ * 
+ * Arguments   : yieldFn   - the function, or NULL to wait without yielding.
+ *               arg       - pointer passed to yieldFn with each call.
+ * 
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void sd_SetBusyYield(SdYieldFn yieldFn, void *arg)
+{
+  busyYieldFn = yieldFn;
+  busyYieldArg = arg;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                          GET BUSY STATISTICS
+ * 
+ * Description : Copies the busy statistics of one kind of operation.
+ * 
+ * Arguments   : op      - the operation. See BUSY OPERATIONS.
+ *               stats   - pointer to the SdBusyStats instance that will be
+ *                         set.
+ * 
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void sd_GetBusyStats(uint8_t op, SdBusyStats *stats)
+{
+  *stats = busyStats[op];
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                        RESET BUSY STATISTICS
+ * 
+ * Description : Sets the busy statistics of every kind of operation to 0.
+ * 
+ * Arguments   : void
+ * 
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void sd_ResetBusyStats(void)
+{
+  memset(busyStats, 0, sizeof busyStats);
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           RESYNCHRONIZE CARD
+ * 
+ * Description : Returns the card to a known state after a failed transfer.
+ *               The card is clocked while deselected, any multiple block
+ *               read it is still in is stopped, and its status is read,
+ *               which clears its error flags.
+ * 
+ * Arguments   : void
+ * 
+ * Returns     : R1 Response of the SEND_STATUS command. OUT_OF_IDLE if the
+ *               card is responding.
+ *
+ * Notes       : Sent after a failed transfer, STOP_TRANSMISSION is expected
+ *               to be rejected as an illegal command. Its response is not
+ *               checked.
+ * ----------------------------------------------------------------------------
+ */
+uint8_t sd_Resync(void)
+{
+  uint8_t r1;                               // for R1 responses
+
+  // end any partial transfer with a few clocks while the card is deselected.
+  CS_SD_HIGH;
+  for (uint8_t byte = 0; byte < RESYNC_DMY_BYTES; ++byte)
+    sd_ReceiveByteSPI();
+
+  //
+  // stop any multiple block read the card is still in. The R1b response is
+  // preceded by a stuff byte and is followed by busy (0) bytes.
+  //
+  CS_SD_LOW;
+  sd_SendCommand(STOP_TRANSMISSION, 0);
+  sd_ReceiveByteSPI();
+  sd_GetR1();
+  pvt_WaitWhileBusy(SD_BUSY_STOP);
+  CS_SD_HIGH;
+
+  // the R2 response of SEND_STATUS is the R1 response and a status byte.
+  CS_SD_LOW;
+  sd_SendCommand(SEND_STATUS, 0);
+  r1 = sd_GetR1();
+  sd_ReceiveByteSPI();
+  CS_SD_HIGH;
+  return r1;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                   READ CSD/CID/SCR/SD STATUS
+ * 
+ * Description : Read the card's CSD (Card Specific Data), CID (Card
+ *               Identification) or SCR (SD Card Configuration) register, or
+ *               its SD Status.
+ * 
+ * Arguments   : regArr   - pointer to an array of length CSD_LEN, CID_LEN,
+ *                          SCR_LEN or SD_STATUS_LEN that will be loaded with
+ *                          the register, most significant byte first.
+ * 
+ * Returns     : Read Block Error (upper byte) and R1 Response (lower byte).
+ *
+ * Notes       : The registers are decoded by the functions of SD_SPI_INFO.H.
+ * ----------------------------------------------------------------------------
+ */
+uint16_t sd_ReadCSD(uint8_t regArr[])
+{
+  return pvt_ReadRegister(SEND_CSD, 0, 0, regArr, CSD_LEN);
+}
+
+uint16_t sd_ReadCID(uint8_t regArr[])
+{
+  return pvt_ReadRegister(SEND_CID, 0, 0, regArr, CID_LEN);
+}
+
+uint16_t sd_ReadSCR(uint8_t regArr[])
+{
+  return pvt_ReadRegister(SEND_SCR, 0, 1, regArr, SCR_LEN);
+}
+
+uint16_t sd_ReadSdStatus(uint8_t regArr[])
+{
+  return pvt_ReadRegister(SD_STATUS, 0, 1, regArr, SD_STATUS_LEN);
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                           READ GEN_CMD BLOCK
+ * 
+ * Description : Reads the data block the card sends for a GEN_CMD (CMD56)
+ *               read. The contents of the block, and the argument selecting
+ *               it, are defined by the card's manufacturer, e.g. some cards
+ *               report their wear and spare blocks this way.
+ * 
+ * Arguments   : arg       - argument of the command. Bit 0, which selects a
+ *                           read, is set by this function.
+ *               blckArr   - pointer to an array of length BLOCK_LEN that
+ *                           will be loaded with the block.
+ * 
+ * Returns     : Read Block Error (upper byte) and R1 Response (lower byte).
+ *               R1_ERROR with ILLEGAL_CMD if the card does not support it.
+ *
+ * Notes       : Only cards that support command class 8 (CCC_APP_SPEC of
+ *               SD_SPI_INFO.H) accept GEN_CMD.
+ * ----------------------------------------------------------------------------
+ */
+uint16_t sd_ReadGenCmd(uint32_t arg, uint8_t blckArr[])
+{
+  return pvt_ReadRegister(GEN_CMD, arg | GEN_CMD_RD, 0, blckArr, BLOCK_LEN);
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                 SET TIMEOUTS
+ * 
+ * Description : Sets the time limits of block reads and writes from the
+ *               card's CSD register. See Notes.
+ * 
+ * Arguments   : info   - pointer to an SdInfo instance set by sd_GetInfo.
+ * 
+ * Returns     : void
+ *
+ * Notes       : 1) For a version 1.0 CSD (SDSC), the read limit is 100 times
+ *                  the access time given by TAAC and NSAC, up to 100 ms, and
+ *                  the write limit is that times 2^R2W_FACTOR, up to 250 ms.
+ *               2) For later CSD versions, the limits are fixed at 100 ms
+ *                  and 250 ms, or 500 ms for SDXC cards.
+ *               3) NSAC is in SPI clock cycles, so the limits are set again
+ *                  each time the retry policy changes the SPI clock. This
+ *                  should be called after the SPI clock rate is changed, and
+ *                  it forgets the retry policy's steps down of the clock.
+ * ----------------------------------------------------------------------------
+ */
+void sd_SetTimeouts(const SdInfo *info)
+{
+  csdVsn    = info->csdVsn;
+  csdTaacNs = info->taacNs;
+  csdNsac   = info->nsac;
+  csdR2w    = info->r2wFactor;
+  csdIsXC   = info->numOfBlks > SDHC_BLKS_MAX;
+  csdValid  = 1;
+
+  // the clock was just set, e.g. by sd_SetMaxClock, so there are no steps
+  // down to undo.
+  stepDowns = 0;
+  okRun = 0;
+  pvt_SetLimits();
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                 GET TIMEOUTS
+ * 
+ * Description : Copies the time limits of block reads and writes.
+ * 
+ * Arguments   : tmo   - pointer to the SdTimeouts instance that will be set.
+ * 
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void sd_GetTimeouts(SdTimeouts *tmo)
+{
+  tmo->readMs  = readLimMs;
+  tmo->writeMs = busyLimMs[SD_BUSY_WRITE];
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                         GET RETRY STATISTICS
+ * 
+ * Description : Copies the statistics of the retry policy.
+ * 
+ * Arguments   : stats   - pointer to the SdRetryStats instance that will be
+ *                         set.
+ * 
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void sd_GetRetryStats(SdRetryStats *stats)
+{
+  *stats = retryStats;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                                 ERASE BLOCKS
+ * 
+ * Description : Erases the blocks between (and including) startBlckAddr and
+ *               endBlckAddr.
+ * 
+ * Arguments   : startBlckAddr   - address of the first block to be erased.
+ *               endBlckAddr     - address of the last block to be erased.
+ * 
+ * Returns     : Erase Block Error (upper byte) and R1 Response (lower byte).
+ * ----------------------------------------------------------------------------
+ */
+uint16_t sd_EraseBlocks(uint32_t startBlckAddr, uint32_t endBlckAddr)
+{
+  uint8_t r1;                               // for R1 responses
+  
+  // set Start Address for erase block
+  CS_SD_LOW;
+  sd_SendCommand(ERASE_WR_BLK_START_ADDR, startBlckAddr);
+  r1 = sd_GetR1();
+  CS_SD_HIGH;
+  if (r1 != OUT_OF_IDLE) 
+    return (SET_ERASE_START_ADDR_ERROR | R1_ERROR | r1);
+  
+  // set End Address for erase block
+  CS_SD_LOW;
+  sd_SendCommand(ERASE_WR_BLK_END_ADDR, endBlckAddr);
+  r1 = sd_GetR1();
+  CS_SD_HIGH;
+  if (r1 != OUT_OF_IDLE) 
+    return (SET_ERASE_END_ADDR_ERROR | R1_ERROR | r1);
+
+  // erase all blocks between, and including, start and end address
+  CS_SD_LOW;
+  sd_SendCommand(ERASE, 0);                 // arg = 0 for this command      
+  r1 = sd_GetR1 ();
+  if (r1 != OUT_OF_IDLE)
+  {
+    CS_SD_HIGH;
+    return (ERASE_ERROR | R1_ERROR | r1);
+  }
+
+  // wait for erase to finish. Busy (0) signal returned until erase completes.
+  if (pvt_WaitWhileBusy(SD_BUSY_ERASE) != DATA_WRITE_SUCCESS)
+  {
+    CS_SD_HIGH;
+    return (ERASE_BUSY_TIMEOUT | r1);
+  }
+
+  CS_SD_HIGH;
+  return ERASE_SUCCESSFUL;
+}
+
+/*
+ * If either of the three print error functions below show that the R1_ERROR 
+ * flag was set in the error response that was passed to it, then the error 
+ * response should also be passed to sd_PrintR1() from SD_SPI_BASE.H/C to read 
+ * the R1 Error.
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                             PRINT READ ERROR
+ * 
+ * Description : Print Read Error Flag returned by a SD card read function.  
+ * 
+ * Arguments   : err   - Read Error Response.
+ * 
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void sd_PrintReadError(uint16_t err)
+{
+  // 0xFF00 filters out the lower byte which is the R1 response
+  switch (err & 0xFF00)
+  {
+    case R1_ERROR:
+      print_Str("\n\r R1_ERROR");
+      break;
+    case READ_SUCCESS:
+      print_Str("\n\r READ_SUCCESS");
+      break;
+    case START_TOKEN_TIMEOUT:
+      print_Str("\n\r START_TOKEN_TIMEOUT");
+      break;
+    case DATA_ERROR_TKN_RECEIVED:
+      print_Str("\n\r DATA_ERROR_TKN_RECEIVED");
+      break;
+    default:
+      print_Str("\n\r UNKNOWN RESPONSE");
+  }
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            PRINT WRITE ERROR
+ * 
+ * Description : Print Write Error Flag returned by a SD card read function.  
+ * 
+ * Arguments   : err   - Write Error Response.
+ * 
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void sd_PrintWriteError(uint16_t err)
+{
+  // 0xFF00 filters out the lower byte which is the R1 response
+  switch(err & 0xFF00)
+  {
+    case DATA_WRITE_SUCCESS:
+      print_Str("\n\r DATA_WRITE_SUCCESS");
+      break;
+    case CRC_ERROR_TKN_RECEIVED:
+      print_Str("\n\r CRC_ERROR_TKN_RECEIVED");
+      break;
+    case WRITE_ERROR_TKN_RECEIVED:
+      print_Str("\n\r WRITE_ERROR_TKN_RECEIVED");
+      break;
+    case INVALID_DATA_RESPONSE:
+      print_Str("\n\r INVALID_DATA_RESPONSE");
+      break;
+    case DATA_RESPONSE_TIMEOUT:
+      print_Str("\n\r DATA_RESPONSE_TIMEOUT");
+      break;
+    case CARD_BUSY_TIMEOUT:
+      print_Str("\n\r CARD_BUSY_TIMEOUT");
+      break;
+    case R1_ERROR:
+      print_Str("\n\r R1_ERROR");
+      break;
+    default:
+      print_Str("\n\r UNKNOWN RESPONSE");
+  }
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                            PRINT ERASE ERROR
+ * 
+ * Description : Print Erase Error Flag returned by a SD card read function.  
+ * 
+ * Arguments   : err   - Erase Error Response.
+ * 
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+void sd_PrintEraseError(uint16_t err)
+{
+  // 0xFF00 filters out the lower byte which is the R1 response
+  switch(err & 0xFF00)
+  {
+    case ERASE_SUCCESSFUL:
+      print_Str("\n\r ERASE_SUCCESSFUL");
+      break;
     case SET_ERASE_START_ADDR_ERROR:
       print_Str("\n\r SET_ERASE_START_ADDR_ERROR");
       break;
@@ -413,3 +1049,430 @@ void sd_PrintEraseError(uint16_t err)
       print_Str("\n\r UNKNOWN RESPONSE");
   }
 }
+
+/*
+ ******************************************************************************
+ *                           "PRIVATE" FUNCTIONS
+ ******************************************************************************
+ */
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                  (PRIVATE) READ SINGLE BLOCK
+ * 
+ * Description : Makes a single attempt to read a data block. Called by
+ *               sd_ReadSingleBlock.
+ * 
+ * Arguments   : blckAddr   - address of the data block on the SD card.
+ *               blckArr    - pointer to the array to be loaded with the
+ *                            block. Must be length BLOCK_LEN.
+ * 
+ * Returns     : Read Block Error (upper byte) and R1 Response (lower byte).   
+ * ----------------------------------------------------------------------------
+ */
+static uint16_t pvt_ReadSingleBlock(uint32_t blckAddr, uint8_t blckArr[])
+{
+  uint8_t  r1;                              // for R1 responses
+  uint16_t err;
+
+  // request contents of a single data block at blckAddr on the SD card.
+  CS_SD_LOW;
+  sd_SendCommand(READ_SINGLE_BLOCK, blckAddr);
+  r1 = sd_GetR1();
+  if (r1 != OUT_OF_IDLE)
+  {
+    CS_SD_HIGH;
+    return (R1_ERROR | r1);
+  }
+
+  //
+  // loop until the 'Start Block Token' has been received from the SD card,
+  // which indicates data from requested blckAddr is about to be sent.
+  //
+  err = pvt_WaitStartTkn();
+  if (err != READ_SUCCESS)
+  {
+    CS_SD_HIGH;
+    return (err | r1);
+  }
+
+  // Load SD card block into the array.         
+  for (uint16_t byte = 0; byte < BLOCK_LEN; ++byte)
+    blckArr[byte] = sd_ReceiveByteSPI();
+
+  // Get 16-bit CRC. Don't need.
+  sd_ReceiveByteSPI();
+  sd_ReceiveByteSPI();
+  
+  // clear any remaining data from the SPDR
+  sd_ReceiveByteSPI();          
+
+  CS_SD_HIGH;
+  return (READ_SUCCESS | r1);
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                 (PRIVATE) WRITE SINGLE BLOCK
+ * 
+ * Description : Makes a single attempt to write a data block. Called by
+ *               sd_WriteSingleBlock.
+ * 
+ * Arguments   : blckAddr   - address of the data block on the SD card.
+ *               dataArr    - pointer to the array holding the data of the
+ *                            block. Must be length BLOCK_LEN.
+ * 
+ * Returns     : Write Block Error (upper byte) and R1 Response (lower byte).
+ * ----------------------------------------------------------------------------
+ */
+static uint16_t pvt_WriteSingleBlock(uint32_t blckAddr, 
+                                     const uint8_t dataArr[])
+{
+  uint8_t  r1;                              // for R1 response
+  uint16_t err;
+
+  // send the Write Single Block command to write data to blckAddr on SD card.
+  CS_SD_LOW;    
+  sd_SendCommand (WRITE_BLOCK, blckAddr);
+  if ((r1 = sd_GetR1()) != OUT_OF_IDLE)
+  {
+    CS_SD_HIGH;
+    return (R1_ERROR | r1);
+  }
+
+  // send Start Block Token (0xFE) and the data, and wait for the write.
+  err = pvt_SendDataBlock(START_BLOCK_TKN, dataArr);
+  if (err == DATA_WRITE_SUCCESS)
+    err = pvt_WaitWhileBusy(SD_BUSY_WRITE);
+  CS_SD_HIGH;
+  return (err | r1);
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                        (PRIVATE) RETRY AFTER
+ * 
+ * Description : Applies the retry policy to the result of an attempt to read
+ *               or write a block. See RETRY POLICY.
+ * 
+ * Arguments   : err         - the error response returned by the attempt.
+ *               okErr       - the error response of a successful attempt.
+ *               retryErrs   - the error flags (upper byte) that are retried.
+ *               busErrs     - the error flags (upper byte), of those, that
+ *                             count towards a step down of the SPI clock.
+ *               tries       - the number of times the block was retried.
+ * 
+ * Returns     : 1 if the block should be tried again, otherwise 0.
+ *
+ * Notes       : An R1 Response is only retried if the card did not respond,
+ *               or it received the command with a bad CRC. Both are bus
+ *               errors.
+ * ----------------------------------------------------------------------------
+ */
+static uint8_t pvt_RetryAfter(uint16_t err, uint16_t okErr, 
+                              uint16_t retryErrs, uint16_t busErrs,
+                              uint8_t tries)
+{
+  if (err == okErr)
+  {
+    failRun = 0;
+
+    // a clean run undoes a step down. The limits are set again for the clock.
+    if (tries == 0 && stepDowns && ++okRun >= SD_STEP_UP_OKS)
+    {
+      spi_SetClockDiv(spi_GetClockDiv() - 1);
+      ++retryStats.stepUpCnt;
+      --stepDowns;
+      okRun = 0;
+      pvt_SetLimits();
+    }
+    return 0;
+  }
+  ++retryStats.failCnt;
+  okRun = 0;
+
+  // only a failure that could come from a bad transfer on the bus is retried.
+  if (err & R1_ERROR)
+    retryErrs = busErrs = R1_TIMEOUT | COM_CRC_ERROR;
+  if (!(err & retryErrs))
+    return 0;
+
+  //
+  // bus errors in a row suggest the SPI clock is too fast for the card or
+  // the wiring. The time limits depend on the clock, so they are set again.
+  //
+  if ((err & busErrs) && ++failRun >= SD_STEP_DOWN_FAILS 
+      && spi_GetClockDiv() < SPI_CLK_DIV_128)
+  {
+    spi_SetClockDiv(spi_GetClockDiv() + 1);
+    ++retryStats.stepDownCnt;
+    ++stepDowns;
+    failRun = 0;
+    pvt_SetLimits();
+  }
+
+  if (tries >= SD_RETRY_MAX)
+    return 0;
+  ++retryStats.retryCnt;
+  return 1;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                         (PRIVATE) SET LIMITS
+ * 
+ * Description : Sets the time limits of block reads and writes from the CSD
+ *               members saved by sd_SetTimeouts, and the SPI clock rate. See
+ *               sd_SetTimeouts.
+ * 
+ * Arguments   : void
+ * 
+ * Returns     : void
+ * ----------------------------------------------------------------------------
+ */
+static void pvt_SetLimits(void)
+{
+  uint32_t accUs, limMs;
+
+  if (!csdValid)
+    return;
+
+  // the limits of CSD versions after 1.0 are fixed.
+  if (csdVsn != CSD_VSN_1)
+  {
+    readLimMs = READ_LIM_MS;
+    busyLimMs[SD_BUSY_WRITE] = csdIsXC ? SDXC_WRITE_LIM_MS : SDSC_WRITE_LIM_MS;
+    return;
+  }
+
+  // typical access time. NSAC is in units of 100 SPI clock cycles.
+  accUs = csdTaacNs / 1000 
+        + (uint32_t)csdNsac * 100 * (2U << spi_GetClockDiv()) 
+        / (F_CPU / 1000000);
+  
+  // 100 times the typical access time, rounded up to at least 1 ms.
+  limMs = (accUs * 100 + 999) / 1000;
+  if (limMs == 0)
+    limMs = 1;
+  readLimMs = (limMs < READ_LIM_MS) ? limMs : READ_LIM_MS;
+
+  // the write is R2W_FACTOR, as a power of 2, times slower than the read.
+  limMs <<= csdR2w;
+  busyLimMs[SD_BUSY_WRITE] = (limMs < SDSC_WRITE_LIM_MS) ? limMs 
+                                                        : SDSC_WRITE_LIM_MS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                               (PRIVATE) WAIT FOR START TOKEN
+ * 
+ * Description : Waits for the Start Block Token that precedes a data block
+ *               sent by the card, or the Data Error Token sent in its place.
+ * 
+ * Arguments   : void
+ * 
+ * Returns     : READ_SUCCESS if the Start Block Token was received,
+ *               DATA_ERROR_TKN_RECEIVED if a Data Error Token was, or
+ *               START_TOKEN_TIMEOUT if neither was received within the read
+ *               time limit.
+ *
+ * Notes       : The card must be selected, i.e. CS_SD_LOW.
+ * ----------------------------------------------------------------------------
+ */
+static uint16_t pvt_WaitStartTkn(void)
+{
+  uint32_t startMs = timer_GetMs();
+  uint8_t  tkn;
+
+  while ((tkn = sd_ReceiveByteSPI()) != START_BLOCK_TKN)
+  {
+    if (IS_DATA_ERROR_TKN(tkn))
+      return DATA_ERROR_TKN_RECEIVED;
+    if (timer_GetMs() - startMs > readLimMs)
+      return START_TOKEN_TIMEOUT;
+  }
+  return READ_SUCCESS;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                      (PRIVATE) READ REGISTER
+ * 
+ * Description : Reads a register the card sends as a data block, i.e. the
+ *               CSD, CID, SCR or SD Status, or the block of a GEN_CMD read.
+ * 
+ * Arguments   : cmd        - the command that requests the register.
+ *               arg        - argument of the command.
+ *               isAppCmd   - 1 if cmd is an ACMD, which is preceded by
+ *                            APP_CMD.
+ *               regArr     - pointer to the array that will be loaded with
+ *                            the register.
+ *               len        - length of the register in bytes.
+ * 
+ * Returns     : Read Block Error (upper byte) and R1 Response (lower byte).
+ * ----------------------------------------------------------------------------
+ */
+static uint16_t pvt_ReadRegister(uint8_t cmd, uint32_t arg, 
+                                 uint8_t isAppCmd, uint8_t regArr[], 
+                                 uint16_t len)
+{
+  uint8_t  r1;                              // for R1 responses
+  uint16_t err;
+
+  if (isAppCmd)
+  {
+    CS_SD_LOW;
+    sd_SendCommand(APP_CMD, 0);
+    r1 = sd_GetR1();
+    CS_SD_HIGH;
+    if (r1 != OUT_OF_IDLE)
+      return (R1_ERROR | r1);
+  }
+
+  CS_SD_LOW;
+  sd_SendCommand(cmd, arg);
+  r1 = sd_GetR1();
+  if (r1 != OUT_OF_IDLE)
+  {
+    CS_SD_HIGH;
+    return (R1_ERROR | r1);
+  }
+
+  // SD_STATUS responds with R2. Its 2nd byte, more card status, not needed.
+  if (isAppCmd && cmd == SD_STATUS)
+    sd_ReceiveByteSPI();
+
+  // the register is sent the same way as a data block.
+  err = pvt_WaitStartTkn();
+  if (err != READ_SUCCESS)
+  {
+    CS_SD_HIGH;
+    return (err | r1);
+  }
+  for (uint16_t byte = 0; byte < len; ++byte)
+    regArr[byte] = sd_ReceiveByteSPI();
+
+  // Get 16-bit CRC. Don't need.
+  sd_ReceiveByteSPI();
+  sd_ReceiveByteSPI();
+
+  // clear any remaining data from the SPDR
+  sd_ReceiveByteSPI();
+
+  CS_SD_HIGH;
+  return (READ_SUCCESS | r1);
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                    (PRIVATE) SEND DATA BLOCK
+ * 
+ * Description : Sends a block of data to the SD card, after a write command
+ *               has been accepted, and receives the card's data response.
+ * 
+ * Arguments   : startTkn   - Start Block Token to send before the data.
+ *               dataArr    - pointer to the array of data to send. Must be of
+ *                            length BLOCK_LEN.
+ * 
+ * Returns     : Write Block Error. DATA_WRITE_SUCCESS if the block was
+ *               accepted.
+ *
+ * Notes       : If the block was accepted the card is busy writing it. Call
+ *               pvt_WaitWhileBusy before sending anything else.
+ * ----------------------------------------------------------------------------
+ */
+static uint16_t pvt_SendDataBlock(uint8_t startTkn, const uint8_t dataArr[])
+{
+  uint8_t dataRespTkn = 0;
+
+  // send Start Block Token to initiate data transfer
+  sd_SendByteSPI(startTkn);
+
+  // send data to write to SD card.
+  for (uint16_t pos = 0; pos < BLOCK_LEN; ++pos) 
+    sd_SendByteSPI (dataArr[pos]);
+
+  // Send 16-bit CRC. CRC should be off (default), so these do not matter.
+  sd_SendByteSPI(DMY_TKN);
+  sd_SendByteSPI(DMY_TKN);
+  
+  // loop until valid data response token received or function exits on timeout
+  for (uint32_t startMs = timer_GetMs(); 
+       dataRespTkn != DATA_ACCEPTED_TKN
+       && dataRespTkn != CRC_ERROR_TKN 
+       && dataRespTkn != WRITE_ERROR_TKN;)
+  {
+    dataRespTkn = sd_ReceiveByteSPI() & DATA_RESPONSE_TKN_MASK;
+    if (timer_GetMs() - startMs > SD_CMD_TIMEOUT_MS)
+      return DATA_RESPONSE_TIMEOUT;
+  }
+  
+  //
+  // if SD card signals the data was accepted by returning the Data Accepted
+  // Token then the card will enter 'busy' state while it writes the data to 
+  // the block. The caller waits for it to finish.
+  //
+  if (dataRespTkn == DATA_ACCEPTED_TKN)
+    return DATA_WRITE_SUCCESS;
+  else if (dataRespTkn == CRC_ERROR_TKN) 
+    return CRC_ERROR_TKN_RECEIVED;
+  else if (dataRespTkn == WRITE_ERROR_TKN)
+    return WRITE_ERROR_TKN_RECEIVED;
+
+  return INVALID_DATA_RESPONSE;
+}
+
+/*
+ * ----------------------------------------------------------------------------
+ *                                                    (PRIVATE) WAIT WHILE BUSY
+ * 
+ * Description : Waits while the SD card is busy after an operation, calling
+ *               the busy yield function, if set, between each check, and
+ *               adds the wait to the busy statistics of the operation.
+ * 
+ * Arguments   : op   - the operation the card is busy after. See BUSY
+ *                      OPERATIONS.
+ * 
+ * Returns     : DATA_WRITE_SUCCESS, or CARD_BUSY_TIMEOUT if the card is still
+ *               busy after the busy timeout of the operation.
+ *
+ * Notes       : The card must be selected, i.e. CS_SD_LOW.
+ *
+ * Warnings    : The timeout is measured by the millisecond clock of
+ *               AVR_TIMER.H, so timer_Init must have been called and global
+ *               interrupts must be enabled.
+ * ----------------------------------------------------------------------------
+ */
+static uint16_t pvt_WaitWhileBusy(uint8_t op)
+{
+  SdBusyStats *stats = &busyStats[op];
+  uint32_t startMs = timer_GetMs();
+  uint16_t err = DATA_WRITE_SUCCESS;
+
+  // while busy, the card holds the DO line at 0.
+  ++stats->waitCnt;
+  while (sd_ReceiveByteSPI() == 0)
+  {
+    ++stats->pollCnt;
+    if (timer_GetMs() - startMs > busyLimMs[op])
+    {
+      ++stats->timeoutCnt;
+      err = CARD_BUSY_TIMEOUT;
+      break;
+    }
+
+    // the card keeps working while it is deselected.
+    if (busyYieldFn)
+    {
+      CS_SD_HIGH;
+      busyYieldFn(op, busyYieldArg);
+      CS_SD_LOW;
+    }
+  }
+
+  uint32_t busyMs = timer_GetMs() - startMs;
+  stats->totalMs += busyMs;
+  if (busyMs > stats->maxMs)
+    stats->maxMs = busyMs;
+  return err;
+}
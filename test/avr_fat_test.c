@@ -22,9 +22,29 @@
  *  (2) ls <FIELDS>   : List directory contents based on specified <FILTERs>.
  *  (3) open <FILE>   : Print contents of <FILE> to a screen.
  *  (4) pwd           : Print the current working directory to screen.
+ *  (5) sum <FILE>    : Print the CRC-32 of <FILE>. Pass /A before <FILE> to
+ *                      print its Adler-32 instead.
+ *  (6) info          : Print the SD card's capacity, speed and identity, and
+ *                      the number of sectors in the bad sector list.
+ *  (7) status        : Print the SD card's speed class, AU size and erase
+ *                      times from its SD Status.
+ *  (8) health <ARG>  : Print the block the SD card returns for a GEN_CMD
+ *                      read with the hex argument <ARG>.
+ *  (9) probe <FILE>  : Time a write of the first sectors of the scratch file
+ *                      <FILE> and print the write rate of this and every
+ *                      earlier probe.
+ * (10) rpc           : Serve the volume to a host program with the binary
+ *                      protocol of FAT_RPC.H, until the host ends it.
+ * (11) play <RATE>   : Play the file named after <RATE> as 8-bit samples,
+ *                      at <RATE> samples per second, on the PWM output OC2A,
+ *                      e.g. 'play 8000 SONG.RAW'. Then print the underruns
+ *                      and the least time that was left in the ring.
  * 
  * NOTES: 
- * (1)  The module only has READ capabilities.
+ * (1)  The module can overwrite the bytes of existing files, but cannot
+ *      create, extend or delete them. This shell only writes to the disk with
+ *      'probe', over the scratch file, with 'rpc', when the host writes to a
+ *      file, and to keep the bad sector list in a reserved sector.
  * (2)  Quotation marks should NOT surround file or directory names even if 
  *      a space exists in the name.
  * (3)  Directory and file name arguments are case sensitive.
@@ -49,23 +69,53 @@
  *       /LM : Print last modified date and time.
  *       /LA : Print last access date.
  *       /A  : ALL - prints all entries and all fields.
+ *       /P  : Print only the next LS_PAGE_ENTS entries. Each 'ls /P'
+ *             continues from where the last one stopped, until the end of
+ *             the directory. 'cd' starts the pages again.
  *
- * (10) Enter 'q' to exit the command-line. If the SD_CARD_READ_DATA macro is
+ * (10) 'sum' will only work for files that are in the cwd directory. The
+ *      CRC-32 matches that of zip and 'cksum -a crc32b'.
+ * (11) 'health' arguments and the block returned are defined by the card's
+ *      manufacturer. Cards that do not support GEN_CMD reject it.
+ * (12) 'probe' OVERWRITES <FILE>, which must already exist with at least
+ *      PROBE_SECS sectors. The rate is in KB/s (1000 bytes).
+ * (13) 'rpc' is for a host program, e.g. tools/fat_rpc.c, not a terminal.
+ *      The host sends "rpc\r" itself, then frames, and RPC_OP_EXIT returns
+ *      to the command line.
+ * (14) 'play' is for unsigned 8-bit mono files, e.g. the data of a WAV file
+ *      without its header. OC2A is pin PB4, which needs a low-pass filter
+ *      to a speaker. The ring holds PLAY_RING_SECS sectors, e.g. 256 ms at
+ *      8000 samples per second. It stops after PLAY_FAILS_MAX failed reads.
+ * (15) Enter 'q' to exit the command-line. If the SD_CARD_READ_DATA macro is
  *      set then there an SD Card raw data access section will also be entered.
  */
 
 #include <string.h>
+#include <stdlib.h>
 #include <avr/io.h>
+#include <avr/interrupt.h>
 #include "avr_usart.h"
+#include "avr_timer.h"
 #include "prints.h"
 #include "sd_spi_base.h"
+#include "sd_spi_info.h"
 #include "sd_spi_rwe.h"
 #include "fat_bpb.h"
 #include "fat.h"
 #include "fat_to_disk_if.h"
+#include "fat_sum.h"
+#include "fat_probe.h"
+#include "fat_warm.h"
+#include "fat_rpc.h"
+#include "fat_play.h"
 
 #define SD_CARD_INIT_ATTEMPTS_MAX      5  
 #define CMD_LINE_MAX_CHAR              100  // max num of chars of a cmd/arg
+#define BAD_LIST_RSVD_SECS_MIN         10   // reserved secs for the bad list
+#define PROBE_SECS                     64   // sectors written by 'probe'
+#define WARM_MS                        50   // time budget of the prewarm
+#define LS_PAGE_ENTS                   20   // entries printed by 'ls /P'
+#define PLAY_FAILS_MAX                 8    // failed reads before 'play' stops
 #define MAX_ARG_CNT                    10   // max num of CL arguments
 #define BACKSPACE                      127  // used for keyboard backspace here
 
@@ -83,15 +133,25 @@
 static uint32_t enterBlockNumber();          
 #endif // SD_CARD_READ_DATA          
 
+// file played by the 'play' command. It is drained by playTick from the
+// TIMER1 interrupt, so it is not on the stack of main.
+static FatPlay play;
+static void playTick(void);
+
 int main(void)
 {
   // Initializat usart and spi ports.
   usart_Init();
 
+  // millisecond clock used to flush the FAT sector cache by age.
+  timer_Init();
+  sei();
+
   //
   // SD card initialization
   //
   CTV ctv;          
+  SdInfo sdInfo;                            // card's CSD, CID and SCR
   uint32_t sdInitResp;
 
   // Loop will continue until SD card init succeeds or max attempts reached.
@@ -112,6 +172,16 @@ int main(void)
     else
     {   
       print_Str(": SD CARD INITIALIZATION SUCCESSFUL");
+
+      //
+      // run at the card's full speed. The SD driver slows the clock if
+      // transfers fail.
+      //
+      if (sd_GetInfo(&sdInfo) == READ_SUCCESS)
+      {
+        sd_SetMaxClock(&sdInfo);
+        sd_SetTimeouts(&sdInfo);
+      }
       break;
     }
   }
@@ -136,6 +206,20 @@ int main(void)
       fat_PrintErrorBPB(err);
     }
 
+    else
+    {
+      //
+      // Keep the bad sector list in the last sector of the volume's reserved
+      // region, if that is past the boot sector and FSInfo backups.
+      //
+      if (bpb.rsvdSecCnt >= BAD_LIST_RSVD_SECS_MIN)
+        FATtoDisk_OpenBadList(bpb.dataRegionFirstSector - 1
+                              - (uint32_t)bpb.numOfFats * bpb.fatSize32);
+
+      // read the root directory into the cache before the first command.
+      fat_Prewarm(NULL, 0, WARM_MS, &bpb);
+    }
+
     //
     // Create and set a FatDir instance. Members of this instance are used for
     // holding parameters of a FAT directory. This instance can be treated as
@@ -145,6 +229,14 @@ int main(void)
     FatDir cwd;
     fat_SetDirToRoot(&cwd, &bpb);
 
+    // where the next 'ls /P' continues listing cwd from.
+    FatDirCursor lsCur;
+    fat_InitDirCursor(&lsCur, &cwd);
+
+    // results of the 'probe' command, kept for the minimum and maximum rates.
+    FatProbe probe;
+    fat_ProbeInit(&probe, PROBE_SECS, 0);
+
     print_Str("\n\n\n\r");
     do
     {
@@ -154,6 +246,7 @@ int main(void)
       char argStr[CMD_LINE_MAX_CHAR];       // separate arg from inputStr
       uint8_t charCnt = 0;                  // number of chars in inputStr
       uint8_t fieldFlags = 0;               // fields printed with 'ls' cmd
+      uint8_t pageFlag = 0;                 // 1 if 'ls' prints one page
 
       // print cmd prompt to screen with cwd
       print_Str("\n\r");
@@ -215,6 +308,7 @@ int main(void)
           err = fat_SetDir(&cwd, argStr, &bpb);
           if (err != SUCCESS) 
             fat_PrintError (err);
+          fat_InitDirCursor(&lsCur, &cwd);
         }
         //
         // Command: "ls" (list dir contents)
@@ -249,6 +343,8 @@ int main(void)
                   fieldFlags |= FILE_SIZE;
             else if (strcmp (argStr, "/T" ) == 0) 
                   fieldFlags |= TYPE;
+            else if (strcmp (argStr, "/P" ) == 0) 
+                  pageFlag = 1;
             
             strcpy(argStr, ++argStrPtr);    // start argStr at next arg 
           }
@@ -272,9 +368,24 @@ int main(void)
           print_Str(" NAME");
           print_Str("\n\r");
 
-          err = fat_PrintDir(&cwd, fieldFlags, &bpb);
-          if (err != END_OF_DIRECTORY) 
-            fat_PrintError (err);
+          if (pageFlag)
+          {
+            err = fat_PrintDirPage(&lsCur, fieldFlags, LS_PAGE_ENTS, &bpb);
+            if (err == SUCCESS)
+              print_Str("\n\r (more - enter 'ls /P' again)");
+            else
+            {
+              if (err != END_OF_DIRECTORY)
+                fat_PrintError (err);
+              fat_InitDirCursor(&lsCur, &cwd);
+            }
+          }
+          else
+          {
+            err = fat_PrintDir(&cwd, fieldFlags, &bpb);
+            if (err != END_OF_DIRECTORY) 
+              fat_PrintError (err);
+          }
         }
        
         //
@@ -287,6 +398,35 @@ int main(void)
             fat_PrintError(err);
         }
         
+        //
+        // Command: "sum" (print checksum of file)
+        //
+        else if (!strcmp(cmdStr, "sum"))
+        {
+          uint8_t  algo = FAT_SUM_CRC32;
+          char    *fileStr = argStr;
+          uint32_t sum;
+          FatFile  file;
+
+          if (!strncmp(argStr, "/A ", 3))
+          {
+            algo = FAT_SUM_ADLER32;
+            fileStr += 3;
+          }
+
+          err = fat_OpenFile(&file, &cwd, fileStr, &bpb);
+          if (err == SUCCESS)
+            err = fat_Checksum(&file, algo, &sum, &bpb);
+          if (err != SUCCESS)
+            fat_PrintError(err);
+          else
+          {
+            print_Str(algo == FAT_SUM_CRC32 ? "\n\r CRC-32: 0x"
+                                            : "\n\r Adler-32: 0x");
+            print_Hex(sum);
+          }
+        }
+
         //
         // Command: "pwd" (print working directory)
         //
@@ -297,6 +437,172 @@ int main(void)
           print_Str (cwd.lnStr);
         }
 
+        //
+        // Command: "info" (print SD card info)
+        //
+        else if (!strcmp(cmdStr, "info"))
+        {
+          sd_PrintInfo(&sdInfo);
+          print_Str("\n\r BAD SECTORS     : ");
+          print_Dec(FATtoDisk_GetBadCount());
+        }
+
+        //
+        // Command: "status" (print SD card status)
+        //
+        else if (!strcmp(cmdStr, "status"))
+        {
+          SdStatus sdSts;
+          uint16_t sdErr = sd_GetStatus(&sdSts);
+
+          if (sdErr == READ_SUCCESS)
+            sd_PrintStatus(&sdSts);
+          else if (sdErr & R1_ERROR)
+            sd_PrintR1(sdErr);
+          else
+            sd_PrintReadError(sdErr);
+        }
+
+        //
+        // Command: "health" (print SD card GEN_CMD block)
+        //
+        else if (!strcmp(cmdStr, "health"))
+        {
+          uint8_t  blckArr[BLOCK_LEN];
+          uint16_t sdErr;
+
+          if (!(sdInfo.cmdClasses & CCC_APP_SPEC))
+            print_Str("\n\r GEN_CMD NOT SUPPORTED");
+          else if ((sdErr = sd_ReadGenCmd(strtoul(argStr, NULL, 16), 
+                                          blckArr)) == READ_SUCCESS)
+            sd_PrintSingleBlock(blckArr);
+          else if (sdErr & R1_ERROR)
+            sd_PrintR1(sdErr);
+          else
+            sd_PrintReadError(sdErr);
+        }
+
+        //
+        // Command: "probe" (time writes to a scratch file)
+        //
+        else if (!strcmp(cmdStr, "probe"))
+        {
+          FatFile file;
+
+          err = fat_OpenFile(&file, &cwd, argStr, &bpb);
+          if (err == SUCCESS)
+            err = fat_ProbeRun(&probe, &file, &bpb);
+          if (err != SUCCESS)
+            fat_PrintError(err);
+          else
+          {
+            print_Str("\n\r RATE (KB/s)     : ");
+            print_Dec(probe.lastRate);
+            print_Str("\n\r TIME (ms)       : ");
+            print_Dec(probe.lastMs);
+            print_Str("\n\r MAX SECTOR (ms) : ");
+            print_Dec(probe.lastSecMsMax);
+            print_Str("\n\r PROBES          : ");
+            print_Dec(probe.runCnt);
+            print_Str("\n\r MIN/MAX RATE    : ");
+            print_Dec(probe.minRate);
+            print_Str("/");
+            print_Dec(probe.maxRate);
+            print_Str("\n\r WORST SECTOR(ms): ");
+            print_Dec(probe.secMsMax);
+          }
+        }
+
+        //
+        // Command: "rpc" (binary protocol for a host program)
+        //
+        else if (!strcmp(cmdStr, "rpc"))
+        {
+          FatRpc rpc;
+
+          // requests the host sends while one is served wait in the buffer.
+          fat_RpcInit(&rpc, usart_Transmit);
+          usart_RxBufferOn();
+          err = STEP_BUSY;
+          do
+          {
+            if (usart_RxCount())
+              err = fat_RpcRxByte(&rpc, usart_Receive(), &bpb);
+            else
+              fat_RpcIdle(&rpc, &bpb);
+          }
+          while (err != RPC_EXIT);
+          usart_RxBufferOff();
+        }
+
+        //
+        // Command: "play" (play samples of a file at a constant rate)
+        //
+        else if (!strcmp(cmdStr, "play"))
+        {
+          char        *fileStr;
+          uint32_t     rate = strtoul(argStr, &fileStr, 10);
+          FatFile      file;
+          FatPlayStats stats;
+          uint8_t      fails = 0;
+
+          // the file's name follows the rate and a space.
+          if (*fileStr == ' ')
+            ++fileStr;
+
+          if (!rate)
+            print_Str("\n\r INVALID RATE");
+          else if ((err = fat_OpenFile(&file, &cwd, fileStr, &bpb)) != SUCCESS
+                   || (err = fat_PlayOpen(&play, &file, 1, rate, &bpb))
+                      != SUCCESS
+                   || (err = fat_PlayStart(&play, &bpb)) != SUCCESS)
+            fat_PrintError(err);
+          else
+          {
+            // fast PWM of TIMER2 on OC2A, at F_CPU / 256.
+            DDRB |= 1 << DDB4;
+            TCCR2A = 1 << COM2A1 | 1 << WGM21 | 1 << WGM20;
+            TCCR2B = 1 << CS20;
+            timer_SampleStart(rate, playTick);
+
+            // refill the ring until the last sector is in it, then let the
+            // interrupt play the rest. A sector that fails is read again by
+            // the next call, up to PLAY_FAILS_MAX times in all.
+            do
+            {
+              err = fat_PlayService(&play, &bpb);
+              if (err != SUCCESS && err != STEP_BUSY && err != END_OF_FILE
+                  && ++fails < PLAY_FAILS_MAX)
+                err = STEP_BUSY;
+            }
+            while (err == SUCCESS || err == STEP_BUSY);
+
+            // the last sector is never added after an error, so the play is
+            // stopped rather than waiting for it.
+            if (err != END_OF_FILE)
+              fat_PlayClose(&play);
+            while (fat_PlayIsPlaying(&play))
+              ;
+
+            timer_SampleStop();
+            TCCR2A = 0;
+            TCCR2B = 0;
+            fat_PlayClose(&play);
+            if (err != END_OF_FILE)
+              fat_PrintError(err);
+
+            fat_PlayGetStats(&play, &stats);
+            print_Str("\n\r SECTORS READ    : ");
+            print_Dec(stats.secsRead);
+            print_Str("\n\r RUNS            : ");
+            print_Dec(stats.runsFound);
+            print_Str("\n\r UNDERRUNS       : ");
+            print_Dec(stats.underrunCnt);
+            print_Str("\n\r MARGIN (ms)     : ");
+            print_Dec(stats.marginMs);
+          }
+        }
+
         //
         // Command: "q" (exit cmd-line)
         //
@@ -403,6 +709,18 @@ int main(void)
  ******************************************************************************
  */
 
+//
+// local function called by the TIMER1 interrupt while the 'play' command
+// runs. Outputs the next sample, or holds the last one if the ring is empty.
+//
+static void playTick(void)
+{
+  uint8_t sample;
+
+  if (fat_PlayDrain(&play, &sample) == SUCCESS)
+    OCR2A = sample;
+}
+
 #if SD_CARD_READ_DATA
 //
 // local function used by the SD_CARD_READ_BLOCK_DATA that gets and returns the
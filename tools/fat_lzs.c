@@ -0,0 +1,286 @@
+/*
+ * File       : FAT_LZS.C
+ * Version    : 2.0
+ * Target     : Host PC
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Host program that compresses a file into the format read by
+ * fat_ReadCompressed (see FAT_LZ.H), or decompresses one to check it.
+ *
+ * Build : gcc -O2 -I includes/fat -o fat_lzs tools/fat_lzs.c
+ * Usage : fat_lzs [-w windowBits] [-l lengthBits] [-d] inFile outFile
+ *
+ * windowBits (default 8) must not be larger than LZ_WIN_BITS_MAX of the AVR
+ * build that will read the file. lengthBits defaults to 4. -d decompresses.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fat_bpb.h"
+#include "fat.h"
+#include "fat_lz.h"
+
+/*
+ ******************************************************************************
+ *                                 BIT WRITER
+ ******************************************************************************
+ */
+
+typedef struct
+{
+  FILE   *fp;
+  uint8_t bitBuf;
+  uint8_t bitCnt;
+}
+BitWriter;
+
+// writes the bitLen low bits of val, most significant first.
+static void putBits(BitWriter *bw, uint32_t val, uint8_t bitLen)
+{
+  while (bitLen--)
+  {
+    bw->bitBuf = (bw->bitBuf << 1) | ((val >> bitLen) & 1);
+    if (++bw->bitCnt == 8)
+    {
+      fputc(bw->bitBuf, bw->fp);
+      bw->bitBuf = 0;
+      bw->bitCnt = 0;
+    }
+  }
+}
+
+static void flushBits(BitWriter *bw)
+{
+  if (bw->bitCnt)
+    fputc(bw->bitBuf << (8 - bw->bitCnt), bw->fp);
+}
+
+/*
+ ******************************************************************************
+ *                              COMPRESS / DECOMPRESS
+ ******************************************************************************
+ */
+
+//
+// match finder. Positions are added to hash chains of their 2-byte prefix in
+// order, and every position before 'added' is in a chain.
+//
+typedef struct
+{
+  const uint8_t *in;
+  uint32_t inLen;
+  uint32_t winLen;
+  uint32_t maxLen;
+  uint32_t added;
+  int32_t *head;
+  int32_t *prev;
+}
+Matcher;
+
+#define HASH(M, P)  (((M)->in[P] << 8) | (M)->in[(P) + 1])
+
+// returns the length of the longest match at pos, and sets *dist.
+static uint32_t findMatch(Matcher *m, uint32_t pos, uint32_t *dist)
+{
+  uint32_t best = 0;
+
+  for (; m->added < pos && m->added + 1 < m->inLen; ++m->added)
+  {
+    m->prev[m->added] = m->head[HASH(m, m->added)];
+    m->head[HASH(m, m->added)] = m->added;
+  }
+  if (pos + 1 >= m->inLen)
+    return 0;
+
+  for (int32_t cand = m->head[HASH(m, pos)];
+       cand >= 0 && pos - cand <= m->winLen; cand = m->prev[cand])
+  {
+    uint32_t len = 0;
+    while (len < m->maxLen && pos + len < m->inLen
+           && m->in[cand + len] == m->in[pos + len])
+      ++len;
+    if (len > best)
+    {
+      best = len;
+      *dist = pos - cand;
+      if (len == m->maxLen)
+        break;
+    }
+  }
+  return best;
+}
+
+// greedy LZSS, with a literal instead when the next byte has a longer match.
+static void compress(const uint8_t *in, uint32_t inLen, FILE *out,
+                     uint8_t winBits, uint8_t lenBits)
+{
+  Matcher m = { in, inLen, 1u << winBits, (1u << lenBits) - 1 + LZ_MIN_LEN,
+                0, malloc(65536 * sizeof(int32_t)),
+                malloc((inLen + 1) * sizeof(int32_t)) };
+  BitWriter bw = { out, 0, 0 };
+  uint8_t hdr[LZ_HDR_LEN];
+
+  memcpy(hdr, LZ_MAGIC, LZ_MAGIC_LEN);
+  hdr[LZ_WIN_BITS_POS] = winBits;
+  hdr[LZ_LEN_BITS_POS] = lenBits;
+  for (int i = 0; i < 4; ++i)
+    hdr[LZ_SIZE_POS + i] = inLen >> (8 * i);
+  fwrite(hdr, 1, LZ_HDR_LEN, out);
+
+  for (int i = 0; i < 65536; ++i)
+    m.head[i] = -1;
+
+  for (uint32_t pos = 0; pos < inLen; )
+  {
+    uint32_t dist = 0, nextDist;
+    uint32_t len = findMatch(&m, pos, &dist);
+
+    if (len >= LZ_MIN_LEN && findMatch(&m, pos + 1, &nextDist) > len)
+      len = 0;
+
+    if (len >= LZ_MIN_LEN)
+    {
+      putBits(&bw, 0, 1);
+      putBits(&bw, dist - 1, winBits);
+      putBits(&bw, len - LZ_MIN_LEN, lenBits);
+      pos += len;
+    }
+    else
+    {
+      putBits(&bw, 1, 1);
+      putBits(&bw, in[pos], 8);
+      ++pos;
+    }
+  }
+  flushBits(&bw);
+  free(m.head);
+  free(m.prev);
+}
+
+// reads the next bitLen bits of in, most significant first.
+static uint32_t getBits(const uint8_t *in, uint32_t *bitPos, uint8_t bitLen)
+{
+  uint32_t val = 0;
+  for (; bitLen; --bitLen, ++*bitPos)
+    val = (val << 1) | ((in[*bitPos / 8] >> (7 - *bitPos % 8)) & 1);
+  return val;
+}
+
+static int decompress(const uint8_t *in, uint32_t inLen, FILE *out)
+{
+  if (inLen < LZ_HDR_LEN || memcmp(in, LZ_MAGIC, LZ_MAGIC_LEN))
+    return 1;
+
+  uint8_t  winBits = in[LZ_WIN_BITS_POS];
+  uint8_t  lenBits = in[LZ_LEN_BITS_POS];
+  uint32_t outLen = 0;
+  for (int i = 3; i >= 0; --i)
+    outLen = (outLen << 8) | in[LZ_SIZE_POS + i];
+
+  uint8_t *buf = malloc(outLen + 1);
+  uint32_t bitPos = LZ_HDR_LEN * 8, outPos = 0;
+  int err = 0;
+
+  while (outPos < outLen)
+  {
+    if (bitPos >= inLen * 8)
+    {
+      err = 1;
+      break;
+    }
+    if (getBits(in, &bitPos, 1))
+      buf[outPos++] = getBits(in, &bitPos, 8);
+    else
+    {
+      uint32_t dist = getBits(in, &bitPos, winBits) + 1;
+      uint32_t len = getBits(in, &bitPos, lenBits) + LZ_MIN_LEN;
+      if (dist > outPos)
+      {
+        err = 1;
+        break;
+      }
+      for (; len && outPos < outLen; --len, ++outPos)
+        buf[outPos] = buf[outPos - dist];
+    }
+  }
+
+  if (!err)
+    fwrite(buf, 1, outLen, out);
+  free(buf);
+  return err;
+}
+
+/*
+ ******************************************************************************
+ *                                    MAIN
+ ******************************************************************************
+ */
+
+int main(int argc, char *argv[])
+{
+  uint8_t winBits = 8, lenBits = 4;
+  int decomp = 0, arg = 1;
+
+  for (; arg < argc && argv[arg][0] == '-'; ++arg)
+  {
+    if (!strcmp(argv[arg], "-d"))
+      decomp = 1;
+    else if (!strcmp(argv[arg], "-w") && arg + 1 < argc)
+      winBits = atoi(argv[++arg]);
+    else if (!strcmp(argv[arg], "-l") && arg + 1 < argc)
+      lenBits = atoi(argv[++arg]);
+    else
+      break;
+  }
+
+  if (argc - arg != 2 || winBits < 1 || winBits > 15
+      || lenBits < 1 || lenBits > LZ_LEN_BITS_MAX)
+  {
+    fprintf(stderr, "usage: %s [-w windowBits] [-l lengthBits] [-d] "
+                    "inFile outFile\n", argv[0]);
+    return 1;
+  }
+
+  FILE *inFp = fopen(argv[arg], "rb");
+  if (!inFp)
+  {
+    perror(argv[arg]);
+    return 1;
+  }
+  fseek(inFp, 0, SEEK_END);
+  uint32_t inLen = ftell(inFp);
+  fseek(inFp, 0, SEEK_SET);
+  uint8_t *in = calloc(inLen + 2, 1);     // + 2 for reads past the end
+  if (fread(in, 1, inLen, inFp) != inLen)
+  {
+    perror(argv[arg]);
+    return 1;
+  }
+  fclose(inFp);
+
+  FILE *outFp = fopen(argv[arg + 1], "wb");
+  if (!outFp)
+  {
+    perror(argv[arg + 1]);
+    return 1;
+  }
+
+  int err = 0;
+  if (decomp)
+  {
+    if ((err = decompress(in, inLen, outFp)))
+      fprintf(stderr, "%s: not a valid compressed file\n", argv[arg]);
+  }
+  else
+  {
+    compress(in, inLen, outFp, winBits, lenBits);
+    fprintf(stderr, "%u -> %ld bytes\n", inLen, ftell(outFp));
+  }
+  fclose(outFp);
+  free(in);
+  return err;
+}
@@ -0,0 +1,186 @@
+/*
+ * File       : FAT_RPC.C
+ * Version    : 2.0
+ * Target     : Host PC
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Host program that drives the 'rpc' command of the test shell, with the
+ * binary protocol of FAT_RPC.H, over a serial port.
+ *
+ * Build : gcc -O2 -I includes/fat -o fat_rpc tools/fat_rpc.c tools/rpc_client.c
+ * Usage : fat_rpc [-b baud] [-n] port ls [dirPath]
+ *         fat_rpc [-b baud] [-n] port stat path
+ *         fat_rpc [-b baud] [-n] port get filePath outFile
+ *         fat_rpc [-b baud] [-n] port put filePath inFile [pos]
+ *         fat_rpc [-b baud] [-n] port sum [-a] filePath
+ *
+ * Paths are from the root directory, e.g. "logs/LOG0001.TXT". baud defaults
+ * to 9600, the BAUD of AVR_USART.H. -n does not send the 'rpc' command, for
+ * a server that is already running. 'put' overwrites bytes of an existing
+ * file, from pos, and cannot extend it. 'sum' prints the CRC-32, or the
+ * Adler-32 with -a.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "fat_bpb.h"
+#include "fat.h"
+#include "fat_rpc.h"
+#include "fat_sum.h"
+#include "rpc_client.h"
+
+static void printEntry(const RpcStat *st, void *arg)
+{
+  uint16_t date = DATE_OF(st->writeDateTime);
+  uint16_t time = TIME_OF(st->writeDateTime);
+
+  (void)arg;
+  printf("%04u-%02u-%02u %02u:%02u  ", YEAR_CALC(date), MONTH_CALC(date),
+         DAY_CALC(date), HOUR_CALC(time), MIN_CALC(time));
+  if (st->attr & DIR_ENTRY_ATTR)
+    printf("%10s  %s/\n", "<DIR>", st->lnStr);
+  else
+    printf("%10u  %s\n", st->fileSize, st->lnStr);
+}
+
+static int report(const char *whatStr, int sts)
+{
+  if (sts < 0)
+    perror(whatStr);
+  else
+    fprintf(stderr, "%s: status 0x%02X\n", whatStr, sts);
+  return 1;
+}
+
+int main(int argc, char *argv[])
+{
+  long        baud = 9600;
+  int         startCmd = 1, arg = 1, ret = 0, sts;
+  RpcClient  *cl;
+  RpcStat     st;
+  const char *cmdStr;
+
+  for (; arg < argc && argv[arg][0] == '-'; ++arg)
+  {
+    if (!strcmp(argv[arg], "-n"))
+      startCmd = 0;
+    else if (!strcmp(argv[arg], "-b") && arg + 1 < argc)
+      baud = atol(argv[++arg]);
+    else
+      break;
+  }
+  if (argc - arg < 2)
+  {
+    fprintf(stderr, "usage: %s [-b baud] [-n] port "
+                    "ls|stat|get|put|sum [args]\n", argv[0]);
+    return 1;
+  }
+
+  // the client holds its frames, so it is too large for the stack.
+  cl = malloc(sizeof(*cl));
+  if (!cl || rpc_Open(cl, argv[arg], baud, startCmd))
+  {
+    perror(argv[arg]);
+    return 1;
+  }
+  cmdStr = argv[arg + 1];
+  arg += 2;
+
+  if (!strcmp(cmdStr, "ls"))
+  {
+    sts = rpc_List(cl, arg < argc ? argv[arg] : "", printEntry, NULL);
+    if (sts != END_OF_DIRECTORY)
+      ret = report("ls", sts);
+  }
+  else if (!strcmp(cmdStr, "stat") && arg < argc)
+  {
+    if ((sts = rpc_Stat(cl, argv[arg], &st)) != SUCCESS)
+      ret = report(argv[arg], sts);
+    else
+      printf("attr 0x%02X  size %u  created 0x%08X  modified 0x%08X\n",
+             st.attr, st.fileSize, st.createDateTime, st.writeDateTime);
+  }
+  else if (!strcmp(cmdStr, "get") && arg + 1 < argc)
+  {
+    uint8_t *dataArr = NULL;
+    FILE    *outFp;
+    clock_t  start = clock();
+    long     ms;
+
+    if ((sts = rpc_Stat(cl, argv[arg], &st)) == SUCCESS)
+    {
+      dataArr = malloc(st.fileSize + 1);
+      sts = rpc_ReadFile(cl, st.refArr, 0, st.fileSize, dataArr);
+    }
+    if (sts != SUCCESS)
+      ret = report(argv[arg], sts);
+    else if (!(outFp = fopen(argv[arg + 1], "wb")))
+      ret = report(argv[arg + 1], -1);
+    else
+    {
+      fwrite(dataArr, 1, st.fileSize, outFp);
+      fclose(outFp);
+      ms = (clock() - start) * 1000 / CLOCKS_PER_SEC;
+      fprintf(stderr, "%u bytes, %lu frames resent, %ld ms cpu\n",
+              st.fileSize, cl->resendCnt, ms);
+    }
+    free(dataArr);
+  }
+  else if (!strcmp(cmdStr, "put") && arg + 1 < argc)
+  {
+    uint32_t pos = arg + 2 < argc ? strtoul(argv[arg + 2], NULL, 0) : 0;
+    FILE    *inFp = fopen(argv[arg + 1], "rb");
+    uint8_t *dataArr;
+    long     len;
+
+    if (!inFp)
+      ret = report(argv[arg + 1], -1);
+    else
+    {
+      fseek(inFp, 0, SEEK_END);
+      len = ftell(inFp);
+      fseek(inFp, 0, SEEK_SET);
+      dataArr = malloc(len + 1);
+      if (fread(dataArr, 1, len, inFp) != (size_t)len)
+        ret = report(argv[arg + 1], -1);
+      else if ((sts = rpc_Stat(cl, argv[arg], &st)) != SUCCESS
+               || (sts = rpc_WriteFile(cl, st.refArr, pos, len, dataArr))
+                  != SUCCESS
+               || (sts = rpc_Sync(cl)) != SUCCESS)
+        ret = report(argv[arg], sts);
+      fclose(inFp);
+      free(dataArr);
+    }
+  }
+  else if (!strcmp(cmdStr, "sum") && arg < argc)
+  {
+    uint8_t  algo = FAT_SUM_CRC32;
+    uint32_t sum;
+
+    if (!strcmp(argv[arg], "-a") && arg + 1 < argc)
+    {
+      algo = FAT_SUM_ADLER32;
+      ++arg;
+    }
+    if ((sts = rpc_Stat(cl, argv[arg], &st)) != SUCCESS
+        || (sts = rpc_Sum(cl, st.refArr, algo, &sum)) != SUCCESS)
+      ret = report(argv[arg], sts);
+    else
+      printf("%s: 0x%08X\n", algo == FAT_SUM_CRC32 ? "CRC-32" : "Adler-32",
+             sum);
+  }
+  else
+  {
+    fprintf(stderr, "%s: unknown command or missing argument\n", cmdStr);
+    ret = 1;
+  }
+
+  rpc_Close(cl);
+  free(cl);
+  return ret;
+}
@@ -0,0 +1,142 @@
+#!/bin/bash
+#
+# Tests tools/fat_rpc, and the RPC server of FAT_RPC.C, on the host. The
+# server is built with tools/rpc_loopback.c, which runs it on a FAT32 image
+# behind a pty, and each fat_rpc command is checked against the files the
+# image was made from. The checks are run on a clean link, and on one that
+# flips a bit of every CORRUPT_NTH byte in each direction.
+#
+# Run from the top of the repository. Exits with the number of failed checks.
+#
+
+#directory to store build files, images and test data
+buildDir=../untracked/loopback
+
+#every n-th byte of the link is corrupted in the second pass
+CORRUPT_NTH=997
+
+mkdir -p -v $buildDir
+
+Host=(gcc -O2 -I "includes/fat" -I "includes/hlpr" -o)
+
+echo -e ">> BUILD: "${Host[@]}" "$buildDir"/rpc_loopback tools/rpc_loopback.c source/fat/*.c"
+"${Host[@]}" $buildDir/rpc_loopback tools/rpc_loopback.c $(ls source/fat/*.c | grep -v fat_to_sd.c)
+status=$?
+if [ $status -gt 0 ]
+then
+    echo -e "error building RPC_LOOPBACK.C"
+    exit $status
+fi
+
+echo -e ">> BUILD: "${Host[@]}" "$buildDir"/fat_rpc tools/fat_rpc.c tools/rpc_client.c"
+"${Host[@]}" $buildDir/fat_rpc tools/fat_rpc.c tools/rpc_client.c
+status=$?
+if [ $status -gt 0 ]
+then
+    echo -e "error building FAT_RPC.C"
+    exit $status
+fi
+
+#
+# test files. FRAG.BIN spans many clusters, none of them consecutive in the
+# image, CONT.BIN ends part way through a sector, and E.BIN is empty.
+#
+head -c 100000 /dev/urandom > $buildDir/FRAG.BIN
+head -c 30001 /dev/urandom > $buildDir/CONT.BIN
+: > $buildDir/E.BIN
+head -c 20000 /dev/urandom > $buildDir/put.bin
+
+echo -e ">> MAKE IMAGE: "$buildDir"/loopback.img"
+$buildDir/rpc_loopback -m $buildDir/loopback.img \
+    $buildDir/FRAG.BIN $buildDir/CONT.BIN $buildDir/E.BIN || exit 1
+
+fails=0
+
+# runs a server with the corruption of $1, and fat_rpc on it with the rest.
+run()
+{
+    local corrupt=$1 pty srv sts
+    shift
+    rm -f $buildDir/pty.txt
+    $buildDir/rpc_loopback -c $corrupt $buildDir/loopback.img \
+        > $buildDir/pty.txt 2>> $buildDir/server.log &
+    srv=$!
+    while [ ! -s $buildDir/pty.txt ] && kill -0 $srv 2> /dev/null
+    do
+        sleep 0.05
+    done
+    timeout 120 $buildDir/fat_rpc -n $(head -n 1 $buildDir/pty.txt) "$@"
+    sts=$?
+    # the server only exits by itself once the client's exit request arrives.
+    if ! timeout 5 tail --pid=$srv -f /dev/null
+    then
+        kill $srv 2> /dev/null
+    fi
+    wait $srv 2> /dev/null
+    return $sts
+}
+
+check()
+{
+    if [ $2 -eq 0 ]
+    then
+        echo -e "   ok      : $1"
+    else
+        echo -e "   FAILED  : $1"
+        fails=$((fails + 1))
+    fi
+}
+
+# CRC-32 of a file, from the trailer gzip writes after the data.
+crc32()
+{
+    gzip -c "$1" | tail -c 8 | od -A n -t x4 -N 4 | tr -d ' '
+}
+
+adler32()
+{
+    od -A n -v -t u1 "$1" | awk 'BEGIN { a = 1 } { for (i = 1; i <= NF; ++i)
+        { a = (a + $i) % 65521; b = (b + a) % 65521 } }
+        END { printf "%08x\n", b * 65536 + a }'
+}
+
+for corrupt in 0 $CORRUPT_NTH
+do
+    echo -e "\n\r>> LINK: corrupt every byte "$corrupt" (0 is none)"
+
+    run $corrupt ls > $buildDir/ls.txt
+    check "ls" $?
+    for name in FRAG.BIN CONT.BIN E.BIN
+    do
+        grep -q " $name\$" $buildDir/ls.txt
+        check "ls lists $name" $?
+
+        run $corrupt get $name $buildDir/get.bin \
+            && cmp -s $buildDir/get.bin $buildDir/$name
+        check "get $name" $?
+
+        sum=$(run $corrupt sum $name)
+        [ "${sum##*0x}" == "$(crc32 $buildDir/$name | tr a-f A-F)" ]
+        check "sum $name" $?
+
+        sum=$(run $corrupt sum -a $name)
+        [ "${sum##*0x}" == "$(adler32 $buildDir/$name | tr a-f A-F)" ]
+        check "sum -a $name" $?
+    done
+
+    # overwrite the middle of FRAG.BIN, and of the reference copy.
+    run $corrupt put FRAG.BIN $buildDir/put.bin 50000
+    check "put FRAG.BIN" $?
+    dd if=$buildDir/put.bin of=$buildDir/FRAG.BIN bs=1 seek=50000 \
+       conv=notrunc status=none
+    run $corrupt get FRAG.BIN $buildDir/get.bin \
+        && cmp -s $buildDir/get.bin $buildDir/FRAG.BIN
+    check "get FRAG.BIN after put" $?
+
+    run $corrupt stat NOPE.BIN 2> /dev/null
+    [ $? -ne 0 ]
+    check "stat of a missing file fails" $?
+done
+
+echo -e "\n\r>> "$fails" checks failed"
+exit $fails
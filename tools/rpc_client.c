@@ -0,0 +1,556 @@
+/*
+ * File       : RPC_CLIENT.C
+ * Version    : 2.0
+ * Target     : Host PC
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Implementation of RPC_CLIENT.H, for POSIX hosts.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "fat_bpb.h"
+#include "fat.h"
+#include "fat_rpc.h"
+#include "rpc_client.h"
+
+/*
+ ******************************************************************************
+ *                                  HELPERS
+ ******************************************************************************
+ */
+
+// CRC-16/CCITT-FALSE, as pvt_Crc16 of FAT_RPC.C.
+static uint16_t crc16(const uint8_t *byteArr, size_t len)
+{
+  uint16_t crc = 0xFFFF;
+
+  while (len--)
+  {
+    crc ^= (uint16_t)*byteArr++ << 8;
+    for (int bit = 0; bit < 8; ++bit)
+      crc = crc & 0x8000 ? crc << 1 ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+static void storeLE(uint8_t *byteArr, uint32_t val, int len)
+{
+  for (int byte = 0; byte < len; ++byte, val >>= 8)
+    byteArr[byte] = val;
+}
+
+static long nowMs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000L + ts.tv_nsec / 1000000;
+}
+
+static int writeAll(int fd, const uint8_t *byteArr, size_t len)
+{
+  while (len)
+  {
+    ssize_t cnt = write(fd, byteArr, len);
+
+    if (cnt < 0 && errno != EINTR && errno != EAGAIN)
+      return -1;
+    if (cnt > 0)
+    {
+      byteArr += cnt;
+      len -= cnt;
+    }
+  }
+  return 0;
+}
+
+static speed_t baudToSpeed(long baud)
+{
+  switch (baud)
+  {
+    case 9600:   return B9600;
+    case 19200:  return B19200;
+    case 38400:  return B38400;
+    case 57600:  return B57600;
+    case 115200: return B115200;
+    default:     return 0;
+  }
+}
+
+//
+// takes the first good response frame out of rxArr. Bytes before it, and
+// frames with a bad CRC, are dropped. Returns 1 if one was found, with its
+// sequence number in seq.
+//
+static int takeFrame(RpcClient *cl, RpcResp *resp, uint8_t *seq)
+{
+  size_t pos = 0;
+  int    found = 0;
+
+  while (pos < cl->rxLen)
+  {
+    uint8_t *frameArr = &cl->rxArr[pos];
+    size_t   left = cl->rxLen - pos;
+    uint16_t len;
+
+    if (frameArr[0] != RPC_SOF)
+    {
+      ++pos;
+      continue;
+    }
+    if (left < RPC_HDR_LEN)
+      break;
+
+    // every response has a status, so a length of 0 is a lost RPC_SOF.
+    len = LOAD_LE16(&frameArr[3]);
+    if (len == 0 || len > RPC_PAYLOAD_MAX || !(frameArr[2] & RPC_RESP))
+    {
+      ++pos;
+      continue;
+    }
+    if (left < (size_t)RPC_HDR_LEN + len + RPC_CRC_LEN)
+      break;
+    if (crc16(&frameArr[1], RPC_HDR_LEN - 1 + len)
+        != LOAD_LE16(&frameArr[RPC_HDR_LEN + len]))
+    {
+      ++cl->badCnt;
+      ++pos;
+      continue;
+    }
+
+    *seq = frameArr[1];
+    resp->op = frameArr[2] & ~RPC_RESP;
+    resp->sts = frameArr[RPC_HDR_LEN];
+    resp->len = len - 1;
+    memcpy(resp->payArr, &frameArr[RPC_HDR_LEN + 1], len - 1);
+    pos += RPC_HDR_LEN + len + RPC_CRC_LEN;
+    found = 1;
+    break;
+  }
+
+  memmove(cl->rxArr, &cl->rxArr[pos], cl->rxLen - pos);
+  cl->rxLen -= pos;
+  return found;
+}
+
+// waits for every request in flight, so the next op starts with none.
+static void drain(RpcClient *cl)
+{
+  RpcResp resp;
+
+  while (cl->reqCnt && rpc_Recv(cl, &resp) == 0)
+    ;
+}
+
+/*
+ ******************************************************************************
+ *                                 FUNCTIONS
+ ******************************************************************************
+ */
+
+int rpc_Open(RpcClient *cl, const char devStr[], long baud, int startCmd)
+{
+  RpcResp resp;
+
+  memset(cl, 0, sizeof(*cl));
+  if ((cl->fd = open(devStr, O_RDWR | O_NOCTTY)) < 0)
+    return -1;
+
+  if (isatty(cl->fd))
+  {
+    struct termios tio;
+    speed_t speed = baudToSpeed(baud);
+
+    if (!speed || tcgetattr(cl->fd, &tio))
+    {
+      fprintf(stderr, "%s: cannot set %ld baud\n", devStr, baud);
+      close(cl->fd);
+      return -1;
+    }
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    tcsetattr(cl->fd, TCSANOW, &tio);
+    tcflush(cl->fd, TCIOFLUSH);
+  }
+
+  // the window is not known until the server answers, so HELLO goes alone.
+  cl->payloadMax = RPC_PAYLOAD_MAX;
+  cl->windowBytes = 0;
+  if (startCmd)
+  {
+    // the shell echoes the command, which is dropped as it has no frame.
+    // Frames are only sent once the shell has had time to start the server.
+    if (writeAll(cl->fd, (const uint8_t *)"rpc\r", 4))
+    {
+      close(cl->fd);
+      return -1;
+    }
+    usleep(100 * 1000L);
+  }
+  if (rpc_Call(cl, RPC_OP_HELLO, NULL, 0, &resp))
+  {
+    close(cl->fd);
+    return -1;
+  }
+  if (resp.sts != SUCCESS || resp.len < 5 || resp.payArr[0] != RPC_VERSION)
+  {
+    fprintf(stderr, "%s: server is not RPC version %d\n", devStr,
+            RPC_VERSION);
+    close(cl->fd);
+    return -1;
+  }
+  cl->payloadMax = LOAD_LE16(&resp.payArr[1]);
+  cl->windowBytes = LOAD_LE16(&resp.payArr[3]);
+  if (cl->payloadMax > RPC_PAYLOAD_MAX)
+    cl->payloadMax = RPC_PAYLOAD_MAX;
+  return 0;
+}
+
+void rpc_Close(RpcClient *cl)
+{
+  RpcResp resp;
+
+  drain(cl);
+  rpc_Call(cl, RPC_OP_EXIT, NULL, 0, &resp);
+  close(cl->fd);
+}
+
+int rpc_CanSend(const RpcClient *cl, uint16_t len)
+{
+  // a request larger than the window can still be sent on its own.
+  if (cl->reqCnt == 0)
+    return 1;
+  return cl->reqCnt < RPC_DEPTH_MAX
+         && cl->reqBytes + RPC_HDR_LEN + len + RPC_CRC_LEN <= cl->windowBytes;
+}
+
+int rpc_Send(RpcClient *cl, uint8_t op, const uint8_t payArr[], uint16_t len,
+             uint32_t tag)
+{
+  RpcReq *req = &cl->reqArr[cl->reqCnt];
+  uint16_t crc;
+
+  if (cl->reqCnt == RPC_DEPTH_MAX || len > cl->payloadMax)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  // a request waiting to be sent again can stay in flight while the
+  // sequence numbers wrap, so a number in flight is not used twice.
+  for (int i = 0; i < cl->reqCnt; ++i)
+    if (cl->reqArr[i].seq == cl->nextSeq)
+    {
+      ++cl->nextSeq;
+      i = -1;
+    }
+  req->seq = cl->nextSeq++;
+  req->tag = tag;
+  req->frameLen = RPC_HDR_LEN + len + RPC_CRC_LEN;
+  req->frameArr[0] = RPC_SOF;
+  req->frameArr[1] = req->seq;
+  req->frameArr[2] = op;
+  storeLE(&req->frameArr[3], len, 2);
+  if (len)
+    memcpy(&req->frameArr[RPC_HDR_LEN], payArr, len);
+  crc = crc16(&req->frameArr[1], RPC_HDR_LEN - 1 + len);
+  storeLE(&req->frameArr[RPC_HDR_LEN + len], crc, 2);
+
+  ++cl->reqCnt;
+  cl->reqBytes += req->frameLen;
+  return writeAll(cl->fd, req->frameArr, req->frameLen);
+}
+
+int rpc_Recv(RpcClient *cl, RpcResp *resp)
+{
+  long deadline = nowMs() + RPC_TIMEOUT_MS;
+  int  resends = 0;
+
+  if (cl->reqCnt == 0)
+  {
+    errno = EINVAL;
+    return -1;
+  }
+
+  for (;;)
+  {
+    uint8_t       seq;
+    struct pollfd pfd = { cl->fd, POLLIN, 0 };
+    long          waitMs;
+
+    while (takeFrame(cl, resp, &seq))
+    {
+      // a response to a request sent twice arrives twice. Only the first
+      // is used.
+      for (int i = 0; i < cl->reqCnt; ++i)
+        if (cl->reqArr[i].seq == seq
+            && cl->reqArr[i].frameArr[2] == resp->op)
+        {
+          resp->tag = cl->reqArr[i].tag;
+          cl->reqBytes -= cl->reqArr[i].frameLen;
+          memmove(&cl->reqArr[i], &cl->reqArr[i + 1],
+                  (cl->reqCnt - i - 1) * sizeof(RpcReq));
+          --cl->reqCnt;
+          return 0;
+        }
+    }
+
+    waitMs = deadline - nowMs();
+    if (waitMs > 0 && poll(&pfd, 1, waitMs) > 0)
+    {
+      ssize_t cnt = read(cl->fd, &cl->rxArr[cl->rxLen],
+                         RPC_RX_BUF_LEN - cl->rxLen);
+
+      if (cnt < 0 && errno != EINTR && errno != EAGAIN)
+        return -1;
+      if (cnt > 0)
+        cl->rxLen += cnt;
+      continue;
+    }
+    if (waitMs > 0)
+      continue;
+
+    // no response in time. Every request in flight is sent again, in order,
+    // as the server drops a frame it did not receive whole.
+    if (++resends > RPC_RETRY_MAX)
+    {
+      fprintf(stderr, "rpc: no response from the server\n");
+      errno = ETIMEDOUT;
+      return -1;
+    }
+    for (int i = 0; i < cl->reqCnt; ++i)
+    {
+      if (writeAll(cl->fd, cl->reqArr[i].frameArr, cl->reqArr[i].frameLen))
+        return -1;
+      ++cl->resendCnt;
+    }
+    deadline = nowMs() + RPC_TIMEOUT_MS;
+  }
+}
+
+int rpc_Call(RpcClient *cl, uint8_t op, const uint8_t payArr[], uint16_t len,
+             RpcResp *resp)
+{
+  if (cl->reqCnt)
+  {
+    errno = EBUSY;
+    return -1;
+  }
+  if (rpc_Send(cl, op, payArr, len, 0))
+    return -1;
+  return rpc_Recv(cl, resp);
+}
+
+/*
+ ******************************************************************************
+ *                                    OPS
+ ******************************************************************************
+ */
+
+int rpc_Stat(RpcClient *cl, const char pathStr[], RpcStat *st)
+{
+  RpcResp     resp;
+  const char *nameStr = strrchr(pathStr, '/');
+  size_t      len = strlen(pathStr);
+
+  if (len > cl->payloadMax)
+    return INVALID_NAME;
+  if (rpc_Call(cl, RPC_OP_STAT, (const uint8_t *)pathStr, len, &resp))
+    return -1;
+  if (resp.sts != SUCCESS)
+    return resp.sts;
+
+  st->attr = resp.payArr[0];
+  st->fileSize = LOAD_LE32(&resp.payArr[1]);
+  st->createDateTime = LOAD_LE32(&resp.payArr[5]);
+  st->writeDateTime = LOAD_LE32(&resp.payArr[9]);
+  memcpy(st->refArr, &resp.payArr[15], ENTRY_REF_LEN);
+  snprintf(st->lnStr, sizeof(st->lnStr), "%s",
+           nameStr ? nameStr + 1 : pathStr);
+  return SUCCESS;
+}
+
+int rpc_List(RpcClient *cl, const char pathStr[],
+             void (*entFn)(const RpcStat *st, void *arg), void *arg)
+{
+  uint8_t reqArr[RPC_PAYLOAD_MAX];
+  size_t  pathLen = strlen(pathStr);
+  RpcResp resp;
+
+  if (DIR_CURSOR_LEN + 1 + pathLen > cl->payloadMax)
+    return INVALID_NAME;
+
+  // the first page has a cursor of zeros and the path. The next pages only
+  // need the cursor.
+  memset(reqArr, 0, DIR_CURSOR_LEN);
+  reqArr[DIR_CURSOR_LEN] = 0xFF;
+  memcpy(&reqArr[DIR_CURSOR_LEN + 1], pathStr, pathLen);
+  if (rpc_Call(cl, RPC_OP_LIST, reqArr, DIR_CURSOR_LEN + 1 + pathLen, &resp))
+    return -1;
+
+  for (;;)
+  {
+    uint16_t pos = DIR_CURSOR_LEN + 1;
+
+    if (resp.sts != SUCCESS && resp.sts != END_OF_DIRECTORY)
+      return resp.sts;
+
+    for (uint8_t ent = 0; ent < resp.payArr[DIR_CURSOR_LEN]; ++ent)
+    {
+      RpcStat  st;
+      uint8_t  lnLen = resp.payArr[pos + 9 + ENTRY_REF_LEN];
+
+      st.attr = resp.payArr[pos];
+      st.fileSize = LOAD_LE32(&resp.payArr[pos + 1]);
+      st.createDateTime = 0;
+      st.writeDateTime = LOAD_LE32(&resp.payArr[pos + 5]);
+      memcpy(st.refArr, &resp.payArr[pos + 9], ENTRY_REF_LEN);
+      memcpy(st.lnStr, &resp.payArr[pos + 10 + ENTRY_REF_LEN], lnLen);
+      st.lnStr[lnLen] = '\0';
+      entFn(&st, arg);
+      pos += 10 + ENTRY_REF_LEN + lnLen;
+    }
+    if (resp.sts == END_OF_DIRECTORY)
+      return END_OF_DIRECTORY;
+
+    memcpy(reqArr, resp.payArr, DIR_CURSOR_LEN);
+    if (rpc_Call(cl, RPC_OP_LIST, reqArr, DIR_CURSOR_LEN + 1, &resp))
+      return -1;
+  }
+}
+
+int rpc_ReadFile(RpcClient *cl, const uint8_t refArr[], uint32_t pos,
+                 uint32_t len, uint8_t dataArr[])
+{
+  uint8_t  reqArr[ENTRY_REF_LEN + 6];
+  uint16_t rangeMax = cl->payloadMax - 1;
+  uint32_t sent = 0;
+  uint32_t done = 0;
+  int      sts = SUCCESS;
+
+  memcpy(reqArr, refArr, ENTRY_REF_LEN);
+  while (done < len)
+  {
+    RpcResp  resp;
+    uint32_t want;
+
+    // ranges are sent while the window has room, and after an error only
+    // the ranges in flight are waited for.
+    while (sts == SUCCESS && sent < len && rpc_CanSend(cl, sizeof(reqArr)))
+    {
+      uint16_t rangeLen = len - sent < rangeMax ? len - sent : rangeMax;
+
+      storeLE(&reqArr[ENTRY_REF_LEN], pos + sent, 4);
+      storeLE(&reqArr[ENTRY_REF_LEN + 4], rangeLen, 2);
+      if (rpc_Send(cl, RPC_OP_READ, reqArr, sizeof(reqArr), sent))
+        return -1;
+      sent += rangeLen;
+    }
+    if (cl->reqCnt == 0)
+      break;
+    if (rpc_Recv(cl, &resp))
+      return -1;
+
+    want = len - resp.tag < rangeMax ? len - resp.tag : rangeMax;
+    if (resp.sts != SUCCESS && resp.sts != END_OF_FILE)
+      sts = resp.sts;
+    else
+    {
+      memcpy(&dataArr[resp.tag], resp.payArr, resp.len);
+      done += resp.len;
+      if (resp.len < want)
+        sts = END_OF_FILE;
+    }
+  }
+  drain(cl);
+  return sts;
+}
+
+int rpc_WriteFile(RpcClient *cl, const uint8_t refArr[], uint32_t pos,
+                  uint32_t len, const uint8_t dataArr[])
+{
+  uint8_t  reqArr[RPC_PAYLOAD_MAX];
+  uint16_t hdrLen = RPC_HDR_LEN + ENTRY_REF_LEN + 4 + RPC_CRC_LEN;
+  uint16_t rangeMax = cl->payloadMax - ENTRY_REF_LEN - 4;
+  uint32_t sent = 0;
+  uint32_t done = 0;
+  int      sts = SUCCESS;
+
+  // ranges are made small enough that two fit in the window, so the next
+  // one is received by the server while it writes the one before.
+  if (cl->windowBytes / 2 > hdrLen && cl->windowBytes / 2 - hdrLen < rangeMax)
+    rangeMax = cl->windowBytes / 2 - hdrLen;
+
+  memcpy(reqArr, refArr, ENTRY_REF_LEN);
+  while (done < len)
+  {
+    RpcResp resp;
+
+    while (sts == SUCCESS && sent < len
+           && rpc_CanSend(cl, ENTRY_REF_LEN + 4 + rangeMax))
+    {
+      uint16_t rangeLen = len - sent < rangeMax ? len - sent : rangeMax;
+
+      storeLE(&reqArr[ENTRY_REF_LEN], pos + sent, 4);
+      memcpy(&reqArr[ENTRY_REF_LEN + 4], &dataArr[sent], rangeLen);
+      if (rpc_Send(cl, RPC_OP_WRITE, reqArr, ENTRY_REF_LEN + 4 + rangeLen,
+                   sent))
+        return -1;
+      sent += rangeLen;
+    }
+    if (cl->reqCnt == 0)
+      break;
+    if (rpc_Recv(cl, &resp))
+      return -1;
+
+    if (resp.sts != SUCCESS && resp.sts != END_OF_FILE)
+      sts = resp.sts;
+    else
+    {
+      uint16_t cnt = LOAD_LE16(resp.payArr);
+
+      done += cnt;
+      if (resp.sts == END_OF_FILE)
+        sts = END_OF_FILE;
+    }
+  }
+  drain(cl);
+  return sts;
+}
+
+int rpc_Sum(RpcClient *cl, const uint8_t refArr[], uint8_t algo,
+            uint32_t *sum)
+{
+  uint8_t reqArr[ENTRY_REF_LEN + 1];
+  RpcResp resp;
+
+  memcpy(reqArr, refArr, ENTRY_REF_LEN);
+  reqArr[ENTRY_REF_LEN] = algo;
+  if (rpc_Call(cl, RPC_OP_SUM, reqArr, sizeof(reqArr), &resp))
+    return -1;
+  if (resp.sts == SUCCESS)
+    *sum = LOAD_LE32(resp.payArr);
+  return resp.sts;
+}
+
+int rpc_Sync(RpcClient *cl)
+{
+  RpcResp resp;
+
+  if (rpc_Call(cl, RPC_OP_SYNC, NULL, 0, &resp))
+    return -1;
+  return resp.sts;
+}
@@ -0,0 +1,140 @@
+/*
+ * File       : RPC_CLIENT.H
+ * Version    : 2.0
+ * Target     : Host PC
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Host side of the binary protocol of FAT_RPC.H, for programs that drive the
+ * 'rpc' command of the test shell over a serial port. Requests are kept in
+ * flight up to the server's window, and are sent again, in order, if a
+ * response does not arrive in time.
+ *
+ * Requires <stdint.h>, <stdio.h>, fat_bpb.h, fat.h and fat_rpc.h to be
+ * included first.
+ */
+
+#ifndef RPC_CLIENT_H
+#define RPC_CLIENT_H
+
+/*
+ ******************************************************************************
+ *                                  MACROS
+ ******************************************************************************
+ */
+
+#define RPC_DEPTH_MAX           16      // most requests in flight
+#define RPC_TIMEOUT_MS          2000    // wait for a response before resend
+#define RPC_RETRY_MAX           5       // resends before giving up
+#define RPC_RX_BUF_LEN          (4 * RPC_FRAME_MAX)
+
+/*
+ ******************************************************************************
+ *                                  STRUCTS
+ ******************************************************************************
+ */
+
+// a response, with the tag its request was sent with.
+typedef struct
+{
+  uint8_t  op;                          // op of the request
+  uint8_t  sts;                         // status byte
+  uint16_t len;                         // bytes of payArr, after the status
+  uint32_t tag;
+  uint8_t  payArr[RPC_PAYLOAD_MAX];
+}
+RpcResp;
+
+// properties of a file or directory, from rpc_Stat or rpc_List.
+typedef struct
+{
+  uint8_t  attr;
+  uint32_t fileSize;
+  uint32_t createDateTime;              // 0 from rpc_List
+  uint32_t writeDateTime;
+  uint8_t  refArr[ENTRY_REF_LEN];
+  char     lnStr[LN_STR_LEN_MAX];
+}
+RpcStat;
+
+// a request that has been sent and not answered.
+typedef struct
+{
+  uint8_t  seq;
+  uint32_t tag;
+  uint16_t frameLen;
+  uint8_t  frameArr[RPC_FRAME_MAX];
+}
+RpcReq;
+
+typedef struct
+{
+  int      fd;
+  uint16_t payloadMax;                  // from the server's RPC_OP_HELLO
+  uint16_t windowBytes;
+  uint8_t  nextSeq;
+  RpcReq   reqArr[RPC_DEPTH_MAX];       // in flight, oldest first
+  uint8_t  reqCnt;
+  uint16_t reqBytes;                    // bytes of the frames in flight
+  uint8_t  rxArr[RPC_RX_BUF_LEN];
+  size_t   rxLen;
+  unsigned long resendCnt;              // requests sent again
+  unsigned long badCnt;                 // frames received with a bad CRC
+}
+RpcClient;
+
+/*
+ ******************************************************************************
+ *                                 FUNCTIONS
+ ******************************************************************************
+ */
+
+//
+// opens the serial port, at baud if it is a terminal, sends "rpc\r" if
+// startCmd is set, and gets the server's limits with RPC_OP_HELLO. Returns 0,
+// or -1 with errno set or a message printed.
+//
+int rpc_Open(RpcClient *cl, const char devStr[], long baud, int startCmd);
+
+// sends RPC_OP_EXIT and closes the port.
+void rpc_Close(RpcClient *cl);
+
+//
+// pipelining. rpc_CanSend is 1 if a request with a payload of len bytes fits
+// in the window now. rpc_Send sends it, with a tag returned in its response,
+// and rpc_Recv waits for the next response to any request in flight, sending
+// every request in flight again each time RPC_TIMEOUT_MS passes without one.
+// Both return 0, or -1 on an error of the port or when the server stops
+// responding.
+//
+int rpc_CanSend(const RpcClient *cl, uint16_t len);
+int rpc_Send(RpcClient *cl, uint8_t op, const uint8_t payArr[], uint16_t len,
+             uint32_t tag);
+int rpc_Recv(RpcClient *cl, RpcResp *resp);
+
+// sends one request and waits for its response. Nothing can be in flight.
+int rpc_Call(RpcClient *cl, uint8_t op, const uint8_t payArr[], uint16_t len,
+             RpcResp *resp);
+
+//
+// the ops. Each returns -1 on an error of the link, otherwise the status of
+// the response, i.e. SUCCESS, a FAT Error Flag or an RPC Error Flag.
+//
+// rpc_List calls entFn with each entry of the directory at pathStr, a page at
+// a time, and returns END_OF_DIRECTORY once they are all listed.
+// rpc_ReadFile reads len bytes from pos, keeping the window full of ranges,
+// and rpc_WriteFile writes them the same way.
+//
+int rpc_Stat(RpcClient *cl, const char pathStr[], RpcStat *st);
+int rpc_List(RpcClient *cl, const char pathStr[],
+             void (*entFn)(const RpcStat *st, void *arg), void *arg);
+int rpc_ReadFile(RpcClient *cl, const uint8_t refArr[], uint32_t pos,
+                 uint32_t len, uint8_t dataArr[]);
+int rpc_WriteFile(RpcClient *cl, const uint8_t refArr[], uint32_t pos,
+                  uint32_t len, const uint8_t dataArr[]);
+int rpc_Sum(RpcClient *cl, const uint8_t refArr[], uint8_t algo,
+            uint32_t *sum);
+int rpc_Sync(RpcClient *cl);
+
+#endif //RPC_CLIENT_H
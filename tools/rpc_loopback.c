@@ -0,0 +1,552 @@
+/*
+ * File       : RPC_LOOPBACK.C
+ * Version    : 2.0
+ * Target     : Host PC
+ * License    : GNU GPLv3
+ * Author     : Joshua Fain
+ * Copyright (c) 2020, 2021
+ *
+ * Host program that runs the RPC server of FAT_RPC.C on a FAT32 image file,
+ * behind a pseudo-terminal, so tools/fat_rpc and RPC_CLIENT.C can be tested
+ * without the AVR. The disk functions of FAT_TO_DISK_IF.H are implemented
+ * here on the image file, in place of FAT_TO_SD.C. See tools/loopback.sh.
+ *
+ * Build : gcc -O2 -I includes/fat -I includes/hlpr -o rpc_loopback
+ *             tools/rpc_loopback.c and the source/fat files but fat_to_sd.c
+ * Usage : rpc_loopback -m imgFile [file ...]
+ *         rpc_loopback [-c n] imgFile
+ *
+ * -m creates imgFile as a FAT32 volume of IMG_SECS sectors, with a copy of
+ * each file in its root directory. The names must be valid 8.3 names. A free
+ * cluster is left after each cluster of a file, so no two of its clusters
+ * are consecutive.
+ *
+ * Otherwise the server is run on imgFile. The name of the pty's slave is
+ * printed on a line of its own, and the server runs until the client sends
+ * the exit request, so 'fat_rpc -n' is run once on it for each server. -c
+ * flips a bit of every n-th byte sent over the link, in each direction.
+ */
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 600
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "fat_bpb.h"
+#include "fat.h"
+#include "fat_to_disk_if.h"
+#include "fat_cache.h"
+#include "fat_rpc.h"
+
+#define IMG_SECS                131072  // sectors of an image made by -m
+#define IMG_RSVD_SECS           32      // reserved region of the image
+#define IMG_FSINFO_SEC          1
+#define IMG_BACKUP_SEC          6       // backup of the boot sector
+#define IMG_DIR_ENTS            (SECTOR_LEN / ENTRY_LEN)
+#define IDLE_US                 200     // sleep while the link is idle
+#define HANGUP_MS               1000    // wait for the client to close
+
+/*
+ ******************************************************************************
+ *                                 IMAGE DISK
+ ******************************************************************************
+ */
+
+static int      imgFd = -1;
+static uint32_t imgSecs;
+
+// the sector of the open write stream, and of the open read stream.
+static int      wrOpen, rdOpen;
+static uint32_t wrSec, rdSec, rdEndSec;
+
+static uint8_t readSec(uint32_t blkNum, uint8_t blkArr[])
+{
+  if (blkNum >= imgSecs
+      || pread(imgFd, blkArr, SECTOR_LEN, (off_t)blkNum * SECTOR_LEN)
+         != SECTOR_LEN)
+    return FAILED_READ_SECTOR;
+  return READ_SECTOR_SUCCESS;
+}
+
+static uint8_t writeSec(uint32_t blkNum, const uint8_t blkArr[])
+{
+  if (blkNum >= imgSecs
+      || pwrite(imgFd, blkArr, SECTOR_LEN, (off_t)blkNum * SECTOR_LEN)
+         != SECTOR_LEN)
+    return FAILED_WRITE_SECTOR;
+  return WRITE_SECTOR_SUCCESS;
+}
+
+// the image is a volume, without a partition table.
+uint32_t FATtoDisk_FindBootSector(void)
+{
+  return 0;
+}
+
+uint8_t FATtoDisk_ReadSingleSector(uint32_t blkNum, uint8_t blkArr[])
+{
+  return readSec(blkNum, blkArr);
+}
+
+uint8_t FATtoDisk_ReadMultipleSectors(uint32_t blkNum, uint32_t numOfBlks,
+                                     uint8_t blkArr[], FatSectorFn secFn,
+                                     void *arg)
+{
+  for (uint32_t blk = 0; blk < numOfBlks; ++blk)
+  {
+    if (readSec(blkNum + blk, blkArr))
+      return FAILED_READ_SECTOR;
+    if (secFn(blkArr, arg))
+      break;
+  }
+  return READ_SECTOR_SUCCESS;
+}
+
+uint8_t FATtoDisk_WriteSingleSector(uint32_t blkNum, const uint8_t blkArr[])
+{
+  return writeSec(blkNum, blkArr);
+}
+
+uint8_t FATtoDisk_WriteMultipleSectors(uint32_t blkNum, uint32_t numOfBlks,
+                                      FatSectorSrcFn secSrcFn, void *arg)
+{
+  for (uint32_t blk = 0; blk < numOfBlks; ++blk)
+    if (writeSec(blkNum + blk, secSrcFn(blk, arg)))
+      return FAILED_WRITE_SECTOR;
+  return WRITE_SECTOR_SUCCESS;
+}
+
+uint32_t FATtoDisk_GetTimeMs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000UL + ts.tv_nsec / 1000000;
+}
+
+uint8_t FATtoDisk_StartStream(uint32_t blkNum)
+{
+  if (wrOpen)
+    return FAILED_WRITE_SECTOR;
+  wrOpen = 1;
+  wrSec = blkNum;
+  return WRITE_SECTOR_SUCCESS;
+}
+
+uint8_t FATtoDisk_StreamSector(const uint8_t blkArr[])
+{
+  if (!wrOpen || writeSec(wrSec, blkArr))
+    return FAILED_WRITE_SECTOR;
+  ++wrSec;
+  return WRITE_SECTOR_SUCCESS;
+}
+
+// the image file is written before FATtoDisk_StreamSector returns.
+uint8_t FATtoDisk_IsBusy(void)
+{
+  return 0;
+}
+
+uint8_t FATtoDisk_StopStream(void)
+{
+  if (!wrOpen)
+    return FAILED_WRITE_SECTOR;
+  wrOpen = 0;
+  return WRITE_SECTOR_SUCCESS;
+}
+
+uint8_t FATtoDisk_StartReadStream(uint32_t blkNum, uint32_t numOfBlks)
+{
+  if (rdOpen)
+    return FAILED_READ_SECTOR;
+  rdOpen = 1;
+  rdSec = blkNum;
+  rdEndSec = blkNum + numOfBlks;
+  return READ_SECTOR_SUCCESS;
+}
+
+uint8_t FATtoDisk_IsReadReady(void)
+{
+  return 1;
+}
+
+uint8_t FATtoDisk_ReadStreamSector(uint8_t blkArr[])
+{
+  if (!rdOpen || rdSec >= rdEndSec || readSec(rdSec, blkArr))
+    return FAILED_READ_SECTOR;
+  ++rdSec;
+  return READ_SECTOR_SUCCESS;
+}
+
+uint8_t FATtoDisk_StopReadStream(void)
+{
+  if (!rdOpen)
+    return FAILED_READ_SECTOR;
+  rdOpen = 0;
+  return READ_SECTOR_SUCCESS;
+}
+
+// a read or write of the image file does not fail, so the list stays empty.
+uint8_t FATtoDisk_OpenBadList(uint32_t blkNum)
+{
+  (void)blkNum;
+  return READ_SECTOR_SUCCESS;
+}
+
+uint8_t FATtoDisk_ClearBadList(void)
+{
+  return WRITE_SECTOR_SUCCESS;
+}
+
+uint8_t FATtoDisk_GetBadCount(void)
+{
+  return 0;
+}
+
+/*
+ ******************************************************************************
+ *                            AVR LIBRARY FUNCTIONS
+ ******************************************************************************
+ */
+
+// PRINTS.C, used by the print functions of FAT.C and FAT_BPB.C.
+void print_Dec(uint32_t num)
+{
+  printf("%u", num);
+}
+
+void print_Bin(uint32_t num)
+{
+  for (int bit = 31; bit >= 0; --bit)
+    putchar(num >> bit & 1 ? '1' : '0');
+}
+
+void print_Hex(uint32_t num)
+{
+  printf("%X", num);
+}
+
+void print_Str(char *str)
+{
+  fputs(str, stdout);
+}
+
+// avr-libc has strlcpy, which glibc only has since 2.38.
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+size_t strlcpy(char *dst, const char *src, size_t len)
+{
+  size_t srcLen = strlen(src);
+
+  if (len)
+  {
+    size_t cpyLen = srcLen < len ? srcLen : len - 1;
+
+    memcpy(dst, src, cpyLen);
+    dst[cpyLen] = '\0';
+  }
+  return srcLen;
+}
+#endif
+
+/*
+ ******************************************************************************
+ *                                 MAKE IMAGE
+ ******************************************************************************
+ */
+
+static void storeLE(uint8_t *byteArr, uint32_t val, int len)
+{
+  for (int byte = 0; byte < len; ++byte, val >>= 8)
+    byteArr[byte] = val;
+}
+
+// sets the 11 characters of a short name from a path's last name.
+static int setShortName(char nameArr[11], const char *pathStr)
+{
+  const char *nameStr = strrchr(pathStr, '/');
+  int         chIndx = 0;
+
+  nameStr = nameStr ? nameStr + 1 : pathStr;
+  memset(nameArr, ' ', 11);
+  for (int fieldLen = 8; *nameStr; ++nameStr)
+  {
+    if (*nameStr == '.' && chIndx <= 8)
+    {
+      chIndx = 8;
+      fieldLen = 3;
+    }
+    else if (!isalnum((unsigned char)*nameStr) && !strchr("_-~", *nameStr))
+      return -1;
+    else if (chIndx >= (fieldLen == 8 ? 8 : 11))
+      return -1;
+    else
+      nameArr[chIndx++] = toupper((unsigned char)*nameStr);
+  }
+  return nameArr[0] == ' ' ? -1 : 0;
+}
+
+static int makeImage(const char *imgStr, int fileCnt, char *fileStrArr[])
+{
+  const uint32_t fatSecs = ((IMG_SECS - IMG_RSVD_SECS) / (SECTOR_LEN / 4) + 1);
+  const uint32_t dataSec = IMG_RSVD_SECS + 2 * fatSecs;
+  const uint32_t clusCnt = IMG_SECS - dataSec;
+  const uint32_t dirClus = (fileCnt + IMG_DIR_ENTS) / IMG_DIR_ENTS;
+  uint32_t      *fatArr = calloc(clusCnt + 2, sizeof(uint32_t));
+  uint8_t        secArr[SECTOR_LEN];
+  uint32_t       nextClus = 2 + dirClus;
+  time_t         now = time(NULL);
+  struct tm     *tm = localtime(&now);
+  uint16_t       date = (tm->tm_year - 80) << 9 | (tm->tm_mon + 1) << 5
+                        | tm->tm_mday;
+  uint16_t       tim = tm->tm_hour << 11 | tm->tm_min << 5 | tm->tm_sec / 2;
+  uint8_t       *dirArr = calloc(dirClus, SECTOR_LEN);
+  int            ret = 0;
+
+  if (!fatArr || !dirArr)
+    return -1;
+  imgFd = open(imgStr, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (imgFd < 0 || ftruncate(imgFd, (off_t)IMG_SECS * SECTOR_LEN))
+  {
+    perror(imgStr);
+    return -1;
+  }
+  imgSecs = IMG_SECS;
+
+  // boot sector, and its backup.
+  memset(secArr, 0, SECTOR_LEN);
+  memcpy(secArr, "\xEB\x58\x90" "MSWIN4.1", 11);
+  storeLE(&secArr[11], SECTOR_LEN, 2);
+  secArr[13] = 1;                                   // sectors per cluster
+  storeLE(&secArr[14], IMG_RSVD_SECS, 2);
+  secArr[16] = 2;                                   // FATs
+  secArr[21] = 0xF8;                                // media
+  storeLE(&secArr[24], 32, 2);                      // sectors per track
+  storeLE(&secArr[26], 64, 2);                      // heads
+  storeLE(&secArr[32], IMG_SECS, 4);
+  storeLE(&secArr[36], fatSecs, 4);
+  storeLE(&secArr[44], 2, 4);                       // root cluster
+  storeLE(&secArr[48], IMG_FSINFO_SEC, 2);
+  storeLE(&secArr[50], IMG_BACKUP_SEC, 2);
+  secArr[64] = 0x80;                                // drive number
+  secArr[66] = 0x29;                                // extended boot sig
+  storeLE(&secArr[67], (uint32_t)now, 4);           // volume ID
+  memcpy(&secArr[71], "NO NAME    FAT32   ", 19);
+  secArr[SECTOR_LEN - 2] = BS_SIGN_1;
+  secArr[SECTOR_LEN - 1] = BS_SIGN_2;
+  writeSec(0, secArr);
+  writeSec(IMG_BACKUP_SEC, secArr);
+
+  // FSInfo, with the free count and next free cluster unknown.
+  memset(secArr, 0, SECTOR_LEN);
+  storeLE(&secArr[0], 0x41615252, 4);
+  storeLE(&secArr[484], 0x61417272, 4);
+  storeLE(&secArr[488], 0xFFFFFFFF, 4);
+  storeLE(&secArr[492], 0xFFFFFFFF, 4);
+  storeLE(&secArr[508], 0xAA550000, 4);
+  writeSec(IMG_FSINFO_SEC, secArr);
+  writeSec(IMG_BACKUP_SEC + 1, secArr);
+
+  // the root directory's clusters are consecutive, from cluster 2.
+  fatArr[0] = 0x0FFFFFF8;
+  fatArr[1] = 0x0FFFFFFF;
+  for (uint32_t clus = 2; clus < 2 + dirClus; ++clus)
+    fatArr[clus] = clus + 1 < 2 + dirClus ? clus + 1 : 0x0FFFFFFF;
+
+  for (int file = 0; file < fileCnt && !ret; ++file)
+  {
+    uint8_t *entArr = &dirArr[file * ENTRY_LEN];
+    uint32_t fileSize = 0, firstClus = 0, prevClus = 0;
+    FILE    *fp = fopen(fileStrArr[file], "rb");
+    size_t   len;
+
+    if (!fp)
+    {
+      perror(fileStrArr[file]);
+      ret = -1;
+      break;
+    }
+    if (setShortName((char *)entArr, fileStrArr[file]))
+    {
+      fprintf(stderr, "%s: not an 8.3 name\n", fileStrArr[file]);
+      ret = -1;
+    }
+    while (!ret && (len = fread(secArr, 1, SECTOR_LEN, fp)) > 0)
+    {
+      if (nextClus >= clusCnt + 2)
+      {
+        fprintf(stderr, "%s: image is full\n", fileStrArr[file]);
+        ret = -1;
+        break;
+      }
+      memset(&secArr[len], 0, SECTOR_LEN - len);
+      writeSec(dataSec + nextClus - 2, secArr);
+      fatArr[nextClus] = 0x0FFFFFFF;
+      if (prevClus)
+        fatArr[prevClus] = nextClus;
+      else
+        firstClus = nextClus;
+      prevClus = nextClus;
+      nextClus += 2;
+      fileSize += len;
+    }
+    fclose(fp);
+
+    entArr[11] = 0x20;                              // archive
+    storeLE(&entArr[14], tim, 2);
+    storeLE(&entArr[16], date, 2);
+    storeLE(&entArr[18], date, 2);
+    storeLE(&entArr[20], firstClus >> 16, 2);
+    storeLE(&entArr[22], tim, 2);
+    storeLE(&entArr[24], date, 2);
+    storeLE(&entArr[26], firstClus & 0xFFFF, 2);
+    storeLE(&entArr[28], fileSize, 4);
+  }
+
+  for (uint32_t sec = 0; sec < dirClus; ++sec)
+    writeSec(dataSec + sec, &dirArr[sec * SECTOR_LEN]);
+  for (int fat = 0; fat < 2; ++fat)
+    for (uint32_t sec = 0; sec < fatSecs; ++sec)
+    {
+      memset(secArr, 0, SECTOR_LEN);
+      for (uint32_t ent = 0; ent < SECTOR_LEN / 4; ++ent)
+        if (sec * (SECTOR_LEN / 4) + ent < clusCnt + 2)
+          storeLE(&secArr[ent * 4],
+                  fatArr[sec * (SECTOR_LEN / 4) + ent], 4);
+      writeSec(IMG_RSVD_SECS + fat * fatSecs + sec, secArr);
+    }
+
+  free(fatArr);
+  free(dirArr);
+  close(imgFd);
+  return ret;
+}
+
+/*
+ ******************************************************************************
+ *                                   SERVER
+ ******************************************************************************
+ */
+
+static int      ptyFd = -1;
+static long     corruptN;
+static uint32_t linkCnt;
+
+// flips a bit of every corruptN-th byte of the link.
+static uint8_t passByte(uint8_t byte)
+{
+  if (corruptN && ++linkCnt % corruptN == 0)
+    byte ^= 0x10;
+  return byte;
+}
+
+static void txByte(uint8_t byte)
+{
+  byte = passByte(byte);
+  while (write(ptyFd, &byte, 1) != 1 && (errno == EINTR || errno == EAGAIN))
+    ;
+}
+
+static int runServer(const char *imgStr)
+{
+  struct termios tio;
+  FatRpc         rpc;
+  BPB            bpb;
+  uint8_t        err;
+  int            slaveFd;
+
+  imgFd = open(imgStr, O_RDWR);
+  if (imgFd < 0)
+  {
+    perror(imgStr);
+    return 1;
+  }
+  imgSecs = lseek(imgFd, 0, SEEK_END) / SECTOR_LEN;
+  if ((err = fat_SetBPB(&bpb)) != BPB_VALID)
+  {
+    fprintf(stderr, "%s: fat_SetBPB returned 0x%02X\n", imgStr, err);
+    return 1;
+  }
+
+  // the slave is held open, and raw, so the pty is not closed between the
+  // client's calls, and its line discipline does not change the frames.
+  ptyFd = posix_openpt(O_RDWR | O_NOCTTY);
+  if (ptyFd < 0 || grantpt(ptyFd) || unlockpt(ptyFd)
+      || (slaveFd = open(ptsname(ptyFd), O_RDWR | O_NOCTTY)) < 0)
+  {
+    perror("pty");
+    return 1;
+  }
+  tcgetattr(slaveFd, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(slaveFd, TCSANOW, &tio);
+  printf("%s\n", ptsname(ptyFd));
+  fflush(stdout);
+
+  fat_RpcInit(&rpc, txByte);
+  err = STEP_BUSY;
+  do
+  {
+    struct pollfd pfd = { ptyFd, POLLIN, 0 };
+    uint8_t       byte;
+
+    if (poll(&pfd, 1, 0) > 0 && read(ptyFd, &byte, 1) == 1)
+      err = fat_RpcRxByte(&rpc, passByte(byte), &bpb);
+    else
+    {
+      fat_RpcIdle(&rpc, &bpb);
+      usleep(IDLE_US);
+    }
+  }
+  while (err != RPC_EXIT);
+
+  err = fat_Sync();
+  fprintf(stderr, "server: %u frames, %u dropped\n", rpc.frameCnt,
+          rpc.badCnt);
+
+  // closing the master drops what the client has not read yet, i.e. the
+  // response to the exit request, so it is held open until the client closes
+  // the slave, or HANGUP_MS passes.
+  close(slaveFd);
+  for (uint32_t startMs = FATtoDisk_GetTimeMs();
+       FATtoDisk_GetTimeMs() - startMs < HANGUP_MS; )
+  {
+    struct pollfd pfd = { ptyFd, POLLIN, 0 };
+    uint8_t       byte;
+
+    if (poll(&pfd, 1, HANGUP_MS) > 0 && (pfd.revents & POLLHUP
+                                         || read(ptyFd, &byte, 1) != 1))
+      break;
+  }
+  close(ptyFd);
+  close(imgFd);
+  return err != SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+  int arg = 1;
+
+  if (arg < argc && !strcmp(argv[arg], "-m") && arg + 1 < argc)
+    return makeImage(argv[arg + 1], argc - arg - 2, &argv[arg + 2]) != 0;
+
+  if (arg + 1 < argc && !strcmp(argv[arg], "-c"))
+  {
+    corruptN = atol(argv[arg + 1]);
+    arg += 2;
+  }
+  if (arg + 1 != argc)
+  {
+    fprintf(stderr, "usage: %s -m imgFile [file ...]\n"
+                    "       %s [-c n] imgFile\n", argv[0], argv[0]);
+    return 1;
+  }
+  return runServer(argv[arg]);
+}